@@ -0,0 +1,391 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Batch read memory and latency benchmark.  Loads records, then reads batches
+// of 1k, 10k and 100k keys with aerospike_batch_get(), which passes all
+// results to one callback, and with aerospike_batch_get_foreach(), which
+// passes each record to the callback as it is parsed.
+//
+// Reports time to the first record, total time and peak memory growth of the
+// batch call.  Each measurement runs in a new process, so peak memory of one
+// run does not hide another's.
+//
+// Usage: target/batch_bench [-h host] [-p port] [-n namespace] [-s set]
+//        [-k keys]... [-b bin_size] [-m max_keys_per_request] [-r repeat] [-c] [-D] [-L]
+//        -m splits each node's keys into sub-batches of this size.
+//        -r requests each distinct key this many times in a batch.
+//        -c runs node commands concurrently.
+//        -D sends duplicate keys only once.
+//        -L skips loading records.
+//
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_record.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct {
+	uint64_t first_ns;
+	uint64_t total_ns;
+	long rss_kb;
+	uint32_t found;
+	int status;
+} batch_result;
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+static const char* g_host = "127.0.0.1";
+static int g_port = 3000;
+static const char* g_ns = "test";
+static const char* g_set = "batchbench";
+static bool g_concurrent = false;
+static uint32_t g_max_keys = 0;
+static uint32_t g_repeat = 1;
+static bool g_deduplicate = false;
+
+static uint64_t g_begin;
+static uint64_t g_first;
+static uint32_t g_found;
+
+/******************************************************************************
+ *	HELPERS
+ *****************************************************************************/
+
+static inline uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long
+max_rss_kb()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+static bool
+connect_cluster(aerospike* as)
+{
+	as_config cfg;
+	as_config_init(&cfg);
+	as_config_add_host(&cfg, g_host, g_port);
+	aerospike_init(as, &cfg);
+
+	as_error err;
+
+	if (aerospike_connect(as, &err) != AEROSPIKE_OK) {
+		fprintf(stderr, "Connect failed: %d %s\n", err.code, err.message);
+		aerospike_destroy(as);
+		return false;
+	}
+	return true;
+}
+
+static int
+load(aerospike* as, uint32_t n_records, uint32_t bin_size)
+{
+	as_error err;
+	char* str = malloc(bin_size + 1);
+
+	memset(str, 'x', bin_size);
+	str[bin_size] = 0;
+
+	for (uint32_t i = 0; i < n_records; i++) {
+		as_key key;
+		as_key_init_int64(&key, g_ns, g_set, i);
+
+		as_record rec;
+		as_record_inita(&rec, 2);
+		as_record_set_int64(&rec, "id", i);
+		as_record_set_str(&rec, "s", str);
+
+		if (aerospike_key_put(as, &err, NULL, &key, &rec) != AEROSPIKE_OK) {
+			fprintf(stderr, "Put failed: %d %s\n", err.code, err.message);
+			as_record_destroy(&rec);
+			free(str);
+			return -1;
+		}
+		as_record_destroy(&rec);
+	}
+	free(str);
+	return 0;
+}
+
+/******************************************************************************
+ *	CALLBACKS
+ *****************************************************************************/
+
+static bool
+all_callback(const as_batch_read* results, uint32_t n, void* udata)
+{
+	g_first = now_ns();
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (results[i].result == AEROSPIKE_OK) {
+			g_found++;
+		}
+	}
+	return true;
+}
+
+static bool
+foreach_callback(const as_batch_read* result, void* udata)
+{
+	uint64_t now = now_ns();
+
+	// Callbacks may run in parallel when node commands are concurrent.
+	__sync_bool_compare_and_swap(&g_first, 0, now);
+
+	if (result->result == AEROSPIKE_OK) {
+		__sync_fetch_and_add(&g_found, 1);
+	}
+	return true;
+}
+
+/******************************************************************************
+ *	BENCHMARK
+ *****************************************************************************/
+
+static void
+run(uint32_t n_keys, bool foreach, batch_result* result)
+{
+	memset(result, 0, sizeof(batch_result));
+
+	aerospike as;
+
+	if (! connect_cluster(&as)) {
+		result->status = -1;
+		return;
+	}
+
+	as_batch batch;
+	as_batch_init(&batch, n_keys);
+
+	for (uint32_t i = 0; i < n_keys; i++) {
+		as_key_init_int64(as_batch_keyat(&batch, i), g_ns, g_set, i / g_repeat);
+	}
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.concurrent = g_concurrent;
+	policy.max_keys_per_request = g_max_keys;
+	policy.deduplicate = g_deduplicate;
+	policy.timeout = 10000;
+
+	as_error err;
+	long rss = max_rss_kb();
+
+	g_first = 0;
+	g_found = 0;
+	g_begin = now_ns();
+
+	as_status status = foreach ?
+		aerospike_batch_get_foreach(&as, &err, &policy, &batch, foreach_callback, NULL) :
+		aerospike_batch_get(&as, &err, &policy, &batch, all_callback, NULL);
+
+	uint64_t end = now_ns();
+
+	if (status != AEROSPIKE_OK) {
+		fprintf(stderr, "Batch failed: %d %s\n", err.code, err.message);
+	}
+
+	result->status = status;
+	result->first_ns = g_first ? g_first - g_begin : 0;
+	result->total_ns = end - g_begin;
+	result->rss_kb = max_rss_kb() - rss;
+	result->found = g_found;
+
+	as_batch_destroy(&batch);
+	aerospike_close(&as, &err);
+	aerospike_destroy(&as);
+}
+
+/**
+ *	Run in a child process, so peak memory only covers this batch.
+ */
+static bool
+run_process(uint32_t n_keys, bool foreach, batch_result* result)
+{
+	int fds[2];
+
+	if (pipe(fds) != 0) {
+		return false;
+	}
+
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		close(fds[0]);
+		run(n_keys, foreach, result);
+		ssize_t rv = write(fds[1], result, sizeof(batch_result));
+		_exit(rv == sizeof(batch_result) ? 0 : 1);
+	}
+
+	close(fds[1]);
+
+	bool ok = pid > 0 && read(fds[0], result, sizeof(batch_result)) == sizeof(batch_result);
+	close(fds[0]);
+
+	if (pid > 0) {
+		waitpid(pid, 0, 0);
+	}
+	return ok && result->status == AEROSPIKE_OK;
+}
+
+/******************************************************************************
+ *	MAIN
+ *****************************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t sizes[16];
+	uint32_t n_sizes = 0;
+	uint32_t bin_size = 100;
+	bool do_load = true;
+	int c;
+
+	while ((c = getopt(argc, argv, "h:p:n:s:k:b:m:r:cDL")) != -1) {
+		switch (c) {
+			case 'h':
+				g_host = optarg;
+				break;
+
+			case 'p':
+				g_port = atoi(optarg);
+				break;
+
+			case 'n':
+				g_ns = optarg;
+				break;
+
+			case 's':
+				g_set = optarg;
+				break;
+
+			case 'k':
+				if (n_sizes < sizeof(sizes) / sizeof(uint32_t)) {
+					sizes[n_sizes++] = (uint32_t)atoi(optarg);
+				}
+				break;
+
+			case 'b':
+				bin_size = (uint32_t)atoi(optarg);
+				break;
+
+			case 'm':
+				g_max_keys = (uint32_t)atoi(optarg);
+				break;
+
+			case 'r':
+				g_repeat = (uint32_t)atoi(optarg);
+
+				if (g_repeat == 0) {
+					g_repeat = 1;
+				}
+				break;
+
+			case 'c':
+				g_concurrent = true;
+				break;
+
+			case 'D':
+				g_deduplicate = true;
+				break;
+
+			case 'L':
+				do_load = false;
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-h host] [-p port] [-n namespace] [-s set] [-k keys]... [-b bin_size] [-m max_keys_per_request] [-r repeat] [-c] [-D] [-L]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (n_sizes == 0) {
+		sizes[n_sizes++] = 1000;
+		sizes[n_sizes++] = 10000;
+		sizes[n_sizes++] = 100000;
+	}
+
+	uint32_t max_keys = 0;
+
+	for (uint32_t i = 0; i < n_sizes; i++) {
+		if (sizes[i] > max_keys) {
+			max_keys = sizes[i];
+		}
+	}
+
+	if (do_load) {
+		aerospike as;
+
+		if (! connect_cluster(&as)) {
+			return 1;
+		}
+
+		int rv = load(&as, max_keys, bin_size);
+		as_error err;
+		aerospike_close(&as, &err);
+		aerospike_destroy(&as);
+
+		if (rv != 0) {
+			return 1;
+		}
+	}
+
+	printf("%8s %8s %8s %14s %14s %14s\n", "keys", "mode", "found", "first ms", "total ms", "peak mem KB");
+
+	for (uint32_t i = 0; i < n_sizes; i++) {
+		for (int foreach = 0; foreach <= 1; foreach++) {
+			batch_result result;
+
+			if (! run_process(sizes[i], foreach, &result)) {
+				return 1;
+			}
+			printf("%8u %8s %8u %14.3f %14.3f %14ld\n", sizes[i], foreach ? "foreach" : "all", result.found,
+				(double)result.first_ns / 1000000.0, (double)result.total_ns / 1000000.0, result.rss_kb);
+		}
+	}
+	return 0;
+}
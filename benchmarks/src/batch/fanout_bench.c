@@ -0,0 +1,371 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Concurrent batch caller benchmark.  Many application threads share one
+// client and each runs concurrent batch reads back to back, so every batch
+// fans out to all nodes at once.
+//
+// Reports batches per second, mean and 99th percentile batch latency and the
+// number of process threads, for each caller count.  Node commands are
+// multiplexed in the calling thread, so the thread count should only be the
+// callers plus the client's fixed threads, and a small thread pool (-P) should
+// not limit throughput.
+//
+// Usage: target/fanout_bench [-h host] [-p port] [-n namespace] [-s set]
+//        [-t callers]... [-k keys] [-d seconds] [-P thread_pool_size] [-L]
+//        -L skips loading records.
+//
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_record.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct {
+	aerospike* as;
+	uint64_t* latencies;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t errors;
+} caller;
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+static const char* g_host = "127.0.0.1";
+static int g_port = 3000;
+static const char* g_ns = "test";
+static const char* g_set = "fanoutbench";
+static uint32_t g_keys = 1000;
+static uint32_t g_seconds = 5;
+static uint32_t g_pool_size = 0;
+
+static volatile bool g_running;
+static volatile uint32_t g_max_threads;
+
+/******************************************************************************
+ *	HELPERS
+ *****************************************************************************/
+
+static inline uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t
+process_threads()
+{
+	FILE* fp = fopen("/proc/self/status", "r");
+
+	if (! fp) {
+		return 0;
+	}
+
+	char line[256];
+	uint32_t threads = 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "Threads:", 8) == 0) {
+			threads = (uint32_t)atoi(line + 8);
+			break;
+		}
+	}
+	fclose(fp);
+	return threads;
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static bool
+connect_cluster(aerospike* as)
+{
+	as_config cfg;
+	as_config_init(&cfg);
+	as_config_add_host(&cfg, g_host, g_port);
+
+	if (g_pool_size) {
+		cfg.thread_pool_size = g_pool_size;
+	}
+	aerospike_init(as, &cfg);
+
+	as_error err;
+
+	if (aerospike_connect(as, &err) != AEROSPIKE_OK) {
+		fprintf(stderr, "Connect failed: %d %s\n", err.code, err.message);
+		aerospike_destroy(as);
+		return false;
+	}
+	return true;
+}
+
+static int
+load(aerospike* as, uint32_t n_records)
+{
+	as_error err;
+
+	for (uint32_t i = 0; i < n_records; i++) {
+		as_key key;
+		as_key_init_int64(&key, g_ns, g_set, i);
+
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "id", i);
+
+		if (aerospike_key_put(as, &err, NULL, &key, &rec) != AEROSPIKE_OK) {
+			fprintf(stderr, "Put failed: %d %s\n", err.code, err.message);
+			as_record_destroy(&rec);
+			return -1;
+		}
+		as_record_destroy(&rec);
+	}
+	return 0;
+}
+
+/******************************************************************************
+ *	BENCHMARK
+ *****************************************************************************/
+
+static bool
+count_callback(const as_batch_read* result, void* udata)
+{
+	return true;
+}
+
+static void*
+run_caller(void* udata)
+{
+	caller* c = udata;
+
+	as_batch batch;
+	as_batch_init(&batch, g_keys);
+
+	for (uint32_t i = 0; i < g_keys; i++) {
+		as_key_init_int64(as_batch_keyat(&batch, i), g_ns, g_set, i);
+	}
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.concurrent = true;
+	policy.timeout = 10000;
+
+	as_error err;
+
+	while (g_running) {
+		uint64_t begin = now_ns();
+
+		if (aerospike_batch_get_foreach(c->as, &err, &policy, &batch, count_callback, NULL) != AEROSPIKE_OK) {
+			c->errors++;
+			continue;
+		}
+
+		uint32_t threads = process_threads();
+
+		if (threads > g_max_threads) {
+			g_max_threads = threads;
+		}
+
+		if (c->count == c->capacity) {
+			c->capacity *= 2;
+			c->latencies = realloc(c->latencies, sizeof(uint64_t) * c->capacity);
+		}
+		c->latencies[c->count++] = now_ns() - begin;
+	}
+	as_batch_destroy(&batch);
+	return NULL;
+}
+
+static bool
+run(aerospike* as, uint32_t n_callers)
+{
+	caller* callers = calloc(n_callers, sizeof(caller));
+	pthread_t* threads = malloc(sizeof(pthread_t) * n_callers);
+
+	g_running = true;
+	g_max_threads = 0;
+
+	for (uint32_t i = 0; i < n_callers; i++) {
+		callers[i].as = as;
+		callers[i].capacity = 1024;
+		callers[i].latencies = malloc(sizeof(uint64_t) * callers[i].capacity);
+
+		if (pthread_create(&threads[i], NULL, run_caller, &callers[i]) != 0) {
+			fprintf(stderr, "Failed to create caller thread\n");
+			g_running = false;
+			n_callers = i;
+			break;
+		}
+	}
+
+	sleep(g_seconds);
+	g_running = false;
+
+	uint32_t total = 0;
+	uint32_t errors = 0;
+
+	for (uint32_t i = 0; i < n_callers; i++) {
+		pthread_join(threads[i], NULL);
+		total += callers[i].count;
+		errors += callers[i].errors;
+	}
+
+	uint64_t* all = malloc(sizeof(uint64_t) * (total ? total : 1));
+	uint32_t n = 0;
+	uint64_t sum = 0;
+
+	for (uint32_t i = 0; i < n_callers; i++) {
+		for (uint32_t j = 0; j < callers[i].count; j++) {
+			all[n++] = callers[i].latencies[j];
+			sum += callers[i].latencies[j];
+		}
+		free(callers[i].latencies);
+	}
+	qsort(all, n, sizeof(uint64_t), compare_u64);
+
+	double mean_ms = n ? (double)sum / n / 1000000.0 : 0;
+	double p99_ms = n ? (double)all[(uint64_t)n * 99 / 100] / 1000000.0 : 0;
+
+	printf("%8u %12.1f %12.3f %12.3f %8u %8u\n", n_callers, (double)total / g_seconds, mean_ms, p99_ms,
+		g_max_threads, errors);
+
+	free(all);
+	free(threads);
+	free(callers);
+	return errors == 0;
+}
+
+/******************************************************************************
+ *	MAIN
+ *****************************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t counts[16];
+	uint32_t n_counts = 0;
+	bool do_load = true;
+	int c;
+
+	while ((c = getopt(argc, argv, "h:p:n:s:t:k:d:P:L")) != -1) {
+		switch (c) {
+			case 'h':
+				g_host = optarg;
+				break;
+
+			case 'p':
+				g_port = atoi(optarg);
+				break;
+
+			case 'n':
+				g_ns = optarg;
+				break;
+
+			case 's':
+				g_set = optarg;
+				break;
+
+			case 't':
+				if (n_counts < sizeof(counts) / sizeof(uint32_t)) {
+					counts[n_counts++] = (uint32_t)atoi(optarg);
+				}
+				break;
+
+			case 'k':
+				g_keys = (uint32_t)atoi(optarg);
+				break;
+
+			case 'd':
+				g_seconds = (uint32_t)atoi(optarg);
+				break;
+
+			case 'P':
+				g_pool_size = (uint32_t)atoi(optarg);
+				break;
+
+			case 'L':
+				do_load = false;
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-h host] [-p port] [-n namespace] [-s set] [-t callers]... [-k keys] [-d seconds] [-P thread_pool_size] [-L]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (n_counts == 0) {
+		counts[n_counts++] = 1;
+		counts[n_counts++] = 8;
+		counts[n_counts++] = 32;
+		counts[n_counts++] = 128;
+	}
+
+	aerospike as;
+
+	if (! connect_cluster(&as)) {
+		return 1;
+	}
+
+	if (do_load && load(&as, g_keys) != 0) {
+		as_error err;
+		aerospike_close(&as, &err);
+		aerospike_destroy(&as);
+		return 1;
+	}
+
+	printf("%8s %12s %12s %12s %8s %8s\n", "callers", "batches/s", "mean ms", "p99 ms", "threads", "errors");
+
+	int rv = 0;
+
+	for (uint32_t i = 0; i < n_counts; i++) {
+		if (! run(&as, counts[i])) {
+			rv = 1;
+		}
+	}
+
+	as_error err;
+	aerospike_close(&as, &err);
+	aerospike_destroy(&as);
+	return rv;
+}
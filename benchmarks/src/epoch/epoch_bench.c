@@ -0,0 +1,357 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Command routing scaling microbenchmark.  Builds an in-memory cluster of
+// fake nodes and one namespace partition table, then measures node lookups per
+// second for 1, 2, 4 ... max threads using:
+//
+//   refcount  The previous routing path: partition tables and node reference
+//             counts incremented and decremented on every lookup.
+//   reserve   as_epoch_enter(), as_node_select(), as_node_reserve(), as_epoch_exit(),
+//             then as_node_release() once the node has been used.
+//   hazard    The sync command path: as_epoch_enter(), as_node_select(),
+//             as_epoch_protect(), as_epoch_exit(), then as_epoch_unprotect() once the
+//             node has been used.  No shared cache line is written per lookup.
+//
+// Reserve and hazard use a pre-resolved namespace handle.  The node is read
+// after leaving the epoch, as a command does while it waits on the network.
+//
+// A tender thread retires a copy of the nodes array and reclaims every
+// millisecond, so epoch reclamation runs concurrently with the readers.
+// No server is required.
+//
+// Usage: target/epoch_bench [-t max_threads] [-d duration_ms] [-n nodes]
+//
+
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_epoch.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_partition.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef enum {
+	MODE_REFCOUNT,
+	MODE_RESERVE,
+	MODE_HAZARD
+} bench_mode;
+
+typedef struct {
+	as_cluster* cluster;
+	as_namespace_handle* handle;
+	bench_mode mode;
+	volatile bool* stop;
+	uint64_t seed;
+	uint64_t ops;
+	uint8_t pad[64];
+} bench_thread;
+
+/******************************************************************************
+ *	HELPERS
+ *****************************************************************************/
+
+static const char* NAMESPACE = "test";
+
+// Keeps node loads from being optimized away.
+static volatile uint64_t sink;
+
+static inline uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline uint64_t
+next_random(uint64_t* seed)
+{
+	uint64_t x = *seed;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*seed = x;
+	return x;
+}
+
+static as_nodes*
+nodes_create(uint32_t capacity)
+{
+	size_t size = sizeof(as_nodes) + (sizeof(as_node*) * capacity);
+	as_nodes* nodes = calloc(1, size);
+	nodes->ref_count = 1;
+	nodes->size = capacity;
+	return nodes;
+}
+
+static void
+nodes_release(void* data)
+{
+	as_nodes_release(data);
+}
+
+/**
+ *	Build cluster with n_nodes fake nodes and a partition table for NAMESPACE.
+ */
+static as_cluster*
+cluster_create(uint32_t n_nodes)
+{
+	as_cluster* cluster = calloc(1, sizeof(as_cluster));
+	cluster->n_partitions = 4096;
+	cluster->epoch = as_epoch_create();
+	cluster->nodes = nodes_create(n_nodes);
+
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		as_node* node = calloc(1, sizeof(as_node));
+		snprintf(node->name, sizeof(node->name), "BB9%013X", i);
+		node->ref_count = 1;
+		node->active = 1;
+		cluster->nodes->array[i] = node;
+	}
+
+	as_partition_table* table = calloc(1, sizeof(as_partition_table) + sizeof(as_partition) * cluster->n_partitions);
+	strcpy(table->ns, NAMESPACE);
+	table->size = cluster->n_partitions;
+
+	for (uint32_t i = 0; i < table->size; i++) {
+		table->partitions[i].master = cluster->nodes->array[i % n_nodes];
+		table->partitions[i].prole = cluster->nodes->array[(i + 1) % n_nodes];
+	}
+
+	cluster->partition_tables = as_partition_tables_create(1);
+	cluster->partition_tables->array[0] = table;
+	return cluster;
+}
+
+/******************************************************************************
+ *	THREADS
+ *****************************************************************************/
+
+/**
+ *	Previous routing path, before epochs.
+ */
+static inline as_node*
+lookup_refcount(as_cluster* cluster, const uint8_t* digest)
+{
+	as_partition_tables* tables = ck_pr_load_ptr(&cluster->partition_tables);
+	ck_pr_inc_32(&tables->ref_count);
+	as_partition_table* table = as_partition_tables_get(tables, NAMESPACE);
+	as_partition_tables_release(tables);
+
+	as_partition* p = &table->partitions[as_partition_getid(digest, cluster->n_partitions)];
+	as_node* node = ck_pr_load_ptr(&p->master);
+	as_node_reserve(node);
+	return node;
+}
+
+static void*
+reader(void* udata)
+{
+	bench_thread* t = udata;
+	as_cluster* cluster = t->cluster;
+	uint8_t digest[AS_DIGEST_VALUE_SIZE];
+	uint64_t ops = 0;
+	uint64_t sum = 0;
+
+	memset(digest, 0, sizeof(digest));
+
+	while (! ck_pr_load_8((uint8_t*)t->stop)) {
+		for (uint32_t i = 0; i < 256; i++) {
+			*(uint64_t*)digest = next_random(&t->seed);
+			as_node* node;
+
+			switch (t->mode) {
+				case MODE_REFCOUNT:
+					node = lookup_refcount(cluster, digest);
+					sum += node->name[15];
+					as_node_release(node);
+					break;
+
+				case MODE_RESERVE: {
+					as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+					node = as_node_select(cluster, NAMESPACE, t->handle, digest, false, AS_POLICY_REPLICA_MASTER);
+					as_node_reserve(node);
+					as_epoch_exit(slot);
+					sum += node->name[15];
+					as_node_release(node);
+					break;
+				}
+
+				default: {
+					as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+					node = as_node_select(cluster, NAMESPACE, t->handle, digest, false, AS_POLICY_REPLICA_MASTER);
+					as_epoch_protect(0, node);
+					as_epoch_exit(slot);
+					sum += node->name[15];
+					as_epoch_unprotect(0);
+					break;
+				}
+			}
+		}
+		ops += 256;
+	}
+	sink += sum;
+	t->ops = ops;
+	return 0;
+}
+
+static void*
+tender(void* udata)
+{
+	bench_thread* t = udata;
+	as_cluster* cluster = t->cluster;
+
+	while (! ck_pr_load_8((uint8_t*)t->stop)) {
+		// Replace nodes array with a copy and retire the old one, as a cluster tend does.
+		as_nodes* old = cluster->nodes;
+		as_nodes* nodes = nodes_create(old->size);
+		memcpy(nodes->array, old->array, sizeof(as_node*) * old->size);
+		ck_pr_fence_store();
+		ck_pr_store_ptr(&cluster->nodes, nodes);
+		as_epoch_retire(cluster->epoch, old, nodes_release);
+		t->ops += as_epoch_reclaim(cluster->epoch);
+		usleep(1000);
+	}
+	return 0;
+}
+
+static double
+run(as_cluster* cluster, as_namespace_handle* handle, bench_mode mode, uint32_t n_threads, uint32_t duration_ms,
+	uint64_t* reclaimed)
+{
+	volatile bool stop = false;
+	bench_thread* threads = calloc(n_threads + 1, sizeof(bench_thread));
+	pthread_t* ids = calloc(n_threads + 1, sizeof(pthread_t));
+
+	for (uint32_t i = 0; i <= n_threads; i++) {
+		threads[i].cluster = cluster;
+		threads[i].handle = handle;
+		threads[i].mode = mode;
+		threads[i].stop = &stop;
+		threads[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+	}
+
+	uint64_t begin = now_ns();
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		pthread_create(&ids[i], 0, reader, &threads[i]);
+	}
+	pthread_create(&ids[n_threads], 0, tender, &threads[n_threads]);
+
+	usleep(duration_ms * 1000);
+	ck_pr_store_8((uint8_t*)&stop, 1);
+
+	uint64_t ops = 0;
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		pthread_join(ids[i], 0);
+		ops += threads[i].ops;
+	}
+	pthread_join(ids[n_threads], 0);
+
+	double seconds = (double)(now_ns() - begin) / 1000000000.0;
+	*reclaimed = threads[n_threads].ops;
+	free(threads);
+	free(ids);
+	return (double)ops / seconds;
+}
+
+/******************************************************************************
+ *	MAIN
+ *****************************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t max_threads = 128;
+	uint32_t duration_ms = 2000;
+	uint32_t n_nodes = 8;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:d:n:")) != -1) {
+		switch (c) {
+			case 't':
+				max_threads = (uint32_t)atoi(optarg);
+				break;
+
+			case 'd':
+				duration_ms = (uint32_t)atoi(optarg);
+				break;
+
+			case 'n':
+				n_nodes = (uint32_t)atoi(optarg);
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-t max_threads] [-d duration_ms] [-n nodes]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (max_threads == 0 || n_nodes == 0) {
+		fprintf(stderr, "Threads and nodes must be positive\n");
+		return 1;
+	}
+
+	as_cluster* cluster = cluster_create(n_nodes);
+
+	as_namespace_handle handle;
+	memset(&handle, 0, sizeof(handle));
+	handle.cluster = cluster;
+	strcpy(handle.ns, NAMESPACE);
+	as_namespace_handle_resolve(cluster, &handle);
+
+	if (! handle.index) {
+		fprintf(stderr, "Failed to resolve namespace handle\n");
+		return 1;
+	}
+
+	printf("%8s %14s %14s %14s %10s %10s\n", "threads", "refcount op/s", "reserve op/s", "hazard op/s",
+		"speedup", "reclaimed");
+
+	for (uint32_t n = 1; n <= max_threads; n *= 2) {
+		uint64_t r1, r2, r3;
+		double refcount = run(cluster, &handle, MODE_REFCOUNT, n, duration_ms, &r1);
+		double reserve = run(cluster, &handle, MODE_RESERVE, n, duration_ms, &r2);
+		double hazard = run(cluster, &handle, MODE_HAZARD, n, duration_ms, &r3);
+
+		printf("%8u %14.0f %14.0f %14.0f %9.2fx %10llu\n", n, refcount, reserve, hazard,
+			hazard / refcount, (unsigned long long)(r2 + r3));
+
+		if (n < max_threads && n * 2 > max_threads) {
+			n = max_threads / 2;
+		}
+	}
+	return 0;
+}
@@ -99,6 +99,8 @@ connect_to_server(arguments* args, aerospike* client)
 	p->exists = AS_POLICY_EXISTS_IGNORE;
 	
 	p->read.replica = args->read_replica;
+	p->read.hedge_delay_ms = args->hedge_delay_ms;
+	p->read.hedge_percentile = args->hedge_percentile;
 	p->read.consistency_level = args->read_consistency_level;
 
 	p->write.timeout = args->write_timeout;
@@ -54,6 +54,8 @@ typedef struct arguments_t {
 	int latency_shift;
 	bool use_shm;
 	as_policy_replica read_replica;
+	uint32_t hedge_delay_ms;
+	uint8_t hedge_percentile;
 	as_policy_consistency_level read_consistency_level;
 	as_policy_commit_level write_commit_level;
 } arguments;
@@ -26,7 +26,7 @@
 #include <string.h>
 #include <getopt.h>
 
-static const char* short_options = "h:p:U:P::n:s:k:o:Rt:w:z:g:T:dL:SC:N:M:u";
+static const char* short_options = "h:p:U:P::n:s:k:o:Rt:w:z:g:T:dL:SC:H:Q:N:M:u";
 
 static struct option long_options[] = {
 	{"hosts",        1, 0, 'h'},
@@ -50,6 +50,8 @@ static struct option long_options[] = {
 	{"latency",      1, 0, 'L'},
 	{"shared",       0, 0, 'S'},
 	{"replica",      1, 0, 'C'},
+	{"hedgeDelay",   1, 0, 'H'},
+	{"hedgePercentile", 1, 0, 'Q'},
 	{"consistencyLevel", 1, 0, 'N'},
 	{"commitLevel",  1, 0, 'M'},
 	{"usage",        0, 0, 'u'},
@@ -171,8 +173,18 @@ print_usage(const char* program)
 	blog_line("   Use shared memory cluster tending.");
 	blog_line("");
 
-	blog_line("-C --replica {master,any}       # Default: master");
-	blog_line("   Which replica to use for reads.");
+	blog_line("-C --replica {master,any,fastest} # Default: master");
+	blog_line("   Which replica to use for reads.  fastest chooses the replica with the lowest latency.");
+	blog_line("");
+
+	blog_line("-H --hedgeDelay <ms>  # Default: 0");
+	blog_line("   Send reads to the other replica if the first has not responded within this delay.");
+	blog_line("   0 disables hedged reads.");
+	blog_line("");
+
+	blog_line("-Q --hedgePercentile <1-99> # Default: 0");
+	blog_line("   Hedge reads after this percentile of the node's recent read latency.  hedgeDelay");
+	blog_line("   is used until enough reads have been measured.");
 	blog_line("");
 
 	blog_line("-N --consistencyLevel {one,all} # Default: one");
@@ -270,7 +282,10 @@ print_args(arguments* args)
 	
 	blog_line("shared memory:  %s", boolstring(args->use_shm));
 
-	blog_line("read replica:   %s", (AS_POLICY_REPLICA_MASTER == args->read_replica ? "master" : "any"));
+	blog_line("read replica:   %s", (AS_POLICY_REPLICA_MASTER == args->read_replica ? "master" :
+		AS_POLICY_REPLICA_ANY == args->read_replica ? "any" : "fastest"));
+	blog_line("hedge delay:    %u ms", args->hedge_delay_ms);
+	blog_line("hedge percentile: %u", args->hedge_percentile);
 	blog_line("read consistency level: %s", (AS_POLICY_CONSISTENCY_LEVEL_ONE == args->read_consistency_level ? "one" : "all"));
 	blog_line("write commit level: %s", (AS_POLICY_COMMIT_LEVEL_ALL == args->write_commit_level ? "all" : "master"));
 }
@@ -514,12 +529,30 @@ set_args(int argc, char * const * argv, arguments* args)
 				else if (strcmp(optarg, "any") == 0) {
 					args->read_replica = AS_POLICY_REPLICA_ANY;
 				}
+				else if (strcmp(optarg, "fastest") == 0) {
+					args->read_replica = AS_POLICY_REPLICA_FASTEST;
+				}
 				else {
-					blog_line("replica must be master or any");
+					blog_line("replica must be master, any or fastest");
 					return 1;
 				}
 				break;
 
+			case 'H':
+				args->hedge_delay_ms = atoi(optarg);
+				break;
+
+			case 'Q': {
+				int pct = atoi(optarg);
+				
+				if (pct < 0 || pct > 99) {
+					blog_line("hedgePercentile must be between 0 and 99");
+					return 1;
+				}
+				args->hedge_percentile = (uint8_t)pct;
+				break;
+			}
+
 			case 'N':
 				if (strcmp(optarg, "one") == 0) {
 					args->read_consistency_level = AS_POLICY_CONSISTENCY_LEVEL_ONE;
@@ -591,6 +624,8 @@ main(int argc, char * const * argv)
 	args.latency_shift = 3;
 	args.use_shm = false;
 	args.read_replica = AS_POLICY_REPLICA_MASTER;
+	args.hedge_delay_ms = 0;
+	args.hedge_percentile = 0;
 	args.read_consistency_level = AS_POLICY_CONSISTENCY_LEVEL_ONE;
 	args.write_commit_level = AS_POLICY_COMMIT_LEVEL_ALL;
 	
@@ -0,0 +1,231 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Map bin serialization microbenchmark.  Encodes a map bin of roughly the
+// requested size into a command buffer the old way (msgpack serializer into a
+// temporary buffer, then copy into the command) and the new way (exact size
+// pass, then pack directly into the command), verifies both produce identical
+// bytes and reports encodes/sec and MB/sec for each.
+//
+// Usage: target/pack_bench [-n iterations] [-s map_size_bytes]...
+//        Default sizes are 10 KB, 100 KB and 1 MB.
+//
+
+#include <aerospike/as_arraylist.h>
+#include <aerospike/as_buffer.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_hashmap.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_msgpack.h>
+#include <aerospike/as_pack.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_serializer.h>
+#include <aerospike/as_string.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	HELPERS
+ *****************************************************************************/
+
+static inline uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ *	Build map of string keys to a mix of strings, integers and small lists,
+ *	about size bytes when packed.
+ */
+static as_map*
+build_map(uint32_t size)
+{
+	uint32_t entries = size / 64 + 1;
+	as_hashmap* map = as_hashmap_new(entries);
+	char buf[64];
+
+	for (uint32_t i = 0; i < entries; i++) {
+		snprintf(buf, sizeof(buf), "key-%08u", i);
+		as_string* key = as_string_new(strdup(buf), true);
+
+		switch (i % 3) {
+			case 0:
+				snprintf(buf, sizeof(buf), "value-%08u-abcdefghijklmnopqrstuvwxyz", i);
+				as_hashmap_set(map, (as_val*)key, (as_val*)as_string_new(strdup(buf), true));
+				break;
+
+			case 1:
+				as_hashmap_set(map, (as_val*)key, (as_val*)as_integer_new((int64_t)i * 1000003));
+				break;
+
+			default: {
+				as_arraylist* list = as_arraylist_new(4, 0);
+				as_arraylist_append_int64(list, i);
+				as_arraylist_append_int64(list, -(int64_t)i);
+				as_arraylist_append_str(list, "nested");
+				as_hashmap_set(map, (as_val*)key, (as_val*)list);
+				break;
+			}
+		}
+	}
+	return (as_map*)map;
+}
+
+/**
+ *	Previous encoding: serialize into temporary buffer, then copy into command.
+ */
+static size_t
+encode_old(as_bin* bin, uint8_t** out)
+{
+	as_buffer buffer;
+	as_buffer_init(&buffer);
+
+	as_serializer ser;
+	as_msgpack_init(&ser);
+	as_serializer_serialize(&ser, (as_val*)bin->valuep, &buffer);
+	as_serializer_destroy(&ser);
+
+	size_t size = strlen(bin->name) + buffer.size + AS_OPERATION_HEADER_SIZE;
+	uint8_t* cmd = malloc(size);
+	uint8_t* p = as_command_write_bin_name(cmd, bin->name);
+	memcpy(p, buffer.data, buffer.size);
+	as_buffer_destroy(&buffer);
+	*out = cmd;
+	return size;
+}
+
+/**
+ *	Current encoding: as_command_bin_size() sizes the map and
+ *	as_command_write_bin() packs it straight into the command.
+ */
+static size_t
+encode_new(as_bin* bin, uint8_t** out)
+{
+	as_buffer buffer;
+	memset(&buffer, 0, sizeof(buffer));
+
+	size_t size = as_command_bin_size(bin, &buffer);
+	uint8_t* cmd = malloc(size);
+	as_command_write_bin(cmd, AS_OPERATOR_WRITE, bin, &buffer);
+
+	if (buffer.data) {
+		free(buffer.data);
+	}
+	*out = cmd;
+	return size;
+}
+
+static double
+run(size_t (*encode)(as_bin*, uint8_t**), as_bin* bin, uint32_t iterations, size_t* size)
+{
+	uint64_t begin = now_ns();
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		uint8_t* cmd;
+		*size = encode(bin, &cmd);
+		free(cmd);
+	}
+	return (double)(now_ns() - begin) / 1000000000.0;
+}
+
+/******************************************************************************
+ *	MAIN
+ *****************************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t iterations = 0;
+	uint32_t sizes[16];
+	uint32_t n_sizes = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+			case 'n':
+				iterations = (uint32_t)atoi(optarg);
+				break;
+
+			case 's':
+				if (n_sizes < 16) {
+					sizes[n_sizes++] = (uint32_t)atoi(optarg);
+				}
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-n iterations] [-s map_size_bytes]...\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (n_sizes == 0) {
+		sizes[n_sizes++] = 10 * 1024;
+		sizes[n_sizes++] = 100 * 1024;
+		sizes[n_sizes++] = 1024 * 1024;
+	}
+
+	printf("%10s %10s %12s %12s %10s %10s %8s\n", "map bytes", "iterations", "old enc/s", "new enc/s",
+		"old MB/s", "new MB/s", "speedup");
+
+	for (uint32_t i = 0; i < n_sizes; i++) {
+		as_map* map = build_map(sizes[i]);
+		as_bin bin;
+		strcpy(bin.name, "map");
+		bin.valuep = (as_bin_value*)map;
+
+		// Both encodings must produce the same bytes.
+		uint8_t* old_cmd;
+		uint8_t* new_cmd;
+		size_t old_size = encode_old(&bin, &old_cmd);
+		size_t new_size = encode_new(&bin, &new_cmd);
+
+		// The bin header value type byte is only written by as_command_write_bin().
+		if (old_size != new_size || memcmp(old_cmd + AS_OPERATION_HEADER_SIZE, new_cmd + AS_OPERATION_HEADER_SIZE,
+				old_size - AS_OPERATION_HEADER_SIZE) != 0) {
+			fprintf(stderr, "Encodings differ for size %u: old=%zu new=%zu\n", sizes[i], old_size, new_size);
+			return 1;
+		}
+		free(old_cmd);
+		free(new_cmd);
+
+		uint32_t n = iterations? iterations : (uint32_t)(200 * 1024 * 1024 / old_size) + 1;
+		size_t size;
+		double old_sec = run(encode_old, &bin, n, &size);
+		double new_sec = run(encode_new, &bin, n, &size);
+		double mb = (double)size * n / (1024 * 1024);
+
+		printf("%10zu %10u %12.0f %12.0f %10.1f %10.1f %7.2fx\n", size, n, n / old_sec, n / new_sec,
+			mb / old_sec, mb / new_sec, old_sec / new_sec);
+
+		as_map_destroy(map);
+	}
+	return 0;
+}
@@ -0,0 +1,389 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Partition map update microbenchmark.  Builds an in-memory cluster with
+// 4096 partitions per namespace and simulates a migration: every round moves
+// a few partitions per namespace to another node, and every node's
+// replicas-master and replicas-prole responses are applied as the tend thread
+// does.  Each round is run with full updates (every partition of every
+// bitmap is applied, as before bitmap diffs) and with incremental updates.
+//
+// Reports tend thread CPU time per round and lookups/sec of reader threads
+// routing commands while the updates run.  Run under "perf stat -e
+// cache-misses" with -f or -i to compare reader cache misses.  No server is
+// required.
+//
+// Usage: target/partition_bench [-n nodes] [-s namespaces] [-m moves] [-r rounds]
+//                               [-t reader_threads] [-f|-i]
+//
+
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_epoch.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_partition.h>
+#include <citrusleaf/cf_b64.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	DECLARATIONS
+ *****************************************************************************/
+
+bool
+as_partition_tables_update(as_cluster* cluster, as_node* node, char* buf, bool master);
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct {
+	as_cluster* cluster;
+	uint32_t n_namespaces;
+	volatile bool* stop;
+	uint64_t seed;
+	uint64_t ops;
+	uint8_t pad[64];
+} reader_thread;
+
+typedef struct {
+	double cpu_ms;
+	double reader_ops;
+} round_result;
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+#define N_PARTITIONS 4096
+#define BITMAP_SIZE (N_PARTITIONS / 8)
+
+static char namespaces[64][AS_MAX_NAMESPACE_SIZE];
+
+// Keeps node loads from being optimized away.
+static volatile uint64_t sink;
+
+/******************************************************************************
+ *	HELPERS
+ *****************************************************************************/
+
+static inline uint64_t
+now_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline uint64_t
+next_random(uint64_t* seed)
+{
+	uint64_t x = *seed;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*seed = x;
+	return x;
+}
+
+static as_cluster*
+cluster_create(uint32_t n_nodes)
+{
+	as_cluster* cluster = calloc(1, sizeof(as_cluster));
+	cluster->n_partitions = N_PARTITIONS;
+	cluster->epoch = as_epoch_create();
+	cluster->partition_tables = as_partition_tables_create(0);
+	cluster->nodes = calloc(1, sizeof(as_nodes) + sizeof(as_node*) * n_nodes);
+	cluster->nodes->ref_count = 1;
+	cluster->nodes->size = n_nodes;
+
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		as_node* node = calloc(1, sizeof(as_node));
+		snprintf(node->name, sizeof(node->name), "BB9%013X", i);
+		node->ref_count = 1;
+		node->active = 1;
+		node->index = i;
+		node->cluster = cluster;
+		as_vector_init(&node->bitmaps, sizeof(as_node_bitmap), 4);
+		cluster->nodes->array[i] = node;
+	}
+	return cluster;
+}
+
+/**
+ *	Build info response for one node and replica role, as returned by
+ *	"replicas-master" or "replicas-prole": ns1:<base64>;ns2:<base64>...
+ */
+static void
+build_response(char* buf, uint16_t* owners, uint32_t n_namespaces, uint32_t n_nodes, uint32_t node, bool master)
+{
+	uint8_t bitmap[BITMAP_SIZE];
+	char* p = buf;
+
+	for (uint32_t n = 0; n < n_namespaces; n++) {
+		memset(bitmap, 0, sizeof(bitmap));
+
+		for (uint32_t i = 0; i < N_PARTITIONS; i++) {
+			uint32_t owner = owners[n * N_PARTITIONS + i];
+
+			if (! master) {
+				owner = (owner + 1) % n_nodes;
+			}
+
+			if (owner == node) {
+				bitmap[i >> 3] |= 0x80 >> (i & 7);
+			}
+		}
+
+		if (n > 0) {
+			*p++ = ';';
+		}
+		p += sprintf(p, "%s:", namespaces[n]);
+		cf_b64_encode(bitmap, BITMAP_SIZE, p);
+		p += cf_b64_encoded_len(BITMAP_SIZE);
+	}
+	*p++ = '\n';
+	*p = 0;
+}
+
+/******************************************************************************
+ *	THREADS
+ *****************************************************************************/
+
+static void*
+reader(void* udata)
+{
+	reader_thread* t = udata;
+	as_cluster* cluster = t->cluster;
+	uint8_t digest[AS_DIGEST_VALUE_SIZE];
+	uint64_t ops = 0;
+	uint64_t sum = 0;
+
+	memset(digest, 0, sizeof(digest));
+
+	while (! ck_pr_load_8((uint8_t*)t->stop)) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint64_t r = next_random(&t->seed);
+			*(uint64_t*)digest = r;
+
+			as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+			as_node* node = as_node_select(cluster, namespaces[(r >> 32) % t->n_namespaces], NULL, digest, false,
+				AS_POLICY_REPLICA_MASTER);
+
+			if (node) {
+				sum += node->index;
+			}
+			as_epoch_exit(slot);
+		}
+		ops += 256;
+	}
+	sink += sum;
+	t->ops = ops;
+	return 0;
+}
+
+/******************************************************************************
+ *	BENCHMARK
+ *****************************************************************************/
+
+static void
+run(uint32_t n_nodes, uint32_t n_namespaces, uint32_t moves, uint32_t rounds, uint32_t n_readers, bool full,
+	round_result* result)
+{
+	as_cluster* cluster = cluster_create(n_nodes);
+	uint16_t* owners = malloc(sizeof(uint16_t) * n_namespaces * N_PARTITIONS);
+	uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+	for (uint32_t i = 0; i < n_namespaces * N_PARTITIONS; i++) {
+		owners[i] = (uint16_t)(i % n_nodes);
+	}
+
+	size_t response_size = n_namespaces * (AS_MAX_NAMESPACE_SIZE + cf_b64_encoded_len(BITMAP_SIZE) + 2) + 2;
+	char* responses = malloc(response_size * n_nodes * 2);
+	char* buf = malloc(response_size);
+
+	// Initial partition maps are applied before readers start.
+	for (uint32_t k = 0; k < n_nodes; k++) {
+		for (int m = 1; m >= 0; m--) {
+			build_response(buf, owners, n_namespaces, n_nodes, k, m);
+			as_partition_tables_update(cluster, cluster->nodes->array[k], buf, m);
+		}
+	}
+
+	volatile bool stop = false;
+	reader_thread* threads = calloc(n_readers, sizeof(reader_thread));
+	pthread_t* ids = calloc(n_readers, sizeof(pthread_t));
+
+	for (uint32_t i = 0; i < n_readers; i++) {
+		threads[i].cluster = cluster;
+		threads[i].n_namespaces = n_namespaces;
+		threads[i].stop = &stop;
+		threads[i].seed = 0x2545F4914F6CDD1DULL * (i + 1);
+		pthread_create(&ids[i], 0, reader, &threads[i]);
+	}
+
+	uint64_t cpu = 0;
+	uint64_t begin = now_ns(CLOCK_MONOTONIC);
+
+	for (uint32_t r = 0; r < rounds; r++) {
+		// Migrate partitions to other nodes.
+		for (uint32_t n = 0; n < n_namespaces; n++) {
+			for (uint32_t i = 0; i < moves; i++) {
+				uint32_t p = next_random(&seed) % N_PARTITIONS;
+				uint16_t* owner = &owners[n * N_PARTITIONS + p];
+				*owner = (uint16_t)((*owner + 1 + next_random(&seed) % (n_nodes - 1)) % n_nodes);
+			}
+		}
+
+		for (uint32_t k = 0; k < n_nodes; k++) {
+			build_response(&responses[(k * 2) * response_size], owners, n_namespaces, n_nodes, k, true);
+			build_response(&responses[(k * 2 + 1) * response_size], owners, n_namespaces, n_nodes, k, false);
+		}
+
+		// Apply responses as the tend thread does.  Only this part is timed.
+		uint64_t cpu_begin = now_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		for (uint32_t k = 0; k < n_nodes; k++) {
+			as_node* node = cluster->nodes->array[k];
+
+			for (uint32_t m = 0; m < 2; m++) {
+				if (full) {
+					// Previous behavior: apply every partition of the bitmap.
+					for (uint32_t i = 0; i < node->bitmaps.size; i++) {
+						as_node_bitmap* bitmap = as_vector_get(&node->bitmaps, i);
+						bitmap->valid = false;
+					}
+				}
+
+				// Parsing is destructive, so work on a copy.
+				strcpy(buf, &responses[(k * 2 + m) * response_size]);
+				as_partition_tables_update(cluster, node, buf, m == 0);
+			}
+		}
+		as_epoch_reclaim(cluster->epoch);
+		cpu += now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_begin;
+	}
+
+	ck_pr_store_8((uint8_t*)&stop, 1);
+
+	uint64_t ops = 0;
+
+	for (uint32_t i = 0; i < n_readers; i++) {
+		pthread_join(ids[i], 0);
+		ops += threads[i].ops;
+	}
+
+	double seconds = (double)(now_ns(CLOCK_MONOTONIC) - begin) / 1000000000.0;
+	result->cpu_ms = (double)cpu / 1000000.0 / rounds;
+	result->reader_ops = (double)ops / seconds;
+
+	free(threads);
+	free(ids);
+	free(buf);
+	free(responses);
+	free(owners);
+}
+
+/******************************************************************************
+ *	MAIN
+ *****************************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t n_nodes = 8;
+	uint32_t n_namespaces = 20;
+	uint32_t moves = 41;
+	uint32_t rounds = 200;
+	uint32_t n_readers = 4;
+	int mode = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:m:r:t:fi")) != -1) {
+		switch (c) {
+			case 'n':
+				n_nodes = (uint32_t)atoi(optarg);
+				break;
+
+			case 's':
+				n_namespaces = (uint32_t)atoi(optarg);
+				break;
+
+			case 'm':
+				moves = (uint32_t)atoi(optarg);
+				break;
+
+			case 'r':
+				rounds = (uint32_t)atoi(optarg);
+				break;
+
+			case 't':
+				n_readers = (uint32_t)atoi(optarg);
+				break;
+
+			case 'f':
+				mode = 1;
+				break;
+
+			case 'i':
+				mode = 2;
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-n nodes] [-s namespaces] [-m moves] [-r rounds] [-t reader_threads] [-f|-i]\n",
+					argv[0]);
+				return 1;
+		}
+	}
+
+	if (n_nodes < 2 || n_nodes > 1000 || n_namespaces == 0 || n_namespaces > 64 || rounds == 0) {
+		fprintf(stderr, "Nodes must be 2 to 1000, namespaces 1 to 64 and rounds positive\n");
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < n_namespaces; i++) {
+		snprintf(namespaces[i], sizeof(namespaces[i]), "ns%u", i);
+	}
+
+	printf("%u nodes, %u namespaces, %u partitions, %u moves per namespace per round, %u rounds, %u readers\n",
+		n_nodes, n_namespaces, N_PARTITIONS, moves, rounds, n_readers);
+	printf("%12s %16s %16s\n", "mode", "tend cpu ms/rnd", "reader op/s");
+
+	round_result result;
+
+	if (mode != 2) {
+		run(n_nodes, n_namespaces, moves, rounds, n_readers, true, &result);
+		printf("%12s %16.3f %16.0f\n", "full", result.cpu_ms, result.reader_ops);
+	}
+
+	if (mode != 1) {
+		run(n_nodes, n_namespaces, moves, rounds, n_readers, false, &result);
+		printf("%12s %16.3f %16.0f\n", "incremental", result.cpu_ms, result.reader_ops);
+	}
+	return 0;
+}
@@ -0,0 +1,291 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Scan and query record parsing benchmark.  Loads records with string and
+// blob bins, then runs aerospike_scan_foreach() and aerospike_query_foreach()
+// with bins copied out of the response buffer and with borrowed bins, and
+// reports records/sec for each.  The callback reads one bin and discards the
+// record, which is where per-bin allocations dominate.
+//
+// Usage: target/scan_bench [-h host] [-p port] [-n namespace] [-s set]
+//        [-k records] [-b bin_size] [-r rounds] [-L]
+//        -L skips loading records and index creation.
+//
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_index.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/aerospike_query.h>
+#include <aerospike/aerospike_scan.h>
+#include <aerospike/as_query.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_scan.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	HELPERS
+ *****************************************************************************/
+
+#define BIN_COUNT 6
+
+static uint64_t g_records = 0;
+static uint64_t g_bytes = 0;
+
+static inline uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool
+record_callback(const as_val* val, void* udata)
+{
+	if (! val) {
+		return true;
+	}
+
+	as_record* rec = as_record_fromval(val);
+	char* s = as_record_get_str(rec, "s0");
+
+	__sync_fetch_and_add(&g_records, 1);
+	__sync_fetch_and_add(&g_bytes, s ? strlen(s) : 0);
+	return true;
+}
+
+static int
+load(aerospike* as, const char* ns, const char* set, uint32_t n_records, uint32_t bin_size)
+{
+	as_error err;
+	char* str = malloc(bin_size + 1);
+	uint8_t* blob = malloc(bin_size);
+
+	memset(str, 'x', bin_size);
+	str[bin_size] = 0;
+	memset(blob, 0xab, bin_size);
+
+	for (uint32_t i = 0; i < n_records; i++) {
+		as_key key;
+		as_key_init_int64(&key, ns, set, i);
+
+		as_record rec;
+		as_record_inita(&rec, BIN_COUNT + 1);
+		as_record_set_int64(&rec, "id", i);
+
+		for (uint32_t b = 0; b < BIN_COUNT; b++) {
+			char name[AS_BIN_NAME_MAX_SIZE];
+
+			if (b & 1) {
+				snprintf(name, sizeof(name), "b%u", b / 2);
+				as_record_set_raw(&rec, name, blob, bin_size);
+			}
+			else {
+				snprintf(name, sizeof(name), "s%u", b / 2);
+				as_record_set_str(&rec, name, str);
+			}
+		}
+
+		if (aerospike_key_put(as, &err, NULL, &key, &rec) != AEROSPIKE_OK) {
+			fprintf(stderr, "Put failed: %d %s\n", err.code, err.message);
+			as_record_destroy(&rec);
+			free(str);
+			free(blob);
+			return -1;
+		}
+		as_record_destroy(&rec);
+	}
+	free(str);
+	free(blob);
+
+	as_index_task task;
+
+	if (aerospike_index_create(as, &err, &task, NULL, ns, set, "id", "scan_bench_id", AS_INDEX_NUMERIC) != AEROSPIKE_OK) {
+		fprintf(stderr, "Index create failed: %d %s\n", err.code, err.message);
+		return -1;
+	}
+	aerospike_index_create_wait(&err, &task, 0);
+	return 0;
+}
+
+static as_status
+run_scan(aerospike* as, as_error* err, const char* ns, const char* set, bool borrow)
+{
+	as_policy_scan policy;
+	as_policy_scan_init(&policy);
+	policy.borrow_bins = borrow;
+
+	as_scan scan;
+	as_scan_init(&scan, ns, set);
+	as_status status = aerospike_scan_foreach(as, err, &policy, &scan, record_callback, NULL);
+	as_scan_destroy(&scan);
+	return status;
+}
+
+static as_status
+run_query(aerospike* as, as_error* err, const char* ns, const char* set, bool borrow)
+{
+	as_policy_query policy;
+	as_policy_query_init(&policy);
+	policy.borrow_bins = borrow;
+
+	as_query query;
+	as_query_init(&query, ns, set);
+	as_query_where_inita(&query, 1);
+	as_query_where(&query, "id", as_integer_range(0, INT64_MAX));
+	as_status status = aerospike_query_foreach(as, err, &policy, &query, record_callback, NULL);
+	as_query_destroy(&query);
+	return status;
+}
+
+static int
+measure(aerospike* as, const char* name, as_status (*fn)(aerospike*, as_error*, const char*, const char*, bool),
+	const char* ns, const char* set, uint32_t rounds)
+{
+	for (int borrow = 0; borrow <= 1; borrow++) {
+		uint64_t best = 0;
+		uint64_t records = 0;
+
+		for (uint32_t r = 0; r < rounds; r++) {
+			as_error err;
+			g_records = 0;
+			g_bytes = 0;
+
+			uint64_t begin = now_ns();
+
+			if (fn(as, &err, ns, set, borrow) != AEROSPIKE_OK) {
+				fprintf(stderr, "%s failed: %d %s\n", name, err.code, err.message);
+				return -1;
+			}
+
+			uint64_t elapsed = now_ns() - begin;
+			uint64_t rate = elapsed ? g_records * 1000000000 / elapsed : 0;
+
+			if (rate > best) {
+				best = rate;
+				records = g_records;
+			}
+		}
+		printf("%-8s %-8s %10llu %14llu\n", name, borrow ? "borrow" : "copy",
+			(unsigned long long)records, (unsigned long long)best);
+	}
+	return 0;
+}
+
+/******************************************************************************
+ *	MAIN
+ *****************************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+	const char* host = "127.0.0.1";
+	int port = 3000;
+	const char* ns = "test";
+	const char* set = "scanbench";
+	uint32_t n_records = 100000;
+	uint32_t bin_size = 100;
+	uint32_t rounds = 3;
+	bool do_load = true;
+	int c;
+
+	while ((c = getopt(argc, argv, "h:p:n:s:k:b:r:L")) != -1) {
+		switch (c) {
+			case 'h':
+				host = optarg;
+				break;
+
+			case 'p':
+				port = atoi(optarg);
+				break;
+
+			case 'n':
+				ns = optarg;
+				break;
+
+			case 's':
+				set = optarg;
+				break;
+
+			case 'k':
+				n_records = (uint32_t)atoi(optarg);
+				break;
+
+			case 'b':
+				bin_size = (uint32_t)atoi(optarg);
+				break;
+
+			case 'r':
+				rounds = (uint32_t)atoi(optarg);
+				break;
+
+			case 'L':
+				do_load = false;
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-h host] [-p port] [-n namespace] [-s set] [-k records] [-b bin_size] [-r rounds] [-L]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	as_config cfg;
+	as_config_init(&cfg);
+	as_config_add_host(&cfg, host, port);
+
+	aerospike as;
+	aerospike_init(&as, &cfg);
+
+	as_error err;
+
+	if (aerospike_connect(&as, &err) != AEROSPIKE_OK) {
+		fprintf(stderr, "Connect failed: %d %s\n", err.code, err.message);
+		aerospike_destroy(&as);
+		return 1;
+	}
+
+	int rv = 0;
+
+	if (do_load && load(&as, ns, set, n_records, bin_size) != 0) {
+		rv = 1;
+	}
+
+	if (rv == 0) {
+		printf("%-8s %-8s %10s %14s\n", "command", "bins", "records", "records/sec");
+
+		if (measure(&as, "scan", run_scan, ns, set, rounds) != 0 ||
+			measure(&as, "query", run_query, ns, set, rounds) != 0) {
+			rv = 1;
+		}
+	}
+
+	aerospike_close(&as, &err);
+	aerospike_destroy(&as);
+	return rv;
+}
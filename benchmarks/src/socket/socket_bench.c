@@ -0,0 +1,289 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Socket layer microbenchmark.  Sends fixed size request/response round trips
+// through as_socket_write_limit()/as_socket_read_limit() to an echo server on
+// loopback and reports system calls per round trip and latency percentiles.
+//
+// System calls issued by the client thread are counted by interposing the libc
+// socket functions, so run the same binary against the old and new client
+// library to compare them.
+//
+// Usage: target/socket_bench [-n iterations] [-s request_size]
+//
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_socket.h>
+
+#include <arpa/inet.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	SYSCALL COUNTING
+ *****************************************************************************/
+
+// Only calls made by the benchmark client thread are counted.
+static __thread int counting = 0;
+static uint64_t syscall_count = 0;
+
+#define NEXT(_name) \
+	static __typeof__(_name)* next_##_name = 0; \
+	if (! next_##_name) { \
+		next_##_name = (__typeof__(_name)*)dlsym(RTLD_NEXT, #_name); \
+	} \
+	if (counting) { \
+		syscall_count++; \
+	}
+
+ssize_t
+read(int fd, void* buf, size_t len)
+{
+	NEXT(read);
+	return next_read(fd, buf, len);
+}
+
+ssize_t
+write(int fd, const void* buf, size_t len)
+{
+	NEXT(write);
+	return next_write(fd, buf, len);
+}
+
+ssize_t
+recv(int fd, void* buf, size_t len, int flags)
+{
+	NEXT(recv);
+	return next_recv(fd, buf, len, flags);
+}
+
+ssize_t
+send(int fd, const void* buf, size_t len, int flags)
+{
+	NEXT(send);
+	return next_send(fd, buf, len, flags);
+}
+
+int
+poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+	NEXT(poll);
+	return next_poll(fds, nfds, timeout);
+}
+
+int
+select(int nfds, fd_set* rset, fd_set* wset, fd_set* eset, struct timeval* tv)
+{
+	NEXT(select);
+	return next_select(nfds, rset, wset, eset, tv);
+}
+
+int
+fcntl(int fd, int cmd, ...)
+{
+	NEXT(fcntl);
+	va_list ap;
+	va_start(ap, cmd);
+	long arg = va_arg(ap, long);
+	va_end(ap);
+	return next_fcntl(fd, cmd, arg);
+}
+
+/******************************************************************************
+ *	ECHO SERVER
+ *****************************************************************************/
+
+static void*
+echo_run(void* udata)
+{
+	int listen_fd = *(int*)udata;
+	int fd = accept(listen_fd, 0, 0);
+
+	if (fd < 0) {
+		return 0;
+	}
+
+	int f = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &f, sizeof(f));
+
+	uint8_t buf[64 * 1024];
+
+	while (true) {
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+		if (n <= 0) {
+			break;
+		}
+
+		ssize_t pos = 0;
+
+		while (pos < n) {
+			ssize_t w = send(fd, buf + pos, n - pos, MSG_NOSIGNAL);
+
+			if (w <= 0) {
+				close(fd);
+				return 0;
+			}
+			pos += w;
+		}
+	}
+	close(fd);
+	return 0;
+}
+
+/******************************************************************************
+ *	BENCHMARK
+ *****************************************************************************/
+
+static inline uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t iterations = 100000;
+	uint32_t size = 30;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+			case 'n':
+				iterations = (uint32_t)atoi(optarg);
+				break;
+
+			case 's':
+				size = (uint32_t)atoi(optarg);
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-n iterations] [-s request_size]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (iterations == 0 || size == 0) {
+		fprintf(stderr, "iterations and request_size must be positive\n");
+		return 1;
+	}
+
+	// Start echo server on ephemeral loopback port.
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addr_len = sizeof(addr);
+
+	if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(listen_fd, 1) ||
+		getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len)) {
+		fprintf(stderr, "Failed to start echo server: %d\n", errno);
+		return 1;
+	}
+
+	pthread_t thread;
+	pthread_create(&thread, 0, echo_run, &listen_fd);
+
+	as_error err;
+	as_error_init(&err);
+	int fd;
+
+	if (as_socket_create_and_connect_nb(&err, &addr, &fd) != AEROSPIKE_OK) {
+		fprintf(stderr, "Connect failed: %s\n", err.message);
+		return 1;
+	}
+
+	uint8_t* req = malloc(size);
+	uint8_t* rsp = malloc(size);
+	uint64_t* latency = malloc(sizeof(uint64_t) * iterations);
+	memset(req, 'x', size);
+
+	// Warm up connection outside of measurement.
+	for (uint32_t i = 0; i < 1000; i++) {
+		as_socket_write_timeout(&err, fd, req, size, 1000);
+		as_socket_read_timeout(&err, fd, rsp, size, 1000);
+	}
+
+	counting = 1;
+	uint64_t begin = now_ns();
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		uint64_t start = now_ns();
+		uint64_t deadline = as_socket_deadline(1000);
+
+		if (as_socket_write_limit(&err, fd, req, size, deadline) ||
+			as_socket_read_limit(&err, fd, rsp, size, deadline)) {
+			fprintf(stderr, "Round trip %u failed: %d %s\n", i, err.code, err.message);
+			return 1;
+		}
+		latency[i] = now_ns() - start;
+	}
+
+	uint64_t elapsed = now_ns() - begin;
+	counting = 0;
+
+	qsort(latency, iterations, sizeof(uint64_t), compare_u64);
+
+	printf("iterations:   %u\n", iterations);
+	printf("request size: %u\n", size);
+	printf("syscalls/op:  %.2f\n", (double)syscall_count / iterations);
+	printf("ops/sec:      %.0f\n", (double)iterations * 1000000000.0 / elapsed);
+	printf("p50 usec:     %.1f\n", latency[iterations / 2] / 1000.0);
+	printf("p99 usec:     %.1f\n", latency[(uint64_t)iterations * 99 / 100] / 1000.0);
+	printf("p99.9 usec:   %.1f\n", latency[(uint64_t)iterations * 999 / 1000] / 1000.0);
+
+	as_close(fd);
+	pthread_join(thread, 0);
+	close(listen_fd);
+	free(latency);
+	free(rsp);
+	free(req);
+	return 0;
+}
@@ -0,0 +1,515 @@
+/*******************************************************************************
+ * Copyright 2008-2015 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+
+//
+// Client startup benchmark.  Runs stand-in cluster nodes on loopback that
+// answer the info requests used for cluster discovery ("node", "features",
+// "partitions", "partition-generation", "services", "replicas-master" and
+// "replicas-prole"), then times aerospike_connect() with a cold start and
+// with a warm start from a partition map snapshot (warm_start_path).
+//
+// For each cluster size, reports time until aerospike_connect() returns,
+// time until a key in every partition routes to a node and time until the
+// first tend has validated the cluster.  Use -l to add a delay to each info
+// response, as seen with remote or busy nodes.  No server is required.
+//
+// Usage: target/startup_bench [-n nodes]... [-r runs] [-l info_delay_ms] [-p base_port]
+//
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_epoch.h>
+#include <aerospike/as_node.h>
+#include <citrusleaf/cf_b64.h>
+#include <citrusleaf/cf_byte_order.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct {
+	char name[AS_NODE_NAME_SIZE];
+	uint16_t port;
+	int listen_fd;
+	char* services;
+	char* replicas[2];
+} stand_in_node;
+
+typedef struct {
+	stand_in_node* node;
+	int fd;
+} connection;
+
+typedef struct {
+	double connect_ms;
+	double routed_ms;
+	double validated_ms;
+} startup_result;
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+#define N_PARTITIONS 4096
+#define BITMAP_SIZE (N_PARTITIONS / 8)
+#define NAMESPACE "test"
+#define SNAPSHOT_PATH "/tmp/startup_bench.snapshot"
+
+static uint32_t info_delay_ms;
+
+/******************************************************************************
+ *	HELPERS
+ *****************************************************************************/
+
+static inline uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool
+read_fully(int fd, void* buf, size_t len)
+{
+	uint8_t* p = buf;
+
+	while (len > 0) {
+		ssize_t rv = read(fd, p, len);
+
+		if (rv <= 0) {
+			return false;
+		}
+		p += rv;
+		len -= rv;
+	}
+	return true;
+}
+
+static bool
+write_fully(int fd, const void* buf, size_t len)
+{
+	const uint8_t* p = buf;
+
+	while (len > 0) {
+		ssize_t rv = write(fd, p, len);
+
+		if (rv <= 0) {
+			return false;
+		}
+		p += rv;
+		len -= rv;
+	}
+	return true;
+}
+
+/**
+ *	Partition i is mastered by node i % n and replicated on the next node.
+ */
+static char*
+build_replicas(uint32_t node, uint32_t n_nodes, bool master)
+{
+	uint8_t bitmap[BITMAP_SIZE];
+	memset(bitmap, 0, sizeof(bitmap));
+
+	for (uint32_t i = 0; i < N_PARTITIONS; i++) {
+		uint32_t owner = master ? i % n_nodes : (i + 1) % n_nodes;
+
+		if (owner == node && (master || n_nodes > 1)) {
+			bitmap[i >> 3] |= 0x80 >> (i & 7);
+		}
+	}
+
+	char* s = malloc(sizeof(NAMESPACE) + cf_b64_encoded_len(BITMAP_SIZE) + 2);
+	char* p = s + sprintf(s, "%s:", NAMESPACE);
+	cf_b64_encode(bitmap, BITMAP_SIZE, p);
+	p += cf_b64_encoded_len(BITMAP_SIZE);
+	*p++ = ';';
+	*p = 0;
+	return s;
+}
+
+/******************************************************************************
+ *	STAND-IN NODES
+ *****************************************************************************/
+
+static const char*
+info_value(stand_in_node* node, const char* name, char* tmp)
+{
+	if (strcmp(name, "node") == 0) {
+		return node->name;
+	}
+
+	if (strcmp(name, "features") == 0) {
+		return "batch-index;float;geo";
+	}
+
+	if (strcmp(name, "partitions") == 0) {
+		sprintf(tmp, "%u", N_PARTITIONS);
+		return tmp;
+	}
+
+	if (strcmp(name, "partition-generation") == 0) {
+		return "1";
+	}
+
+	if (strcmp(name, "services") == 0) {
+		return node->services;
+	}
+
+	if (strcmp(name, "replicas-master") == 0) {
+		return node->replicas[0];
+	}
+
+	if (strcmp(name, "replicas-prole") == 0) {
+		return node->replicas[1];
+	}
+	return "";
+}
+
+static void*
+connection_run(void* udata)
+{
+	connection* conn = udata;
+	stand_in_node* node = conn->node;
+	int fd = conn->fd;
+	free(conn);
+
+	uint64_t proto;
+
+	while (read_fully(fd, &proto, sizeof(proto))) {
+		size_t size = cf_swap_from_be64(proto) & 0xFFFFFFFFFFFFULL;
+		char* names = malloc(size + 1);
+
+		if (! read_fully(fd, names, size)) {
+			free(names);
+			break;
+		}
+		names[size] = 0;
+
+		// Response is "name\tvalue\n" for each requested name.
+		size_t capacity = 1024;
+		size_t len = 8;
+		char* response = malloc(capacity);
+		char tmp[32];
+		char* save = 0;
+
+		for (char* name = strtok_r(names, "\n", &save); name; name = strtok_r(0, "\n", &save)) {
+			const char* value = info_value(node, name, tmp);
+			size_t need = strlen(name) + strlen(value) + 2;
+
+			if (len + need > capacity) {
+				capacity = (len + need) * 2;
+				response = realloc(response, capacity);
+			}
+			len += sprintf(response + len, "%s\t%s\n", name, value);
+		}
+		free(names);
+
+		if (info_delay_ms) {
+			usleep(info_delay_ms * 1000);
+		}
+
+		*(uint64_t*)response = cf_swap_to_be64((len - 8) | (AS_INFO_MESSAGE_VERSION << 56) |
+			(AS_INFO_MESSAGE_TYPE << 48));
+
+		bool ok = write_fully(fd, response, len);
+		free(response);
+
+		if (! ok) {
+			break;
+		}
+	}
+	close(fd);
+	return 0;
+}
+
+static void*
+accept_run(void* udata)
+{
+	stand_in_node* node = udata;
+
+	while (true) {
+		int fd = accept(node->listen_fd, 0, 0);
+
+		if (fd < 0) {
+			continue;
+		}
+
+		int flag = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+		connection* conn = malloc(sizeof(connection));
+		conn->node = node;
+		conn->fd = fd;
+
+		pthread_t id;
+		pthread_create(&id, 0, connection_run, conn);
+		pthread_detach(id);
+	}
+	return 0;
+}
+
+/**
+ *	Start nodes on consecutive ports.  Nodes are never stopped.  Larger clusters
+ *	are run on a new port range.
+ */
+static bool
+stand_ins_start(uint32_t n_nodes, uint16_t base_port)
+{
+	stand_in_node* nodes = calloc(n_nodes, sizeof(stand_in_node));
+
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		stand_in_node* node = &nodes[i];
+		snprintf(node->name, sizeof(node->name), "BB9%013X", base_port + i);
+		node->port = (uint16_t)(base_port + i);
+		node->replicas[0] = build_replicas(i, n_nodes, true);
+		node->replicas[1] = build_replicas(i, n_nodes, false);
+
+		// Every node lists all other nodes as peers.
+		node->services = malloc(n_nodes * 24 + 1);
+		char* p = node->services;
+		*p = 0;
+
+		for (uint32_t j = 0; j < n_nodes; j++) {
+			if (j != i) {
+				p += sprintf(p, "%s127.0.0.1:%u", p == node->services ? "" : ";", base_port + j);
+			}
+		}
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(node->port);
+
+		int flag = 1;
+		node->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+		setsockopt(node->listen_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+		if (bind(node->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(node->listen_fd, 128) != 0) {
+			fprintf(stderr, "Failed to listen on port %u\n", node->port);
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		pthread_t id;
+		pthread_create(&id, 0, accept_run, &nodes[i]);
+		pthread_detach(id);
+	}
+	return true;
+}
+
+/******************************************************************************
+ *	BENCHMARK
+ *****************************************************************************/
+
+/**
+ *	Return true when a key in every partition routes to a node.
+ */
+static bool
+all_routed(as_cluster* cluster)
+{
+	uint8_t digest[AS_DIGEST_VALUE_SIZE];
+	memset(digest, 0, sizeof(digest));
+
+	as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+	bool routed = cluster->n_partitions > 0;
+
+	for (uint32_t i = 0; routed && i < N_PARTITIONS; i++) {
+		// Partition id is taken from the first two digest bytes.
+		digest[0] = (uint8_t)i;
+		digest[1] = (uint8_t)(i >> 8);
+		routed = as_node_select(cluster, NAMESPACE, NULL, digest, false, AS_POLICY_REPLICA_MASTER) != NULL;
+	}
+	as_epoch_exit(slot);
+	return routed;
+}
+
+static bool
+run(uint16_t port, bool warm, startup_result* result)
+{
+	as_config config;
+	as_config_init(&config);
+	as_config_add_host(&config, "127.0.0.1", port);
+
+	if (warm) {
+		strcpy(config.warm_start_path, SNAPSHOT_PATH);
+	}
+
+	aerospike as;
+	aerospike_init(&as, &config);
+
+	as_error err;
+	uint64_t begin = now_ns();
+
+	if (aerospike_connect(&as, &err) != AEROSPIKE_OK) {
+		fprintf(stderr, "Connect failed: %d %s\n", err.code, err.message);
+		aerospike_destroy(&as);
+		return false;
+	}
+
+	uint64_t connected = now_ns();
+	as_cluster* cluster = as.cluster;
+
+	while (! all_routed(cluster)) {
+		usleep(100);
+	}
+
+	uint64_t routed = now_ns();
+
+	while (ck_pr_load_64(&cluster->tend_stats.count) == 0) {
+		usleep(100);
+	}
+
+	uint64_t validated = now_ns();
+
+	result->connect_ms = (double)(connected - begin) / 1000000.0;
+	result->routed_ms = (double)(routed - begin) / 1000000.0;
+	result->validated_ms = (double)(validated - begin) / 1000000.0;
+
+	aerospike_close(&as, &err);
+	aerospike_destroy(&as);
+	return true;
+}
+
+static bool
+run_size(uint32_t n_nodes, uint16_t port, uint32_t runs)
+{
+	if (! stand_ins_start(n_nodes, port)) {
+		return false;
+	}
+
+	// Connect once with a warm start path to save the snapshot used by warm runs.
+	startup_result result;
+	unlink(SNAPSHOT_PATH);
+
+	if (! run(port, true, &result)) {
+		return false;
+	}
+
+	for (int warm = 0; warm < 2; warm++) {
+		startup_result total;
+		memset(&total, 0, sizeof(total));
+
+		for (uint32_t i = 0; i < runs; i++) {
+			if (! run(port, warm, &result)) {
+				return false;
+			}
+			total.connect_ms += result.connect_ms;
+			total.routed_ms += result.routed_ms;
+			total.validated_ms += result.validated_ms;
+		}
+		printf("%8u %8s %14.3f %14.3f %14.3f\n", n_nodes, warm ? "warm" : "cold", total.connect_ms / runs,
+			total.routed_ms / runs, total.validated_ms / runs);
+	}
+	return true;
+}
+
+/******************************************************************************
+ *	MAIN
+ *****************************************************************************/
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t sizes[16];
+	uint32_t n_sizes = 0;
+	uint32_t runs = 10;
+	uint32_t base_port = 23000;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:r:l:p:")) != -1) {
+		switch (c) {
+			case 'n':
+				if (n_sizes < sizeof(sizes) / sizeof(uint32_t)) {
+					sizes[n_sizes++] = (uint32_t)atoi(optarg);
+				}
+				break;
+
+			case 'r':
+				runs = (uint32_t)atoi(optarg);
+				break;
+
+			case 'l':
+				info_delay_ms = (uint32_t)atoi(optarg);
+				break;
+
+			case 'p':
+				base_port = (uint32_t)atoi(optarg);
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-n nodes]... [-r runs] [-l info_delay_ms] [-p base_port]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (n_sizes == 0) {
+		sizes[n_sizes++] = 1;
+		sizes[n_sizes++] = 10;
+		sizes[n_sizes++] = 40;
+	}
+
+	uint32_t ports = 0;
+
+	for (uint32_t i = 0; i < n_sizes; i++) {
+		if (sizes[i] == 0 || sizes[i] > 1000) {
+			fprintf(stderr, "Nodes must be 1 to 1000\n");
+			return 1;
+		}
+		ports += sizes[i];
+	}
+
+	if (runs == 0 || base_port + ports > 65535) {
+		fprintf(stderr, "Runs must be positive and ports must fit below 65536\n");
+		return 1;
+	}
+
+	printf("%u partitions, %u runs, %u ms info delay\n", N_PARTITIONS, runs, info_delay_ms);
+	printf("%8s %8s %14s %14s %14s\n", "nodes", "start", "connect ms", "routed ms", "validated ms");
+
+	uint16_t port = (uint16_t)base_port;
+
+	for (uint32_t i = 0; i < n_sizes; i++) {
+		if (! run_size(sizes[i], port, runs)) {
+			return 1;
+		}
+		port += sizes[i];
+	}
+	unlink(SNAPSHOT_PATH);
+	return 0;
+}
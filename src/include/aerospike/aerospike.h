@@ -52,6 +52,7 @@
 
 #include <aerospike/as_error.h>
 #include <aerospike/as_config.h>
+#include <aerospike/as_key.h>
 #include <aerospike/as_log.h>
 #include <aerospike/as_status.h>
 #include <stdbool.h>
@@ -279,6 +280,30 @@ as_status aerospike_connect(aerospike * as, as_error * err);
  */
 as_status aerospike_close(aerospike * as, as_error * err);
 
+/**
+ *	Resolve a namespace once for fast node lookup.  Assign the handle to 
+ *	as_key.handle for keys in this namespace, including batch keys.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_namespace_handle handle;
+ *	aerospike_namespace_handle_init(&as, &err, &handle, "test");
+ *	~~~~~~~~~~
+ *
+ *	A namespace which the cluster has not reported yet is not an error.  The 
+ *	handle is resolved when the namespace appears.  The handle must be 
+ *	initialized again after reconnecting.
+ *
+ *	@param as 		The aerospike instance, which must be connected.
+ *	@param err 		If an error occurs, the err will be populated.
+ *	@param handle	The handle to initialize.
+ *	@param ns 		The namespace.
+ *
+ *	@returns AEROSPIKE_OK on success. Otherwise an error occurred. 
+ *
+ *	@relates aerospike
+ */
+as_status aerospike_namespace_handle_init(aerospike * as, as_error * err, as_namespace_handle * handle, const char * ns);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
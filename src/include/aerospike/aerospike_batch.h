@@ -114,8 +114,10 @@ typedef struct as_batch_read_records_s {
  *	or aerospike_batch_exists() functions.
  *
  * 	The `results` argument will be an array of `n` as_batch_read entries. The
- * 	`results` argument is on the stack and is only available within the context
- * 	of the callback. To use the data outside of the callback, copy the data.
+ * 	`results` argument is only available within the context of the callback.
+ * 	To use the data outside of the callback, copy the data.  Use the foreach
+ * 	variants, like aerospike_batch_get_foreach(), to receive records as they
+ * 	arrive instead of holding every result of a large batch in memory.
  *
  *	~~~~~~~~~~{.c}
  *	bool my_callback(const as_batch_read * results, uint32_t n, void * udata) {
@@ -133,6 +135,37 @@ typedef struct as_batch_read_records_s {
  */
 typedef bool (*aerospike_batch_read_callback)(const as_batch_read* results, uint32_t n, void* udata);
 
+/**
+ *	This callback will be called for each result of aerospike_batch_get_foreach(),
+ *	aerospike_batch_get_bins_foreach() or aerospike_batch_exists_foreach() as soon
+ *	as the result is received, in no particular order.  Keys of a node that fails
+ *	are retried as set by as_policy_batch.retry, so a key is passed at most once.
+ *	If the batch still fails, each key that did not return is passed with the error
+ *	code as its result.
+ *
+ *	The callback is always called in the thread that issued the batch, even when
+ *	commands to several nodes are in flight at once.  The `result`
+ *	argument is only available within the context of the callback.  To use the
+ *	data outside of the callback, copy the data.
+ *
+ *	~~~~~~~~~~{.c}
+ *	bool my_callback(const as_batch_read * result, void * udata) {
+ *		if (result->result == AEROSPIKE_OK) {
+ *			// Use result->record.
+ *		}
+ *		return true;
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param result 		The result of one key in the batch request.
+ *	@param udata 		User-data provided to the calling function.
+ *
+ *	@return `true` to continue. `false` to abort the batch request.
+ *
+ *	@ingroup batch_operations
+ */
+typedef bool (*aerospike_batch_foreach_callback)(const as_batch_read* result, void* udata);
+
 	
 /**
  *	@private
@@ -377,6 +410,87 @@ aerospike_batch_exists(
 	aerospike_batch_read_callback callback, void * udata
 	);
 
+/**
+ *	Look up multiple records by key, then return all bins.  Unlike aerospike_batch_get(),
+ *	the callback is called for each record as soon as it's received, so results are not
+ *	held in memory and the first records are available before the slowest node responds.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_batch batch;
+ *	as_batch_inita(&batch, 3);
+ *	
+ *	as_key_init(as_batch_keyat(&batch,0), "ns", "set", "key1");
+ *	as_key_init(as_batch_keyat(&batch,1), "ns", "set", "key2");
+ *	as_key_init(as_batch_keyat(&batch,2), "ns", "set", "key3");
+ *	
+ *	if ( aerospike_batch_get_foreach(&as, &err, NULL, &batch, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_batch_destroy(&batch);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param batch		The batch of keys to read.
+ *	@param callback 	The callback to invoke for each record read.
+ *	@param udata		The user-data for the callback.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup batch_operations
+ */
+as_status
+aerospike_batch_get_foreach(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	aerospike_batch_foreach_callback callback, void* udata
+	);
+
+/**
+ *	Look up multiple records by key, then return specified bins.  The callback is called
+ *	for each record as soon as it's received.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param batch		The batch of keys to read.
+ *	@param bins			Bin filters.  Only return these bins.
+ *	@param n_bins		The number of bin filters.
+ *	@param callback 	The callback to invoke for each record read.
+ *	@param udata		The user-data for the callback.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup batch_operations
+ */
+as_status
+aerospike_batch_get_bins_foreach(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	const char** bins, uint32_t n_bins, aerospike_batch_foreach_callback callback, void* udata
+	);
+
+/**
+ *	Test whether multiple records exist in the cluster.  The callback is called for each
+ *	key as soon as its result is received.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param batch		The batch of keys to read.
+ *	@param callback 	The callback to invoke for each key.
+ *	@param udata		The user-data for the callback.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup batch_operations
+ */
+as_status
+aerospike_batch_exists_foreach(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	aerospike_batch_foreach_callback callback, void* udata
+	);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
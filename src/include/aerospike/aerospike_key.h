@@ -30,6 +30,7 @@
 
 #include <aerospike/aerospike.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_event.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_list.h>
 #include <aerospike/as_operations.h>
@@ -293,6 +294,131 @@ as_status aerospike_key_apply(
 	as_val ** result
 	);
 
+/**
+ *	Asynchronously look up a record by key, then return all bins.  The listener
+ *	is called from the event loop thread when the command completes.  If this
+ *	function returns an error, the listener is not called.
+ *
+ *	~~~~~~~~~~{.c}
+ *	void my_listener(as_error* err, as_record* rec, void* udata, as_event_loop* event_loop)
+ *	{
+ *		if (err) {
+ *			fprintf(stderr, "error(%d) %s", err->code, err->message);
+ *		}
+ *	}
+ *
+ *	as_key key;
+ *	as_key_init(&key, "ns", "set", "key");
+ *	
+ *	if ( aerospike_key_get_async(&as, &err, NULL, &key, my_listener, NULL, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_get_async(
+	aerospike* as, as_error* err, const as_policy_read* policy, const as_key* key,
+	as_async_record_listener listener, void* udata, as_event_loop* event_loop
+	);
+
+/**
+ *	Asynchronously store a record in the cluster.  The record is fully
+ *	serialized before this function returns, so it may be destroyed immediately.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param rec 			The record containing the data to be written.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_put_async(
+	aerospike* as, as_error* err, const as_policy_write* policy, const as_key* key, as_record* rec,
+	as_async_write_listener listener, void* udata, as_event_loop* event_loop
+	);
+
+/**
+ *	Asynchronously remove a record from the cluster.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_remove_async(
+	aerospike* as, as_error* err, const as_policy_remove* policy, const as_key* key,
+	as_async_write_listener listener, void* udata, as_event_loop* event_loop
+	);
+
+/**
+ *	Asynchronously lookup a record by key, then perform specified operations.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param ops			The operations to perform on the record.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_operate_async(
+	aerospike* as, as_error* err, const as_policy_operate* policy, const as_key* key, const as_operations* ops,
+	as_async_record_listener listener, void* udata, as_event_loop* event_loop
+	);
+
+/**
+ *	Asynchronously lookup a record by key, then apply the UDF.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param module		The module containing the function to execute.
+ *	@param function 	The function to execute.
+ *	@param arglist 		The arguments for the function.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_apply_async(
+	aerospike* as, as_error* err, const as_policy_apply* policy, const as_key* key,
+	const char* module, const char* function, as_list* arglist,
+	as_async_value_listener listener, void* udata, as_event_loop* event_loop
+	);
+
 /**
  *	Do the connected servers support the new floating point type.
  *	The cluster must already be connected (aerospike_connect()) prior to making this call.
@@ -263,6 +263,15 @@ as_roles_destroy(as_role** roles, int roles_size);
 as_status
 as_authenticate(as_error* err, int fd, const char* user, const char* credential, uint64_t deadline_ms);
 
+/**
+ *	@private
+ *	Write authentication command into buffer and return the command length.
+ *	The buffer must hold 34 bytes of headers plus the user and credential lengths.
+ *	Used by connections that can not block on as_authenticate().
+ */
+uint32_t
+as_authenticate_set(const char* user, const char* credential, uint8_t* buffer);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Default block size of arenas shared by many records.
+ */
+#define AS_ARENA_BLOCK_SIZE (64 * 1024)
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Arena memory block.
+ */
+typedef struct as_arena_block_s {
+	struct as_arena_block_s* next;
+	size_t capacity;
+	size_t offset;
+	uint8_t data[];
+} as_arena_block;
+
+/**
+ *	@private
+ *	Reference counted bump pointer allocator for parsed records.  Memory is only
+ *	returned when the last reference is released, so every record that allocates
+ *	from the arena holds a reference.  Allocation is thread safe so one arena can
+ *	be shared by parallel batch node commands.
+ */
+typedef struct as_arena_s {
+	pthread_mutex_t lock;
+
+	/**
+	 *	Current block.  Older blocks are linked through next.
+	 */
+	as_arena_block* block;
+
+	/**
+	 *	First block when it is part of the arena's own allocation.
+	 */
+	as_arena_block* inline_block;
+
+	/**
+	 *	Minimum size of blocks added when the current block is full.
+	 */
+	size_t block_size;
+
+	uint32_t ref_count;
+
+	/**
+	 *	Arena struct was allocated by as_arena_create().
+	 */
+	bool free;
+} as_arena;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Number of bytes as_arena_init() needs for an arena with a first block of size bytes.
+ */
+static inline size_t
+as_arena_footprint(size_t size)
+{
+	return sizeof(as_arena) + sizeof(as_arena_block) + ((size + 7) & ~(size_t)7);
+}
+
+/**
+ *	@private
+ *	Initialize arena in mem, which must hold as_arena_footprint(size) bytes.
+ *	The caller owns mem and frees it after the last reference is released.
+ */
+as_arena*
+as_arena_init(void* mem, size_t size, size_t block_size);
+
+/**
+ *	@private
+ *	Create heap arena with no initial block.  Returns NULL if out of memory.
+ */
+as_arena*
+as_arena_create(size_t block_size);
+
+/**
+ *	@private
+ *	Allocate size bytes aligned to 8 bytes.  Returns NULL if out of memory.
+ */
+void*
+as_arena_alloc(as_arena* arena, size_t size);
+
+/**
+ *	@private
+ *	Add reference to arena.
+ */
+void
+as_arena_reserve(as_arena* arena);
+
+/**
+ *	@private
+ *	Remove reference to arena and free its memory when no references remain.
+ */
+void
+as_arena_release(as_arena* arena);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -17,6 +17,8 @@
 #pragma once
 
 #include <aerospike/as_config.h>
+#include <aerospike/as_epoch.h>
+#include <aerospike/as_key.h>
 #include <aerospike/as_node.h>
 #include <aerospike/as_partition.h>
 #include <aerospike/as_policy.h>
@@ -49,52 +51,84 @@ typedef struct as_seed_s {
 } as_seed;
 
 /**
- *	@private
- *  Reference counted array of server node pointers.
+ *	Cluster tend statistics.
  */
-typedef struct as_nodes_s {
+typedef struct as_tend_stats_s {
 	/**
-	 *	@private
-	 *  Reference count of node array.
+	 *	Completed tends.
 	 */
-	uint32_t ref_count;
+	uint64_t count;
 	
 	/**
-	 *	@private
-	 *  Length of node array.
+	 *	Duration of last tend in milliseconds.
 	 */
-	uint32_t size;
+	uint64_t last_ms;
 	
 	/**
-	 *	@private
-	 *  Server node array.
+	 *	Longest tend in milliseconds.
 	 */
-	as_node* array[];
-} as_nodes;
+	uint64_t max_ms;
+	
+	/**
+	 *	Total time in milliseconds spent in completed tends.
+	 */
+	uint64_t total_ms;
+	
+	/**
+	 *	Time in milliseconds the last tend waited on node info requests.
+	 */
+	uint64_t last_refresh_ms;
+	
+	/**
+	 *	Node refreshes that failed.
+	 */
+	uint64_t refresh_failures;
+} as_tend_stats;
 
 /**
- *	@private
- *	Reference counted release function definition.
+ *	Node circuit breaker statistics.
  */
-typedef void (*as_release_fn) (void* value);
+typedef struct as_breaker_stats_s {
+	/**
+	 *	Times a node's circuit breaker was opened, including failed recovery probes.
+	 */
+	uint64_t trips;
+	
+	/**
+	 *	Commands failed immediately because their node's circuit breaker was open
+	 *	and no other replica could be used.
+	 */
+	uint64_t rejects;
+	
+	/**
+	 *	Nodes whose circuit breaker is currently open or half-open.
+	 */
+	uint32_t open_nodes;
+} as_breaker_stats;
 
 /**
  *	@private
- *  Reference counted data to be garbage collected.
+ *  Reference counted array of server node pointers.
  */
-typedef struct as_gc_item_s {
+typedef struct as_nodes_s {
 	/**
 	 *	@private
-	 *  Reference counted data to be garbage collected.
+	 *  Reference count of node array.
 	 */
-	void* data;
+	uint32_t ref_count;
 	
 	/**
 	 *	@private
-	 *  Release function.
+	 *  Length of node array.
 	 */
-	as_release_fn release_fn;
-} as_gc_item;
+	uint32_t size;
+	
+	/**
+	 *	@private
+	 *  Server node array.
+	 */
+	as_node* array[];
+} as_nodes;
 
 /**
  *	Cluster of server nodes.
@@ -114,9 +148,15 @@ typedef struct as_cluster_s {
 		
 	/**
 	 *	@private
-	 *	Nodes to be garbage collected.
+	 *	Epoch based reclamation of nodes and partition tables removed by the tend thread.
+	 */
+	as_epoch* epoch;
+	
+	/**
+	 *	@private
+	 *	Released nodes still protected by command thread hazard pointers.
 	 */
-	as_vector* /* <as_gc_item> */ gc;
+	struct as_node_s* deferred_nodes;
 	
 	/**
 	 *	@private
@@ -171,6 +211,30 @@ typedef struct as_cluster_s {
 	 */
 	as_thread_pool thread_pool;
 	
+	/**
+	 *	@private
+	 *	Event loops used to execute asynchronous commands.
+	 */
+	struct as_event_loop_s* event_loops;
+	
+	/**
+	 *	@private
+	 *	Length of event_loops array.
+	 */
+	uint32_t event_loop_size;
+	
+	/**
+	 *	@private
+	 *	Round-robin counter used to assign commands to event loops.
+	 */
+	uint32_t event_loop_index;
+	
+	/**
+	 *	@private
+	 *	Maximum asynchronous connections per node on each event loop.  Zero means unlimited.
+	 */
+	uint32_t async_max_conns_per_loop;
+	
 	/**
 	 *	@private
 	 *	Lock for the tend thread to wait on with the tend interval as timeout.
@@ -198,6 +262,24 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t conn_queue_size;
 	
+	/**
+	 *	@private
+	 *	Maximum synchronous connections per node.  Zero means unlimited.
+	 */
+	uint32_t max_conns_per_node;
+	
+	/**
+	 *	@private
+	 *	Synchronous connections opened to each node on connect.
+	 */
+	uint32_t min_conns_per_node;
+	
+	/**
+	 *	@private
+	 *	Maximum outstanding commands on node pipeline connection.  Zero disables pipelining.
+	 */
+	uint32_t pipeline_depth;
+	
 	/**
 	 *	@private
 	 *	Initial connection timeout in milliseconds.
@@ -206,10 +288,40 @@ typedef struct as_cluster_s {
 	
 	/**
 	 *	@private
-	 *	Maximum socket idle in seconds.
+	 *	Maximum socket idle in seconds.  Zero disables closing idle pooled connections.
 	 */
 	uint32_t max_socket_idle;
 	
+	/**
+	 *	@private
+	 *	Pooled connections used within this many milliseconds are not validated.
+	 */
+	uint32_t conn_validate_ms;
+	
+	/**
+	 *	@private
+	 *	Consecutive node errors that open the node's circuit breaker.  Zero disables breakers.
+	 */
+	uint32_t breaker_errors;
+	
+	/**
+	 *	@private
+	 *	Milliseconds an open circuit breaker waits before allowing a probe command.
+	 */
+	uint32_t breaker_open_ms;
+	
+	/**
+	 *	@private
+	 *	Circuit breaker trips.
+	 */
+	uint64_t breaker_trips;
+	
+	/**
+	 *	@private
+	 *	Commands rejected by open circuit breakers.
+	 */
+	uint64_t breaker_rejects;
+	
 	/**
 	 *	@private
 	 *	Random node index.
@@ -222,6 +334,30 @@ typedef struct as_cluster_s {
 	 */
 	cl_partition_id	n_partitions;
 	
+	/**
+	 *	@private
+	 *	Tend statistics.  Written by tend thread only.
+	 */
+	as_tend_stats tend_stats;
+	
+	/**
+	 *	@private
+	 *	Warm start snapshot file.  Null if disabled.
+	 */
+	char* snapshot_path;
+	
+	/**
+	 *	@private
+	 *	Signature of the last saved snapshot.  Tend thread only.
+	 */
+	uint64_t snapshot_signature;
+	
+	/**
+	 *	@private
+	 *	Nodes were loaded from a snapshot and have not been tended yet.
+	 */
+	bool warm_start;
+	
 	/**
 	 *	@private
 	 *	Should continue to tend cluster.
@@ -257,6 +393,18 @@ as_cluster_destroy(as_cluster* cluster);
 bool
 as_cluster_is_connected(as_cluster* cluster);
 
+/**
+ *	Get cluster tend statistics.
+ */
+void
+as_cluster_get_tend_stats(as_cluster* cluster, as_tend_stats* stats);
+
+/**
+ *	Get node circuit breaker statistics.
+ */
+void
+as_cluster_get_breaker_stats(as_cluster* cluster, as_breaker_stats* stats);
+
 /**
  *	Get all node names in cluster.
  */
@@ -269,9 +417,11 @@ as_cluster_get_node_names(as_cluster* cluster, int* n_nodes, char** node_names);
 static inline as_nodes*
 as_nodes_reserve(as_cluster* cluster)
 {
+	// Epoch keeps nodes from being released between load and reference count increment.
+	as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
 	as_nodes* nodes = (as_nodes *)ck_pr_load_ptr(&cluster->nodes);
-	//ck_pr_fence_acquire();
 	ck_pr_inc_32(&nodes->ref_count);
+	as_epoch_exit(slot);
 	return nodes;
 }
 
@@ -301,11 +451,19 @@ as_cluster_change_password(as_cluster* cluster, const char* user, const char* pa
 /**
  *	@private
  *	Get random node in the cluster.
- *	as_nodes_release() must be called when done with node.
+ *	as_node_release() must be called when done with node.
  */
 as_node*
 as_node_get_random(as_cluster* cluster);
 
+/**
+ *	@private
+ *	Select random node in the cluster without reserving it.  Must be called inside an epoch
+ *	(see as_epoch_enter()) and the node must not be used after leaving it.
+ */
+as_node*
+as_node_select_random(as_cluster* cluster);
+
 /**
  *	@private
  *	Get node given node name.
@@ -322,8 +480,10 @@ as_node_get_by_name(as_cluster* cluster, const char* name);
 static inline as_partition_tables*
 as_partition_tables_reserve(as_cluster* cluster)
 {
+	as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
 	as_partition_tables* tables = (as_partition_tables *)ck_pr_load_ptr(&cluster->partition_tables);
 	ck_pr_inc_32(&tables->ref_count);
+	as_epoch_exit(slot);
 	return tables;
 }
 
@@ -344,59 +504,157 @@ as_partition_tables_release(as_partition_tables* tables)
 
 /**
  *	@private
- *	Get partition table given namespace.
+ *	Get partition table given namespace.  Must be called inside an epoch.  The tables array is
+ *	not reference counted because the epoch keeps it from being released.
  */
 static inline as_partition_table*
 as_cluster_get_partition_table(as_cluster* cluster, const char* ns)
 {
-	// Partition tables array size does not currently change after first cluster tend.
-	// Also, there is a one second delayed garbage collection coupled with as_partition_tables_get()
-	// being very fast.  Reference counting the tables array is not currently necessary, but do it
-	// anyway in case the server starts supporting dynamic namespaces.
-	as_partition_tables* tables = as_partition_tables_reserve(cluster);
-	as_partition_table* table = as_partition_tables_get(tables, ns);
-	as_partition_tables_release(tables);
-	return table;
+	as_partition_tables* tables = (as_partition_tables *)ck_pr_load_ptr(&cluster->partition_tables);
+	return as_partition_tables_get(tables, ns);
 }
 
 /**
  *	@private
- *	Get mapped node given digest key and partition table.  If there is no mapped node, a random
- *	node is used instead.
- *	as_nodes_release() must be called when done with node.
+ *	Select mapped node given digest key and partition table without reserving it.  If there is
+ *	no mapped node, a random node is used instead.  Must be called inside an epoch.
  */
 as_node*
-as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, bool write, as_policy_replica replica);
+as_partition_table_select_node(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, bool write, as_policy_replica replica);
 
 /**
  *	@private
- *	Get shared memory mapped node given digest key.  If there is no mapped node, a random node is used instead.
- *	as_nodes_release() must be called when done with node.
+ *	Select the replica which is not the given node for the digest's partition.  Return NULL if
+ *	the partition has no other active replica.  Must be called inside an epoch.
  */
 as_node*
-as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica);
+as_partition_table_select_alternate(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, as_node* node);
 
 /**
  *	@private
- *	Get mapped node given digest key.  If there is no mapped node, a random node is used instead.
- *	as_nodes_release() must be called when done with node.
+ *	Select shared memory mapped node given digest key without reserving it.  If there is no
+ *	mapped node, a random node is used instead.  Must be called inside an epoch.
+ */
+as_node*
+as_shm_node_select(as_cluster* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica);
+
+/**
+ *	@private
+ *	Select shared memory mapped node given partition table index plus one and digest key without
+ *	reserving it.  If there is no mapped node, a random node is used instead.  Must be called
+ *	inside an epoch.
+ */
+as_node*
+as_shm_node_select_by_index(as_cluster* cluster, uint32_t index, const uint8_t* digest, bool write, as_policy_replica replica);
+
+/**
+ *	@private
+ *	Select the replica which is not the given node for the digest's shared memory partition.
+ *	The partition table is found by index plus one or, if index is zero, by namespace.  Must
+ *	be called inside an epoch.
+ */
+as_node*
+as_shm_node_select_alternate(as_cluster* cluster, const char* ns, uint32_t index, const uint8_t* digest, as_node* node);
+
+/**
+ *	@private
+ *	Resolve namespace handle's partition table.  Resolved handles are not changed.  Unresolved
+ *	handles are looked up again only when the number of partition tables has changed since
+ *	the last attempt.
+ */
+void
+as_namespace_handle_resolve(as_cluster* cluster, as_namespace_handle* handle);
+
+/**
+ *	@private
+ *	Select mapped node given digest key without reserving it.  If there is no mapped node, a random
+ *	node is used instead.  If handle is not null and belongs to this cluster, the namespace name is
+ *	not used.  Must be called inside an epoch and the node must not be used after leaving it.
  */
 static inline as_node*
-as_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica)
+as_node_select(as_cluster* cluster, const char* ns, as_namespace_handle* handle, const uint8_t* digest, bool write, as_policy_replica replica)
 {
 #ifdef AS_TEST_PROXY
-	return as_node_get_random(cluster);
+	return as_node_select_random(cluster);
 #else
+	if (handle && handle->cluster == cluster) {
+		// Partition tables are never removed while the cluster exists, so a resolved handle
+		// can be used without a name lookup or partition tables reference count.
+		uint32_t index = ck_pr_load_32(&handle->index);
+		
+		if (! index) {
+			as_namespace_handle_resolve(cluster, handle);
+			index = ck_pr_load_32(&handle->index);
+		}
+		ck_pr_fence_load();
+		
+		if (cluster->shm_info) {
+			return as_shm_node_select_by_index(cluster, index, digest, write, replica);
+		}
+		return as_partition_table_select_node(cluster, index ? ck_pr_load_ptr(&handle->table) : 0, digest, write, replica);
+	}
+	
 	if (cluster->shm_info) {
-		return as_shm_node_get(cluster, ns, digest, write, replica);
+		return as_shm_node_select(cluster, ns, digest, write, replica);
 	}
 	else {
 		as_partition_table* table = as_cluster_get_partition_table(cluster, ns);
-		return as_partition_table_get_node(cluster, table, digest, write, replica);
+		return as_partition_table_select_node(cluster, table, digest, write, replica);
 	}
 #endif
 }
 
+/**
+ *	@private
+ *	Select the replica which is not the given node for the digest's partition, so a read
+ *	can be hedged.  Return NULL if there is no other active replica.  Must be called inside
+ *	the epoch in which node was selected.
+ */
+static inline as_node*
+as_node_select_alternate(as_cluster* cluster, const char* ns, as_namespace_handle* handle, const uint8_t* digest, as_node* node)
+{
+#ifdef AS_TEST_PROXY
+	return 0;
+#else
+	if (handle && handle->cluster == cluster) {
+		uint32_t index = ck_pr_load_32(&handle->index);
+		ck_pr_fence_load();
+		
+		if (cluster->shm_info) {
+			return index ? as_shm_node_select_alternate(cluster, ns, index, digest, node) : 0;
+		}
+		return index ? as_partition_table_select_alternate(cluster, ck_pr_load_ptr(&handle->table), digest, node) : 0;
+	}
+	
+	if (cluster->shm_info) {
+		return as_shm_node_select_alternate(cluster, ns, 0, digest, node);
+	}
+	else {
+		as_partition_table* table = as_cluster_get_partition_table(cluster, ns);
+		return as_partition_table_select_alternate(cluster, table, digest, node);
+	}
+#endif
+}
+
+/**
+ *	@private
+ *	Get mapped node given digest key.  If there is no mapped node, a random node is used instead.
+ *	If handle is not null and belongs to this cluster, the namespace name is not used.
+ *	as_node_release() must be called when done with node.
+ */
+static inline as_node*
+as_node_get(as_cluster* cluster, const char* ns, as_namespace_handle* handle, const uint8_t* digest, bool write, as_policy_replica replica)
+{
+	as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+	as_node* node = as_node_select(cluster, ns, handle, digest, write, replica);
+	
+	if (node) {
+		as_node_reserve(node);
+	}
+	as_epoch_exit(slot);
+	return node;
+}
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
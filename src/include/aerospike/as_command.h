@@ -111,6 +111,22 @@ extern "C" {
  */
 #define as_command_free(_buf, _sz) if (_sz > AS_STACK_BUF_SIZE) {cf_free(_buf);}
 
+/**
+ *	@private
+ *	String and blob bin values of at least this size are sent directly from their
+ *	own memory instead of being copied into the command buffer.  So are list and
+ *	map values that had to be serialized into a separate buffer.
+ */
+#define AS_COMMAND_REF_SIZE AS_STACK_BUF_SIZE
+
+/**
+ *	@private
+ *	Maximum number of bin values referenced by one command.  Each referenced
+ *	value adds two entries to the command's write vector.  Larger values beyond
+ *	this count are copied as usual.
+ */
+#define AS_COMMAND_REF_MAX 16
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -122,8 +138,11 @@ extern "C" {
 typedef struct as_command_node_s {
 	as_node* node;
 	const char* ns;
+	as_namespace_handle* handle;
 	const uint8_t* digest;
 	as_policy_replica replica;
+	uint32_t hedge_delay_ms;
+	uint8_t hedge_percentile;
 	bool write;
 } as_command_node;
 
@@ -134,13 +153,78 @@ typedef struct as_command_node_s {
 typedef struct as_command_parse_result_data_s {
 	as_record** record;
 	bool deserialize;
+	bool lazy;
 } as_command_parse_result_data;
 
+/**
+ *	@private
+ *	Command write vector.  Header, key and bin headers are written to a command
+ *	buffer as usual, while large bin values are left in place and interleaved
+ *	with the buffer segments when the command is sent.  The first entry always
+ *	starts with the command header.
+ */
+typedef struct as_command_iov_s {
+	/**
+	 *	@private
+	 *	Write vector.
+	 */
+	struct iovec iov[AS_COMMAND_REF_MAX * 2 + 1];
+
+	/**
+	 *	@private
+	 *	Command buffer.
+	 */
+	uint8_t* begin;
+
+	/**
+	 *	@private
+	 *	Start of command buffer bytes not yet added to vector.
+	 */
+	uint8_t* seg;
+
+	/**
+	 *	@private
+	 *	Number of vector entries used.
+	 */
+	int iovcnt;
+
+	/**
+	 *	@private
+	 *	Number of values reserved for referencing by as_command_bin_size_iov().
+	 */
+	uint32_t n_reserved;
+
+	/**
+	 *	@private
+	 *	Number of values referenced by as_command_write_bin_iov().
+	 */
+	uint32_t n_refs;
+} as_command_iov;
+
 /**
  *	@private
  *	Parse results callback used in as_command_execute().
  */
-typedef as_status (*as_parse_results_fn) (as_error* err, int fd, uint64_t deadline_ms, void* user_data);
+typedef as_status (*as_parse_results_fn) (as_error* err, as_connection* conn, uint64_t deadline_ms, void* user_data);
+
+/**
+ *	@private
+ *	Parse one group of records from a multi-record response (batch, scan or query).
+ *	Return AEROSPIKE_NO_MORE_RECORDS after the last group.
+ */
+typedef as_status (*as_parse_group_fn) (as_error* err, uint8_t* buf, size_t size, void* user_data);
+
+/**
+ *	@private
+ *	Multi-record command sent to one node by as_command_execute_fanout().
+ */
+typedef struct as_command_fanout_s {
+	as_node* node;
+	uint8_t* command;
+	size_t command_len;
+	void* parse_data;
+	as_status status;  // Set on return.  AEROSPIKE_ERR_CLIENT_ABORT if the command was not completed.
+} as_command_fanout;
 
 /******************************************************************************
  * FUNCTIONS
@@ -190,6 +274,29 @@ as_command_bin_size(const as_bin* bin, as_buffer* buffer)
 	return strlen(bin->name) + as_command_value_size((as_val*)bin->valuep, buffer) + 8;
 }
 
+/**
+ *	@private
+ *	Initialize command write vector before sizing bins.
+ */
+static inline void
+as_command_iov_init(as_command_iov* ci)
+{
+	ci->begin = 0;
+	ci->seg = 0;
+	ci->iovcnt = 0;
+	ci->n_reserved = 0;
+	ci->n_refs = 0;
+}
+
+/**
+ *	@private
+ *	Calculate command buffer space needed for bin when writing with as_command_write_bin_iov().
+ *	Large values are not counted because they are referenced in place.  Bins must be
+ *	sized and written in the same order.
+ */
+size_t
+as_command_bin_size_iov(as_command_iov* ci, const as_bin* bin, as_buffer* buffer);
+
 /**
  *	@private
  *	Calculate size of bin name.  Return error is bin name greater than 14 characters.
@@ -350,6 +457,37 @@ as_command_write_bin_name(uint8_t* cmd, const char* name)
 uint8_t*
 as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin, as_buffer* buffer);
 
+/**
+ *	@private
+ *	Write bin.  Large values reserved by as_command_bin_size_iov() are added to
+ *	the write vector instead of being copied.  begin must point into the command
+ *	buffer passed to as_command_iov_begin().
+ */
+uint8_t*
+as_command_write_bin_iov(as_command_iov* ci, uint8_t* begin, uint8_t operation_type, const as_bin* bin,
+	as_buffer* buffer);
+
+/**
+ *	@private
+ *	Start writing command buffer for vectored command.
+ */
+static inline void
+as_command_iov_begin(as_command_iov* ci, uint8_t* cmd)
+{
+	ci->begin = cmd;
+	ci->seg = cmd;
+	ci->iovcnt = 0;
+	ci->n_refs = 0;
+}
+
+/**
+ *	@private
+ *	Finish writing vectored command.  Return total command length including
+ *	referenced values.
+ */
+size_t
+as_command_iov_end(as_command_iov* ci, uint8_t* end);
+
 /**
  *	@private
  *	Finish writing command.
@@ -372,26 +510,66 @@ as_command_execute(as_cluster* cluster, as_error * err, as_command_node* cn, uin
    uint32_t timeout_ms, uint32_t retry,
    as_parse_results_fn parse_results_fn, void* parse_results_data);
 
+/**
+ *	@private
+ *	Send vectored command to the server.  The first entry must start with the
+ *	command header so the timeout can be reset on retry.
+ */
+as_status
+as_command_execute_iov(as_cluster* cluster, as_error * err, as_command_node* cn, struct iovec* iov, int iovcnt,
+   uint32_t timeout_ms, uint32_t retry,
+   as_parse_results_fn parse_results_fn, void* parse_results_data);
+
+/**
+ *	@private
+ *	Send multi-record commands to all their nodes from the calling thread, then poll
+ *	the connections together and parse each response group as it arrives.  Commands
+ *	are not retried.  Commands for a node at its connection limit are sent when other
+ *	commands return their connections, so the caller never waits on the pool while it
+ *	holds connections.  The first failure is returned.  If abort_on_error is true, the first
+ *	failure also closes the remaining connections.  Otherwise, only a user abort stops
+ *	other commands, and each command's result is left in its status field.
+ */
+as_status
+as_command_execute_fanout(as_cluster* cluster, as_error* err, as_command_fanout* commands, uint32_t n_commands,
+	uint32_t timeout_ms, as_parse_group_fn parse_group_fn, bool abort_on_error);
+
 /**
  *	@private
  *	Parse header of server response.
  */
 as_status
-as_command_parse_header(as_error* err, int fd, uint64_t deadline_ms, void* user_data);
+as_command_parse_header(as_error* err, as_connection* conn, uint64_t deadline_ms, void* user_data);
 
 /**
  *	@private
  *	Parse server record.  Used for reads.
  */
 as_status
-as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data);
+as_command_parse_result(as_error* err, as_connection* conn, uint64_t deadline_ms, void* user_data);
+
+/**
+ *	@private
+ *	Parse server record from a response body that has already been read.
+ *	The buffer starts immediately after the as_msg header.
+ */
+as_status
+as_command_parse_result_buf(as_error* err, as_msg* msg, uint8_t* buf, void* user_data);
 
 /**
  *	@private
  *	Parse server success or failure result.
  */
 as_status
-as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, void* user_data);
+as_command_parse_success_failure(as_error* err, as_connection* conn, uint64_t deadline_ms, void* user_data);
+
+/**
+ *	@private
+ *	Parse server success or failure result from a response body that has already been read.
+ *	The buffer starts immediately after the as_msg header.
+ */
+as_status
+as_command_parse_success_failure_buf(as_error* err, as_msg* msg, uint8_t* buf, void* user_data);
 
 /**
  *	@private
@@ -403,9 +581,21 @@ as_command_parse_success_failure_bins(uint8_t** pp, as_error* err, as_msg* msg,
 /**
  *	@private
  *	Parse bins received from the server.
+ *
+ *	If borrow is true, string, geojson and raw bytes values point into buf instead of
+ *	being copied.  Strings are null terminated in place, which overwrites the first byte
+ *	after each value, including the byte following the last bin.  The caller must make
+ *	that byte writable and restore it if it is still needed (see as_command_ignore_bins()).
+ */
+uint8_t*
+as_command_parse_bins(as_record* rec, uint8_t* buf, uint32_t n_bins, bool deserialize, bool borrow);
+
+/**
+ *	@private
+ *	Skip over bins section in returned data.
  */
 uint8_t*
-as_command_parse_bins(as_record* rec, uint8_t* buf, uint32_t n_bins, bool deserialize);
+as_command_ignore_bins(uint8_t* p, uint32_t n_bins);
 
 /**
  *	@private
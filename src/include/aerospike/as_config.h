@@ -274,19 +274,67 @@ typedef struct as_config_s {
 	/**
 	 *	Estimate of incoming threads concurrently using synchronous methods in the client instance.
 	 *	This field is used to size the synchronous connection pool for each server node.
+	 *	Up to max_threads + 1 idle connections are kept per node.  Each connection carries
+	 *	a 64 KB read buffer (AS_CONNECTION_BUFFER_SIZE), so a full pool uses about
+	 *	(max_threads + 1) * 64 KB per node, or 19 MB per node at the default.
 	 *	Default: 300
 	 */
 	uint32_t max_threads;
 	
 	/**
-	 *	@private
-	 *	Not currently used.
-	 *	Maximum socket idle in seconds.  Socket connection pools will discard sockets
-	 *	that have been idle longer than the maximum.
+	 *	Maximum socket idle in seconds.  The cluster tend thread closes pooled
+	 *	synchronous connections that have been idle longer than the maximum.
+	 *	Keep this below the server's proto-fd-idle-ms.  Zero disables idle checks.
 	 *	Default: 14
 	 */
 	uint32_t max_socket_idle_sec;
 	
+	/**
+	 *	Maximum number of synchronous connections, idle or in use, allowed per server
+	 *	node.  When a node is at the limit, commands wait for a connection to be
+	 *	returned, up to their timeout, instead of opening a new one.  This avoids
+	 *	opening and authenticating connections during bursts, only to close them
+	 *	again when the burst ends.  It also bounds the connection read buffer memory
+	 *	(64 KB per connection) per node.  Zero means unlimited.
+	 *	Default: 0
+	 */
+	uint32_t max_conns_per_node;
+	
+	/**
+	 *	Number of synchronous connections opened to each server node by aerospike_connect(),
+	 *	so the first commands do not pay for connection setup.  Capped by max_threads + 1
+	 *	and max_conns_per_node.
+	 *	Default: 0
+	 */
+	uint32_t min_conns_per_node;
+	
+	/**
+	 *	Pooled connections that were last used within this many milliseconds are
+	 *	reused without first checking whether the server closed them, which saves
+	 *	a system call per command.  Zero checks every pooled connection.  If the
+	 *	server did close such a connection, the command is sent again on another
+	 *	connection without counting against the policy's retry limit.
+	 *	Default: 1000
+	 */
+	uint32_t conn_validate_ms;
+	
+	/**
+	 *	Consecutive connection, socket or timeout errors on a node that open the node's
+	 *	circuit breaker.  While a breaker is open, commands to the node fail immediately
+	 *	with AEROSPIKE_ERR_NODE_UNAVAILABLE instead of retrying until their timeout, and
+	 *	reads use the other replica when it is available.  Zero disables circuit breakers.
+	 *	Default: 0
+	 */
+	uint32_t breaker_errors;
+	
+	/**
+	 *	Milliseconds an open circuit breaker waits before letting one command through to
+	 *	test whether the node has recovered.  The breaker closes when that command gets
+	 *	a response and stays open for another interval otherwise.
+	 *	Default: 1000
+	 */
+	uint32_t breaker_open_ms;
+	
 	/**
 	 *	Initial host connection timeout in milliseconds.  The timeout when opening a connection
 	 *	to the server host for the first time.
@@ -301,17 +349,53 @@ typedef struct as_config_s {
 	uint32_t tender_interval;
 
 	/**
-	 *	Number of threads stored in underlying thread pool that is used in batch/scan/query commands.
-	 *	These commands are often sent to multiple server nodes in parallel threads.  A thread pool 
-	 *	improves performance because threads do not have to be created/destroyed for each command.
+	 *	Number of threads stored in underlying thread pool.  Batch, scan and query commands
+	 *	to multiple server nodes are multiplexed in the calling thread and do not use the pool.
+	 *	Query aggregation uses one pool thread per query to run the lua stream.
 	 *	Calculate your value using the following formula:
 	 *
-	 *	thread_pool_size = (concurrent batch/scan/query commands) * (server nodes)
+	 *	thread_pool_size = (concurrent aggregation queries)
 	 *
 	 *	Default: 16
 	 */
 	uint32_t thread_pool_size;
 
+	/**
+	 *	Number of epoll event loops used to execute asynchronous commands such as
+	 *	aerospike_key_get_async().  Each event loop can have many commands in flight
+	 *	and is serviced by one client owned thread.  Zero disables asynchronous commands.
+	 *	Default: 0
+	 */
+	uint32_t event_loop_size;
+	
+	/**
+	 *	If true, the client does not create event loop threads.  Instead, the application
+	 *	drives each event loop by calling as_event_loop_poll() from a single thread per
+	 *	event loop.  Only used when event_loop_size is greater than zero.
+	 *	Default: false
+	 */
+	bool event_loop_external;
+	
+	/**
+	 *	Maximum number of asynchronous connections, idle or in use, allowed per server
+	 *	node.  The limit is divided evenly between event loops.  When an event loop has
+	 *	reached its share for a node, commands wait for one of its connections to that
+	 *	node to be returned, up to their timeout, instead of opening a new one.  Zero
+	 *	means unlimited.
+	 *	Default: 0
+	 */
+	uint32_t async_max_conns_per_node;
+	
+	/**
+	 *	Maximum number of single record commands that may be outstanding at once on a
+	 *	node's shared pipeline connection.  When greater than zero, key commands issued by
+	 *	different threads to the same node are written back-to-back on one socket and
+	 *	their responses are read in order.  Commands that arrive while the pipeline is full
+	 *	use a regular pooled connection.  Zero disables pipelining.
+	 *	Default: 0
+	 */
+	uint32_t pipeline_depth;
+
 	/**
 	 *	Count of entries in hosts array.
 	 */
@@ -386,6 +470,18 @@ typedef struct as_config_s {
 	 *	Default: 30
 	 */
 	uint32_t shm_takeover_threshold_sec;
+	
+	/**
+	 *	Warm start snapshot file.  When set, the cluster tend thread saves node addresses
+	 *	and partition ownership to this file whenever they change.  If the file is valid
+	 *	when the client connects, aerospike_connect() loads it and returns without waiting
+	 *	for the cluster to be discovered, so commands are routed immediately.  The first
+	 *	tend then validates each node against its partition generation in the background.
+	 *	If none of the saved nodes respond, the seed hosts are used.  Not used when use_shm
+	 *	is enabled, since processes then already share partition maps.
+	 *	Default: empty (disabled)
+	 */
+	char warm_start_path[AS_CONFIG_PATH_MAX_SIZE];
 } as_config;
 
 /******************************************************************************
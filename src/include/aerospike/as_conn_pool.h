@@ -0,0 +1,329 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_connection.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Concurrency kit needs to be under extern "C" when compiling C++.
+#include <aerospike/ck/ck_pr.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Number of per-thread cache slots in each pool.  Threads are assigned slots
+ *	round robin, so slots are only shared when there are more threads than slots.
+ */
+#define AS_CONN_POOL_SLOTS 64
+
+/**
+ *	@private
+ *	Cache line size used to keep slots and queue indexes from false sharing.
+ */
+#define AS_CONN_POOL_CACHE_LINE 64
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Connection pool statistics for a node.
+ */
+typedef struct as_conn_pool_stats_s {
+	/**
+	 *	Connections taken from the pool.
+	 */
+	uint64_t hits;
+
+	/**
+	 *	Connection requests that found the pool empty.
+	 */
+	uint64_t misses;
+
+	/**
+	 *	Connections opened.
+	 */
+	uint64_t creates;
+
+	/**
+	 *	Connections closed.
+	 */
+	uint64_t closes;
+
+	/**
+	 *	Connection requests that waited because the node was at its connection limit.
+	 */
+	uint64_t waits;
+
+	/**
+	 *	Total time in milliseconds spent waiting for a connection.
+	 */
+	uint64_t wait_time_ms;
+
+	/**
+	 *	Connections closed on return because the pool already held its maximum
+	 *	number of idle connections.  High values mean the pool is too small for
+	 *	bursts and connections are being churned.
+	 */
+	uint64_t discards;
+} as_conn_pool_stats;
+
+/**
+ *	@private
+ *	Per-thread cache slot.  Holds the connection most recently returned by the
+ *	threads mapped to this slot, plus their statistics.  Each slot spans two
+ *	cache lines so neighboring slots are not pulled in by adjacent line prefetch.
+ */
+typedef struct as_conn_pool_slot_s {
+	as_connection* conn;
+	as_conn_pool_stats stats;
+	uint8_t pad[AS_CONN_POOL_CACHE_LINE * 2 - sizeof(as_connection*) - sizeof(as_conn_pool_stats)];
+} as_conn_pool_slot;
+
+/**
+ *	@private
+ *	Shared queue cell.  seq tells producers and consumers whose turn it is.
+ */
+typedef struct as_conn_pool_cell_s {
+	uint64_t seq;
+	as_connection* conn;
+} as_conn_pool_cell;
+
+/**
+ *	@private
+ *	Lock-free synchronous connection pool.  Connections are returned to the
+ *	calling thread's cache slot when it is empty, and to a bounded multi-producer,
+ *	multi-consumer array queue otherwise.  A thread issuing commands back to back
+ *	therefore usually gets its own most recently used connection with a single
+ *	atomic exchange.
+ */
+typedef struct as_conn_pool_s {
+	/**
+	 *	@private
+	 *	Per-thread cache slots.
+	 */
+	as_conn_pool_slot slots[AS_CONN_POOL_SLOTS];
+
+	/**
+	 *	@private
+	 *	Next queue position to pop.
+	 */
+	uint64_t head;
+	uint8_t pad1[AS_CONN_POOL_CACHE_LINE - sizeof(uint64_t)];
+
+	/**
+	 *	@private
+	 *	Next queue position to push.
+	 */
+	uint64_t tail;
+	uint8_t pad2[AS_CONN_POOL_CACHE_LINE - sizeof(uint64_t)];
+
+	/**
+	 *	@private
+	 *	Idle connections in slots and queue.
+	 */
+	uint32_t size;
+
+	/**
+	 *	@private
+	 *	Queue capacity minus one.  Capacity is a power of two.
+	 */
+	uint32_t mask;
+
+	/**
+	 *	@private
+	 *	Queue cells.
+	 */
+	as_conn_pool_cell* cells;
+
+	/**
+	 *	@private
+	 *	Open connections, idle or in use.  Only maintained against max.
+	 */
+	uint32_t total;
+
+	/**
+	 *	@private
+	 *	Maximum open connections.  Zero means unlimited.
+	 */
+	uint32_t max;
+
+	/**
+	 *	@private
+	 *	Threads blocked in as_conn_pool_wait().
+	 */
+	uint32_t waiters;
+
+	/**
+	 *	@private
+	 *	Protects waiting.  Not used when the node is below its connection limit.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 *	@private
+	 *	Signaled when a connection is returned or closed while threads are waiting.
+	 */
+	pthread_cond_t cond;
+} as_conn_pool;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Initialize pool that holds at most capacity idle connections and allows at
+ *	most max open connections.  If max is zero, the number of open connections
+ *	is not limited.
+ */
+void
+as_conn_pool_init(as_conn_pool* pool, uint32_t capacity, uint32_t max);
+
+/**
+ *	@private
+ *	Close idle connections and free pool resources.  No other thread may be using the pool.
+ */
+void
+as_conn_pool_destroy(as_conn_pool* pool);
+
+/**
+ *	@private
+ *	Return this thread's cache slot.
+ */
+as_conn_pool_slot*
+as_conn_pool_slot_current(as_conn_pool* pool);
+
+/**
+ *	@private
+ *	Pop idle connection.  The calling thread's cache slot is tried first.
+ *	Return false if pool is empty.
+ */
+bool
+as_conn_pool_get(as_conn_pool* pool, as_connection** conn);
+
+/**
+ *	@private
+ *	Push idle connection if pool holds fewer than limit connections.  Return
+ *	false if the pool is full, in which case the caller owns the connection.
+ *	A thread waiting for a connection is woken.
+ */
+bool
+as_conn_pool_put(as_conn_pool* pool, as_connection* conn, uint32_t limit);
+
+/**
+ *	@private
+ *	Close idle connections last used before the given cf_getms() time.  Only
+ *	connections in the pool at the start of the call are examined.  Return number
+ *	of connections closed.
+ */
+uint32_t
+as_conn_pool_close_idle(as_conn_pool* pool, uint64_t used_before_ms);
+
+/**
+ *	@private
+ *	Reserve room for a new connection.  Return false if the pool is at its
+ *	connection limit.  A successful reservation must be followed by
+ *	as_conn_pool_incr_creates() or, if the connection could not be opened,
+ *	as_conn_pool_release().
+ */
+static inline bool
+as_conn_pool_reserve(as_conn_pool* pool)
+{
+	if (pool->max == 0) {
+		return true;
+	}
+
+	uint32_t total = ck_pr_load_32(&pool->total);
+
+	while (total < pool->max) {
+		if (ck_pr_cas_32(&pool->total, total, total + 1)) {
+			return true;
+		}
+		total = ck_pr_load_32(&pool->total);
+	}
+	return false;
+}
+
+/**
+ *	@private
+ *	Give back connection reservation and wake a waiting thread.
+ */
+void
+as_conn_pool_release(as_conn_pool* pool);
+
+/**
+ *	@private
+ *	Wait until an idle connection is returned or room for a new connection
+ *	opens up.  On success, conn is set to the idle connection, or NULL if a new
+ *	connection was reserved.  Return false if deadline was reached.  If deadline
+ *	is zero, wait indefinitely.
+ */
+bool
+as_conn_pool_wait(as_conn_pool* pool, uint64_t deadline_ms, as_connection** conn);
+
+/**
+ *	@private
+ *	Count connection creation.
+ */
+static inline void
+as_conn_pool_incr_creates(as_conn_pool* pool)
+{
+	ck_pr_inc_64(&as_conn_pool_slot_current(pool)->stats.creates);
+}
+
+/**
+ *	@private
+ *	Count connection whose socket has already been closed and give back its reservation.
+ */
+static inline void
+as_conn_pool_closed(as_conn_pool* pool)
+{
+	ck_pr_inc_64(&as_conn_pool_slot_current(pool)->stats.closes);
+	as_conn_pool_release(pool);
+}
+
+/**
+ *	@private
+ *	Close connection taken from this pool that is not being returned.
+ */
+static inline void
+as_conn_pool_close(as_conn_pool* pool, as_connection* conn)
+{
+	as_connection_close(conn);
+	as_conn_pool_closed(pool);
+}
+
+/**
+ *	@private
+ *	Sum statistics of all slots.
+ */
+void
+as_conn_pool_get_stats(as_conn_pool* pool, as_conn_pool_stats* stats);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Size of connection read-ahead buffer.
+ */
+#define AS_CONNECTION_BUFFER_SIZE (64 * 1024)
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Synchronous connection with read-ahead buffer.  Each socket read requests as
+ *	much as the buffer can hold, so a response header and body usually arrive
+ *	with a single recv().  The buffer stays attached to the connection while it
+ *	sits in the node's connection pool.
+ */
+typedef struct as_connection_s {
+	/**
+	 *	@private
+	 *	Socket file descriptor.
+	 */
+	int fd;
+
+	/**
+	 *	@private
+	 *	Offset of next unread byte in buffer.
+	 */
+	uint32_t offset;
+
+	/**
+	 *	@private
+	 *	Number of bytes in buffer.
+	 */
+	uint32_t length;
+
+	/**
+	 *	@private
+	 *	Time in milliseconds (cf_getms()) when connection was last returned to pool.
+	 */
+	uint64_t last_used;
+
+	/**
+	 *	@private
+	 *	Connection was returned to the pool and has not read any bytes since.  A read
+	 *	error on an idle connection usually means the server closed it while pooled.
+	 */
+	bool idle;
+
+	/**
+	 *	@private
+	 *	Read-ahead buffer.  The extra byte lets borrowed record parsing terminate a
+	 *	string that ends at the end of the buffer.
+	 */
+	uint8_t buf[AS_CONNECTION_BUFFER_SIZE + 1];
+} as_connection;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Wrap connected socket.  Returns NULL if out of memory.
+ */
+as_connection*
+as_connection_create(int fd);
+
+/**
+ *	@private
+ *	Close socket and free connection.
+ */
+void
+as_connection_close(as_connection* conn);
+
+/**
+ *	@private
+ *	Read exactly len bytes into buf.  Buffered bytes are used first.
+ *	If deadline is zero, do not set deadline.
+ */
+as_status
+as_connection_read(as_error* err, as_connection* conn, uint8_t* buf, size_t len, uint64_t deadline_ms);
+
+/**
+ *	@private
+ *	Read exactly len bytes and return pointer to them in the connection buffer.
+ *	The data is valid until the next read on this connection.
+ *	len must not exceed AS_CONNECTION_BUFFER_SIZE.
+ */
+as_status
+as_connection_read_ptr(as_error* err, as_connection* conn, size_t len, uint64_t deadline_ms, uint8_t** ptr);
+
+/**
+ *	@private
+ *	Write data to connection.  If deadline is zero, do not set deadline.
+ */
+static inline as_status
+as_connection_write(as_error* err, as_connection* conn, uint8_t* buf, size_t len, uint64_t deadline_ms)
+{
+	return as_socket_write_deadline(err, conn->fd, buf, len, deadline_ms);
+}
+
+/**
+ *	@private
+ *	Write scattered data to connection.  If deadline is zero, do not set deadline.
+ */
+static inline as_status
+as_connection_writev(as_error* err, as_connection* conn, struct iovec* iov, int iovcnt, uint64_t deadline_ms)
+{
+	return as_socket_writev_deadline(err, conn->fd, iov, iovcnt, deadline_ms);
+}
+
+/**
+ *	@private
+ *	Does connection buffer contain unread data.
+ */
+static inline bool
+as_connection_has_data(as_connection* conn)
+{
+	return conn->offset < conn->length;
+}
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_vector.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Concurrency kit needs to be under extern "C" when compiling C++.
+#include <aerospike/ck/ck_pr.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Number of reader slots.  Threads are assigned slots round robin, so slots are
+ *	only shared when there are more threads than slots.
+ */
+#define AS_EPOCH_SLOTS 256
+
+/**
+ *	@private
+ *	Cache line size used to keep reader slots from false sharing.
+ */
+#define AS_EPOCH_CACHE_LINE 64
+
+/**
+ *	@private
+ *	Hazard pointers per thread.
+ */
+#define AS_EPOCH_HAZARDS 2
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Reference counted release function definition.
+ */
+typedef void (*as_release_fn) (void* value);
+
+/**
+ *	@private
+ *	Reader slot.  Written only by the threads mapped to it, so entering and leaving
+ *	an epoch does not touch cache lines shared with other threads.
+ */
+typedef struct as_epoch_slot_s {
+	/**
+	 *	@private
+	 *	Number of readers inside the epoch.  More than one only when the slot is
+	 *	shared or calls are nested.
+	 */
+	uint32_t active;
+
+	/**
+	 *	@private
+	 *	Epoch announced by the first reader to enter.
+	 */
+	uint64_t epoch;
+
+	uint8_t pad[AS_EPOCH_CACHE_LINE - sizeof(uint64_t) * 2];
+} as_epoch_slot;
+
+/**
+ *	@private
+ *	Hazard pointers of one thread.  A thread publishes data it loaded inside an epoch
+ *	before leaving the epoch, so it can keep using the data without holding the epoch
+ *	or a shared reference count.  Records are never freed.  A record is reused after
+ *	its thread exits.
+ */
+typedef struct as_epoch_hazard_s {
+	/**
+	 *	@private
+	 *	Protected data.  Written only by the owning thread.
+	 */
+	void* ptr[AS_EPOCH_HAZARDS];
+
+	/**
+	 *	@private
+	 *	Next record.
+	 */
+	struct as_epoch_hazard_s* next;
+
+	/**
+	 *	@private
+	 *	Record is owned by a thread.
+	 */
+	uint32_t used;
+
+	uint8_t pad[AS_EPOCH_CACHE_LINE - sizeof(void*) * (AS_EPOCH_HAZARDS + 1) - sizeof(uint32_t)];
+} as_epoch_hazard;
+
+/**
+ *	@private
+ *	Data retired by the tend thread, released when no reader can still see it.
+ */
+typedef struct as_epoch_item_s {
+	/**
+	 *	@private
+	 *	Reference counted data.
+	 */
+	void* data;
+
+	/**
+	 *	@private
+	 *	Release function.
+	 */
+	as_release_fn release_fn;
+
+	/**
+	 *	@private
+	 *	Global epoch when the data was retired.
+	 */
+	uint64_t epoch;
+} as_epoch_item;
+
+/**
+ *	@private
+ *	Epoch based reclamation of cluster data.  Command threads enter an epoch before
+ *	loading nodes and partition tables, and leave it once they have selected a node
+ *	and protected it with a hazard pointer, so no network I/O happens inside an epoch.
+ *	The tend thread retires data it has unlinked and releases it once every reader
+ *	that could have loaded it has left.
+ */
+typedef struct as_epoch_s {
+	/**
+	 *	@private
+	 *	Reader slots.
+	 */
+	as_epoch_slot slots[AS_EPOCH_SLOTS];
+
+	/**
+	 *	@private
+	 *	Global epoch.  Only advanced by the tend thread.
+	 */
+	uint64_t global;
+	uint8_t pad[AS_EPOCH_CACHE_LINE - sizeof(uint64_t)];
+
+	/**
+	 *	@private
+	 *	Retired data.  Only accessed by the tend thread.
+	 */
+	as_vector /* <as_epoch_item> */ retired;
+} as_epoch;
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Slot index plus one of the current thread.  Zero means not assigned yet.
+ */
+extern __thread uint32_t as_epoch_thread_slot;
+
+/**
+ *	@private
+ *	Hazard pointers of the current thread.  Null if not assigned yet.
+ */
+extern __thread as_epoch_hazard* as_epoch_thread_hazard;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Create epoch state.
+ */
+as_epoch*
+as_epoch_create();
+
+/**
+ *	@private
+ *	Release all retired data and free epoch state.  No readers may be active.
+ */
+void
+as_epoch_destroy(as_epoch* epoch);
+
+/**
+ *	@private
+ *	Assign slot to the current thread and return slot index plus one.
+ */
+uint32_t
+as_epoch_register();
+
+/**
+ *	@private
+ *	Enter epoch.  Nodes and partition tables loaded from the cluster remain valid
+ *	until as_epoch_exit() is called with the returned slot.  Calls may be nested.
+ */
+static inline as_epoch_slot*
+as_epoch_enter(as_epoch* epoch)
+{
+	uint32_t index = as_epoch_thread_slot;
+
+	if (index == 0) {
+		index = as_epoch_register();
+	}
+
+	as_epoch_slot* slot = &epoch->slots[index - 1];
+
+	// Read global epoch before the slot becomes active, so the announced epoch is never
+	// newer than one seen by a reader which shares the slot and entered afterwards.
+	uint64_t global = ck_pr_load_64(&epoch->global);
+
+	if (ck_pr_faa_32(&slot->active, 1) == 0) {
+		// Readers that share the slot keep the first reader's epoch.  It can only be
+		// older than their own, which delays reclamation but is never unsafe.
+		ck_pr_store_64(&slot->epoch, global);
+	}
+	// Slot must be visible to the tend thread before shared data is loaded.
+	ck_pr_fence_memory();
+	return slot;
+}
+
+/**
+ *	@private
+ *	Leave epoch entered by as_epoch_enter().
+ */
+static inline void
+as_epoch_exit(as_epoch_slot* slot)
+{
+	// Loads of shared data must complete before the slot is seen as quiescent.
+	ck_pr_fence_memory();
+	ck_pr_dec_32(&slot->active);
+}
+
+/**
+ *	@private
+ *	Assign hazard pointer record to the current thread.
+ */
+as_epoch_hazard*
+as_epoch_hazard_register();
+
+/**
+ *	@private
+ *	Protect data loaded inside an epoch, so it can be used after as_epoch_exit().  Must
+ *	be called before leaving the epoch.  Only a plain store to memory owned by the
+ *	current thread.  The fence in as_epoch_exit() publishes it.
+ */
+static inline void
+as_epoch_protect(uint32_t index, void* data)
+{
+	as_epoch_hazard* hazard = as_epoch_thread_hazard;
+
+	if (! hazard) {
+		hazard = as_epoch_hazard_register();
+	}
+	ck_pr_store_ptr(&hazard->ptr[index], data);
+}
+
+/**
+ *	@private
+ *	Stop protecting data protected by as_epoch_protect().
+ */
+static inline void
+as_epoch_unprotect(uint32_t index)
+{
+	// Uses of protected data must complete before the hazard is cleared.
+	ck_pr_fence_release();
+	ck_pr_store_ptr(&as_epoch_thread_hazard->ptr[index], 0);
+}
+
+/**
+ *	@private
+ *	Is data protected by any thread's hazard pointer.  Data that is no longer reachable
+ *	from the cluster and has been released by the epoch can not become protected again,
+ *	so a false result is final.
+ */
+bool
+as_epoch_protected(void* data);
+
+/**
+ *	@private
+ *	Retire data which has been unlinked from the cluster.  Tend thread only.
+ */
+void
+as_epoch_retire(as_epoch* epoch, void* data, as_release_fn release_fn);
+
+/**
+ *	@private
+ *	Advance global epoch and release retired data that no active reader can see.  Data
+ *	is released by this call, including data retired since the previous call, unless a
+ *	reader that entered before the data was retired is still inside its epoch.  Such data
+ *	is kept until a later call.  Releasing a node only drops a reference.  Nodes still
+ *	protected by a hazard pointer are freed later (see as_node_destroy()).  Tend thread
+ *	only.  Returns number of items released.
+ */
+uint32_t
+as_epoch_reclaim(as_epoch* epoch);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
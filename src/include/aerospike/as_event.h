@@ -0,0 +1,525 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+/**
+ *	@defgroup async_events Asynchronous Event Loops
+ *	@ingroup client_operations
+ *
+ *	Asynchronous commands are executed on client owned epoll event loops.
+ *	Each event loop runs on a single thread and can have many commands in
+ *	flight at once.  Enable event loops with as_config.event_loop_size.
+ */
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_proto.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_val.h>
+#include <aerospike/as_vector.h>
+#include <citrusleaf/cf_queue.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+struct as_event_loop_s;
+
+/**
+ *	Asynchronous record listener.  This function is called once when a command
+ *	that returns a record completes.  The record is destroyed by the client when
+ *	the listener returns, so the listener must copy any data it wants to retain.
+ *
+ *	@param err			Error that occurred or NULL on success.
+ *	@param record		Record returned by the server.  NULL if an error occurred.
+ *	@param udata		User data passed to the asynchronous function.
+ *	@param event_loop	Event loop that executed the command.
+ *
+ *	@ingroup async_events
+ */
+typedef void (*as_async_record_listener) (as_error* err, as_record* record, void* udata, struct as_event_loop_s* event_loop);
+
+/**
+ *	Asynchronous write listener.  This function is called once when a command
+ *	that does not return data completes.
+ *
+ *	@param err			Error that occurred or NULL on success.
+ *	@param udata		User data passed to the asynchronous function.
+ *	@param event_loop	Event loop that executed the command.
+ *
+ *	@ingroup async_events
+ */
+typedef void (*as_async_write_listener) (as_error* err, void* udata, struct as_event_loop_s* event_loop);
+
+/**
+ *	Asynchronous value listener.  This function is called once when a command
+ *	that returns a single value (UDF apply) completes.  The value is destroyed
+ *	by the client when the listener returns.
+ *
+ *	@param err			Error that occurred or NULL on success.
+ *	@param val			Value returned by the server.  NULL if an error occurred.
+ *	@param udata		User data passed to the asynchronous function.
+ *	@param event_loop	Event loop that executed the command.
+ *
+ *	@ingroup async_events
+ */
+typedef void (*as_async_value_listener) (as_error* err, as_val* val, void* udata, struct as_event_loop_s* event_loop);
+
+/**
+ *	@private
+ *	Asynchronous connection.  Connections are registered with the event loop's
+ *	epoll instance once when opened and stay registered while they sit in the
+ *	node's asynchronous connection pool.
+ */
+typedef struct as_event_connection_s {
+	/**
+	 *	@private
+	 *	Socket file descriptor.
+	 */
+	int fd;
+
+	/**
+	 *	@private
+	 *	Is the socket currently registered for write readiness.
+	 */
+	bool watch_write;
+
+	/**
+	 *	@private
+	 *	Has the connection been authenticated.
+	 */
+	bool authenticated;
+
+	/**
+	 *	@private
+	 *	Has the peer closed or errored the connection while it was idle in the pool.
+	 */
+	bool closed;
+
+	/**
+	 *	@private
+	 *	Command currently using this connection.  NULL when idle.
+	 */
+	struct as_event_command_s* cmd;
+} as_event_connection;
+
+/**
+ *	@private
+ *	Asynchronous command state.
+ */
+typedef enum as_event_state_e {
+	AS_EVENT_WRITE_AUTH,
+	AS_EVENT_READ_AUTH_HEADER,
+	AS_EVENT_READ_AUTH_BODY,
+	AS_EVENT_WRITE_COMMAND,
+	AS_EVENT_READ_HEADER,
+	AS_EVENT_READ_BODY,
+	AS_EVENT_WAIT_CONNECTION
+} as_event_state;
+
+/**
+ *	@private
+ *	Asynchronous command result type.
+ */
+typedef enum as_event_type_e {
+	AS_EVENT_TYPE_WRITE,
+	AS_EVENT_TYPE_RECORD,
+	AS_EVENT_TYPE_VALUE,
+	AS_EVENT_TYPE_CLOSE_POOL
+} as_event_type;
+
+/**
+ *	@private
+ *	Asynchronous command.  The command struct and the serialized command are
+ *	allocated in one block.  Responses that fit are read into the same block
+ *	once the command has been sent.
+ */
+typedef struct as_event_command_s {
+	/**
+	 *	@private
+	 *	Event loop that executes this command.
+	 */
+	struct as_event_loop_s* event_loop;
+
+	/**
+	 *	@private
+	 *	Cluster used for node lookup.
+	 */
+	struct as_cluster_s* cluster;
+
+	/**
+	 *	@private
+	 *	Reserved node.  Only valid while a connection is assigned.
+	 */
+	as_node* node;
+
+	/**
+	 *	@private
+	 *	Connection assigned to command.
+	 */
+	as_event_connection* conn;
+
+	/**
+	 *	@private
+	 *	User listener.  Member used depends on type.
+	 */
+	union {
+		as_async_write_listener write;
+		as_async_record_listener record;
+		as_async_value_listener value;
+	} listener;
+
+	/**
+	 *	@private
+	 *	User data passed back to listener.
+	 */
+	void* udata;
+
+	/**
+	 *	@private
+	 *	Serialized command.  Points into this allocation.
+	 */
+	uint8_t* cmd_buf;
+
+	/**
+	 *	@private
+	 *	Current read/write buffer.
+	 */
+	uint8_t* buf;
+
+	/**
+	 *	@private
+	 *	Absolute deadline in milliseconds.  Zero means no deadline.
+	 */
+	uint64_t deadline_ms;
+
+	/**
+	 *	@private
+	 *	Serialized command length.
+	 */
+	uint32_t cmd_len;
+
+	/**
+	 *	@private
+	 *	Capacity of the inline buffer that starts at cmd_buf.
+	 */
+	uint32_t capacity;
+
+	/**
+	 *	@private
+	 *	Bytes to transfer in current state.
+	 */
+	uint32_t len;
+
+	/**
+	 *	@private
+	 *	Bytes already transferred in current state.
+	 */
+	uint32_t pos;
+
+	/**
+	 *	@private
+	 *	Index into event loop timer heap.  -1 when not in heap.
+	 */
+	int32_t timer_index;
+
+	/**
+	 *	@private
+	 *	User specified timeout.  Used to report errors.
+	 */
+	uint32_t timeout_ms;
+
+	/**
+	 *	@private
+	 *	Maximum number of retries on connection and write failures.
+	 */
+	uint32_t retry;
+
+	/**
+	 *	@private
+	 *	Number of retries already attempted.
+	 */
+	uint32_t iterations;
+
+	/**
+	 *	@private
+	 *	Response protocol header.
+	 */
+	as_proto proto;
+
+	/**
+	 *	@private
+	 *	Namespace used for node lookup.
+	 */
+	char ns[AS_NAMESPACE_MAX_SIZE];
+
+	/**
+	 *	@private
+	 *	Optional pre-resolved namespace used for node lookup.
+	 */
+	as_namespace_handle* handle;
+
+	/**
+	 *	@private
+	 *	Digest used for node lookup.
+	 */
+	uint8_t digest[AS_DIGEST_VALUE_SIZE];
+
+	/**
+	 *	@private
+	 *	as_event_state.
+	 */
+	uint8_t state;
+
+	/**
+	 *	@private
+	 *	as_event_type.
+	 */
+	uint8_t type;
+
+	/**
+	 *	@private
+	 *	as_policy_replica.
+	 */
+	uint8_t replica;
+
+	/**
+	 *	@private
+	 *	Is command a write.
+	 */
+	bool write;
+
+	/**
+	 *	@private
+	 *	Deserialize list/map bins.
+	 */
+	bool deserialize;
+
+	/**
+	 *	@private
+	 *	Deserialize list/map bins on first access.
+	 */
+	bool lazy;
+
+	/**
+	 *	@private
+	 *	Is buf a separate heap allocation.
+	 */
+	bool free_buf;
+
+	/**
+	 *	@private
+	 *	Next command waiting for a connection.
+	 */
+	struct as_event_command_s* wait_next;
+
+	/**
+	 *	@private
+	 *	Previous command waiting for a connection.
+	 */
+	struct as_event_command_s* wait_prev;
+} as_event_command;
+
+/**
+ *	Event loop.  Each event loop owns an epoll instance and executes its commands
+ *	from a single thread.  That thread is created by the client unless
+ *	as_config.event_loop_external is set, in which case the application calls
+ *	as_event_loop_poll() from its own thread.
+ *
+ *	@ingroup async_events
+ */
+typedef struct as_event_loop_s {
+	/**
+	 *	@private
+	 *	Commands submitted from other threads.
+	 */
+	cf_queue* queue;
+
+	/**
+	 *	@private
+	 *	Timer heap of commands ordered by deadline.
+	 */
+	as_event_command** timers;
+
+	/**
+	 *	@private
+	 *	Number of commands in timer heap.
+	 */
+	uint32_t timers_size;
+
+	/**
+	 *	@private
+	 *	Capacity of timer heap.
+	 */
+	uint32_t timers_capacity;
+
+	/**
+	 *	@private
+	 *	Connections closed during the current epoll batch.  Freed after the
+	 *	batch so that later events in the same batch do not reference freed memory.
+	 */
+	as_vector garbage;
+
+	/**
+	 *	@private
+	 *	Number of commands that have been submitted but not completed.
+	 */
+	uint32_t pending;
+
+	/**
+	 *	@private
+	 *	Commands waiting for a connection to a node at its connection limit, oldest first.
+	 */
+	as_event_command* wait_head;
+
+	/**
+	 *	@private
+	 *	Newest command waiting for a connection.
+	 */
+	as_event_command* wait_tail;
+
+	/**
+	 *	@private
+	 *	Set when a wakeup has been signaled and not yet consumed.
+	 */
+	uint32_t wakeup;
+
+	/**
+	 *	@private
+	 *	Index of event loop in cluster's event loop array.
+	 */
+	uint32_t index;
+
+	/**
+	 *	@private
+	 *	epoll file descriptor.
+	 */
+	int epoll_fd;
+
+	/**
+	 *	@private
+	 *	eventfd used to wake the loop when commands are queued.
+	 */
+	int wakeup_fd;
+
+	/**
+	 *	@private
+	 *	Event loop thread.  Not used for external event loops.
+	 */
+	pthread_t thread;
+
+	/**
+	 *	@private
+	 *	Is event loop driven by the application.
+	 */
+	bool external;
+
+	/**
+	 *	@private
+	 *	Should event loop thread continue to run.
+	 */
+	volatile bool valid;
+} as_event_loop;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Return event loop at index.  If index is negative, event loops are
+ *	assigned in round-robin fashion.  Returns NULL if the client has no
+ *	event loops.
+ *
+ *	@ingroup async_events
+ */
+as_event_loop*
+as_event_loop_get(aerospike* as, int index);
+
+/**
+ *	Process ready events, queued commands and expired timers of an external
+ *	event loop.  Waits up to timeout_ms for events when nothing is ready.
+ *	Must always be called from the same thread for a given event loop.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_event_loop* loop = as_event_loop_get(&as, 0);
+ *
+ *	while (running) {
+ *		as_event_loop_poll(loop, 100);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param event_loop	The event loop to process.
+ *	@param timeout_ms	Maximum time to wait for events.
+ *
+ *	@return Number of commands still pending on the event loop.
+ *
+ *	@ingroup async_events
+ */
+uint32_t
+as_event_loop_poll(as_event_loop* event_loop, uint32_t timeout_ms);
+
+/**
+ *	@private
+ *	Create event loops for cluster.
+ */
+as_status
+as_event_loops_create(struct as_cluster_s* cluster, as_error* err, uint32_t size, bool external);
+
+/**
+ *	@private
+ *	Wait for pending commands to complete and destroy the cluster's event loops.
+ */
+void
+as_event_loops_destroy(struct as_cluster_s* cluster);
+
+/**
+ *	@private
+ *	Allocate asynchronous command with room for a serialized command of size bytes.
+ *	The caller writes the serialized command to cmd_buf, sets cmd_len and then
+ *	sets type, listener, udata and deserialize.
+ */
+as_event_command*
+as_event_command_create(struct as_cluster_s* cluster, const as_key* key, size_t size,
+	uint32_t timeout_ms, uint32_t retry, as_policy_replica replica, bool write);
+
+/**
+ *	@private
+ *	Queue command on event loop.  If event_loop is NULL, an event loop is
+ *	chosen in round-robin fashion.  Ownership of the command passes to the
+ *	event loop even on failure.
+ */
+as_status
+as_event_command_execute(as_error* err, as_event_command* cmd, as_event_loop* event_loop);
+
+/**
+ *	@private
+ *	Close and free node's asynchronous connection pools.
+ */
+void
+as_event_node_destroy(as_node* node);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -100,6 +100,61 @@ typedef struct as_digest_s {
 
 } as_digest;
 
+/**
+ *	Namespace resolved once to its partition table.  Keys which reference a
+ *	handle are routed by table pointer instead of comparing namespace names on
+ *	every command.  Initialize with aerospike_namespace_handle_init() after
+ *	connecting and assign to as_key.handle.
+ *
+ *	A handle may be shared by any number of keys and threads, and must stay
+ *	valid while commands using it are in progress.  A namespace which is not
+ *	yet known to the cluster is looked up again when the cluster's namespace
+ *	list changes.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_namespace_handle handle;
+ *	aerospike_namespace_handle_init(&as, &err, &handle, "test");
+ *
+ *	as_key key;
+ *	as_key_init(&key, "test", "demo", "key");
+ *	key.handle = &handle;
+ *	~~~~~~~~~~
+ *
+ *	@ingroup as_key_object
+ */
+typedef struct as_namespace_handle_s {
+
+	/**
+	 *	@private
+	 *	Cluster the handle was resolved against.
+	 */
+	struct as_cluster_s * cluster;
+
+	/**
+	 *	@private
+	 *	Partition table.  Not used in shared memory mode.
+	 */
+	struct as_partition_table_s * table;
+
+	/**
+	 *	@private
+	 *	Partition table array index plus one.  Zero means not resolved yet.
+	 */
+	uint32_t index;
+
+	/**
+	 *	@private
+	 *	Partition table count when the handle was last resolved.
+	 */
+	uint32_t generation;
+
+	/**
+	 *	The namespace name.
+	 */
+	as_namespace ns;
+
+} as_namespace_handle;
+
 /**
  *	Key value
  *
@@ -231,6 +286,12 @@ typedef struct as_key_s {
 	 */
 	as_digest digest;
 
+	/**
+	 *	Optional pre-resolved namespace used for node lookup.  Must reference
+	 *	the same namespace as as_key.ns.  NULL if not used.
+	 */
+	as_namespace_handle * handle;
+
 } as_key;
 
 /******************************************************************************
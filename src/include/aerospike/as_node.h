@@ -16,10 +16,14 @@
  */
 #pragma once
 
+#include <aerospike/as_conn_pool.h>
+#include <aerospike/as_connection.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
 #include <aerospike/as_vector.h>
 #include <citrusleaf/cf_queue.h>
 #include <netinet/in.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +44,39 @@ extern "C" {
 // Leave this is in for backwards compatibility.
 #define AS_NODE_NAME_MAX_SIZE AS_NODE_NAME_SIZE
 
+/**
+ *	@private
+ *	Node latency average is stored multiplied by 2^AS_NODE_LATENCY_SHIFT.  Each sample
+ *	has a weight of 1/2^AS_NODE_LATENCY_SHIFT.
+ */
+#define AS_NODE_LATENCY_SHIFT 3
+
+/**
+ *	@private
+ *	One in this many AS_POLICY_REPLICA_FASTEST reads on a thread goes to the slower replica.
+ */
+#define AS_NODE_PROBE_INTERVAL 64
+
+/**
+ *	@private
+ *	Number of hedged read latency buckets.  Bucket i counts responses that took less
+ *	than 2^i microseconds and at least 2^(i-1).  The last bucket also counts slower ones.
+ */
+#define AS_NODE_LATENCY_BUCKETS 24
+
+/**
+ *	@private
+ *	Minimum hedged read latency samples before a node's percentiles are used.
+ */
+#define AS_NODE_LATENCY_MIN_SAMPLES 100
+
+/**
+ *	@private
+ *	Hedged read latency buckets are halved by the tend thread once they hold this many
+ *	samples, so percentiles follow recent latency.
+ */
+#define AS_NODE_LATENCY_WINDOW 10000
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -59,7 +96,59 @@ typedef struct as_address_s {
 	char name[INET_ADDRSTRLEN];
 } as_address;
 
+/**
+ *	@private
+ *	Partition ownership bitmap last applied to a namespace partition table.
+ */
+typedef struct as_node_bitmap_s {
+	/**
+	 *	@private
+	 *	Namespace.
+	 */
+	as_namespace ns;
+	
+	/**
+	 *	@private
+	 *	Master or prole ownership.
+	 */
+	bool master;
+	
+	/**
+	 *	@private
+	 *	Bits have been applied to the partition table.
+	 */
+	bool valid;
+	
+	/**
+	 *	@private
+	 *	One bit per partition, most significant bit first.
+	 */
+	uint8_t* bits;
+} as_node_bitmap;
+
+/**
+ *	@private
+ *	Node circuit breaker state.
+ */
+typedef enum as_node_breaker_e {
+	/**
+	 *	Commands are sent to the node.
+	 */
+	AS_NODE_BREAKER_CLOSED,
+	
+	/**
+	 *	Node has failed repeatedly.  Commands fail immediately or use another replica.
+	 */
+	AS_NODE_BREAKER_OPEN,
+	
+	/**
+	 *	One command is allowed through to test whether the node has recovered.
+	 */
+	AS_NODE_BREAKER_HALF_OPEN
+} as_node_breaker;
+
 struct as_cluster_s;
+struct as_pipeline_s;
 
 /**
  *	Server node representation.
@@ -99,9 +188,9 @@ typedef struct as_node_s {
 	
 	/**
 	 *	@private
-	 *	Pool of current, cached FDs.
+	 *	Pool of current, cached connections.
 	 */
-	cf_queue* conn_q;
+	as_conn_pool conn_pool;
 	
 	/**
 	 *	@private
@@ -111,15 +200,30 @@ typedef struct as_node_s {
 	
 	/**
 	 *	@private
-	 *	FDs for async command execution. Not currently used.
+	 *	Pools of asynchronous connections, one per event loop.  Each pool is only
+	 *	accessed by its event loop thread, so the queues are not thread-safe.
 	 */
-	// cf_queue* conn_q_asyncfd;
+	cf_queue** async_conn_qs;
 	
 	/**
 	 *	@private
-	 *	Asynchronous work queue. Not currently used.
+	 *	Asynchronous connections, idle or in use, one count per event loop.  Each count
+	 *	is only accessed by its event loop thread.
 	 */
-	// cf_queue* asyncwork_q;
+	uint32_t* async_conn_counts;
+	
+	/**
+	 *	@private
+	 *	Shared connection for pipelined single record commands.  NULL if pipelining is disabled.
+	 */
+	struct as_pipeline_s* pipeline;
+	
+	/**
+	 *	@private
+	 *	Partition bitmaps last applied to partition tables for this node.
+	 *	Only used by tend thread. Not thread-safe.
+	 */
+	as_vector /* <as_node_bitmap> */ bitmaps;
 	
 	/**
 	 *	@private
@@ -169,6 +273,49 @@ typedef struct as_node_s {
 	 */
 	uint8_t has_geo;
 	
+	/**
+	 *	@private
+	 *	Moving average of AS_POLICY_REPLICA_FASTEST read latency in microseconds,
+	 *	scaled by 2^AS_NODE_LATENCY_SHIFT.  Zero if not measured yet.
+	 */
+	uint32_t latency;
+	
+	/**
+	 *	@private
+	 *	AS_POLICY_REPLICA_FASTEST reads in progress.
+	 */
+	uint32_t inflight;
+	
+	/**
+	 *	@private
+	 *	Hedged read latency histogram.  See AS_NODE_LATENCY_BUCKETS.
+	 */
+	uint32_t latency_buckets[AS_NODE_LATENCY_BUCKETS];
+	
+	/**
+	 *	@private
+	 *	Circuit breaker state.  See as_node_breaker.
+	 */
+	uint32_t breaker_state;
+	
+	/**
+	 *	@private
+	 *	Consecutive connection, socket and timeout errors.
+	 */
+	uint32_t breaker_errors;
+	
+	/**
+	 *	@private
+	 *	Time in milliseconds the breaker was last opened or a probe command was allowed.
+	 */
+	uint64_t breaker_open_ms;
+	
+	/**
+	 *	@private
+	 *	Next node whose destruction has been deferred (see as_node_destroy()).
+	 */
+	struct as_node_s* deferred_next;
+	
 } as_node;
 
 /**
@@ -245,11 +392,21 @@ as_node_create(struct as_cluster_s* cluster, struct sockaddr_in* addr, as_node_i
 
 /**
  *	@private
- *	Close all connections in pool and free resources.
+ *	Close all connections in pool and free resources.  Called when the last reference is
+ *	released.  If a command thread still protects the node with a hazard pointer, the node
+ *	is queued on the cluster and freed by as_node_destroy_deferred().
  */
 void
 as_node_destroy(as_node* node);
 
+/**
+ *	@private
+ *	Free deferred nodes that are no longer protected.  Free all deferred nodes if force is
+ *	true.  Tend thread or cluster destroy only.
+ */
+void
+as_node_destroy_deferred(struct as_cluster_s* cluster, bool force);
+
 /**
  *	@private
  *	Set node to inactive.
@@ -289,6 +446,170 @@ as_node_release(as_node* node)
 	}
 }
 
+/**
+ *	@private
+ *	Reads selected on the current thread with AS_POLICY_REPLICA_FASTEST.
+ */
+extern __thread uint32_t as_node_select_count;
+
+/**
+ *	@private
+ *	Choose replica with lowest latency weighted by commands in progress.  Both nodes
+ *	must be active.  Periodically choose the slower replica, so a node that has
+ *	recovered is noticed.
+ */
+static inline as_node*
+as_node_select_fastest(as_node* master, as_node* prole)
+{
+	uint64_t master_score = (uint64_t)(ck_pr_load_32(&master->latency) + 1) * (ck_pr_load_32(&master->inflight) + 1);
+	uint64_t prole_score = (uint64_t)(ck_pr_load_32(&prole->latency) + 1) * (ck_pr_load_32(&prole->inflight) + 1);
+	uint32_t count = as_node_select_count++;
+	
+	if (master_score == prole_score) {
+		return (count & 1)? master : prole;
+	}
+	
+	bool probe = (count % AS_NODE_PROBE_INTERVAL) == 0;
+	return ((master_score < prole_score) != probe)? master : prole;
+}
+
+/**
+ *	@private
+ *	Start AS_POLICY_REPLICA_FASTEST read on node.
+ */
+static inline void
+as_node_begin_read(as_node* node)
+{
+	ck_pr_inc_32(&node->inflight);
+}
+
+/**
+ *	@private
+ *	End AS_POLICY_REPLICA_FASTEST read on node.  Add elapsed time to latency average
+ *	if a response was received or the read timed out.
+ */
+static inline void
+as_node_end_read(as_node* node, uint64_t elapsed_us, bool sample)
+{
+	ck_pr_dec_32(&node->inflight);
+	
+	if (sample) {
+		// Keep scaled average within 32 bits.
+		uint32_t us = (elapsed_us < 100000000)? (uint32_t)elapsed_us : 100000000;
+		uint32_t avg = ck_pr_load_32(&node->latency);
+		
+		// Concurrent updates may overwrite each other.  Losing a sample does not matter
+		// for a moving average and avoids a compare-and-swap loop.
+		avg = (avg == 0)? (us << AS_NODE_LATENCY_SHIFT) : avg - (avg >> AS_NODE_LATENCY_SHIFT) + us;
+		ck_pr_store_32(&node->latency, avg);
+	}
+}
+
+/**
+ *	@private
+ *	Allow a command through an open or half-open circuit breaker if the node has not
+ *	been tried for the cluster's breaker_open_ms.  The breaker becomes half-open.
+ */
+bool
+as_node_breaker_probe(as_node* node);
+
+/**
+ *	@private
+ *	Record a connection, socket or timeout error on node.  Opens the circuit breaker
+ *	after the cluster's breaker_errors consecutive errors or a failed probe.
+ */
+void
+as_node_breaker_failure(as_node* node);
+
+/**
+ *	@private
+ *	Close circuit breaker after node has responded.
+ */
+void
+as_node_breaker_close(as_node* node);
+
+/**
+ *	@private
+ *	Return whether a command may be sent to node.
+ */
+static inline bool
+as_node_breaker_allow(as_node* node)
+{
+	if (ck_pr_load_32(&node->breaker_state) == AS_NODE_BREAKER_CLOSED) {
+		return true;
+	}
+	return as_node_breaker_probe(node);
+}
+
+/**
+ *	@private
+ *	Record a response from node.  Closes the circuit breaker.  Shared data is only
+ *	written after errors, so responses from healthy nodes do not contend.
+ */
+static inline void
+as_node_breaker_success(as_node* node)
+{
+	if (ck_pr_load_32(&node->breaker_errors)) {
+		ck_pr_store_32(&node->breaker_errors, 0);
+	}
+	
+	if (ck_pr_load_32(&node->breaker_state) != AS_NODE_BREAKER_CLOSED) {
+		as_node_breaker_close(node);
+	}
+}
+
+/**
+ *	@private
+ *	Return the partition replica which is not node, if it is active.  Return NULL if node
+ *	is neither replica.
+ */
+static inline as_node*
+as_node_other_replica(as_node* node, as_node* master, as_node* prole)
+{
+	as_node* other;
+	
+	if (node == master) {
+		other = prole;
+	}
+	else if (node == prole) {
+		other = master;
+	}
+	else {
+		return 0;
+	}
+	return (other && ck_pr_load_8(&other->active))? other : 0;
+}
+
+/**
+ *	@private
+ *	Add hedged read response time to node's latency histogram.
+ */
+static inline void
+as_node_add_latency(as_node* node, uint64_t elapsed_us)
+{
+	uint32_t index = elapsed_us ? 64 - __builtin_clzll(elapsed_us) : 0;
+	
+	if (index >= AS_NODE_LATENCY_BUCKETS) {
+		index = AS_NODE_LATENCY_BUCKETS - 1;
+	}
+	ck_pr_inc_32(&node->latency_buckets[index]);
+}
+
+/**
+ *	@private
+ *	Return upper bound in microseconds of the bucket containing the given percentile of
+ *	node's hedged read latency.  Return zero if there are not enough samples yet.
+ */
+uint64_t
+as_node_latency_percentile(as_node* node, uint32_t percentile);
+
+/**
+ *	@private
+ *	Halve node's hedged read latency histogram if it is full.  Tend thread only.
+ */
+void
+as_node_decay_latency(as_node* node);
+
 /**
  *	@private
  *	Add socket address to node addresses.
@@ -296,6 +617,33 @@ as_node_release(as_node* node)
 void
 as_node_add_address(as_node* node, struct sockaddr_in* addr);
 
+/**
+ *	@private
+ *	Get partition bitmap last applied for namespace and replica role, creating an
+ *	invalid one if it does not exist.  Tend thread only.
+ */
+as_node_bitmap*
+as_node_get_bitmap(as_node* node, const char* ns, bool master, uint32_t size);
+
+/**
+ *	@private
+ *	Another node has taken over a partition from this node.  Clear the partition's
+ *	bit, so the next update for this node applies the partition again if the node
+ *	still claims it.  Tend thread only.
+ */
+static inline void
+as_node_bitmap_clear(as_node* node, const char* ns, bool master, uint32_t partition_id)
+{
+	for (uint32_t i = 0; i < node->bitmaps.size; i++) {
+		as_node_bitmap* bitmap = as_vector_get(&node->bitmaps, i);
+		
+		if (bitmap->master == master && strcmp(bitmap->ns, ns) == 0) {
+			bitmap->bits[partition_id >> 3] &= ~(0x80 >> (partition_id & 7));
+			return;
+		}
+	}
+}
+
 /**
  *	@private
  *	Get socket address and name.
@@ -318,23 +666,83 @@ as_node_get_address_full(as_node* node)
 
 /**
  *	@private
- *	Get a connection to the given node from pool and validate.  Return 0 on success.
+ *	Create a non-blocking socket and start connecting to the node.  Node aliases are
+ *	tried if the primary address fails.  The connection is not authenticated.
+ */
+as_status
+as_node_create_socket(as_error* err, as_node* node, int* fd);
+
+/**
+ *	@private
+ *	Get a connection to the given node from pool.  Connections that have been idle
+ *	longer than the cluster's conn_validate_ms are validated first.  If the pool is
+ *	empty and the node is at its connection limit, wait for a connection until
+ *	deadline.  Return 0 on success.
  */
 as_status
-as_node_get_connection(as_error* err, as_node* node, uint64_t deadline_ms, int* fd);
+as_node_get_connection(as_error* err, as_node* node, uint64_t deadline_ms, as_connection** conn);
+
+/**
+ *	@private
+ *	Get a connection like as_node_get_connection(), but do not wait when the pool is
+ *	empty and the node is at its connection limit.  Return 0 with a NULL connection in
+ *	that case.  Used by callers that already hold other connections, which could
+ *	otherwise wait for connections only they can return.
+ */
+as_status
+as_node_get_connection_nowait(as_error* err, as_node* node, uint64_t deadline_ms, as_connection** conn);
+
+/**
+ *	@private
+ *	Get a connection to the given node from pool without waiting for one or opening
+ *	a new one.  Return false if the pool has no valid connection.
+ */
+bool
+as_node_try_connection(as_node* node, as_connection** conn);
+
+/**
+ *	@private
+ *	Open connections until the node has count pooled connections or the connection
+ *	limit is reached.  Return number of connections opened.
+ */
+uint32_t
+as_node_create_min_connections(as_node* node, uint32_t count, uint64_t deadline_ms);
 
 /**
  *	@private
  *	Put connection back into pool if pool size < limit.  Otherwise, close connection.
+ *	Connections with unread data are also closed.
  */
 static inline void
-as_node_put_connection(as_node* node, int fd, uint32_t limit)
+as_node_put_connection(as_node* node, as_connection* conn, uint32_t limit)
 {
-	if (! cf_queue_push_limit(node->conn_q, &fd, limit)) {
-		close(fd);
+	conn->last_used = cf_getms();
+	conn->idle = true;
+	
+	if (as_connection_has_data(conn) || ! as_conn_pool_put(&node->conn_pool, conn, limit)) {
+		as_conn_pool_close(&node->conn_pool, conn);
 	}
 }
 
+/**
+ *	@private
+ *	Close connection that is not returned to the pool.
+ */
+static inline void
+as_node_close_connection(as_node* node, as_connection* conn)
+{
+	as_conn_pool_close(&node->conn_pool, conn);
+}
+
+/**
+ *	Get connection pool statistics for node.
+ */
+static inline void
+as_node_get_conn_stats(as_node* node, as_conn_pool_stats* stats)
+{
+	as_conn_pool_get_stats(&node->conn_pool, stats);
+}
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
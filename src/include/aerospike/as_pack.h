@@ -0,0 +1,67 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_val.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Calculate exact size of value when packed in the same msgpack format as the
+ *	as_msgpack serializer.  Return false if the value contains a type that can
+ *	not be packed directly, in which case the serializer must be used instead.
+ */
+bool
+as_pack_size(const as_val* val, uint32_t* size);
+
+/**
+ *	@private
+ *	Pack value directly into p, which must have room for the size returned by
+ *	as_pack_size().  Return pointer to the byte after the packed value.
+ */
+uint8_t*
+as_pack_write(uint8_t* p, const as_val* val);
+
+/**
+ *	@private
+ *	Find element at index in packed list buf without unpacking other elements.
+ *	On success, set elem and elem_size to the packed element.
+ */
+bool
+as_unpack_list_element(const uint8_t* buf, uint32_t size, uint32_t index, const uint8_t** elem, uint32_t* elem_size);
+
+/**
+ *	@private
+ *	Find value of key in packed map buf without unpacking other entries.  Only
+ *	integer and string keys are supported.  On success, set val and val_size to
+ *	the packed value.
+ */
+bool
+as_unpack_map_value(const uint8_t* buf, uint32_t size, const as_val* key, const uint8_t** val, uint32_t* val_size);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
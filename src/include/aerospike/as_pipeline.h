@@ -0,0 +1,163 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_command.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Node pipeline connection.  Single record commands from many threads are
+ *	written back-to-back on one socket.  The server answers commands on a
+ *	connection in order, so each command is assigned a ticket when written and
+ *	the thread holding the oldest outstanding ticket reads the next response.
+ *
+ *	Threads that time out before their response arrives abandon their ticket.
+ *	Abandoned responses are read and discarded by the next thread in line.
+ */
+typedef struct as_pipeline_s {
+	/**
+	 *	@private
+	 *	Protects all fields below.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 *	@private
+	 *	Serializes writers so tickets are issued in socket write order.
+	 */
+	pthread_mutex_t write_lock;
+
+	/**
+	 *	@private
+	 *	Signaled when the next response may be read or the connection is closed.
+	 */
+	pthread_cond_t cond;
+
+	/**
+	 *	@private
+	 *	Abandoned flags indexed by ticket modulo depth.
+	 */
+	bool* abandoned;
+
+	/**
+	 *	@private
+	 *	Next ticket to issue.
+	 */
+	uint64_t write_seq;
+
+	/**
+	 *	@private
+	 *	Ticket of the next response on the socket.
+	 */
+	uint64_t read_seq;
+
+	/**
+	 *	@private
+	 *	Maximum outstanding commands.
+	 */
+	uint32_t depth;
+
+	/**
+	 *	@private
+	 *	Incremented each time the connection is closed.  Outstanding tickets
+	 *	from an older generation will never receive a response.
+	 */
+	uint32_t generation;
+
+	/**
+	 *	@private
+	 *	Node connection pool.  Pipeline connections are taken from it and count
+	 *	against its connection limit.
+	 */
+	as_conn_pool* pool;
+
+	/**
+	 *	@private
+	 *	Pipeline connection.  NULL if not connected.
+	 */
+	as_connection* conn;
+
+	/**
+	 *	@private
+	 *	Shut down connection that is still in use by a reader or writer.  It is
+	 *	closed when they finish.  The pipeline does not reconnect until then.
+	 */
+	as_connection* stale_conn;
+
+	/**
+	 *	@private
+	 *	Is a thread currently reading a response.
+	 */
+	bool reading;
+
+	/**
+	 *	@private
+	 *	Is a thread currently writing a command.
+	 */
+	bool writing;
+} as_pipeline;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Create pipeline with given maximum outstanding commands.
+ */
+as_pipeline*
+as_pipeline_create(as_conn_pool* pool, uint32_t depth);
+
+/**
+ *	@private
+ *	Close pipeline connection and free pipeline.  No other thread may be using it.
+ */
+void
+as_pipeline_destroy(as_pipeline* pipe);
+
+/**
+ *	@private
+ *	Write a single record command on the node's pipeline connection and parse its response.
+ *
+ *	sent is set to false when the command was not written.  In that case, AEROSPIKE_OK
+ *	means the pipeline is full or another thread is writing, and the caller should use a
+ *	pooled connection.  Any other status is a connection or write failure that may be
+ *	retried.
+ *
+ *	When sent is true, the return value is the result of parse_results_fn, or an
+ *	error if the response could not be read.  AEROSPIKE_ERR_CLIENT means the connection
+ *	was closed before the response was read, possibly by another command.  The server
+ *	may have executed the command.
+ */
+as_status
+as_pipeline_execute(as_error* err, as_node* node, struct iovec* iov, int iovcnt,
+	uint64_t deadline_ms, as_parse_results_fn parse_results_fn, void* parse_results_data, bool* sent);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -263,7 +263,16 @@ typedef enum as_policy_replica_e {
 	/**
 	 *  Read from an unspecified replica node.
 	 */
-	AS_POLICY_REPLICA_ANY
+	AS_POLICY_REPLICA_ANY,
+
+	/**
+	 *  Read from the replica node with the lowest recent latency, weighted by
+	 *  commands in progress on that node.  The slower replica is still used for
+	 *  a small share of reads so its latency stays current.  Latency is measured
+	 *  by synchronous single record reads using this policy.  Asynchronous reads
+	 *  use those measurements and alternate replicas until any exist.
+	 */
+	AS_POLICY_REPLICA_FASTEST
 
 } as_policy_replica;
 
@@ -398,6 +407,36 @@ typedef struct as_policy_read_s {
 	 */
 	bool deserialize;
 
+	/**
+	 *	When deserialize is true, keep list and map bins packed until they are first
+	 *	accessed through as_record functions.  as_record_get_map_value() and
+	 *	as_record_get_list_value() read single elements without deserializing the
+	 *	whole bin.  Bins accessed directly through as_record.bins stay as_bytes.
+	 *	The first access writes the decoded bin back into the record, so records
+	 *	read with this policy must not be shared between threads without locking.
+	 *	Default: false
+	 */
+	bool lazy_deserialize;
+
+	/**
+	 *	Hedge reads against the other replica.  If the first node has not responded
+	 *	within this many milliseconds, the read is also sent to the other replica and
+	 *	the first response is used.  The slower request is cancelled by closing its
+	 *	socket.  Only single record reads are hedged, and only when an idle pooled
+	 *	connection to the other replica is available (see min_conns_per_node).
+	 *	0 disables the fixed delay.
+	 *	Default: 0
+	 */
+	uint32_t hedge_delay_ms;
+
+	/**
+	 *	Hedge reads when the first node has not responded within this percentile
+	 *	(1 to 99) of its recent hedged read latency.  Until a node has enough
+	 *	samples, hedge_delay_ms is used instead.  0 disables percentile hedging.
+	 *	Default: 0
+	 */
+	uint8_t hedge_percentile;
+
 } as_policy_read;
 
 /**
@@ -560,6 +599,15 @@ typedef struct as_policy_query_s {
 	 *	Default: true
 	 */
 	bool deserialize;
+
+	/**
+	 *	Point string, geojson and raw bytes bin values at the response buffer instead of
+	 *	copying them.  Borrowed values are only valid until the record callback returns.
+	 *	A callback that keeps a record must copy it with as_record_copy() rather than
+	 *	reserving it.
+	 *	Default: false
+	 */
+	bool borrow_bins;
 	
 } as_policy_query;
 
@@ -583,6 +631,15 @@ typedef struct as_policy_scan_s {
 	 */
 	bool fail_on_cluster_change;
 
+	/**
+	 *	Point string, geojson and raw bytes bin values at the response buffer instead of
+	 *	copying them.  Borrowed values are only valid until the record callback returns.
+	 *	A callback that keeps a record must copy it with as_record_copy() rather than
+	 *	reserving it.
+	 *	Default: false
+	 */
+	bool borrow_bins;
+
 } as_policy_scan;
 
 /**
@@ -624,25 +681,52 @@ typedef struct as_policy_batch_s {
 	uint32_t timeout;
 
 	/**
-	 *	Determine if batch commands to each server are run in parallel threads.
+	 *	Maximum time in milliseconds for one attempt of a node's batch command.  When a node
+	 *	has not completed within this time, its keys that have not returned are retried
+	 *	within the remaining timeout.  Zero means an attempt may use the full timeout.
+	 *	Default: 0
+	 */
+	uint32_t socket_timeout;
+
+	/**
+	 *	Maximum number of retries of keys whose node command failed due to a network error,
+	 *	timeout or cluster change.  Those keys are re-routed through the current partition
+	 *	map, using the other replica if the same node would be chosen again.  Keys that
+	 *	already returned are not retried.
+	 *	Default: AS_POLICY_RETRY_DEFAULT
+	 */
+	uint32_t retry;
+
+	/**
+	 *	Determine if batch commands to each server are run in parallel.
 	 *	<p>
 	 *	Values:
 	 *	<ul>
 	 *	<li>
 	 *	false: Issue batch commands sequentially.  This mode has a performance advantage for small
-	 *	to medium sized batch sizes because commands can be issued in the main transaction thread.
+	 *	to medium sized batch sizes because each command completes before the next is sent.
 	 *	This is the default.
 	 *	</li>
 	 *	<li>
-	 *	true: Issue batch commands in parallel threads.  This mode has a performance
-	 *	advantage for large batch sizes because each node can process the command immediately.
-	 *	The downside is extra threads will need to be created (or taken from
-	 *	a thread pool).
+	 *	true: Send batch commands to all nodes before reading any response.  This mode has a
+	 *	performance advantage for large batch sizes because each node can process the command
+	 *	immediately.  Responses are read as they arrive in the calling thread, so no extra
+	 *	threads are used.
 	 *	</li>
 	 *	</ul>
 	 */
 	bool concurrent;
 	
+	/**
+	 *	Maximum number of keys sent to a node in one batch command.  A node's keys beyond
+	 *	this limit are split into sub-batches that are sent in parallel over separate
+	 *	connections, so the server can process them in multiple transaction threads.
+	 *	Sub-batches are run in parallel even when concurrent is false.
+	 *	Zero means no limit.
+	 *	Default: 0
+	 */
+	uint32_t max_keys_per_request;
+	
 	/**
 	 *	Use old batch direct protocol where batch reads are handled by direct low-level batch server
 	 *	database routines.  The batch direct protocol can be faster when there is a single namespace,
@@ -680,6 +764,34 @@ typedef struct as_policy_batch_s {
 	 */
 	bool deserialize;
 
+	/**
+	 *	When deserialize is true, keep list and map bins packed until they are first
+	 *	accessed through as_record functions.  The first access writes the decoded
+	 *	bin back into the record, so records must not be shared between threads
+	 *	without locking.
+	 *	Default: false
+	 */
+	bool lazy_deserialize;
+
+	/**
+	 *	Point string, geojson and raw bytes bin values at the response buffer instead of
+	 *	copying them when records are passed to a callback.  Borrowed values are only valid
+	 *	until the callback returns.  Records stored in batch result arrays are always copied.
+	 *	Default: false
+	 */
+	bool borrow_bins;
+
+	/**
+	 *	Send each distinct key only once when the same key appears more than once in
+	 *	the batch.  Keys are the same when namespace and digest match and, for
+	 *	aerospike_batch_read(), the same bins are requested.  Every duplicate receives
+	 *	its own copy of the result.  Records in result arrays share bin value memory
+	 *	where possible, and streaming callbacks are called once for each duplicate
+	 *	with the same record.
+	 *	Default: false
+	 */
+	bool deduplicate;
+
 } as_policy_batch;
 
 /**
@@ -848,6 +960,9 @@ as_policy_read_init(as_policy_read* p)
 	p->replica = AS_POLICY_REPLICA_DEFAULT;
 	p->consistency_level = AS_POLICY_CONSISTENCY_LEVEL_DEFAULT;
 	p->deserialize = true;
+	p->lazy_deserialize = false;
+	p->hedge_delay_ms = 0;
+	p->hedge_percentile = 0;
 	return p;
 }
 
@@ -868,6 +983,9 @@ as_policy_read_copy(as_policy_read* src, as_policy_read* trg)
 	trg->replica = src->replica;
 	trg->consistency_level = src->consistency_level;
 	trg->deserialize = src->deserialize;
+	trg->lazy_deserialize = src->lazy_deserialize;
+	trg->hedge_delay_ms = src->hedge_delay_ms;
+	trg->hedge_percentile = src->hedge_percentile;
 }
 
 /**
@@ -1071,10 +1189,16 @@ static inline as_policy_batch*
 as_policy_batch_init(as_policy_batch* p)
 {
 	p->timeout = AS_POLICY_TIMEOUT_DEFAULT;
+	p->socket_timeout = 0;
+	p->retry = AS_POLICY_RETRY_DEFAULT;
 	p->concurrent = false;
+	p->max_keys_per_request = 0;
 	p->use_batch_direct = false;
 	p->allow_inline = true;
 	p->deserialize = true;
+	p->lazy_deserialize = false;
+	p->borrow_bins = false;
+	p->deduplicate = false;
 	return p;
 }
 
@@ -1090,10 +1214,16 @@ static inline void
 as_policy_batch_copy(as_policy_batch* src, as_policy_batch* trg)
 {
 	trg->timeout = src->timeout;
+	trg->socket_timeout = src->socket_timeout;
+	trg->retry = src->retry;
 	trg->concurrent = src->concurrent;
+	trg->max_keys_per_request = src->max_keys_per_request;
 	trg->use_batch_direct = src->use_batch_direct;
 	trg->allow_inline = src->allow_inline;
 	trg->deserialize = src->deserialize;
+	trg->lazy_deserialize = src->lazy_deserialize;
+	trg->borrow_bins = src->borrow_bins;
+	trg->deduplicate = src->deduplicate;
 }
 
 /**
@@ -1138,6 +1268,7 @@ as_policy_scan_init(as_policy_scan* p)
 {
 	p->timeout = 0;
 	p->fail_on_cluster_change = false;
+	p->borrow_bins = false;
 	return p;
 }
 
@@ -1154,6 +1285,7 @@ as_policy_scan_copy(as_policy_scan* src, as_policy_scan* trg)
 {
 	trg->timeout = src->timeout;
 	trg->fail_on_cluster_change = src->fail_on_cluster_change;
+	trg->borrow_bins = src->borrow_bins;
 }
 
 /**
@@ -1169,6 +1301,7 @@ as_policy_query_init(as_policy_query* p)
 {
 	p->timeout = 0;
 	p->deserialize = true;
+	p->borrow_bins = false;
 	return p;
 }
 
@@ -1185,6 +1318,7 @@ as_policy_query_copy(as_policy_query* src, as_policy_query* trg)
 {
 	trg->timeout = src->timeout;
 	trg->deserialize = src->deserialize;
+	trg->borrow_bins = src->borrow_bins;
 }
 
 /**
@@ -205,6 +205,22 @@ typedef struct as_record_s {
 	 */
 	as_bins bins;
 
+	/**
+	 *	@private
+	 *	Arena holding the bins array and bin values of a parsed record.
+	 *	Released when the record is destroyed.
+	 */
+	struct as_arena_s * arena;
+
+	/**
+	 *	@private
+	 *	List and map bins are kept as packed bytes and deserialized the first
+	 *	time they are accessed through as_record functions.  The bin is replaced
+	 *	in place, even through a const record, so a lazy record must not be read
+	 *	by more than one thread at a time.
+	 */
+	bool lazy;
+
 } as_record;
 
 /**
@@ -297,6 +313,52 @@ as_record * as_record_new(uint16_t nbins);
  */
 as_record * as_record_init(as_record * rec, uint16_t nbins);
 
+/**
+ *	@private
+ *	Create a new as_record on the heap with nbins capacity and an arena of size
+ *	bytes for bin values, all in a single allocation.
+ */
+as_record * as_record_new_arena(uint16_t nbins, size_t size);
+
+/**
+ *	@private
+ *	Initialize an as_record with nbins capacity allocated from a shared arena.
+ *	The record holds a reference to the arena until it is destroyed.
+ */
+as_record * as_record_init_arena(as_record * rec, uint16_t nbins, struct as_arena_s * arena);
+
+/**
+ *	Create a new as_record on the heap with copies of the key and bins of rec.
+ *
+ *	String, geojson and bytes values are duplicated, so the copy remains valid
+ *	after rec is destroyed.  Use this to keep a record parsed with borrowed
+ *	bins (`borrow_bins` policy) beyond the callback it was passed to.
+ *	List and map values are shared using reference counts.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_record * keep = as_record_copy(rec);
+ *	~~~~~~~~~~
+ *
+ *	When you are finished using the copy, you should release it by calling
+ *	`as_record_destroy()`.
+ *
+ *	@param rec		The record to copy.
+ *
+ *	@return a pointer to the new as_record if successful, otherwise NULL.
+ *
+ *	@relates as_record
+ */
+as_record * as_record_copy(const as_record * rec);
+
+/**
+ *	@private
+ *	Initialize an as_record with the bins of src.  String, geojson and bytes values
+ *	allocated from src's arena are shared by holding a reference to that arena.
+ *	Other values are copied as in as_record_copy().  The key is not copied.
+ *	Used to give duplicate batch keys their own record.
+ */
+as_record * as_record_init_shared(as_record * rec, const as_record * src);
+
 /**
  *	Destroy the as_record and associated resources.
  *
@@ -850,6 +912,51 @@ as_list * as_record_get_list(const as_record * rec, const as_bin_name name);
  */
 as_map * as_record_get_map(const as_record * rec, const as_bin_name name);
 
+/**
+ *	Get a value from a map bin without deserializing the rest of the map when
+ *	the bin is still packed, which is the case for records read with the
+ *	`lazy_deserialize` policy until the map is accessed as a whole.
+ *	Packed lookups support integer and string keys.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_string key;
+ *	as_string_init(&key, "name", false);
+ *	as_val * val = as_record_get_map_value(rec, "profile", (as_val *) &key);
+ *	...
+ *	as_val_destroy(val);
+ *	~~~~~~~~~~
+ *
+ *	@param rec		The record containing the bin.
+ *	@param name		The name of the map bin.
+ *	@param key		The map key.
+ *
+ *	@return the value if found, otherwise NULL.  The caller must destroy the value.
+ *
+ *	@relates as_record
+ */
+as_val * as_record_get_map_value(const as_record * rec, const as_bin_name name, const as_val * key);
+
+/**
+ *	Get an element from a list bin without deserializing the rest of the list
+ *	when the bin is still packed.
+ *
+ *	@param rec		The record containing the bin.
+ *	@param name		The name of the list bin.
+ *	@param index	The list index.
+ *
+ *	@return the element if found, otherwise NULL.  The caller must destroy the value.
+ *
+ *	@relates as_record
+ */
+as_val * as_record_get_list_value(const as_record * rec, const as_bin_name name, uint32_t index);
+
+/**
+ *	@private
+ *	Return bin value, deserializing a packed list or map of a lazy record first.
+ *	This writes to the record and is not thread safe.
+ */
+as_bin_value * as_record_bin_value(const as_record * rec, as_bin * bin);
+
 /******************************************************************************
  *	ITERATION FUNCTIONS
  ******************************************************************************/
@@ -309,11 +309,37 @@ as_shm_update_partitions(as_shm_info* shm_info, const char* ns, char* bitmap_b64
 
 /**
  *	@private
- *	Get shared memory mapped node given digest key.  If there is no mapped node, a random node is 
- *	used instead.  as_nodes_release() must be called when done with node.
+ *	Select shared memory mapped node given digest key without reserving it.  If there is no mapped
+ *	node, a random node is used instead.  Must be called inside an epoch.
  */
 as_node*
-as_shm_node_get(struct as_cluster_s* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica);
+as_shm_node_select(struct as_cluster_s* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica);
+
+/**
+ *	@private
+ *	Select shared memory mapped node given partition table index plus one and digest key without
+ *	reserving it.  If index is zero or there is no mapped node, a random node is used instead.
+ *	Must be called inside an epoch.
+ */
+as_node*
+as_shm_node_select_by_index(struct as_cluster_s* cluster, uint32_t index, const uint8_t* digest, bool write, as_policy_replica replica);
+
+/**
+ *	@private
+ *	Select the replica which is not the given node for the digest's shared memory partition.
+ *	The partition table is found by index plus one or, if index is zero, by namespace.  Return
+ *	NULL if the partition has no other active replica.  Must be called inside an epoch.
+ */
+as_node*
+as_shm_node_select_alternate(struct as_cluster_s* cluster, const char* ns, uint32_t index, const uint8_t* digest, as_node* node);
+
+/**
+ *	@private
+ *	Find partition table index plus one given namespace, searching the first max tables.
+ *	Return zero if not found.
+ */
+uint32_t
+as_shm_find_partition_index(as_cluster_shm* cluster_shm, const char* ns, uint32_t max);
 
 /**
  *	@private
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_vector.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Warm start snapshot file format version.  Files with another version are ignored.
+ */
+#define AS_SNAPSHOT_VERSION 1
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+struct as_cluster_s;
+
+/**
+ *	@private
+ *	Load nodes and partition ownership saved by as_snapshot_save().  Nodes are created
+ *	without contacting them and appended to nodes.  Their partitions are applied to the
+ *	cluster's partition tables, so commands can be routed before the first tend.  Return
+ *	an error, without creating nodes, if the file does not exist or is not valid.
+ */
+as_status
+as_snapshot_load(struct as_cluster_s* cluster, as_error* err, const char* path, as_vector* /* <as_node*> */ nodes);
+
+/**
+ *	@private
+ *	Save nodes and partition ownership if they have changed since the last save.  The
+ *	snapshot is written to a temporary file and renamed, so a process loading it never
+ *	sees a partial file.  Tend thread only.
+ */
+void
+as_snapshot_save(struct as_cluster_s* cluster, const char* path);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
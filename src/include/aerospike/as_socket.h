@@ -26,6 +26,7 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 // Windows send() and recv() parameter types are different.
 #define as_socket_data_t void
@@ -131,6 +132,26 @@ as_socket_write_deadline(as_error* err, int fd, uint8_t *buf, size_t buf_len, ui
 	}
 }
 
+/**
+ *	@private
+ *	Write scattered socket data with future deadline in milliseconds.
+ *	Do not adjust for zero deadline.  iov is not modified.
+ */
+as_status
+as_socket_writev_limit(as_error* err, int fd, struct iovec* iov, int iovcnt, uint64_t deadline);
+
+/**
+ *	@private
+ *	Write scattered socket data with a single system call when the socket
+ *	buffer has room.  If deadline is zero, use the same one minute limit as
+ *	as_socket_write_forever().  iov is not modified.
+ */
+static inline as_status
+as_socket_writev_deadline(as_error* err, int fd, struct iovec* iov, int iovcnt, uint64_t deadline)
+{
+	return as_socket_writev_limit(err, fd, iov, iovcnt, deadline? deadline : cf_getms() + 60000);
+}
+
 /**
  *	@private
  *	Write socket data with timeout in milliseconds.
@@ -162,6 +183,16 @@ as_socket_read_forever(as_error* err, int fd, uint8_t *buf, size_t buf_len);
 as_status
 as_socket_read_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline);
 
+/**
+ *	@private
+ *	Read at least min_len and at most max_len bytes of socket data.  Whatever the
+ *	kernel has already buffered up to max_len is returned in bytes_read, so one
+ *	call can return data beyond min_len.  If deadline is zero, do not set deadline.
+ */
+as_status
+as_socket_read_available(as_error* err, int fd, uint8_t *buf, size_t min_len, size_t max_len,
+	uint64_t deadline, size_t* bytes_read);
+
 /**
  *	@private
  *	Read socket data with future deadline in milliseconds.
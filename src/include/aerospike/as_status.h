@@ -33,6 +33,11 @@ typedef enum as_status_e {
 	 *	Client Errors
 	 **************************************************************************/
 	
+	/**
+	 *	Node circuit breaker is open after repeated connection or socket errors.
+	 */
+	AEROSPIKE_ERR_NODE_UNAVAILABLE = -6,
+
 	/**
 	 *	Query or scan was aborted in user's callback.
 	 */
@@ -21,6 +21,7 @@
 #include <aerospike/as_module.h>
 #include <aerospike/mod_lua.h>
 #include <aerospike/mod_lua_config.h>
+#include <string.h>
 
 /******************************************************************************
  * STATIC FUNCTIONS
@@ -123,3 +124,30 @@ as_status aerospike_close(aerospike * as, as_error * err)
 
 	return err->code;
 }
+
+/**
+ * Resolve namespace for fast node lookup
+ */
+as_status aerospike_namespace_handle_init(aerospike * as, as_error * err, as_namespace_handle * handle, const char * ns)
+{
+	as_error_reset(err);
+
+	if ( ! as->cluster ) {
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Not connected");
+	}
+
+	size_t len = ns ? strlen(ns) : 0;
+
+	if ( len == 0 || len >= AS_NAMESPACE_MAX_SIZE ) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Invalid namespace: %s", ns ? ns : "null");
+	}
+
+	handle->cluster = as->cluster;
+	handle->table = NULL;
+	handle->index = 0;
+	handle->generation = 0;
+	memcpy(handle->ns, ns, len + 1);
+
+	as_namespace_handle_resolve(as->cluster, handle);
+	return AEROSPIKE_OK;
+}
@@ -16,6 +16,7 @@
  */
 #include <aerospike/aerospike.h>
 #include <aerospike/aerospike_batch.h>
+#include <aerospike/as_arena.h>
 #include <aerospike/as_command.h>
 #include <aerospike/as_error.h>
 #include <aerospike/as_key.h>
@@ -26,10 +27,16 @@
 #include <aerospike/as_record.h>
 #include <aerospike/as_socket.h>
 #include <aerospike/as_status.h>
-#include <aerospike/as_thread_pool.h>
 #include <aerospike/as_val.h>
 #include <citrusleaf/cf_clock.h>
 
+/************************************************************************
+ * 	MACROS
+ ************************************************************************/
+
+// End of duplicate key chain.
+#define AS_BATCH_NO_DUP UINT32_MAX
+
 /************************************************************************
  * 	TYPES
  ************************************************************************/
@@ -37,6 +44,7 @@
 typedef struct as_batch_node_s {
 	as_node* node;
 	as_vector offsets;
+	bool failed;            // Command failed with an error that can be retried.
 } as_batch_node;
 
 typedef struct as_batch_task_s {
@@ -45,13 +53,12 @@ typedef struct as_batch_task_s {
 	
 	as_cluster* cluster;
 	as_error* err;
-	cf_queue* complete_q;
-	uint32_t* error_mutex;
 	as_vector* records;     // New aerospike_batch_read()
 	const char* ns;         // Old aerospike_batch_get()
 	as_key* keys;           // Old aerospike_batch_get()
 	as_batch_read* results; // Old aerospike_batch_get()
-	void* udata;            // XDR
+	void* udata;            // Streaming callbacks
+	aerospike_batch_foreach_callback callback_foreach;
 	as_batch_callback_xdr callback_xdr; // XDR
 	const char** bins;      // Old aerospike_batch_get()
 	
@@ -66,12 +73,24 @@ typedef struct as_batch_task_s {
 	bool use_new_batch;
 	bool allow_inline;
 	bool deserialize;
+	bool lazy;
+	bool borrow;
+	as_arena* arena;        // Shared by all result records when not NULL.
+	uint8_t* done;          // Keys that have returned, by offset.
+	uint32_t* dup_next;     // Next duplicate of key, by offset.  NULL when keys are not deduplicated.
+	uint32_t* dup_first;    // Key that is sent in place of key, by offset.
 } as_batch_task;
 
-typedef struct as_batch_complete_task_s {
-	as_node* node;
-	as_status result;
-} as_batch_complete_task;
+/**
+ *	Open addressing digest table used to find keys that were already mapped to a node.
+ *	Slots hold key offset + 1, so zero is empty.
+ */
+typedef struct as_batch_dedup_s {
+	uint32_t* slots;
+	uint32_t* next;
+	uint32_t* first;
+	uint32_t mask;
+} as_batch_dedup;
 
 /******************************************************************************
  *	STATIC FUNCTIONS
@@ -101,17 +120,52 @@ as_batch_parse_fields(uint8_t* p, uint32_t n_fields, uint8_t** digest)
 }
 
 static inline uint8_t*
-as_batch_parse_record(uint8_t* p, as_msg* msg, as_record* rec, bool deserialize)
+as_batch_parse_record(uint8_t* p, as_msg* msg, as_record* rec, as_arena* arena, bool deserialize, bool lazy, bool borrow)
 {
-	as_record_init(rec, msg->n_ops);
+	if (arena) {
+		as_record_init_arena(rec, msg->n_ops, arena);
+	}
+	else {
+		as_record_init(rec, msg->n_ops);
+	}
 	rec->gen = msg->generation;
 	rec->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
-	return as_command_parse_bins(rec, p, msg->n_ops, deserialize);
+	rec->lazy = deserialize && lazy;
+	return as_command_parse_bins(rec, p, msg->n_ops, deserialize && ! rec->lazy, borrow);
+}
+
+/**
+ *	Pass streamed result to callback for the key at offset and each of its duplicates.
+ */
+static bool
+as_batch_stream_result(as_batch_task* task, uint32_t offset, as_batch_read* result)
+{
+	while (true) {
+		as_key* key = &task->keys[offset];
+		result->key = key;
+		
+		bool rv = (task->callback_foreach)? task->callback_foreach(result, task->udata) :
+			task->callback_xdr(key, &result->record, task->udata);
+		
+		if (! rv) {
+			return false;
+		}
+		
+		if (! task->dup_next) {
+			return true;
+		}
+		offset = task->dup_next[offset];
+		
+		if (offset == AS_BATCH_NO_DUP) {
+			return true;
+		}
+	}
 }
 
 static as_status
-as_batch_parse_records(as_error* err, uint8_t* buf, size_t size, as_batch_task* task)
+as_batch_parse_records(as_error* err, uint8_t* buf, size_t size, void* udata)
 {
+	as_batch_task* task = udata;
 	uint8_t* p = buf;
 	uint8_t* end = buf + size;
 	
@@ -143,10 +197,11 @@ as_batch_parse_records(as_error* err, uint8_t* buf, size_t size, as_batch_task*
 			as_batch_read_record* record = as_vector_get(task->records, offset);
 
 			if (digest && memcmp(digest, record->key.digest.value, AS_DIGEST_VALUE_SIZE) == 0) {
+				task->done[offset] = 1;
 				record->result = msg->result_code;
 				
 				if (msg->result_code == AEROSPIKE_OK) {
-					p = as_batch_parse_record(p, msg, &record->record, task->deserialize);
+					p = as_batch_parse_record(p, msg, &record->record, task->arena, task->deserialize, task->lazy, false);
 				}
 			}
 			else {
@@ -158,12 +213,37 @@ as_batch_parse_records(as_error* err, uint8_t* buf, size_t size, as_batch_task*
 		else {
 			as_key* key = &task->keys[offset];
 			if (digest && memcmp(digest, key->digest.value, AS_DIGEST_VALUE_SIZE) == 0) {
-				if (task->callback_xdr) {
-					if (msg->result_code == AEROSPIKE_OK) {
-						as_record rec;
-						p = as_batch_parse_record(p, msg, &rec, task->deserialize);
-						bool rv = task->callback_xdr(key, &rec, task->udata);
-						as_record_destroy(&rec);
+				task->done[offset] = 1;
+				
+				if (task->callback_foreach || task->callback_xdr) {
+					// Stream records as they are parsed.  The XDR callback only receives
+					// records that were found.
+					if (msg->result_code == AEROSPIKE_OK || task->callback_foreach) {
+						// Borrowed parse terminates the last string in the byte following
+						// the record, which may be the next record's header.
+						uint8_t* end = 0;
+						uint8_t saved = 0;
+						
+						as_batch_read result;
+						result.result = msg->result_code;
+						
+						if (msg->result_code == AEROSPIKE_OK) {
+							if (task->borrow) {
+								end = as_command_ignore_bins(p, msg->n_ops);
+								saved = *end;
+							}
+							p = as_batch_parse_record(p, msg, &result.record, 0, task->deserialize, task->lazy, task->borrow);
+						}
+						else {
+							as_record_init(&result.record, 0);
+						}
+						
+						bool rv = as_batch_stream_result(task, offset, &result);
+						as_record_destroy(&result.record);
+						
+						if (end) {
+							*end = saved;
+						}
 						
 						if (!rv) {
 							return AEROSPIKE_ERR_CLIENT_ABORT;
@@ -175,7 +255,7 @@ as_batch_parse_records(as_error* err, uint8_t* buf, size_t size, as_batch_task*
 					result->result = msg->result_code;
 					
 					if (msg->result_code == AEROSPIKE_OK) {
-						p = as_batch_parse_record(p, msg, &result->record, task->deserialize);
+						p = as_batch_parse_record(p, msg, &result->record, task->arena, task->deserialize, task->lazy, false);
 					}
 				}
 			}
@@ -190,17 +270,17 @@ as_batch_parse_records(as_error* err, uint8_t* buf, size_t size, as_batch_task*
 }
 
 static as_status
-as_batch_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
+as_batch_parse(as_error* err, as_connection* conn, uint64_t deadline_ms, void* udata)
 {
 	as_batch_task* task = udata;
 	as_status status = AEROSPIKE_OK;
-	uint8_t* buf = 0;
+	uint8_t* heap_buf = 0;
 	size_t capacity = 0;
 	
 	while (true) {
 		// Read header
 		as_proto proto;
-		status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
+		status = as_connection_read(err, conn, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
 		
 		if (status) {
 			break;
@@ -209,15 +289,25 @@ as_batch_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 		size_t size = proto.sz;
 		
 		if (size > 0) {
-			// Prepare buffer
-			if (size > capacity) {
-				as_command_free(buf, capacity);
-				capacity = size;
-				buf = as_command_init(capacity);
-			}
+			uint8_t* buf;
 			
-			// Read remaining message bytes in group
-			status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
+			if (size <= AS_CONNECTION_BUFFER_SIZE) {
+				// Parse group directly from connection buffer.
+				status = as_connection_read_ptr(err, conn, size, deadline_ms, &buf);
+			}
+			else {
+				// Prepare buffer
+				if (size > capacity) {
+					cf_free(heap_buf);
+					capacity = size;
+					// Extra byte lets borrowed parsing terminate the last string in place.
+					heap_buf = cf_malloc(capacity + 1);
+				}
+				buf = heap_buf;
+				
+				// Read remaining message bytes in group
+				status = as_connection_read(err, conn, buf, size, deadline_ms);
+			}
 			
 			if (status) {
 				break;
@@ -233,12 +323,12 @@ as_batch_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 			}
 		}
 	}
-	as_command_free(buf, capacity);
+	cf_free(heap_buf);
 	return status;
 }
 
-static as_status
-as_batch_index_records_execute(as_batch_task* task)
+static uint8_t*
+as_batch_index_records_command(as_batch_task* task, size_t* size_ptr)
 {
 	// Estimate buffer size.
 	size_t size = AS_HEADER_SIZE + AS_FIELD_HEADER_SIZE + sizeof(uint32_t) + 1;
@@ -331,28 +421,12 @@ as_batch_index_records_execute(as_batch_task* task)
 	size = p - field_size_ptr - 4;
 	*(uint32_t*)field_size_ptr = cf_swap_to_be32((uint32_t)size);
 
-	size = as_command_write_end(cmd, p);
-
-	as_command_node cn;
-	cn.node = task->node;
-
-	as_error err;
-	as_error_init(&err);
-	as_status status = as_command_execute(task->cluster, &err, &cn, cmd, size, task->timeout_ms, task->retry, as_batch_parse, task);
-	
-	as_command_free(cmd, size);
-	
-	if (status) {
-		// Copy error to main error only once.
-		if (ck_pr_fas_32(task->error_mutex, 1) == 0) {
-			as_error_copy(task->err, &err);
-		}
-	}
-	return status;
+	*size_ptr = as_command_write_end(cmd, p);
+	return cmd;
 }
 
-static as_status
-as_batch_index_execute(as_batch_task* task)
+static uint8_t*
+as_batch_index_command(as_batch_task* task, size_t* size_ptr)
 {
 	// Estimate full row size
 	// Add namespace(max size 31) field to header.
@@ -433,28 +507,12 @@ as_batch_index_execute(as_batch_task* task)
 	size = p - field_size_ptr - 4;
 	*(uint32_t*)field_size_ptr = cf_swap_to_be32((uint32_t)size);
 	
-	size = as_command_write_end(cmd, p);
-	
-	as_command_node cn;
-	cn.node = task->node;
-	
-	as_error err;
-	as_error_init(&err);
-	as_status status = as_command_execute(task->cluster, &err, &cn, cmd, size, task->timeout_ms, task->retry, as_batch_parse, task);
-	
-	as_command_free(cmd, size);
-	
-	if (status) {
-		// Copy error to main error only once.
-		if (ck_pr_fas_32(task->error_mutex, 1) == 0) {
-			as_error_copy(task->err, &err);
-		}
-	}
-	return status;
+	*size_ptr = as_command_write_end(cmd, p);
+	return cmd;
 }
 
-static as_status
-as_batch_direct_execute(as_batch_task* task)
+static uint8_t*
+as_batch_direct_command(as_batch_task* task, size_t* size_ptr)
 {
 	size_t size = AS_HEADER_SIZE;
 	size += as_command_string_field_size(task->ns);
@@ -487,60 +545,44 @@ as_batch_direct_execute(as_batch_task* task)
 		}
 	}
 	
-	size = as_command_write_end(cmd, p);
-	
-	as_command_node cn;
-	cn.node = task->node;
-	
-	as_error err;
-	as_error_init(&err);
-	as_status status = as_command_execute(task->cluster, &err, &cn, cmd, size, task->timeout_ms, task->retry, as_batch_parse, task);
-	
-	as_command_free(cmd, size);
-	
-	if (status) {
-		// Copy error to main error only once.
-		if (ck_pr_fas_32(task->error_mutex, 1) == 0) {
-			as_error_copy(task->err, &err);
-		}
-	}
-	return status;
+	*size_ptr = as_command_write_end(cmd, p);
+	return cmd;
 }
 
-static inline as_status
-as_batch_command_execute(as_batch_task* task)
+static inline uint8_t*
+as_batch_command_build(as_batch_task* task, size_t* size_ptr)
 {
-	as_status status;
-	
 	if (task->use_new_batch) {
 		// New batch protocol
 		if (task->use_batch_records) {
 			// Use as_batch_read_records referenced in aerospike_batch_read().
-			status = as_batch_index_records_execute(task);
+			return as_batch_index_records_command(task, size_ptr);
 		}
 		else {
 			// Use as_batch referenced in aerospike_batch_get(), aerospike_batch_get_bins()
 			// and aerospike_batch_exists().
-			status = as_batch_index_execute(task);
+			return as_batch_index_command(task, size_ptr);
 		}
 	}
 	else {
 		// Old batch protocol
-		status = as_batch_direct_execute(task);
+		return as_batch_direct_command(task, size_ptr);
 	}
-	return status;
 }
 
-static void
-as_batch_worker(void* data)
+static as_status
+as_batch_command_execute(as_batch_task* task, as_error* err)
 {
-	as_batch_task* task = (as_batch_task*)data;
+	size_t size;
+	uint8_t* cmd = as_batch_command_build(task, &size);
 	
-	as_batch_complete_task complete_task;
-	complete_task.node = task->node;
-	complete_task.result = as_batch_command_execute(task);
+	as_command_node cn;
+	cn.node = task->node;
+	
+	as_status status = as_command_execute(task->cluster, err, &cn, cmd, size, task->timeout_ms, task->retry, as_batch_parse, task);
 	
-	cf_queue_push(task->complete_q, &complete_task);
+	as_command_free(cmd, size);
+	return status;
 }
 
 static as_batch_node*
@@ -569,11 +611,538 @@ as_batch_release_nodes(as_batch_node* batch_nodes, uint32_t n_batch_nodes)
 	}
 }
 
+static inline uint32_t
+as_batch_node_requests(as_batch_node* batch_node, uint32_t max_keys)
+{
+	uint32_t n_keys = batch_node->offsets.size;
+	return (max_keys && n_keys > max_keys)? (n_keys + max_keys - 1) / max_keys : 1;
+}
+
+/**
+ *	Point task at a range of the node's key offsets.  The range is not owned by the task.
+ */
+static inline void
+as_batch_task_set_offsets(as_batch_task* task, as_vector* offsets, uint32_t begin, uint32_t size)
+{
+	task->offsets.list = as_vector_get(offsets, begin);
+	task->offsets.capacity = size;
+	task->offsets.size = size;
+	task->offsets.item_size = offsets->item_size;
+	task->offsets.flags = 0;
+}
+
+/**
+ *	Can keys of a failed node command be sent again, possibly to another node.
+ */
+static inline bool
+as_batch_retryable(as_status status)
+{
+	switch (status) {
+		case AEROSPIKE_ERR_CLIENT:
+		case AEROSPIKE_ERR_TIMEOUT:
+		case AEROSPIKE_ERR_NODE_UNAVAILABLE:
+		case AEROSPIKE_ERR_CLUSTER_CHANGE:
+		case AEROSPIKE_ERR_BATCH_QUEUES_FULL:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ *	Timeout of the next node command.  Return false when the total timeout has expired.
+ */
+static inline bool
+as_batch_attempt_timeout(const as_policy_batch* policy, uint64_t deadline_ms, uint32_t* timeout_ms)
+{
+	uint32_t timeout = policy->socket_timeout;
+	
+	if (deadline_ms > 0) {
+		int64_t remaining = (int64_t)(deadline_ms - cf_getms());
+		
+		if (remaining <= 0) {
+			return false;
+		}
+		
+		if (timeout == 0 || timeout > remaining) {
+			timeout = (uint32_t)remaining;
+		}
+	}
+	*timeout_ms = timeout;
+	return true;
+}
+
+/**
+ *	Run batch requests for each node once.  When max_keys_per_request is set, a node's keys
+ *	are split into sub-batches that are sent on separate connections.  Parallel requests
+ *	are multiplexed in the calling thread.  Results are stored by key offset, so
+ *	sub-batches complete in any order.
+ *
+ *	Nodes that fail with an error that can be retried are marked, and the other nodes
+ *	still run.  The first error is returned.  retryable is set to false if any node
+ *	failed with an error that cannot be retried.
+ */
+static as_status
+as_batch_execute_attempt(
+	as_batch_task* task, const as_policy_batch* policy, as_batch_node* batch_nodes, uint32_t n_batch_nodes,
+	uint64_t deadline_ms, bool* retryable
+	)
+{
+	uint32_t max_keys = policy->max_keys_per_request;
+	uint32_t n_requests = 0;
+	
+	for (uint32_t i = 0; i < n_batch_nodes; i++) {
+		n_requests += as_batch_node_requests(&batch_nodes[i], max_keys);
+	}
+	
+	as_status status = AEROSPIKE_OK;
+	*retryable = true;
+	
+	if (n_requests > 1 && (policy->concurrent || n_requests > n_batch_nodes)) {
+		if (! as_batch_attempt_timeout(policy, deadline_ms, &task->timeout_ms)) {
+			return as_error_update(task->err, AEROSPIKE_ERR_TIMEOUT, "Batch timeout: timeout=%u", policy->timeout);
+		}
+		
+		// Send all requests, then parse responses as they arrive.  Tasks and commands
+		// only need to be valid within this function.  Sub-batches can create many
+		// tasks, so allocate them on heap.
+		as_batch_task* tasks = cf_malloc(sizeof(as_batch_task) * n_requests);
+		as_command_fanout* commands = cf_malloc(sizeof(as_command_fanout) * n_requests);
+		uint32_t n = 0;
+		
+		for (uint32_t i = 0; i < n_batch_nodes; i++) {
+			as_batch_node* batch_node = &batch_nodes[i];
+			uint32_t n_keys = batch_node->offsets.size;
+			uint32_t size = (max_keys && n_keys > max_keys)? max_keys : n_keys;
+			
+			for (uint32_t begin = 0; begin < n_keys; begin += size) {
+				as_batch_task* task_node = &tasks[n];
+				memcpy(task_node, task, sizeof(as_batch_task));
+				task_node->use_new_batch = as_batch_use_new(policy, batch_node->node);
+				task_node->node = batch_node->node;
+				task_node->index = 0;
+				as_batch_task_set_offsets(task_node, &batch_node->offsets, begin,
+					(n_keys - begin < size)? n_keys - begin : size);
+				
+				as_command_fanout* command = &commands[n];
+				command->node = batch_node->node;
+				command->command = as_batch_command_build(task_node, &command->command_len);
+				command->parse_data = task_node;
+				n++;
+			}
+		}
+		
+		// Other nodes keep running when a node fails, so only its keys need to be retried.
+		status = as_command_execute_fanout(task->cluster, task->err, commands, n, task->timeout_ms,
+			as_batch_parse_records, false);
+		
+		// Commands were built in node order.
+		n = 0;
+		
+		for (uint32_t i = 0; i < n_batch_nodes; i++) {
+			as_batch_node* batch_node = &batch_nodes[i];
+			uint32_t n_node_requests = as_batch_node_requests(batch_node, max_keys);
+			
+			for (uint32_t j = 0; j < n_node_requests; j++) {
+				as_status rc = commands[n].status;
+				
+				if (rc) {
+					if (as_batch_retryable(rc)) {
+						batch_node->failed = true;
+					}
+					else {
+						*retryable = false;
+					}
+				}
+				as_command_free(commands[n].command, commands[n].command_len);
+				n++;
+			}
+		}
+		cf_free(commands);
+		cf_free(tasks);
+	}
+	else {
+		// Run batch requests sequentially in same thread.
+		as_error node_err;
+		
+		for (uint32_t i = 0; i < n_batch_nodes; i++) {
+			as_batch_node* batch_node = &batch_nodes[i];
+			as_status rc;
+			
+			as_error_init(&node_err);
+			
+			if (as_batch_attempt_timeout(policy, deadline_ms, &task->timeout_ms)) {
+				task->use_new_batch = as_batch_use_new(policy, batch_node->node);
+				task->node = batch_node->node;
+				task->index = 0;
+				as_batch_task_set_offsets(task, &batch_node->offsets, 0, batch_node->offsets.size);
+				rc = as_batch_command_execute(task, &node_err);
+			}
+			else {
+				rc = as_error_update(&node_err, AEROSPIKE_ERR_TIMEOUT, "Batch timeout: timeout=%u", policy->timeout);
+			}
+			
+			if (rc) {
+				if (status == AEROSPIKE_OK) {
+					status = rc;
+					as_error_copy(task->err, &node_err);
+				}
+				
+				if (! as_batch_retryable(rc)) {
+					*retryable = false;
+					break;
+				}
+				batch_node->failed = true;
+			}
+		}
+	}
+	return status;
+}
+
+static inline as_key*
+as_batch_task_key(as_batch_task* task, uint32_t offset)
+{
+	if (task->use_batch_records) {
+		as_batch_read_record* record = as_vector_get(task->records, offset);
+		return &record->key;
+	}
+	return &task->keys[offset];
+}
+
+/**
+ *	Map key through current partition map for a retry.  Use the other replica when the
+ *	map still points to the node that failed.
+ */
+static as_node*
+as_batch_retry_node(as_cluster* cluster, as_key* key, as_node* failed)
+{
+	as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+	as_node* node = as_node_select(cluster, key->ns, key->handle, key->digest.value, false, AS_POLICY_REPLICA_MASTER);
+	
+	if (node && node == failed) {
+		as_node* alt = as_node_select_alternate(cluster, key->ns, key->handle, key->digest.value, node);
+		
+		if (alt) {
+			node = alt;
+		}
+	}
+	
+	if (node) {
+		as_node_reserve(node);
+	}
+	as_epoch_exit(slot);
+	return node;
+}
+
+/**
+ *	Map keys that have not returned to nodes for a retry.  Return number of retry nodes.
+ *	Keys that cannot be mapped are left to fail.
+ */
+static uint32_t
+as_batch_retry_nodes(as_batch_task* task, as_batch_node* batch_nodes, uint32_t n_batch_nodes, as_batch_node** retry_nodes_ptr)
+{
+	uint32_t n_retry_keys = 0;
+	
+	for (uint32_t i = 0; i < n_batch_nodes; i++) {
+		as_vector* offsets = &batch_nodes[i].offsets;
+		
+		for (uint32_t j = 0; j < offsets->size; j++) {
+			if (! task->done[*(uint32_t*)as_vector_get(offsets, j)]) {
+				n_retry_keys++;
+			}
+		}
+	}
+	
+	if (n_retry_keys == 0) {
+		*retry_nodes_ptr = 0;
+		return 0;
+	}
+	
+	// Retry keys are spread over at most one node per key.
+	as_batch_node* retry_nodes = cf_malloc(sizeof(as_batch_node) * n_retry_keys);
+	uint32_t n_retry_nodes = 0;
+	
+	for (uint32_t i = 0; i < n_batch_nodes; i++) {
+		as_batch_node* batch_node = &batch_nodes[i];
+		as_node* failed = batch_node->failed ? batch_node->node : 0;
+		as_vector* offsets = &batch_node->offsets;
+		
+		for (uint32_t j = 0; j < offsets->size; j++) {
+			uint32_t offset = *(uint32_t*)as_vector_get(offsets, j);
+			
+			if (task->done[offset]) {
+				continue;
+			}
+			
+			as_node* node = as_batch_retry_node(task->cluster, as_batch_task_key(task, offset), failed);
+			
+			if (! node) {
+				continue;
+			}
+			
+			as_batch_node* retry_node = as_batch_node_find(retry_nodes, n_retry_nodes, node);
+			
+			if (retry_node) {
+				// Release duplicate node
+				as_node_release(node);
+			}
+			else {
+				// Add retry node.
+				retry_node = &retry_nodes[n_retry_nodes++];
+				retry_node->node = node;  // Transfer node
+				retry_node->failed = false;
+				as_vector_init(&retry_node->offsets, sizeof(uint32_t), 16);
+			}
+			as_vector_append(&retry_node->offsets, &offset);
+		}
+	}
+	*retry_nodes_ptr = retry_nodes;
+	return n_retry_nodes;
+}
+
+/**
+ *	Set result of keys that did not return, so per key results match the error.
+ */
+static void
+as_batch_set_failed(as_batch_task* task, as_status status)
+{
+	for (uint32_t i = 0; i < task->n_keys; i++) {
+		if (task->done[i] || (task->dup_first && task->dup_first[i] != i)) {
+			// Duplicates receive the result of the key that was sent.
+			continue;
+		}
+		
+		if (task->use_batch_records) {
+			as_batch_read_record* record = as_vector_get(task->records, i);
+			record->result = status;
+		}
+		else if (task->results) {
+			task->results[i].result = status;
+		}
+		else if (task->callback_foreach && status != AEROSPIKE_ERR_CLIENT_ABORT) {
+			as_batch_read result;
+			result.result = status;
+			as_record_init(&result.record, 0);
+			
+			bool rv = as_batch_stream_result(task, i, &result);
+			as_record_destroy(&result.record);
+			
+			if (! rv) {
+				break;
+			}
+		}
+	}
+}
+
+/**
+ *	Give each duplicate key in a result array the result of the key that was sent.
+ *	Records share bin values stored in the task arena.
+ */
+static void
+as_batch_copy_duplicates(as_batch_task* task)
+{
+	for (uint32_t i = 0; i < task->n_keys; i++) {
+		uint32_t first = task->dup_first[i];
+		
+		if (first == i) {
+			continue;
+		}
+		
+		if (task->use_batch_records) {
+			as_batch_read_record* src = as_vector_get(task->records, first);
+			as_batch_read_record* dst = as_vector_get(task->records, i);
+			dst->result = src->result;
+			
+			if (src->result == AEROSPIKE_OK) {
+				as_record_init_shared(&dst->record, &src->record);
+			}
+		}
+		else {
+			as_batch_read* src = &task->results[first];
+			as_batch_read* dst = &task->results[i];
+			dst->result = src->result;
+			
+			if (src->result == AEROSPIKE_OK) {
+				as_record_init_shared(&dst->record, &src->record);
+			}
+		}
+	}
+}
+
+/**
+ *	Run batch requests for each node.  Keys of nodes that fail with an error that can be
+ *	retried are re-routed and sent again within the total timeout.  Keys that already
+ *	returned keep their results and are not sent again.
+ */
+static as_status
+as_batch_execute_nodes(as_batch_task* task, const as_policy_batch* policy, as_batch_node* batch_nodes, uint32_t n_batch_nodes)
+{
+	uint64_t deadline_ms = as_socket_deadline(policy->timeout);
+	as_batch_node* nodes = batch_nodes;
+	uint32_t n_nodes = n_batch_nodes;
+	as_status status;
+	bool retryable;
+	
+	task->done = cf_malloc(task->n_keys);
+	memset(task->done, 0, task->n_keys);
+	
+	for (uint32_t iteration = 0; ; iteration++) {
+		status = as_batch_execute_attempt(task, policy, nodes, n_nodes, deadline_ms, &retryable);
+		
+		if (status == AEROSPIKE_OK || ! retryable || iteration >= policy->retry ||
+			(deadline_ms > 0 && cf_getms() >= deadline_ms)) {
+			break;
+		}
+		
+		as_batch_node* retry_nodes;
+		uint32_t n_retry_nodes = as_batch_retry_nodes(task, nodes, n_nodes, &retry_nodes);
+		
+		if (nodes != batch_nodes) {
+			as_batch_release_nodes(nodes, n_nodes);
+			cf_free(nodes);
+		}
+		nodes = retry_nodes;
+		n_nodes = n_retry_nodes;
+		
+		if (! retry_nodes) {
+			// Every key returned before its node failed.
+			status = AEROSPIKE_OK;
+			as_error_reset(task->err);
+			nodes = batch_nodes;
+			break;
+		}
+		
+		if (n_nodes == 0) {
+			// No node found for keys that did not return.
+			break;
+		}
+		
+		// Error from the previous attempt no longer applies.
+		as_error_reset(task->err);
+	}
+	
+	if (nodes != batch_nodes) {
+		as_batch_release_nodes(nodes, n_nodes);
+		cf_free(nodes);
+	}
+	
+	if (status != AEROSPIKE_OK) {
+		as_batch_set_failed(task, status);
+	}
+	
+	if (task->dup_first && (task->use_batch_records || task->results)) {
+		as_batch_copy_duplicates(task);
+	}
+	cf_free(task->done);
+	task->done = 0;
+	return status;
+}
+
+/**
+ *	Allocate digest table when duplicate keys should only be sent once.
+ */
+static void
+as_batch_dedup_init(as_batch_dedup* dedup, const as_policy_batch* policy, uint32_t n_keys)
+{
+	if (! policy->deduplicate || n_keys < 2) {
+		memset(dedup, 0, sizeof(as_batch_dedup));
+		return;
+	}
+	
+	// Keep table at most half full.
+	uint32_t capacity = 4;
+	
+	while (capacity < n_keys * 2) {
+		capacity <<= 1;
+	}
+	
+	// Table and duplicate links share one allocation.
+	dedup->slots = cf_malloc(sizeof(uint32_t) * (capacity + n_keys * 2));
+	memset(dedup->slots, 0, sizeof(uint32_t) * capacity);
+	dedup->next = dedup->slots + capacity;
+	dedup->first = dedup->next + n_keys;
+	dedup->mask = capacity - 1;
+}
+
+static inline bool
+as_batch_same_key(const as_key* a, const as_key* b)
+{
+	return memcmp(a->digest.value, b->digest.value, AS_DIGEST_VALUE_SIZE) == 0 && strcmp(a->ns, b->ns) == 0;
+}
+
+static bool
+as_batch_same_read(const as_batch_read_record* a, const as_batch_read_record* b)
+{
+	if (! as_batch_same_key(&a->key, &b->key) || a->read_all_bins != b->read_all_bins) {
+		return false;
+	}
+	
+	if (a->read_all_bins) {
+		return true;
+	}
+	
+	if (a->n_bin_names != b->n_bin_names) {
+		return false;
+	}
+	
+	for (uint32_t i = 0; i < a->n_bin_names; i++) {
+		if (strcmp(a->bin_names[i], b->bin_names[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ *	Return true if an earlier key is the same as the key at offset.  The key is then
+ *	linked to that key and must not be sent.  Otherwise, add key to the table.
+ *	Pass keys for aerospike_batch_get() or records for aerospike_batch_read().
+ */
+static bool
+as_batch_dedup_find(as_batch_dedup* dedup, as_key* keys, as_vector* records, uint32_t offset)
+{
+	as_batch_read_record* record = 0;
+	as_key* key;
+	
+	if (records) {
+		record = as_vector_get(records, offset);
+		key = &record->key;
+	}
+	else {
+		key = &keys[offset];
+	}
+	
+	uint32_t hash;
+	memcpy(&hash, key->digest.value, sizeof(uint32_t));
+	
+	uint32_t index = hash & dedup->mask;
+	uint32_t slot;
+	
+	while ((slot = dedup->slots[index]) != 0) {
+		uint32_t first = slot - 1;
+		bool same = (records)? as_batch_same_read(as_vector_get(records, first), record) :
+			as_batch_same_key(&keys[first], key);
+		
+		if (same) {
+			dedup->first[offset] = first;
+			dedup->next[offset] = dedup->next[first];
+			dedup->next[first] = offset;
+			return true;
+		}
+		index = (index + 1) & dedup->mask;
+	}
+	dedup->slots[index] = offset + 1;
+	dedup->first[offset] = offset;
+	dedup->next[offset] = AS_BATCH_NO_DUP;
+	return false;
+}
+
 static as_status
 as_batch_execute(
 	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
 	int read_attr, const char** bins, uint32_t n_bins,
-	aerospike_batch_read_callback callback, as_batch_callback_xdr callback_xdr, void* udata
+	aerospike_batch_read_callback callback, aerospike_batch_foreach_callback callback_foreach,
+	as_batch_callback_xdr callback_xdr, void* udata
 	)
 {
 	as_error_reset(err);
@@ -585,7 +1154,9 @@ as_batch_execute(
 	uint32_t n_keys = batch->keys.size;
 	
 	if (n_keys <= 0) {
-		callback(0, 0, udata);
+		if (callback) {
+			callback(0, 0, udata);
+		}
 		return AEROSPIKE_OK;
 	}
 	
@@ -598,8 +1169,9 @@ as_batch_execute(
 		return as_error_set_message(err, AEROSPIKE_ERR_SERVER, "Batch command failed because cluster is empty.");
 	}
 	
-	// Allocate results array on stack.  May be an issue for huge batch.
-	as_batch_read* results = (callback)? (as_batch_read*)alloca(sizeof(as_batch_read) * n_keys) : 0;
+	// Results are only collected when all results are passed to the callback at once.
+	// Streaming callbacks receive each record as it is parsed.
+	as_batch_read* results = (callback)? (as_batch_read*)cf_malloc(sizeof(as_batch_read) * n_keys) : 0;
 	
 	as_batch_node* batch_nodes = alloca(sizeof(as_batch_node) * n_nodes);
 	char* ns = batch->keys.entries[0].ns;
@@ -615,6 +1187,9 @@ as_batch_execute(
 		offsets_capacity = 10;
 	}
 	
+	as_batch_dedup dedup;
+	as_batch_dedup_init(&dedup, policy, n_keys);
+	
 	// Map keys to server nodes.
 	for (uint32_t i = 0; i < n_keys; i++) {
 		as_key* key = &batch->keys.entries[i];
@@ -631,14 +1206,23 @@ as_batch_execute(
 		if (status != AEROSPIKE_OK) {
 			as_batch_release_nodes(batch_nodes, n_batch_nodes);
 			as_nodes_release(nodes);
+			cf_free(dedup.slots);
+			cf_free(results);
 			return status;
 		}
 		
-		as_node* node = as_node_get(cluster, key->ns, key->digest.value, false, AS_POLICY_REPLICA_MASTER);
+		if (dedup.slots && as_batch_dedup_find(&dedup, batch->keys.entries, 0, i)) {
+			// Result is copied from the earlier key.
+			continue;
+		}
+		
+		as_node* node = as_node_get(cluster, key->ns, key->handle, key->digest.value, false, AS_POLICY_REPLICA_MASTER);
 		
 		if (! node) {
 			as_batch_release_nodes(batch_nodes, n_batch_nodes);
 			as_nodes_release(nodes);
+			cf_free(dedup.slots);
+			cf_free(results);
 			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to find batch node for key.");
 		}
 		
@@ -647,6 +1231,8 @@ as_batch_execute(
 			if (strcmp(ns, key->ns)) {
 				as_batch_release_nodes(batch_nodes, n_batch_nodes);
 				as_nodes_release(nodes);
+				cf_free(dedup.slots);
+				cf_free(results);
 				return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Batch keys must all be in the same namespace.");
 			}
 		}
@@ -661,14 +1247,21 @@ as_batch_execute(
 			// Add batch node.
 			batch_node = &batch_nodes[n_batch_nodes++];
 			batch_node->node = node;  // Transfer node
-			as_vector_inita(&batch_node->offsets, sizeof(uint32_t), offsets_capacity);
+			batch_node->failed = false;
+			
+			if (n_keys <= 5000) {
+				// All keys and offsets should fit on stack.
+				as_vector_inita(&batch_node->offsets, sizeof(uint32_t), offsets_capacity);
+			}
+			else {
+				// Allocate vector on heap to avoid stack overflow.
+				as_vector_init(&batch_node->offsets, sizeof(uint32_t), offsets_capacity);
+			}
 		}
 		as_vector_append(&batch_node->offsets, &i);
 	}
 	as_nodes_release(nodes);
 	
-	uint32_t error_mutex = 0;
-	
 	// Initialize task.
 	as_batch_task task;
 	memset(&task, 0, sizeof(as_batch_task));
@@ -676,81 +1269,34 @@ as_batch_execute(
 	task.ns = ns;
 	task.err = err;
 	task.results = results;
-	task.error_mutex = &error_mutex;
 	task.n_keys = n_keys;
 	task.bins = bins;
 	task.n_bins = n_bins;
 	task.keys = batch->keys.entries;
 	task.timeout_ms = policy->timeout;
 	task.index = 0;
-	task.retry = 0;
+	task.retry = 0;  // Failed node keys are re-routed in as_batch_execute_nodes().
 	task.read_attr = read_attr;
 	task.use_batch_records = false;
 	task.allow_inline = policy->allow_inline;
 	task.deserialize = policy->deserialize;
+	task.lazy = policy->lazy_deserialize;
+	task.borrow = policy->borrow_bins;
 	task.udata = udata;
+	task.callback_foreach = callback_foreach;
 	task.callback_xdr = callback_xdr;
+	task.dup_next = dedup.next;
+	task.dup_first = dedup.first;
+	
+	// Result records share one arena.  Records passed to streaming callbacks are
+	// destroyed immediately, so they are allocated individually.
+	task.arena = (callback)? as_arena_create(AS_ARENA_BLOCK_SIZE) : 0;
 
-	if (policy->concurrent && n_batch_nodes > 1) {
-		// Run batch requests in parallel in separate threads.
-		task.complete_q = cf_queue_create(sizeof(as_batch_complete_task), true);
-		
-		uint32_t n_wait_nodes = n_batch_nodes;
-		
-		// Run task for each node.
-		for (uint32_t i = 0; i < n_batch_nodes; i++) {
-			// Stack allocate task for each node.  It should be fine since the task
-			// only needs to be valid within this function.
-			as_batch_task* task_node = alloca(sizeof(as_batch_task));
-			memcpy(task_node, &task, sizeof(as_batch_task));
-			
-			as_batch_node* batch_node = &batch_nodes[i];
-			task_node->use_new_batch = as_batch_use_new(policy, batch_node->node);
-			task_node->node = batch_node->node;
-			memcpy(&task_node->offsets, &batch_node->offsets, sizeof(as_vector));
-			
-			int rc = as_thread_pool_queue_task(&cluster->thread_pool, as_batch_worker, task_node);
-			
-			if (rc) {
-				// Thread could not be added. Abort entire batch.
-				if (ck_pr_fas_32(task.error_mutex, 1) == 0) {
-					status = as_error_update(task.err, AEROSPIKE_ERR_CLIENT, "Failed to add batch thread: %d", rc);
-				}
-				
-				// Reset node count to threads that were run.
-				n_wait_nodes = i;
-				break;
-			}
-		}
-		
-		// Wait for tasks to complete.
-		for (uint32_t i = 0; i < n_wait_nodes; i++) {
-			as_batch_complete_task complete;
-			cf_queue_pop(task.complete_q, &complete, CF_QUEUE_FOREVER);
-			
-			if (complete.result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
-				status = complete.result;
-			}
-		}
-		
-		// Release temporary queue.
-		cf_queue_destroy(task.complete_q);
-	}
-	else {
-		// Run batch requests sequentially in same thread.
-		for (uint32_t i = 0; status == AEROSPIKE_OK && i < n_batch_nodes; i++) {
-			as_batch_node* batch_node = &batch_nodes[i];
-			
-			task.use_new_batch = as_batch_use_new(policy, batch_node->node);
-			task.node = batch_node->node;
-			task.index = 0;
-			memcpy(&task.offsets, &batch_node->offsets, sizeof(as_vector));
-			status = as_batch_command_execute(&task);
-		}
-	}
+	status = as_batch_execute_nodes(&task, policy, batch_nodes, n_batch_nodes);
 			
 	// Release each node.
 	as_batch_release_nodes(batch_nodes, n_batch_nodes);
+	cf_free(dedup.slots);
 
 	// Call user defined function with results.
 	if (callback) {
@@ -762,6 +1308,11 @@ as_batch_execute(
 				as_record_destroy(&task.results[i].record);
 			}
 		}
+		cf_free(task.results);
+	}
+	
+	if (task.arena) {
+		as_arena_release(task.arena);
 	}
 	return status;
 }
@@ -836,6 +1387,9 @@ aerospike_batch_read(
 		offsets_capacity = 10;
 	}
 	
+	as_batch_dedup dedup;
+	as_batch_dedup_init(&dedup, policy, n_keys);
+	
 	// Map keys to server nodes.
 	for (uint32_t i = 0; i < n_keys; i++) {
 		as_batch_read_record* record = as_vector_get(list, i);
@@ -849,20 +1403,28 @@ aerospike_batch_read(
 		if (status != AEROSPIKE_OK) {
 			as_batch_release_nodes(batch_nodes, n_batch_nodes);
 			as_nodes_release(nodes);
+			cf_free(dedup.slots);
 			return status;
 		}
 		
-		as_node* node = as_node_get(cluster, key->ns, key->digest.value, false, AS_POLICY_REPLICA_MASTER);
+		if (dedup.slots && as_batch_dedup_find(&dedup, 0, list, i)) {
+			// Record is copied from the earlier key.
+			continue;
+		}
+		
+		as_node* node = as_node_get(cluster, key->ns, key->handle, key->digest.value, false, AS_POLICY_REPLICA_MASTER);
 		
 		if (! node) {
 			as_batch_release_nodes(batch_nodes, n_batch_nodes);
 			as_nodes_release(nodes);
+			cf_free(dedup.slots);
 			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to find batch node for key.");
 		}
 		
 		if (! as_batch_use_new(policy, node)) {
 			as_batch_release_nodes(batch_nodes, n_batch_nodes);
 			as_nodes_release(nodes);
+			cf_free(dedup.slots);
 			return as_error_set_message(err, AEROSPIKE_ERR_UNSUPPORTED_FEATURE, "aerospike_batch_read() requires a server that supports new batch index protocol.");
 		}
 		
@@ -876,6 +1438,7 @@ aerospike_batch_read(
 			// Add batch node.
 			batch_node = &batch_nodes[n_batch_nodes++];
 			batch_node->node = node;  // Transfer node
+			batch_node->failed = false;
 			
 			if (n_keys <= 5000) {
 				// All keys and offsets should fit on stack.
@@ -890,81 +1453,35 @@ aerospike_batch_read(
 	}
 	as_nodes_release(nodes);
 	
-	uint32_t error_mutex = 0;
-	
 	// Initialize task.
 	as_batch_task task;
 	memset(&task, 0, sizeof(as_batch_task));
 	task.cluster = cluster;
 	task.err = err;
 	task.records = list;
-	task.error_mutex = &error_mutex;
 	task.n_keys = n_keys;
 	task.timeout_ms = policy->timeout;
-	task.retry = 0;
+	task.retry = 0;  // Failed node keys are re-routed in as_batch_execute_nodes().
 	task.use_batch_records = true;
 	task.allow_inline = policy->allow_inline;
 	task.deserialize = policy->deserialize;
+	task.lazy = policy->lazy_deserialize;
+	task.borrow = false;
+	task.dup_next = dedup.next;
+	task.dup_first = dedup.first;
 	
-	if (policy->concurrent && n_batch_nodes > 1) {
-		// Run batch requests in parallel in separate threads.
-		task.complete_q = cf_queue_create(sizeof(as_batch_complete_task), true);
-		
-		uint32_t n_wait_nodes = n_batch_nodes;
-		
-		// Run task for each node.
-		for (uint32_t i = 0; i < n_batch_nodes; i++) {
-			// Stack allocate task for each node.  It should be fine since the task
-			// only needs to be valid within this function.
-			as_batch_task* task_node = alloca(sizeof(as_batch_task));
-			memcpy(task_node, &task, sizeof(as_batch_task));
-			
-			as_batch_node* batch_node = &batch_nodes[i];
-			task_node->use_new_batch = true;
-			task_node->node = batch_node->node;
-			memcpy(&task_node->offsets, &batch_node->offsets, sizeof(as_vector));
-			
-			int rc = as_thread_pool_queue_task(&cluster->thread_pool, as_batch_worker, task_node);
-			
-			if (rc) {
-				// Thread could not be added. Abort entire batch.
-				if (ck_pr_fas_32(task.error_mutex, 1) == 0) {
-					status = as_error_update(task.err, AEROSPIKE_ERR_CLIENT, "Failed to add batch thread: %d", rc);
-				}
-				
-				// Reset node count to threads that were run.
-				n_wait_nodes = i;
-				break;
-			}
-		}
-		
-		// Wait for tasks to complete.
-		for (uint32_t i = 0; i < n_wait_nodes; i++) {
-			as_batch_complete_task complete;
-			cf_queue_pop(task.complete_q, &complete, CF_QUEUE_FOREVER);
-			
-			if (complete.result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
-				status = complete.result;
-			}
-		}
-		
-		// Release temporary queue.
-		cf_queue_destroy(task.complete_q);
-	}
-	else {
-		// Run batch requests sequentially in same thread.
-		for (uint32_t i = 0; status == AEROSPIKE_OK && i < n_batch_nodes; i++) {
-			as_batch_node* batch_node = &batch_nodes[i];
-			
-			task.use_new_batch = true;
-			task.node = batch_node->node;
-			memcpy(&task.offsets, &batch_node->offsets, sizeof(as_vector));
-			status = as_batch_command_execute(&task);
-		}
-	}
+	// Records share one arena, which is freed when the last record is destroyed.
+	task.arena = as_arena_create(AS_ARENA_BLOCK_SIZE);
+	
+	status = as_batch_execute_nodes(&task, policy, batch_nodes, n_batch_nodes);
 	
 	// Release each node.
 	as_batch_release_nodes(batch_nodes, n_batch_nodes);
+	cf_free(dedup.slots);
+	
+	if (task.arena) {
+		as_arena_release(task.arena);
+	}
 	return status;
 }
 
@@ -1000,7 +1517,7 @@ aerospike_batch_get(
 	aerospike_batch_read_callback callback, void* udata
 	)
 {
-	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL, 0, 0, callback, 0, udata);
+	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL, 0, 0, callback, 0, 0, udata);
 }
 
 /**
@@ -1014,7 +1531,7 @@ aerospike_batch_get_xdr(
 	as_batch_callback_xdr callback, void* udata
 	)
 {
-	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL, 0, 0, 0, callback, udata);
+	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL, 0, 0, 0, 0, callback, udata);
 }
 
 /**
@@ -1026,7 +1543,7 @@ aerospike_batch_get_bins(
 	const char** bins, uint32_t n_bins, aerospike_batch_read_callback callback, void* udata
 	)
 {
-	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ, bins, n_bins, callback, 0, udata);
+	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ, bins, n_bins, callback, 0, 0, udata);
 }
 
 /**
@@ -1038,5 +1555,44 @@ aerospike_batch_exists(
 	aerospike_batch_read_callback callback, void* udata
 	)
 {
-	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_NOBINDATA, 0, 0, callback, 0, udata);
+	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_NOBINDATA, 0, 0, callback, 0, 0, udata);
+}
+
+/**
+ *	Look up multiple records by key, then return all bins.  The callback is called for
+ *	each record as soon as it's parsed.
+ */
+as_status
+aerospike_batch_get_foreach(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	aerospike_batch_foreach_callback callback, void* udata
+	)
+{
+	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL, 0, 0, 0, callback, 0, udata);
+}
+
+/**
+ *	Look up multiple records by key, then return specified bins.  The callback is called
+ *	for each record as soon as it's parsed.
+ */
+as_status
+aerospike_batch_get_bins_foreach(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	const char** bins, uint32_t n_bins, aerospike_batch_foreach_callback callback, void* udata
+	)
+{
+	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ, bins, n_bins, 0, callback, 0, udata);
+}
+
+/**
+ *	Test whether multiple records exist in the cluster.  The callback is called for each
+ *	key as soon as its result is parsed.
+ */
+as_status
+aerospike_batch_exists_foreach(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	aerospike_batch_foreach_callback callback, void* udata
+	)
+{
+	return as_batch_execute(as, err, policy, batch, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_NOBINDATA, 0, 0, 0, callback, 0, udata);
 }
@@ -20,6 +20,7 @@
 #include <aerospike/as_buffer.h>
 #include <aerospike/as_command.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_event.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_list.h>
 #include <aerospike/as_log.h>
@@ -36,13 +37,15 @@
  *****************************************************************************/
 
 static inline void
-as_command_node_init(as_command_node* cn, const char* ns,
-	const uint8_t* digest, as_policy_replica replica, bool write)
+as_command_node_init(as_command_node* cn, const as_key* key, as_policy_replica replica, bool write)
 {
 	cn->node = 0;
-	cn->ns = ns;
-	cn->digest = digest;
+	cn->ns = key->ns;
+	cn->handle = key->handle;
+	cn->digest = key->digest.value;
 	cn->replica = replica;
+	cn->hedge_delay_ms = 0;
+	cn->hedge_percentile = 0;
 	cn->write = write;
 }
 
@@ -82,11 +85,14 @@ as_status aerospike_key_get(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, key->ns, key->digest.value, policy->replica, false);
+	as_command_node_init(&cn, key, policy->replica, false);
+	cn.hedge_delay_ms = policy->hedge_delay_ms;
+	cn.hedge_percentile = policy->hedge_percentile;
 	
 	as_command_parse_result_data data;
 	data.record = rec;
 	data.deserialize = policy->deserialize;
+	data.lazy = policy->lazy_deserialize;
 	
 	status = as_command_execute(as->cluster, err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_result, &data);
 	
@@ -144,11 +150,14 @@ as_status aerospike_key_select(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, key->ns, key->digest.value, policy->replica, false);
+	as_command_node_init(&cn, key, policy->replica, false);
+	cn.hedge_delay_ms = policy->hedge_delay_ms;
+	cn.hedge_percentile = policy->hedge_percentile;
 	
 	as_command_parse_result_data data;
 	data.record = rec;
 	data.deserialize = policy->deserialize;
+	data.lazy = policy->lazy_deserialize;
 
 	status = as_command_execute(as->cluster, err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_result, &data);
 	
@@ -192,7 +201,9 @@ as_status aerospike_key_exists(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, key->ns, key->digest.value, policy->replica, false);
+	as_command_node_init(&cn, key, policy->replica, false);
+	cn.hedge_delay_ms = policy->hedge_delay_ms;
+	cn.hedge_percentile = policy->hedge_percentile;
 	
 	as_proto_msg msg;
 	status = as_command_execute(as->cluster, err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
@@ -253,26 +264,31 @@ as_status aerospike_key_put(
 	as_buffer* buffers = (as_buffer*)alloca(sizeof(as_buffer) * n_bins);
 	memset(buffers, 0, sizeof(as_buffer) * n_bins);
 
+	// Large values are sent from the record's own memory, so they are not counted.
+	as_command_iov ci;
+	as_command_iov_init(&ci);
+
 	for (uint32_t i = 0; i < n_bins; i++) {
-		size += as_command_bin_size(&bins[i], &buffers[i]);
+		size += as_command_bin_size_iov(&ci, &bins[i], &buffers[i]);
 	}
 	
 	uint8_t* cmd = as_command_init(size);
 	uint8_t* p = as_command_write_header(cmd, 0, AS_MSG_INFO2_WRITE, policy->commit_level, 0, policy->exists, policy->gen, rec->gen, rec->ttl, policy->timeout, n_fields, n_bins);
 		
 	p = as_command_write_key(p, policy->key, key);
+	as_command_iov_begin(&ci, cmd);
 
 	for (uint32_t i = 0; i < n_bins; i++) {
-		p = as_command_write_bin(p, AS_OPERATOR_WRITE, &bins[i], &buffers[i]);
+		p = as_command_write_bin_iov(&ci, p, AS_OPERATOR_WRITE, &bins[i], &buffers[i]);
 	}
 	
-	size = as_command_write_end(cmd, p);
+	as_command_iov_end(&ci, p);
 
 	as_command_node cn;
-	as_command_node_init(&cn, key->ns, key->digest.value, AS_POLICY_REPLICA_MASTER, true);
+	as_command_node_init(&cn, key, AS_POLICY_REPLICA_MASTER, true);
 	
 	as_proto_msg msg;
-	status = as_command_execute(as->cluster, err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
+	status = as_command_execute_iov(as->cluster, err, &cn, ci.iov, ci.iovcnt, policy->timeout, policy->retry, as_command_parse_header, &msg);
 	
 	for (uint32_t i = 0; i < n_bins; i++) {
 		as_buffer* buffer = &buffers[i];
@@ -328,7 +344,7 @@ as_status aerospike_key_remove(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, key->ns, key->digest.value, AS_POLICY_REPLICA_MASTER, true);
+	as_command_node_init(&cn, key, AS_POLICY_REPLICA_MASTER, true);
 	
 	as_proto_msg msg;
 	status = as_command_execute(as->cluster, err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
@@ -388,6 +404,8 @@ as_status aerospike_key_operate(
 	size_t size = as_command_key_size(policy->key, key, &n_fields);
 	uint8_t read_attr = 0;
 	uint8_t write_attr = 0;
+	as_command_iov ci;
+	as_command_iov_init(&ci);
 	
 	for (int i = 0; i < n_operations; i++) {
 		as_binop* op = &ops->binops.entries[i];
@@ -402,29 +420,31 @@ as_status aerospike_key_operate(
 				write_attr |= AS_MSG_INFO2_WRITE;
 				break;
 		}
-		size += as_command_bin_size(&op->bin, &buffers[i]);
+		size += as_command_bin_size_iov(&ci, &op->bin, &buffers[i]);
 	}
 
 	uint8_t* cmd = as_command_init(size);
 	uint8_t* p = as_command_write_header(cmd, read_attr, write_attr, policy->commit_level, policy->consistency_level,
 				 AS_POLICY_EXISTS_IGNORE, policy->gen, ops->gen, ops->ttl, policy->timeout, n_fields, n_operations);
 	p = as_command_write_key(p, policy->key, key);
+	as_command_iov_begin(&ci, cmd);
 	
 	for (uint32_t i = 0; i < n_operations; i++) {
 		as_binop* op = &ops->binops.entries[i];
-		p = as_command_write_bin(p, op->op, &op->bin, &buffers[i]);
+		p = as_command_write_bin_iov(&ci, p, op->op, &op->bin, &buffers[i]);
 	}
 
-	size = as_command_write_end(cmd, p);
+	as_command_iov_end(&ci, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, key->ns, key->digest.value, policy->replica, write_attr != 0);
+	as_command_node_init(&cn, key, policy->replica, write_attr != 0);
 	
 	as_command_parse_result_data data;
 	data.record = rec;
 	data.deserialize = policy->deserialize;
+	data.lazy = false;
 
-	status = as_command_execute(as->cluster, err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_result, &data);
+	status = as_command_execute_iov(as->cluster, err, &cn, ci.iov, ci.iovcnt, policy->timeout, policy->retry, as_command_parse_result, &data);
 	
 	for (uint32_t i = 0; i < n_operations; i++) {
 		as_buffer* buffer = &buffers[i];
@@ -513,7 +533,7 @@ as_status aerospike_key_apply(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, key->ns, key->digest.value, AS_POLICY_REPLICA_MASTER, true);
+	as_command_node_init(&cn, key, AS_POLICY_REPLICA_MASTER, true);
 	
 	status = as_command_execute(as->cluster, err, &cn, cmd, size, policy->timeout, 0, as_command_parse_success_failure, result);
 	
@@ -523,6 +543,336 @@ as_status aerospike_key_apply(
 	return status;
 }
 
+/**
+ *	Asynchronously look up a record by key, then return all bins.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ */
+as_status aerospike_key_get_async(
+	aerospike* as, as_error* err, const as_policy_read* policy, const as_key* key,
+	as_async_record_listener listener, void* udata, as_event_loop* event_loop)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.read;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, key, size, policy->timeout, policy->retry, policy->replica, false);
+	
+	if (! cmd) {
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate async command");
+	}
+	
+	uint8_t* p = as_command_write_header_read(cmd->cmd_buf, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL, policy->consistency_level, policy->timeout, n_fields, 0);
+	p = as_command_write_key(p, policy->key, key);
+	cmd->cmd_len = (uint32_t)as_command_write_end(cmd->cmd_buf, p);
+	cmd->type = AS_EVENT_TYPE_RECORD;
+	cmd->listener.record = listener;
+	cmd->udata = udata;
+	cmd->deserialize = policy->deserialize;
+	cmd->lazy = policy->lazy_deserialize;
+	return as_event_command_execute(err, cmd, event_loop);
+}
+
+/**
+ *	Asynchronously store a record in the cluster.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param rec 			The record containing the data to be written.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ */
+as_status aerospike_key_put_async(
+	aerospike* as, as_error* err, const as_policy_write* policy, const as_key* key, as_record* rec,
+	as_async_write_listener listener, void* udata, as_event_loop* event_loop)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.write;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	
+	as_bin* bins = rec->bins.entries;
+	uint32_t n_bins = rec->bins.size;
+	as_buffer* buffers = (as_buffer*)alloca(sizeof(as_buffer) * n_bins);
+	memset(buffers, 0, sizeof(as_buffer) * n_bins);
+	
+	for (uint32_t i = 0; i < n_bins; i++) {
+		size += as_command_bin_size(&bins[i], &buffers[i]);
+	}
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, key, size, policy->timeout, policy->retry, AS_POLICY_REPLICA_MASTER, true);
+	
+	if (! cmd) {
+		for (uint32_t i = 0; i < n_bins; i++) {
+			if (buffers[i].data) {
+				cf_free(buffers[i].data);
+			}
+		}
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate async command");
+	}
+	
+	uint8_t* p = as_command_write_header(cmd->cmd_buf, 0, AS_MSG_INFO2_WRITE, policy->commit_level, 0, policy->exists, policy->gen, rec->gen, rec->ttl, policy->timeout, n_fields, n_bins);
+	p = as_command_write_key(p, policy->key, key);
+	
+	for (uint32_t i = 0; i < n_bins; i++) {
+		p = as_command_write_bin(p, AS_OPERATOR_WRITE, &bins[i], &buffers[i]);
+	}
+	cmd->cmd_len = (uint32_t)as_command_write_end(cmd->cmd_buf, p);
+	
+	// Serialized list/map buffers have been copied into the command.
+	for (uint32_t i = 0; i < n_bins; i++) {
+		as_buffer* buffer = &buffers[i];
+		
+		if (buffer->data) {
+			cf_free(buffer->data);
+		}
+	}
+	cmd->type = AS_EVENT_TYPE_WRITE;
+	cmd->listener.write = listener;
+	cmd->udata = udata;
+	return as_event_command_execute(err, cmd, event_loop);
+}
+
+/**
+ *	Asynchronously remove a record from the cluster.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ */
+as_status aerospike_key_remove_async(
+	aerospike* as, as_error* err, const as_policy_remove* policy, const as_key* key,
+	as_async_write_listener listener, void* udata, as_event_loop* event_loop)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.remove;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, key, size, policy->timeout, policy->retry, AS_POLICY_REPLICA_MASTER, true);
+	
+	if (! cmd) {
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate async command");
+	}
+	
+	uint8_t* p = as_command_write_header(cmd->cmd_buf, 0, AS_MSG_INFO2_WRITE | AS_MSG_INFO2_DELETE, policy->commit_level, 0, AS_POLICY_EXISTS_IGNORE, policy->gen, policy->generation, 0, policy->timeout, n_fields, 0);
+	p = as_command_write_key(p, policy->key, key);
+	cmd->cmd_len = (uint32_t)as_command_write_end(cmd->cmd_buf, p);
+	cmd->type = AS_EVENT_TYPE_WRITE;
+	cmd->listener.write = listener;
+	cmd->udata = udata;
+	return as_event_command_execute(err, cmd, event_loop);
+}
+
+/**
+ *	Asynchronously lookup a record by key, then perform specified operations.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param ops			The operations to perform on the record.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ */
+as_status aerospike_key_operate_async(
+	aerospike* as, as_error* err, const as_policy_operate* policy, const as_key* key, const as_operations* ops,
+	as_async_record_listener listener, void* udata, as_event_loop* event_loop)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.operate;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint32_t n_operations = ops->binops.size;
+	as_buffer* buffers = (as_buffer*)alloca(sizeof(as_buffer) * n_operations);
+	memset(buffers, 0, sizeof(as_buffer) * n_operations);
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	uint8_t read_attr = 0;
+	uint8_t write_attr = 0;
+	
+	for (uint32_t i = 0; i < n_operations; i++) {
+		as_binop* op = &ops->binops.entries[i];
+		
+		switch (op->op)
+		{
+			case AS_OPERATOR_READ:
+				read_attr |= AS_MSG_INFO1_READ;
+				break;
+				
+			default:
+				write_attr |= AS_MSG_INFO2_WRITE;
+				break;
+		}
+		size += as_command_bin_size(&op->bin, &buffers[i]);
+	}
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, key, size, policy->timeout, policy->retry, policy->replica, write_attr != 0);
+	
+	if (! cmd) {
+		for (uint32_t i = 0; i < n_operations; i++) {
+			if (buffers[i].data) {
+				cf_free(buffers[i].data);
+			}
+		}
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate async command");
+	}
+	
+	uint8_t* p = as_command_write_header(cmd->cmd_buf, read_attr, write_attr, policy->commit_level, policy->consistency_level,
+				 AS_POLICY_EXISTS_IGNORE, policy->gen, ops->gen, ops->ttl, policy->timeout, n_fields, n_operations);
+	p = as_command_write_key(p, policy->key, key);
+	
+	for (uint32_t i = 0; i < n_operations; i++) {
+		as_binop* op = &ops->binops.entries[i];
+		p = as_command_write_bin(p, op->op, &op->bin, &buffers[i]);
+	}
+	cmd->cmd_len = (uint32_t)as_command_write_end(cmd->cmd_buf, p);
+	
+	for (uint32_t i = 0; i < n_operations; i++) {
+		as_buffer* buffer = &buffers[i];
+		
+		if (buffer->data) {
+			cf_free(buffer->data);
+		}
+	}
+	cmd->type = AS_EVENT_TYPE_RECORD;
+	cmd->listener.record = listener;
+	cmd->udata = udata;
+	cmd->deserialize = policy->deserialize;
+	return as_event_command_execute(err, cmd, event_loop);
+}
+
+/**
+ *	Asynchronously lookup a record by key, then apply the UDF.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param module		The module containing the function to execute.
+ *	@param function 	The function to execute.
+ *	@param arglist 		The arguments for the function.
+ *	@param listener		User function to be called with command results.
+ *	@param udata		User data to be forwarded to user callback.
+ *	@param event_loop	Event loop assigned to run this command. If NULL, an event loop will be choosen by round-robin.
+ *
+ *	@return AEROSPIKE_OK if async command succesfully queued. Otherwise an error.
+ */
+as_status aerospike_key_apply_async(
+	aerospike* as, as_error* err, const as_policy_apply* policy, const as_key* key,
+	const char* module, const char* function, as_list* arglist,
+	as_async_value_listener listener, void* udata, as_event_loop* event_loop)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.apply;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	size += as_command_string_field_size(module);
+	size += as_command_string_field_size(function);
+	
+	as_serializer ser;
+	as_msgpack_init(&ser);
+	as_buffer args;
+	as_buffer_init(&args);
+	as_serializer_serialize(&ser, (as_val*)arglist, &args);
+	size += as_command_field_size(args.size);
+	n_fields += 3;
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, key, size, policy->timeout, 0, AS_POLICY_REPLICA_MASTER, true);
+	
+	if (! cmd) {
+		as_buffer_destroy(&args);
+		as_serializer_destroy(&ser);
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate async command");
+	}
+	
+	uint8_t* p = as_command_write_header(cmd->cmd_buf, 0, AS_MSG_INFO2_WRITE, policy->commit_level, 0, 0, 0, 0, policy->ttl, policy->timeout, n_fields, 0);
+	p = as_command_write_key(p, policy->key, key);
+	p = as_command_write_field_string(p, AS_FIELD_UDF_PACKAGE_NAME, module);
+	p = as_command_write_field_string(p, AS_FIELD_UDF_FUNCTION, function);
+	p = as_command_write_field_buffer(p, AS_FIELD_UDF_ARGLIST, &args);
+	cmd->cmd_len = (uint32_t)as_command_write_end(cmd->cmd_buf, p);
+	as_buffer_destroy(&args);
+	as_serializer_destroy(&ser);
+	
+	cmd->type = AS_EVENT_TYPE_VALUE;
+	cmd->listener.value = listener;
+	cmd->udata = udata;
+	return as_event_command_execute(err, cmd, event_loop);
+}
+
 bool
 aerospike_has_double(aerospike* as)
 {
@@ -59,7 +59,6 @@ typedef struct as_query_task_s {
 	uint32_t* error_mutex;
 	as_error* err;
 	cf_queue* input_queue;
-	cf_queue* complete_q;
 	uint64_t task_id;
 	
 	uint8_t* cmd;
@@ -67,6 +66,7 @@ typedef struct as_query_task_s {
 	
 	uint32_t timeout;
 	bool deserialize;
+	bool borrow;
 } as_query_task;
 
 typedef struct as_query_task_aggr_s {
@@ -78,12 +78,6 @@ typedef struct as_query_task_aggr_s {
 	cf_queue* complete_q;
 } as_query_task_aggr;
 
-typedef struct as_query_complete_task_s {
-	as_node* node;
-	uint64_t task_id;
-	as_status result;
-} as_query_complete_task;
-
 /******************************************************************************
  * STATIC FUNCTIONS
  *****************************************************************************/
@@ -221,7 +215,17 @@ as_query_parse_record(uint8_t** pp, as_msg* msg, as_query_task* task, as_error*
 
 		AEROSPIKE_QUERY_RECPARSE_BINS(task->task_id, task->node->name);
 
-		p = as_command_parse_bins(&rec, p, msg->n_ops, task->deserialize);
+		// Borrowed parse terminates the last string in the byte following the record,
+		// which may be the next record's header.
+		uint8_t* end = 0;
+		uint8_t saved = 0;
+		
+		if (task->borrow) {
+			end = as_command_ignore_bins(p, msg->n_ops);
+			saved = *end;
+		}
+
+		p = as_command_parse_bins(&rec, p, msg->n_ops, task->deserialize, task->borrow);
 		*pp = p;
 		
 		AEROSPIKE_QUERY_RECPARSE_FINISHED(task->task_id, task->node->name);
@@ -232,6 +236,10 @@ as_query_parse_record(uint8_t** pp, as_msg* msg, as_query_task* task, as_error*
 			AEROSPIKE_QUERY_RECCB_FINISHED(task->task_id, task->node->name);
 		}
 		as_record_destroy(&rec);
+		
+		if (end) {
+			*end = saved;
+		}
 	}
 	return rv ? AEROSPIKE_OK : AEROSPIKE_ERR_CLIENT_ABORT;
 }
@@ -288,17 +296,17 @@ as_query_parse_records(uint8_t* buf, size_t size, as_query_task* task, as_error*
 }
 
 static as_status
-as_query_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
+as_query_parse(as_error* err, as_connection* conn, uint64_t deadline_ms, void* udata)
 {
 	as_query_task* task = udata;
 	as_status status = AEROSPIKE_OK;
-	uint8_t* buf = 0;
+	uint8_t* heap_buf = 0;
 	size_t capacity = 0;
 	
 	while (true) {
 		// Read header
 		as_proto proto;
-		status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
+		status = as_connection_read(err, conn, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
 		
 		if (status) {
 			break;
@@ -307,15 +315,25 @@ as_query_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 		size_t size = proto.sz;
 		
 		if (size > 0) {
-			// Prepare buffer
-			if (size > capacity) {
-				as_command_free(buf, capacity);
-				capacity = size;
-				buf = as_command_init(capacity);
-			}
+			uint8_t* buf;
 			
-			// Read remaining message bytes in group
-			status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
+			if (size <= AS_CONNECTION_BUFFER_SIZE) {
+				// Parse group directly from connection buffer.
+				status = as_connection_read_ptr(err, conn, size, deadline_ms, &buf);
+			}
+			else {
+				// Prepare buffer
+				if (size > capacity) {
+					cf_free(heap_buf);
+					capacity = size;
+					// Extra byte lets borrowed parsing terminate the last string in place.
+					heap_buf = cf_malloc(capacity + 1);
+				}
+				buf = heap_buf;
+				
+				// Read remaining message bytes in group
+				status = as_connection_read(err, conn, buf, size, deadline_ms);
+			}
 			
 			if (status) {
 				break;
@@ -331,46 +349,14 @@ as_query_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 			}
 		}
 	}
-	as_command_free(buf, capacity);
+	cf_free(heap_buf);
 	return status;
 }
 
 static as_status
-as_query_command_execute(as_query_task* task)
+as_query_parse_group(as_error* err, uint8_t* buf, size_t size, void* udata)
 {
-	as_command_node cn;
-	cn.node = task->node;
-	
-	AEROSPIKE_QUERY_COMMAND_EXECUTE(task->task_id, task->node->name);
-
-	as_error err;
-	as_error_init(&err);
-	as_status status = as_command_execute(task->cluster, &err, &cn, task->cmd, task->cmd_size, task->timeout, 0, as_query_parse, task);
-		
-	if (status) {
-		// Set main error only once.
-		if (ck_pr_fas_32(task->error_mutex, 1) == 0) {
-			// Don't set error when user aborts query,
-			if (status != AEROSPIKE_ERR_CLIENT_ABORT) {
-				as_error_copy(task->err, &err);
-			}
-		}
-	}
-
-	return status;
-}
-
-static void
-as_query_worker(void* data)
-{
-	as_query_task* task = (as_query_task*)data;
-		
-	as_query_complete_task complete_task;
-	complete_task.node = task->node;
-	complete_task.task_id = task->task_id;
-	complete_task.result = as_query_command_execute(task);
-		
-	cf_queue_push(task->complete_q, &complete_task);
+	return as_query_parse_records(buf, size, udata, err);
 }
 
 static uint8_t*
@@ -688,44 +674,36 @@ as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, u
 	size = as_command_write_end(cmd, p);
 	task->cmd = cmd;
 	task->cmd_size = size;
-	task->complete_q = cf_queue_create(sizeof(as_query_complete_task), true);
 
-	as_status status = AEROSPIKE_OK;
-	uint32_t n_wait_nodes = n_nodes;
-
-	// Run tasks in parallel.
+	// Send query to all nodes, then parse records as they arrive.  Tasks only need
+	// to be valid within this function.
+	as_query_task* tasks = alloca(sizeof(as_query_task) * n_nodes);
+	as_command_fanout* commands = alloca(sizeof(as_command_fanout) * n_nodes);
+	
 	for (uint32_t i = 0; i < n_nodes; i++) {
-		// Stack allocate task for each node.  It should be fine since the task
-		// only needs to be valid within this function.
-		as_query_task* task_node = alloca(sizeof(as_query_task));
+		as_query_task* task_node = &tasks[i];
 		memcpy(task_node, task, sizeof(as_query_task));
 		task_node->node = nodes->array[i];
 		
-		int rc = as_thread_pool_queue_task(&task->cluster->thread_pool, as_query_worker, task_node);
+		AEROSPIKE_QUERY_COMMAND_EXECUTE(task->task_id, task_node->node->name);
 		
-		if (rc) {
-			// Thread could not be added. Abort entire query.
-			if (ck_pr_fas_32(task->error_mutex, 1) == 0) {
-				status = as_error_update(task->err, AEROSPIKE_ERR_CLIENT, "Failed to add query thread: %d", rc);
- 			}
-			
-			// Reset node count to threads that were run.
-			n_wait_nodes = i;
-			break;
-		}
-
-		AEROSPIKE_QUERY_ENQUEUE_TASK(task->task_id, task_node->node->name);
+		commands[i].node = task_node->node;
+		commands[i].command = cmd;
+		commands[i].command_len = size;
+		commands[i].parse_data = task_node;
 	}
-
-	// Wait for tasks to complete.
-	for (uint32_t i = 0; i < n_wait_nodes; i++) {
-		as_query_complete_task complete;
-		cf_queue_pop(task->complete_q, &complete, CF_QUEUE_FOREVER);
-		
-		AEROSPIKE_QUERY_COMMAND_COMPLETE(task->task_id, complete.node->name);
-
-		if (complete.result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
-			status = complete.result;
+	
+	as_error err;
+	as_error_init(&err);
+	as_status status = as_command_execute_fanout(task->cluster, &err, commands, n_nodes, task->timeout, as_query_parse_group, true);
+	
+	if (status) {
+		// Aggregation thread may have already set main error.
+		if (ck_pr_fas_32(task->error_mutex, 1) == 0) {
+			// Don't set error when user aborts query,
+			if (status != AEROSPIKE_ERR_CLIENT_ABORT) {
+				as_error_copy(task->err, &err);
+			}
 		}
 	}
 	
@@ -739,9 +717,6 @@ as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, u
 		task->callback(NULL, task->udata);
 	}
 	
-	// Release temporary queue.
-	cf_queue_destroy(task->complete_q);
-	
 	// Free command memory.
 	as_command_free(cmd, size);
 	
@@ -873,12 +848,12 @@ as_status aerospike_query_foreach(
 		.error_mutex = &error_mutex,
 		.err = err,
 		.input_queue = 0,
-		.complete_q = 0,
 		.task_id = cf_get_rand64() / 2,
 		.cmd = 0,
 		.cmd_size = 0,
 		.timeout = policy->timeout,
-		.deserialize = policy->deserialize
+		.deserialize = policy->deserialize,
+		.borrow = policy->borrow_bins
 	};
 	
 	AEROSPIKE_QUERY_FOREACH_STARTING(task.task_id);
@@ -1008,12 +983,12 @@ aerospike_query_background(
 		.error_mutex = &error_mutex,
 		.err = err,
 		.input_queue = 0,
-		.complete_q = 0,
 		.task_id = task_id,
 		.cmd = 0,
 		.cmd_size = 0,
 		.timeout = policy->timeout,
-		.deserialize = false
+		.deserialize = false,
+		.borrow = false
 	};
 	
 	as_status status = as_query_execute(&task, query, nodes, n_nodes, QUERY_BACKGROUND);
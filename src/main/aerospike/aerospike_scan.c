@@ -23,9 +23,7 @@
 #include <aerospike/as_msgpack.h>
 #include <aerospike/as_serializer.h>
 #include <aerospike/as_socket.h>
-#include <aerospike/as_thread_pool.h>
 #include <citrusleaf/cf_clock.h>
-#include <citrusleaf/cf_queue.h>
 #include <citrusleaf/cf_random.h>
 
 /******************************************************************************
@@ -41,7 +39,6 @@ typedef struct as_scan_task_s {
 	aerospike_scan_foreach_callback callback;
 	void* udata;
 	as_error* err;
-	cf_queue* complete_q;
 	uint32_t* error_mutex;
 	uint64_t task_id;
 	
@@ -49,12 +46,6 @@ typedef struct as_scan_task_s {
 	size_t cmd_size;
 } as_scan_task;
 
-typedef struct as_scan_complete_task_s {
-	as_node* node;
-	uint64_t task_id;
-	as_status result;
-} as_scan_complete_task;
-
 /******************************************************************************
  * STATIC FUNCTIONS
  *****************************************************************************/
@@ -70,7 +61,19 @@ as_scan_parse_record(uint8_t** pp, as_msg* msg, as_scan_task* task)
 	
 	uint8_t* p = *pp;
 	p = as_command_parse_key(p, msg->n_fields, &rec.key);
-	p = as_command_parse_bins(&rec, p, msg->n_ops, task->scan->deserialize_list_map);
+	
+	// Borrowed parse terminates the last string in the byte following the record,
+	// which may be the next record's header.
+	bool borrow = task->policy->borrow_bins;
+	uint8_t* end = 0;
+	uint8_t saved = 0;
+	
+	if (borrow) {
+		end = as_command_ignore_bins(p, msg->n_ops);
+		saved = *end;
+	}
+	
+	p = as_command_parse_bins(&rec, p, msg->n_ops, task->scan->deserialize_list_map, borrow);
 	*pp = p;
 	
 	bool rv = true;
@@ -79,6 +82,10 @@ as_scan_parse_record(uint8_t** pp, as_msg* msg, as_scan_task* task)
 		rv = task->callback((as_val*)&rec, task->udata);
 	}
 	as_record_destroy(&rec);
+	
+	if (end) {
+		*end = saved;
+	}
 	return rv ? AEROSPIKE_OK : AEROSPIKE_ERR_CLIENT_ABORT;
 }
 
@@ -125,17 +132,17 @@ as_scan_parse_records(uint8_t* buf, size_t size, as_scan_task* task, as_error* e
 }
 
 static as_status
-as_scan_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
+as_scan_parse(as_error* err, as_connection* conn, uint64_t deadline_ms, void* udata)
 {
 	as_scan_task* task = udata;
 	as_status status = AEROSPIKE_OK;
-	uint8_t* buf = 0;
+	uint8_t* heap_buf = 0;
 	size_t capacity = 0;
 	
 	while (true) {
 		// Read header
 		as_proto proto;
-		status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
+		status = as_connection_read(err, conn, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
 		
 		if (status) {
 			break;
@@ -144,15 +151,25 @@ as_scan_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 		size_t size = proto.sz;
 		
 		if (size > 0) {
-			// Prepare buffer
-			if (size > capacity) {
-				as_command_free(buf, capacity);
-				capacity = size;
-				buf = as_command_init(capacity);
-			}
+			uint8_t* buf;
 			
-			// Read remaining message bytes in group
-			status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
+			if (size <= AS_CONNECTION_BUFFER_SIZE) {
+				// Parse group directly from connection buffer.
+				status = as_connection_read_ptr(err, conn, size, deadline_ms, &buf);
+			}
+			else {
+				// Prepare buffer
+				if (size > capacity) {
+					cf_free(heap_buf);
+					capacity = size;
+					// Extra byte lets borrowed parsing terminate the last string in place.
+					heap_buf = cf_malloc(capacity + 1);
+				}
+				buf = heap_buf;
+				
+				// Read remaining message bytes in group
+				status = as_connection_read(err, conn, buf, size, deadline_ms);
+			}
 			
 			if (status) {
 				break;
@@ -168,7 +185,7 @@ as_scan_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 			}
 		}
 	}
-	as_command_free(buf, capacity);
+	cf_free(heap_buf);
 	return status;
 }
 
@@ -194,17 +211,10 @@ as_scan_command_execute(as_scan_task* task)
 	return status;
 }
 
-static void
-as_scan_worker(void* data)
+static as_status
+as_scan_parse_group(as_error* err, uint8_t* buf, size_t size, void* udata)
 {
-	as_scan_task* task = (as_scan_task*)data;
-	
-	as_scan_complete_task complete_task;
-	complete_task.node = task->node;
-	complete_task.task_id = task->task_id;
-	complete_task.result = as_scan_command_execute(task);
-		
-	cf_queue_push(task->complete_q, &complete_task);
+	return as_scan_parse_records(buf, size, udata, err);
 }
 
 static size_t
@@ -378,47 +388,24 @@ as_scan_generic(
 	as_status status = AEROSPIKE_OK;
 	
 	if (scan->concurrent) {
-		uint32_t n_wait_nodes = n_nodes;
-		task.complete_q = cf_queue_create(sizeof(as_scan_complete_task), true);
-
-		// Run node scans in parallel.
+		// Send scan to all nodes, then parse records as they arrive.
+		as_command_fanout* commands = alloca(sizeof(as_command_fanout) * n_nodes);
+		
 		for (uint32_t i = 0; i < n_nodes; i++) {
-			// Stack allocate task for each node.  It should be fine since the task
-			// only needs to be valid within this function.
-			as_scan_task* task_node = alloca(sizeof(as_scan_task));
-			memcpy(task_node, &task, sizeof(as_scan_task));
-			task_node->node = nodes->array[i];
-			
-			int rc = as_thread_pool_queue_task(&cluster->thread_pool, as_scan_worker, task_node);
-			
-			if (rc) {
-				// Thread could not be added. Abort entire scan.
-				if (ck_pr_fas_32(task.error_mutex, 1) == 0) {
-					status = as_error_update(task.err, AEROSPIKE_ERR_CLIENT, "Failed to add scan thread: %d", rc);
-				}
-				
-				// Reset node count to threads that were run.
-				n_wait_nodes = i;
-				break;
-			}
-		}
-
-		// Wait for tasks to complete.
-		for (uint32_t i = 0; i < n_wait_nodes; i++) {
-			as_scan_complete_task complete;
-			cf_queue_pop(task.complete_q, &complete, CF_QUEUE_FOREVER);
-			
-			if (complete.result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
-				status = complete.result;
-			}
+			commands[i].node = nodes->array[i];
+			commands[i].command = cmd;
+			commands[i].command_len = size;
+			commands[i].parse_data = &task;
 		}
 		
-		// Release temporary queue.
-		cf_queue_destroy(task.complete_q);
+		status = as_command_execute_fanout(cluster, err, commands, n_nodes, policy->timeout, as_scan_parse_group, true);
+		
+		// Don't set error when user aborts scan.
+		if (status == AEROSPIKE_ERR_CLIENT_ABORT) {
+			as_error_reset(err);
+		}
 	}
 	else {
-		task.complete_q = 0;
-		
 		// Run node scans in series.
 		for (uint32_t i = 0; i < n_nodes && status == AEROSPIKE_OK; i++) {
 			task.node = nodes->array[i];
@@ -673,7 +660,6 @@ as_status aerospike_scan_node(
 	task.callback = callback;
 	task.udata = udata;
 	task.err = err;
-	task.complete_q = 0;
 	task.error_mutex = &error_mutex;
 	task.task_id = task_id;
 	task.cmd = cmd;
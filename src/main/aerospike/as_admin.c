@@ -158,13 +158,13 @@ as_admin_write_privileges(uint8_t** p, as_error* err, as_privilege** privileges,
 }
 
 static as_status
-as_admin_send(as_error* err, int fd, uint8_t* buffer, uint8_t* end, uint64_t deadline_ms)
+as_admin_send(as_error* err, as_connection* conn, uint8_t* buffer, uint8_t* end, uint64_t deadline_ms)
 {
 	uint64_t len = end - buffer;
 	uint64_t proto = (len - 8) | (MSG_VERSION << 56) | (MSG_TYPE << 48);
 	*(uint64_t*)buffer = cf_swap_to_be64(proto);
 	
-	return as_socket_write_deadline(err, fd, buffer, len, deadline_ms);
+	return as_connection_write(err, conn, buffer, len, deadline_ms);
 }
 
 static as_status
@@ -182,31 +182,31 @@ as_admin_execute(aerospike* as, as_error* err, const as_policy_admin* policy, ui
 		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to find server node.");
 	}
 	
-	int fd;
-	as_status status = as_node_get_connection(err, node, deadline_ms, &fd);
+	as_connection* conn;
+	as_status status = as_node_get_connection(err, node, deadline_ms, &conn);
 	
 	if (status) {
 		as_node_release(node);
 		return status;
 	}
 
-	status = as_admin_send(err, fd, buffer, end, deadline_ms);
+	status = as_admin_send(err, conn, buffer, end, deadline_ms);
 	
 	if (status) {
-		as_close(fd);
+		as_node_close_connection(node, conn);
 		as_node_release(node);
 		return status;
 	}
 	
-	status = as_socket_read_deadline(err, fd, buffer, HEADER_SIZE, deadline_ms);
+	status = as_connection_read(err, conn, buffer, HEADER_SIZE, deadline_ms);
 	
 	if (status) {
-		as_close(fd);
+		as_node_close_connection(node, conn);
 		as_node_release(node);
 		return status;
 	}
 	
-	as_node_put_connection(node, fd, cluster->conn_queue_size);
+	as_node_put_connection(node, conn, cluster->conn_queue_size);
 	as_node_release(node);
 	
 	status = buffer[RESULT_CODE];
@@ -218,16 +218,16 @@ as_admin_execute(aerospike* as, as_error* err, const as_policy_admin* policy, ui
 }
 
 static as_status
-as_admin_read_blocks(as_error* err, int fd, uint64_t deadline_ms, as_admin_parse_fn parse_fn, as_vector* list)
+as_admin_read_blocks(as_error* err, as_connection* conn, uint64_t deadline_ms, as_admin_parse_fn parse_fn, as_vector* list)
 {
 	as_status status = AEROSPIKE_OK;
-	uint8_t* buf = 0;
+	uint8_t* heap_buf = 0;
 	size_t capacity = 0;
 	
 	while (true) {
 		// Read header
 		as_proto proto;
-		status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
+		status = as_connection_read(err, conn, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
 		
 		if (status) {
 			break;
@@ -236,15 +236,22 @@ as_admin_read_blocks(as_error* err, int fd, uint64_t deadline_ms, as_admin_parse
 		size_t size = proto.sz;
 		
 		if (size > 0) {
-			// Prepare buffer
-			if (size > capacity) {
-				as_command_free(buf, capacity);
-				capacity = size;
-				buf = as_command_init(capacity);
-			}
+			uint8_t* buf;
 			
-			// Read remaining message bytes in group
-			status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
+			if (size <= AS_CONNECTION_BUFFER_SIZE) {
+				// Parse group directly from connection buffer.
+				status = as_connection_read_ptr(err, conn, size, deadline_ms, &buf);
+			}
+			else {
+				// Prepare buffer
+				if (size > capacity) {
+					cf_free(heap_buf);
+					capacity = size;
+					heap_buf = cf_malloc(capacity);
+				}
+				buf = heap_buf;
+				status = as_connection_read(err, conn, buf, size, deadline_ms);
+			}
 			
 			if (status) {
 				break;
@@ -263,7 +270,7 @@ as_admin_read_blocks(as_error* err, int fd, uint64_t deadline_ms, as_admin_parse
 			}
 		}
 	}
-	as_command_free(buf, capacity);
+	cf_free(heap_buf);
 	return status;
 }
 
@@ -282,31 +289,31 @@ as_admin_read_list(aerospike* as, as_error* err, const as_policy_admin* policy,
 		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to find server node.");
 	}
 	
-	int fd;
-	as_status status = as_node_get_connection(err, node, deadline_ms, &fd);
+	as_connection* conn;
+	as_status status = as_node_get_connection(err, node, deadline_ms, &conn);
 	
 	if (status) {
 		as_node_release(node);
 		return status;
 	}
 	
-	status = as_admin_send(err, fd, command, end, deadline_ms);
+	status = as_admin_send(err, conn, command, end, deadline_ms);
 	
 	if (status) {
-		as_close(fd);
+		as_node_close_connection(node, conn);
 		as_node_release(node);
 		return status;
 	}
 	
-	status = as_admin_read_blocks(err, fd, deadline_ms, parse_fn, list);
+	status = as_admin_read_blocks(err, conn, deadline_ms, parse_fn, list);
 	
 	if (status) {
-		as_close(fd);
+		as_node_close_connection(node, conn);
 		as_node_release(node);
 		return status;
 	}
 
-	as_node_put_connection(node, fd, cluster->conn_queue_size);
+	as_node_put_connection(node, conn, cluster->conn_queue_size);
 	as_node_release(node);
 	return status;
 }
@@ -315,17 +322,28 @@ as_admin_read_list(aerospike* as, as_error* err, const as_policy_admin* policy,
  *	FUNCTIONS
  *****************************************************************************/
 
-as_status
-as_authenticate(as_error* err, int fd, const char* user, const char* credential, uint64_t deadline_ms)
+uint32_t
+as_authenticate_set(const char* user, const char* credential, uint8_t* buffer)
 {
-	uint8_t buffer[AS_STACK_BUF_SIZE];
 	uint8_t* p = buffer + 8;
-
+	
 	p = as_admin_write_header(p, AUTHENTICATE, 2);
 	p = as_admin_write_field_string(p, USER, user);
 	p = as_admin_write_field_string(p, CREDENTIAL, credential);
 	
-	as_status status = as_admin_send(err, fd, buffer, p, deadline_ms);
+	uint64_t len = p - buffer;
+	uint64_t proto = (len - 8) | (MSG_VERSION << 56) | (MSG_TYPE << 48);
+	*(uint64_t*)buffer = cf_swap_to_be64(proto);
+	return (uint32_t)len;
+}
+
+as_status
+as_authenticate(as_error* err, int fd, const char* user, const char* credential, uint64_t deadline_ms)
+{
+	uint8_t buffer[AS_STACK_BUF_SIZE];
+	uint32_t len = as_authenticate_set(user, credential, buffer);
+	
+	as_status status = as_socket_write_deadline(err, fd, buffer, len, deadline_ms);
 	
 	if (status) {
 		return status;
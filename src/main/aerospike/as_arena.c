@@ -0,0 +1,136 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_arena.h>
+#include <citrusleaf/alloc.h>
+#include <aerospike/ck/ck_pr.h>
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline size_t
+as_arena_align(size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
+static inline void
+as_arena_defaults(as_arena* arena, size_t block_size)
+{
+	pthread_mutex_init(&arena->lock, 0);
+	arena->block = 0;
+	arena->inline_block = 0;
+	arena->block_size = block_size;
+	arena->ref_count = 1;
+	arena->free = false;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_arena*
+as_arena_init(void* mem, size_t size, size_t block_size)
+{
+	as_arena* arena = mem;
+	as_arena_defaults(arena, block_size);
+
+	as_arena_block* block = (as_arena_block*)((uint8_t*)mem + sizeof(as_arena));
+	block->next = 0;
+	block->capacity = as_arena_align(size);
+	block->offset = 0;
+
+	arena->block = block;
+	arena->inline_block = block;
+	return arena;
+}
+
+as_arena*
+as_arena_create(size_t block_size)
+{
+	as_arena* arena = cf_malloc(sizeof(as_arena));
+
+	if (! arena) {
+		return 0;
+	}
+	as_arena_defaults(arena, block_size);
+	arena->free = true;
+	return arena;
+}
+
+void*
+as_arena_alloc(as_arena* arena, size_t size)
+{
+	size = as_arena_align(size);
+
+	pthread_mutex_lock(&arena->lock);
+
+	as_arena_block* block = arena->block;
+
+	if (! block || block->capacity - block->offset < size) {
+		size_t capacity = (size > arena->block_size)? size : arena->block_size;
+		block = cf_malloc(sizeof(as_arena_block) + capacity);
+
+		if (! block) {
+			pthread_mutex_unlock(&arena->lock);
+			return 0;
+		}
+		block->next = arena->block;
+		block->capacity = capacity;
+		block->offset = 0;
+		arena->block = block;
+	}
+
+	void* p = block->data + block->offset;
+	block->offset += size;
+
+	pthread_mutex_unlock(&arena->lock);
+	return p;
+}
+
+void
+as_arena_reserve(as_arena* arena)
+{
+	ck_pr_inc_32(&arena->ref_count);
+}
+
+void
+as_arena_release(as_arena* arena)
+{
+	bool zero;
+	ck_pr_dec_32_zero(&arena->ref_count, &zero);
+
+	if (! zero) {
+		return;
+	}
+
+	as_arena_block* block = arena->block;
+
+	while (block) {
+		as_arena_block* next = block->next;
+
+		if (block != arena->inline_block) {
+			cf_free(block);
+		}
+		block = next;
+	}
+	pthread_mutex_destroy(&arena->lock);
+
+	if (arena->free) {
+		cf_free(arena);
+	}
+}
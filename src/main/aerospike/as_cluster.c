@@ -16,11 +16,13 @@
  */
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_admin.h>
+#include <aerospike/as_event.h>
 #include <aerospike/as_info.h>
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_lookup.h>
 #include <aerospike/as_password.h>
 #include <aerospike/as_shm_cluster.h>
+#include <aerospike/as_snapshot.h>
 #include <aerospike/as_socket.h>
 #include <aerospike/as_string.h>
 #include <aerospike/as_vector.h>
@@ -31,8 +33,8 @@
  *	Function declarations
  *****************************************************************************/
 
-as_status
-as_node_refresh(as_cluster* cluster, as_error* err, as_node* node, as_vector* /* <as_friend> */ friends);
+uint32_t
+as_node_refresh_all(as_cluster* cluster, as_nodes* nodes, as_vector* /* <as_friend> */ friends, uint64_t* refresh_ms);
 
 /******************************************************************************
  *	Functions
@@ -240,11 +242,8 @@ as_cluster_add_nodes_copy(as_cluster* cluster, as_vector* /* <as_node*> */ nodes
 	// Replace nodes with copy.
 	set_nodes(cluster, nodes_new);
 	
-	// Put old nodes on garbage collector stack.
-	as_gc_item item;
-	item.data = nodes_old;
-	item.release_fn = (as_release_fn)release_nodes;
-	as_vector_append(cluster->gc, &item);
+	// Release old nodes when no command can still be using them.
+	as_epoch_retire(cluster->epoch, nodes_old, (as_release_fn)release_nodes);
 }
 
 static void
@@ -484,10 +483,7 @@ as_cluster_remove_nodes_copy(as_cluster* cluster, as_vector* /* <as_node*> */ no
 		if (as_cluster_find_node_by_reference(nodes_to_remove, node)) {
 			as_address* a = as_node_get_address_full(node);
 			as_log_info("Remove node %s %s:%d", node->name, a->name, (int)cf_swap_from_be16(a->addr.sin_port));
-			as_gc_item item;
-			item.data = node;
-			item.release_fn = (as_release_fn)release_node;
-			as_vector_append(cluster->gc, &item);
+			as_epoch_retire(cluster->epoch, node, (as_release_fn)release_node);
 		}
 		else {
 			if (count < nodes_new->size) {
@@ -508,11 +504,8 @@ as_cluster_remove_nodes_copy(as_cluster* cluster, as_vector* /* <as_node*> */ no
 	// Replace nodes with copy.
 	set_nodes(cluster, nodes_new);
 
-	// Put old nodes on garbage collector stack.
-	as_gc_item item;
-	item.data = nodes_old;
-	item.release_fn = (as_release_fn)release_nodes;
-	as_vector_append(cluster->gc, &item);
+	// Release old nodes when no command can still be using them.
+	as_epoch_retire(cluster->epoch, nodes_old, (as_release_fn)release_nodes);
 }
 
 static void
@@ -585,16 +578,33 @@ as_cluster_set_partition_size(as_cluster* cluster, as_error* err)
 }
 
 /**
- *	Release data structures schuleduled for removal in previous cluster tend.
+ * Record duration of completed tend.  Stats are only written by the tend thread.
  */
 static void
-as_cluster_gc(as_vector* /* <as_gc_item> */ vector)
+as_cluster_update_tend_stats(as_cluster* cluster, uint64_t begin, uint64_t refresh_ms, uint32_t failures)
 {
-	for (uint32_t i = 0; i < vector->size; i++) {
-		as_gc_item* item = as_vector_get(vector, i);
-		item->release_fn(item->data);
+	as_tend_stats* stats = &cluster->tend_stats;
+	uint64_t elapsed = cf_getms() - begin;
+	
+	ck_pr_store_64(&stats->count, stats->count + 1);
+	ck_pr_store_64(&stats->last_ms, elapsed);
+	ck_pr_store_64(&stats->total_ms, stats->total_ms + elapsed);
+	ck_pr_store_64(&stats->last_refresh_ms, refresh_ms);
+	
+	if (elapsed > stats->max_ms) {
+		ck_pr_store_64(&stats->max_ms, elapsed);
+	}
+	
+	if (failures > 0) {
+		ck_pr_store_64(&stats->refresh_failures, stats->refresh_failures + failures);
+	}
+	
+	if (elapsed > cluster->tend_interval) {
+		as_log_info("Tend took %lu ms, longer than tend interval %u ms", elapsed, cluster->tend_interval);
+	}
+	else {
+		as_log_debug("Tend took %lu ms, node refresh %lu ms", elapsed, refresh_ms);
 	}
-	as_vector_clear(vector);
 }
 
 /**
@@ -603,12 +613,13 @@ as_cluster_gc(as_vector* /* <as_gc_item> */ vector)
 as_status
 as_cluster_tend(as_cluster* cluster, as_error* err, bool enable_seed_warnings)
 {
+	uint64_t begin = cf_getms();
+	
 	// All node additions/deletions are performed in tend thread.
-	// Garbage collect data structures released in previous tend.
-	// This tend interval delay substantially reduces the chance of
-	// deleting a ref counted data structure when other threads
-	// are stuck between assigment and incrementing the ref count.
-	as_cluster_gc(cluster->gc);
+	// Release data structures retired in previous tends that are no
+	// longer visible to any command thread.
+	as_epoch_reclaim(cluster->epoch);
+	as_node_destroy_deferred(cluster, false);
 	
 	// If active nodes don't exist, seed cluster.
 	as_nodes* nodes = cluster->nodes;
@@ -631,28 +642,37 @@ as_cluster_tend(as_cluster* cluster, as_error* err, bool enable_seed_warnings)
 	
 	// Clear tend iteration node statistics.
 	nodes = cluster->nodes;
+	uint32_t active_count = 0;
 	for (uint32_t i = 0; i < nodes->size; i++) {
 		as_node* node = nodes->array[i];
 		node->friends = 0;
+		
+		if (node->active) {
+			active_count++;
+		}
 	}
 	
-	// Refresh all known nodes.
-	as_error err_local;
+	// Refresh all known nodes concurrently.
 	as_vector friends;
 	as_vector_inita(&friends, sizeof(as_friend), 8);
-	uint32_t refresh_count = 0;
+	uint64_t refresh_ms;
+	uint32_t refresh_count = as_node_refresh_all(cluster, nodes, &friends, &refresh_ms);
 	
+	// Age hedged read latency, so percentiles follow recent responses.
 	for (uint32_t i = 0; i < nodes->size; i++) {
-		as_node* node = nodes->array[i];
+		as_node_decay_latency(nodes->array[i]);
+	}
+	
+	// Close pooled connections that the server may have already dropped.
+	if (cluster->max_socket_idle > 0) {
+		uint64_t used_before_ms = cf_getms() - (uint64_t)cluster->max_socket_idle * 1000;
 		
-		if (node->active) {
-			if (as_node_refresh(cluster, &err_local, node, &friends) == AEROSPIKE_OK) {
-				node->failures = 0;
-				refresh_count++;
-			}
-			else {
-				as_log_info("Node %s refresh failed: %s %s", node->name, as_error_string(err_local.code), err_local.message);
-				node->failures++;
+		for (uint32_t i = 0; i < nodes->size; i++) {
+			as_node* node = nodes->array[i];
+			uint32_t closed = as_conn_pool_close_idle(&node->conn_pool, used_before_ms);
+			
+			if (closed > 0) {
+				as_log_debug("Node %s closed %u idle connections", node->name, closed);
 			}
 		}
 	}
@@ -665,7 +685,20 @@ as_cluster_tend(as_cluster* cluster, as_error* err, bool enable_seed_warnings)
 	as_vector_inita(&nodes_to_remove, sizeof(as_node*), nodes->size);
 
 	as_cluster_find_nodes_to_add(cluster, &friends, &nodes_to_add);
-	as_cluster_find_nodes_to_remove(cluster, refresh_count, &nodes_to_remove);
+	
+	if (cluster->warm_start && refresh_count == 0) {
+		// None of the nodes loaded from the snapshot responded.  Discard them, so the
+		// cluster is seeded again.
+		as_log_warn("Warm start nodes did not respond. Seed cluster.");
+		
+		for (uint32_t i = 0; i < nodes->size; i++) {
+			as_vector_append(&nodes_to_remove, &nodes->array[i]);
+		}
+	}
+	else {
+		as_cluster_find_nodes_to_remove(cluster, refresh_count, &nodes_to_remove);
+	}
+	cluster->warm_start = false;
 	
 	// Remove nodes in a batch.
 	if (nodes_to_remove.size > 0) {
@@ -680,6 +713,12 @@ as_cluster_tend(as_cluster* cluster, as_error* err, bool enable_seed_warnings)
 	as_vector_destroy(&nodes_to_add);
 	as_vector_destroy(&nodes_to_remove);
 	as_vector_destroy(&friends);
+	
+	if (cluster->snapshot_path) {
+		as_snapshot_save(cluster, cluster->snapshot_path);
+	}
+	
+	as_cluster_update_tend_stats(cluster, begin, refresh_ms, active_count - refresh_count);
 	return AEROSPIKE_OK;
 }
 
@@ -718,6 +757,23 @@ as_wait_till_stabilized(as_cluster* cluster, as_error* err)
 	return AEROSPIKE_OK;
 }
 
+/**
+ * Open minimum connections to each node, so the first commands after connect
+ * do not have to create and authenticate sockets.
+ */
+static void
+as_cluster_create_min_connections(as_cluster* cluster)
+{
+	uint64_t deadline_ms = cf_getms() + cluster->conn_timeout_ms;
+	as_nodes* nodes = cluster->nodes;
+	
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+		uint32_t count = as_node_create_min_connections(node, cluster->min_conns_per_node, deadline_ms);
+		as_log_debug("Node %s opened %u connections", node->name, count);
+	}
+}
+
 static void*
 as_cluster_tender(void* data)
 {
@@ -814,6 +870,33 @@ as_cluster_init(as_cluster* cluster, as_error* err, bool fail_if_not_connected)
 	return AEROSPIKE_OK;
 }
 
+/**
+ * Load nodes and partition tables from the warm start snapshot instead of waiting for
+ * the cluster to stabilize.  The tend thread validates them in the background.
+ */
+static bool
+as_cluster_warm_start(as_cluster* cluster)
+{
+	as_vector nodes;
+	as_vector_inita(&nodes, sizeof(as_node*), 16);
+	
+	as_error err;
+	as_error_init(&err);
+	
+	if (as_snapshot_load(cluster, &err, cluster->snapshot_path, &nodes) != AEROSPIKE_OK) {
+		as_log_info("Warm start not used: %s", err.message);
+		as_vector_destroy(&nodes);
+		return false;
+	}
+	
+	as_cluster_add_nodes(cluster, &nodes);
+	as_vector_destroy(&nodes);
+	as_cluster_add_seeds(cluster);
+	cluster->warm_start = true;
+	cluster->valid = true;
+	return true;
+}
+
 static uint32_t
 seeds_size(as_config* config)
 {
@@ -859,9 +942,10 @@ ip_map_create(as_addr_map* source_map, uint32_t size)
 }
 
 as_node*
-as_node_get_random(as_cluster* cluster)
+as_node_select_random(as_cluster* cluster)
 {
-	as_nodes* nodes = as_nodes_reserve(cluster);
+	// Caller's epoch keeps nodes array from being released.
+	as_nodes* nodes = (as_nodes *)ck_pr_load_ptr(&cluster->nodes);
 	uint32_t size = nodes->size;
 	
 	for (uint32_t i = 0; i < size; i++) {
@@ -871,15 +955,25 @@ as_node_get_random(as_cluster* cluster)
 		uint8_t active = ck_pr_load_8(&node->active);
 		
 		if (active) {
-			as_node_reserve(node);
-			as_nodes_release(nodes);
 			return node;
 		}
 	}
-	as_nodes_release(nodes);
 	return 0;
 }
 
+as_node*
+as_node_get_random(as_cluster* cluster)
+{
+	as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+	as_node* node = as_node_select_random(cluster);
+	
+	if (node) {
+		as_node_reserve(node);
+	}
+	as_epoch_exit(slot);
+	return node;
+}
+
 as_node*
 as_node_get_by_name(as_cluster* cluster, const char* name)
 {
@@ -898,6 +992,35 @@ as_node_get_by_name(as_cluster* cluster, const char* name)
 	return(0);
 }
 
+void
+as_cluster_get_tend_stats(as_cluster* cluster, as_tend_stats* stats)
+{
+	as_tend_stats* s = &cluster->tend_stats;
+	stats->count = ck_pr_load_64(&s->count);
+	stats->last_ms = ck_pr_load_64(&s->last_ms);
+	stats->max_ms = ck_pr_load_64(&s->max_ms);
+	stats->total_ms = ck_pr_load_64(&s->total_ms);
+	stats->last_refresh_ms = ck_pr_load_64(&s->last_refresh_ms);
+	stats->refresh_failures = ck_pr_load_64(&s->refresh_failures);
+}
+
+void
+as_cluster_get_breaker_stats(as_cluster* cluster, as_breaker_stats* stats)
+{
+	stats->trips = ck_pr_load_64(&cluster->breaker_trips);
+	stats->rejects = ck_pr_load_64(&cluster->breaker_rejects);
+	stats->open_nodes = 0;
+	
+	as_nodes* nodes = as_nodes_reserve(cluster);
+	
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		if (ck_pr_load_32(&nodes->array[i]->breaker_state) != AS_NODE_BREAKER_CLOSED) {
+			stats->open_nodes++;
+		}
+	}
+	as_nodes_release(nodes);
+}
+
 void
 as_cluster_get_node_names(as_cluster* cluster, int* n_nodes, char** node_names)
 {
@@ -972,6 +1095,21 @@ as_cluster_create(as_config* config, as_error* err, as_cluster** cluster_out)
 	cluster->tend_interval = (config->tender_interval < 1000)? 1000 : config->tender_interval;
 	cluster->conn_queue_size = config->max_threads + 1;  // Add one connection for tend thread.
 	cluster->conn_timeout_ms = (config->conn_timeout_ms == 0) ? 1000 : config->conn_timeout_ms;
+	cluster->pipeline_depth = config->pipeline_depth;
+	cluster->max_socket_idle = config->max_socket_idle_sec;
+	cluster->conn_validate_ms = config->conn_validate_ms;
+	cluster->max_conns_per_node = config->max_conns_per_node;
+	cluster->min_conns_per_node = config->min_conns_per_node;
+	cluster->breaker_errors = config->breaker_errors;
+	cluster->breaker_open_ms = (config->breaker_open_ms == 0)? 1000 : config->breaker_open_ms;
+	
+	if (config->warm_start_path[0] && ! config->use_shm) {
+		cluster->snapshot_path = cf_strdup(config->warm_start_path);
+	}
+	
+	if (cluster->min_conns_per_node > cluster->conn_queue_size) {
+		cluster->min_conns_per_node = cluster->conn_queue_size;
+	}
 	
 	// Initialize seed hosts.
 	cluster->seeds_size = seeds_size(config);
@@ -989,8 +1127,8 @@ as_cluster_create(as_config* config, as_error* err, as_cluster** cluster_out)
 	// Initialize empty partition tables.
 	cluster->partition_tables = as_partition_tables_create(0);
 	
-	// Initialize garbage collection array.
-	cluster->gc = as_vector_create(sizeof(as_gc_item), 8);
+	// Initialize epoch based reclamation.
+	cluster->epoch = as_epoch_create();
 	
 	// Initialize thread pool.
 	int rc = as_thread_pool_init(&cluster->thread_pool, config->thread_pool_size);
@@ -1007,9 +1145,24 @@ as_cluster_create(as_config* config, as_error* err, as_cluster** cluster_out)
 	pthread_mutex_init(&cluster->tend_lock, NULL);
 	pthread_cond_init(&cluster->tend_cond, NULL);
 	
+	// Initialize event loops before nodes are created, so nodes can size their async pools.
+	as_status status = as_event_loops_create(cluster, err, config->event_loop_size, config->event_loop_external);
+	
+	if (status != AEROSPIKE_OK) {
+		as_cluster_destroy(cluster);
+		*cluster_out = 0;
+		return status;
+	}
+	
+	if (config->async_max_conns_per_node > 0 && cluster->event_loop_size > 0) {
+		// Round up, so every event loop can open at least one connection per node.
+		uint32_t size = cluster->event_loop_size;
+		cluster->async_max_conns_per_loop = (config->async_max_conns_per_node + size - 1) / size;
+	}
+	
 	if (config->use_shm) {
 		// Create shared memory cluster.
-		as_status status = as_shm_create(cluster, err, config);
+		status = as_shm_create(cluster, err, config);
 		
 		if (status != AEROSPIKE_OK) {
 			as_cluster_destroy(cluster);
@@ -1018,14 +1171,22 @@ as_cluster_create(as_config* config, as_error* err, as_cluster** cluster_out)
 		}
 	}
 	else {
-		// Initialize normal cluster.
-		as_status status = as_cluster_init(cluster, err, config->fail_if_not_connected);
+		// Initialize normal cluster.  A warm start snapshot avoids waiting for the cluster
+		// to be discovered.
+		if (! (cluster->snapshot_path && as_cluster_warm_start(cluster))) {
+			status = as_cluster_init(cluster, err, config->fail_if_not_connected);
+			
+			if (status != AEROSPIKE_OK) {
+				as_cluster_destroy(cluster);
+				*cluster_out = 0;
+				return status;
+			}
+		}
 		
-		if (status != AEROSPIKE_OK) {
-			as_cluster_destroy(cluster);
-			*cluster_out = 0;
-			return status;
+		if (cluster->min_conns_per_node > 0) {
+			as_cluster_create_min_connections(cluster);
 		}
+		
 		// Run cluster tend thread.
 		pthread_create(&cluster->tend_thread, 0, as_cluster_tender, cluster);
 	}
@@ -1059,10 +1220,12 @@ as_cluster_destroy(as_cluster* cluster)
 			as_shm_destroy(cluster);
 		}
 	}
+	
+	// Complete pending asynchronous commands and stop event loops.
+	as_event_loops_destroy(cluster);
 
-	// Release everything in garbage collector.
-	as_cluster_gc(cluster->gc);
-	as_vector_destroy(cluster->gc);
+	// Release everything retired.
+	as_epoch_destroy(cluster->epoch);
 		
 	// Release partition tables.
 	as_partition_tables* tables = cluster->partition_tables;
@@ -1078,6 +1241,9 @@ as_cluster_destroy(as_cluster* cluster)
 	}
 	as_nodes_release(nodes);
 	
+	// Command threads have finished, so nothing can still be protected.
+	as_node_destroy_deferred(cluster, true);
+	
 	// Destroy IP map.
 	if (cluster->ip_map) {
 		as_addr_map* entry = cluster->ip_map;
@@ -1103,6 +1269,7 @@ as_cluster_destroy(as_cluster* cluster)
 	
 	cf_free(cluster->user);
 	cf_free(cluster->password);
+	cf_free(cluster->snapshot_path);
 	
 	// Destroy cluster.
 	cf_free(cluster);
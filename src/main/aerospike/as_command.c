@@ -15,16 +15,29 @@
  * the License.
  */
 #include <aerospike/as_command.h>
+#include <aerospike/as_arena.h>
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_msgpack.h>
+#include <aerospike/as_pack.h>
+#include <aerospike/as_pipeline.h>
 #include <aerospike/as_record.h>
 #include <aerospike/as_serializer.h>
 #include <aerospike/as_socket.h>
 #include <citrusleaf/cf_clock.h>
+#include <errno.h>
+#include <poll.h>
 #include <string.h>
 
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Hazard pointer indexes used by sync commands.
+#define AS_COMMAND_HAZARD_NODE 0
+#define AS_COMMAND_HAZARD_ALT 1
+
 /******************************************************************************
  * FUNCTIONS
  *****************************************************************************/
@@ -110,6 +123,17 @@ as_command_value_size(as_val* val, as_buffer* buffer)
 		}
 		case AS_LIST:
 		case AS_MAP: {
+			uint32_t size;
+			
+			if (as_pack_size(val, &size)) {
+				// Value is packed straight into the command by as_command_write_bin().
+				// A null buffer with a size tells the writer to do so.
+				buffer->data = 0;
+				buffer->size = size;
+				return size;
+			}
+			
+			// Value contains types only the serializer handles.
 			as_serializer ser;
 			as_msgpack_init(&ser);
 			as_serializer_serialize(&ser, val, buffer);
@@ -260,6 +284,20 @@ as_command_write_key(uint8_t* p, as_policy_key policy, const as_key* key)
 	return p;
 }
 
+/**
+ *	Write list or map value sized by as_command_value_size().
+ */
+static inline uint8_t*
+as_command_write_packed(uint8_t* p, as_val* val, as_buffer* buffer)
+{
+	if (buffer->data) {
+		// Serializer fallback.
+		memcpy(p, buffer->data, buffer->size);
+		return p + buffer->size;
+	}
+	return as_pack_write(p, val);
+}
+
 uint8_t*
 as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin, as_buffer* buffer)
 {
@@ -348,15 +386,13 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 			break;
 		}
 		case AS_LIST: {
-			memcpy(p, buffer->data, buffer->size);
-			p += buffer->size;
+			p = as_command_write_packed(p, val, buffer);
 			val_len = buffer->size;
 			val_type = AS_BYTES_LIST;
 			break;
 		}
 		case AS_MAP: {
-			memcpy(p, buffer->data, buffer->size);
-			p += buffer->size;
+			p = as_command_write_packed(p, val, buffer);
 			val_len = buffer->size;
 			val_type = AS_BYTES_MAP;
 			break;
@@ -371,18 +407,332 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 	return p;
 }
 
+/**
+ *	Return size of value if it is large enough to be sent from its own memory.
+ *	Otherwise, return zero.  String length and list/map buffers must already be
+ *	set by as_command_value_size().
+ */
+static uint32_t
+as_command_value_ref(as_val* val, as_buffer* buffer, uint8_t** data, uint8_t* type)
+{
+	uint32_t len;
+	
+	switch (val->type) {
+		case AS_STRING: {
+			as_string* v = as_string_fromval(val);
+			*data = (uint8_t*)v->value;
+			*type = AS_BYTES_STRING;
+			len = (uint32_t)v->len;
+			break;
+		}
+		case AS_BYTES: {
+			as_bytes* v = as_bytes_fromval(val);
+			*data = v->value;
+			*type = v->type;
+			len = v->size;
+			break;
+		}
+		case AS_LIST:
+		case AS_MAP: {
+			if (! buffer->data) {
+				// Packed directly into the command buffer.
+				return 0;
+			}
+			*data = buffer->data;
+			*type = (val->type == AS_LIST)? AS_BYTES_LIST : AS_BYTES_MAP;
+			len = buffer->size;
+			break;
+		}
+		default: {
+			return 0;
+		}
+	}
+	return (len >= AS_COMMAND_REF_SIZE)? len : 0;
+}
+
+/**
+ *	Add command buffer bytes written since the last call to the write vector.
+ */
+static inline void
+as_command_iov_add_segment(as_command_iov* ci, uint8_t* end)
+{
+	if (end > ci->seg) {
+		struct iovec* v = &ci->iov[ci->iovcnt++];
+		v->iov_base = ci->seg;
+		v->iov_len = end - ci->seg;
+		ci->seg = end;
+	}
+}
+
+size_t
+as_command_bin_size_iov(as_command_iov* ci, const as_bin* bin, as_buffer* buffer)
+{
+	size_t size = as_command_bin_size(bin, buffer);
+	
+	if (ci->n_reserved < AS_COMMAND_REF_MAX) {
+		uint8_t* data;
+		uint8_t type;
+		uint32_t len = as_command_value_ref((as_val*)bin->valuep, buffer, &data, &type);
+		
+		if (len) {
+			ci->n_reserved++;
+			size -= len;
+		}
+	}
+	return size;
+}
+
+uint8_t*
+as_command_write_bin_iov(as_command_iov* ci, uint8_t* begin, uint8_t operation_type, const as_bin* bin,
+	as_buffer* buffer)
+{
+	uint8_t* data;
+	uint8_t val_type;
+	uint32_t val_len = 0;
+	
+	// Make the same decision as as_command_bin_size_iov().
+	if (ci->n_refs < ci->n_reserved) {
+		val_len = as_command_value_ref((as_val*)bin->valuep, buffer, &data, &val_type);
+	}
+	
+	if (! val_len) {
+		return as_command_write_bin(begin, operation_type, bin, buffer);
+	}
+	ci->n_refs++;
+	
+	uint8_t* p = begin + AS_OPERATION_HEADER_SIZE;
+	const char* name = bin->name;
+	
+	// Copy string, but do not transfer null byte.
+	while (*name) {
+		*p++ = *name++;
+	}
+	uint8_t name_len = p - begin - AS_OPERATION_HEADER_SIZE;
+	*(uint32_t*)begin = cf_swap_to_be32(name_len + val_len + 4);
+	begin += 4;
+	*begin++ = operation_type;
+	*begin++ = val_type;
+	*begin++ = 0;
+	*begin++ = name_len;
+	
+	// Value is sent from its own memory, between the bin header and whatever follows.
+	as_command_iov_add_segment(ci, p);
+	struct iovec* v = &ci->iov[ci->iovcnt++];
+	v->iov_base = data;
+	v->iov_len = val_len;
+	return p;
+}
+
+size_t
+as_command_iov_end(as_command_iov* ci, uint8_t* end)
+{
+	as_command_iov_add_segment(ci, end);
+	
+	uint64_t len = 0;
+	
+	for (int i = 0; i < ci->iovcnt; i++) {
+		len += ci->iov[i].iov_len;
+	}
+	
+	uint64_t proto = (len - 8) | (AS_MESSAGE_VERSION << 56) | (AS_MESSAGE_TYPE << 48);
+	*(uint64_t*)ci->begin = cf_swap_to_be64(proto);
+	return len;
+}
+
 as_status
 as_command_execute(as_cluster* cluster, as_error * err, as_command_node* cn, uint8_t* command, size_t command_len,
 	uint32_t timeout_ms, uint32_t retry,
 	as_parse_results_fn parse_results_fn, void* parse_results_data
 )
 {
+	struct iovec iov;
+	iov.iov_base = command;
+	iov.iov_len = command_len;
+	return as_command_execute_iov(cluster, err, cn, &iov, 1, timeout_ms, retry, parse_results_fn, parse_results_data);
+}
+
+/**
+ *	Finish attempt on node selected from the partition map.
+ */
+static inline void
+as_command_release_node(as_node* node, uint64_t begin_us, bool sample)
+{
+	if (begin_us) {
+		as_node_end_read(node, cf_getus() - begin_us, sample);
+	}
+	as_epoch_unprotect(AS_COMMAND_HAZARD_NODE);
+}
+
+/**
+ *	Reset timeout in send buffer (destined for server) to the time left before the
+ *	deadline, less the time that will be spent sleeping.  Return false if no time is left.
+ */
+static inline bool
+as_command_reset_timeout(uint8_t* command, uint64_t deadline_ms, uint32_t sleep_ms)
+{
+	int remaining_ms = (int)(deadline_ms - cf_getms() - sleep_ms);
+	
+	if (remaining_ms <= 0) {
+		return false;
+	}
+	*(uint32_t*)(command + 22) = cf_swap_to_be32(remaining_ms);
+	return true;
+}
+
+/**
+ *	Update node's circuit breaker with the result of a command.  Socket errors and
+ *	timeouts count against the node.  Any response from the server counts for it.
+ */
+static inline void
+as_command_breaker_update(as_node* node, as_status status)
+{
+	if (status == AEROSPIKE_ERR_CLIENT || status == AEROSPIKE_ERR_TIMEOUT) {
+		as_node_breaker_failure(node);
+	}
+	else {
+		as_node_breaker_success(node);
+	}
+}
+
+/**
+ *	Wait up to the hedge delay for the first node to respond to a read.  If it has not,
+ *	send the read to the other replica and keep whichever connection becomes readable
+ *	first.  The other connection is closed, which cancels its request.  Node, connection
+ *	and start times are replaced when the other replica wins, and the other replica takes
+ *	over the first node's hazard pointer.
+ */
+static void
+as_command_hedge(as_cluster* cluster, as_command_node* cn, struct iovec* iov, int iovcnt, uint64_t deadline_ms,
+	as_node** node_ptr, as_connection** conn_ptr, uint64_t* send_us, uint64_t* begin_us)
+{
+	as_node* node = *node_ptr;
+	as_connection* conn = *conn_ptr;
+	uint64_t delay_us = 0;
+	
+	if (cn->hedge_percentile) {
+		delay_us = as_node_latency_percentile(node, cn->hedge_percentile);
+	}
+	
+	if (delay_us == 0) {
+		delay_us = (uint64_t)cn->hedge_delay_ms * 1000;
+		
+		if (delay_us == 0) {
+			return;
+		}
+	}
+	
+	// Poll resolution is one millisecond, so round up.
+	uint64_t elapsed_us = cf_getus() - *send_us;
+	int wait_ms = (delay_us > elapsed_us)? (int)((delay_us - elapsed_us + 999) / 1000) : 0;
+	
+	if (deadline_ms > 0) {
+		int remaining_ms = (int)(deadline_ms - cf_getms());
+		
+		if (remaining_ms <= wait_ms) {
+			// Not enough time left for a hedged request to help.
+			return;
+		}
+	}
+	
+	struct pollfd fds[2];
+	fds[0].fd = conn->fd;
+	fds[0].events = POLLIN;
+	fds[0].revents = 0;
+	
+	if (poll(fds, 1, wait_ms) != 0) {
+		// Response arrived, socket failed or poll was interrupted.  Parse as usual.
+		return;
+	}
+	
+	as_epoch_slot* slot = as_epoch_enter(cluster->epoch);
+	as_node* alt = as_node_select_alternate(cluster, cn->ns, cn->handle, cn->digest, node);
+	
+	// Do not hedge to a node that is failing.
+	if (! alt || ck_pr_load_32(&alt->breaker_state) != AS_NODE_BREAKER_CLOSED) {
+		as_epoch_exit(slot);
+		return;
+	}
+	as_epoch_protect(AS_COMMAND_HAZARD_ALT, alt);
+	as_epoch_exit(slot);
+	
+	// Only hedge on an idle pooled connection.  Waiting for the pool or connecting
+	// would leave the first node's response unread.
+	as_connection* alt_conn;
+	
+	if (! as_node_try_connection(alt, &alt_conn)) {
+		as_epoch_unprotect(AS_COMMAND_HAZARD_ALT);
+		return;
+	}
+	
+	// Hedged request failures are not reported.  The first request is still in progress.
+	as_error err;
+	
+	uint64_t alt_send_us = cf_getus();
+	
+	if (as_connection_writev(&err, alt_conn, iov, iovcnt, deadline_ms) != AEROSPIKE_OK) {
+		as_node_close_connection(alt, alt_conn);
+		as_epoch_unprotect(AS_COMMAND_HAZARD_ALT);
+		return;
+	}
+	
+	fds[1].fd = alt_conn->fd;
+	fds[1].events = POLLIN;
+	fds[1].revents = 0;
+	
+	int timeout_ms = -1;
+	
+	if (deadline_ms > 0) {
+		timeout_ms = (int)(deadline_ms - cf_getms());
+		
+		if (timeout_ms < 0) {
+			timeout_ms = 0;
+		}
+	}
+	
+	int rv = poll(fds, 2, timeout_ms);
+	uint64_t now_us = cf_getus();
+	
+	if (rv <= 0 || (fds[0].revents & POLLIN)) {
+		// First node responded or neither did before the deadline.  Cancel hedged request.
+		// Its elapsed time is a lower bound of its latency, but still belongs in the tail.
+		as_node_add_latency(alt, now_us - alt_send_us);
+		as_node_close_connection(alt, alt_conn);
+		as_epoch_unprotect(AS_COMMAND_HAZARD_ALT);
+		return;
+	}
+	
+	// Other replica responded first or first node's socket failed.  Cancel first request.
+	as_node_add_latency(node, now_us - *send_us);
+	as_node_close_connection(node, conn);
+	
+	if (*begin_us) {
+		as_node_end_read(node, now_us - *begin_us, true);
+		as_node_begin_read(alt);
+		*begin_us = alt_send_us;
+	}
+	// Alternate stays protected while it moves to the first node's hazard.
+	as_epoch_protect(AS_COMMAND_HAZARD_NODE, alt);
+	as_epoch_unprotect(AS_COMMAND_HAZARD_ALT);
+	*node_ptr = alt;
+	*conn_ptr = alt_conn;
+	*send_us = alt_send_us;
+}
+
+as_status
+as_command_execute_iov(as_cluster* cluster, as_error * err, as_command_node* cn, struct iovec* iov, int iovcnt,
+	uint32_t timeout_ms, uint32_t retry,
+	as_parse_results_fn parse_results_fn, void* parse_results_data
+)
+{
+	// Header, including timeout, is always at the start of the first entry.
+	uint8_t* command = iov[0].iov_base;
 	uint64_t deadline_ms = as_socket_deadline(timeout_ms);
 	uint32_t sleep_between_retries_ms = 0;
 	uint32_t failed_nodes = 0;
 	uint32_t failed_conns = 0;
 	uint32_t iterations = 0;
 	bool release_node;
+	as_epoch_slot* slot = 0;
 
 	// Execute command until successful, timed out or maximum iterations have been reached.
 	while (true) {
@@ -393,22 +743,118 @@ as_command_execute(as_cluster* cluster, as_error * err, as_command_node* cn, uin
 			release_node = false;
 		}
 		else {
-			node = as_node_get(cluster, cn->ns, cn->digest, cn->write, cn->replica);
+			// The epoch keeps the selected node from being destroyed until it is reserved.
+			slot = as_epoch_enter(cluster->epoch);
+			node = as_node_select(cluster, cn->ns, cn->handle, cn->digest, cn->write, cn->replica);
 			release_node = true;
 		}
 		
 		if (!node) {
+			if (release_node) {
+				as_epoch_exit(slot);
+			}
 			failed_nodes++;
 			sleep_between_retries_ms = 10;
 			goto Retry;
 		}
 		
-		int fd;
-		as_status status = as_node_get_connection(err, node, deadline_ms, &fd);
+		if (! as_node_breaker_allow(node)) {
+			// Reads can use the other replica while the node is failing.
+			as_node* alt = 0;
+			
+			if (release_node && ! cn->write) {
+				alt = as_node_select_alternate(cluster, cn->ns, cn->handle, cn->digest, node);
+			}
+			
+			if (! alt || ! as_node_breaker_allow(alt)) {
+				ck_pr_inc_64(&cluster->breaker_rejects);
+				as_error_update(err, AEROSPIKE_ERR_NODE_UNAVAILABLE, "Node %s circuit breaker open", node->name);
+				
+				if (release_node) {
+					as_epoch_exit(slot);
+				}
+				return err->code;
+			}
+			node = alt;
+		}
+		
+		if (release_node) {
+			// Leave the epoch before any network I/O, so a slow command does not delay
+			// reclamation of retired nodes and partition tables for other threads.  The
+			// hazard pointer keeps the node from being freed without touching its shared
+			// reference count.
+			as_epoch_protect(AS_COMMAND_HAZARD_NODE, node);
+			as_epoch_exit(slot);
+		}
+		
+		// Track latency of reads that choose the fastest replica.
+		uint64_t begin_us = 0;
+		
+		if (release_node && cn->replica == AS_POLICY_REPLICA_FASTEST && ! cn->write) {
+			begin_us = cf_getus();
+			as_node_begin_read(node);
+		}
+		
+		// Hedged reads need their own connection, so the slower request can be cancelled.
+		bool hedge = release_node && ! cn->write && (cn->hedge_delay_ms || cn->hedge_percentile);
+		as_status status;
+		
+		// Only single record commands (node not preassigned) return exactly one
+		// response message and can share the node's pipeline connection.
+		if (release_node && node->pipeline && ! hedge) {
+			bool sent;
+			status = as_pipeline_execute(err, node, iov, iovcnt, deadline_ms,
+				parse_results_fn, parse_results_data, &sent);
+			
+			if (! sent) {
+				if (status) {
+					// Connection or write failure.  Retry.
+					as_node_breaker_failure(node);
+					as_command_release_node(node, begin_us, false);
+					failed_conns++;
+					sleep_between_retries_ms = 0;
+					goto Retry;
+				}
+				// Pipeline is full or busy.  Fall through to pooled connection.
+			}
+			else if (status == AEROSPIKE_ERR_TIMEOUT) {
+				as_node_breaker_failure(node);
+				as_command_release_node(node, begin_us, true);
+				sleep_between_retries_ms = 0;
+				goto Retry;
+			}
+			else if (status == AEROSPIKE_ERR_CLIENT && ! cn->write) {
+				// Connection was closed before the response was read, usually because
+				// another command on the pipeline failed.  Reads are safe to send again.
+				// Connect failures on the retry count against the node if it is down.
+				as_command_release_node(node, begin_us, false);
+				failed_conns++;
+				sleep_between_retries_ms = 0;
+				goto Retry;
+			}
+			else {
+				as_command_breaker_update(node, status);
+				
+				if (status == AEROSPIKE_OK) {
+					// Reset error code if retry had occurred.
+					if (iterations > 0) {
+						as_error_reset(err);
+					}
+				}
+				else {
+					err->code = status;
+				}
+				as_command_release_node(node, begin_us, true);
+				return status;
+			}
+		}
+		
+		as_connection* conn;
+		status = as_node_get_connection(err, node, deadline_ms, &conn);
 		
 		if (status) {
 			if (release_node) {
-				as_node_release(node);
+				as_command_release_node(node, begin_us, false);
 			}
 			failed_conns++;
 			sleep_between_retries_ms = 1;
@@ -416,21 +862,57 @@ as_command_execute(as_cluster* cluster, as_error * err, as_command_node* cn, uin
 		}
 		
 		// Send command.
-		status = as_socket_write_deadline(err, fd, command, command_len, deadline_ms);
+		uint64_t send_us = hedge ? cf_getus() : 0;
+		status = as_connection_writev(err, conn, iov, iovcnt, deadline_ms);
 		
 		if (status) {
 			// Socket errors are considered temporary anomalies.  Retry.
 			// Close socket to flush out possible garbage.	Do not put back in pool.
-			as_close(fd);
+			as_node_breaker_failure(node);
+			as_node_close_connection(node, conn);
 			if (release_node) {
-				as_node_release(node);
+				as_command_release_node(node, begin_us, false);
 			}
 			sleep_between_retries_ms = 0;
 			goto Retry;
 		}
 		
+		if (hedge) {
+			as_command_hedge(cluster, cn, iov, iovcnt, deadline_ms, &node, &conn, &send_us, &begin_us);
+		}
+		
 		// Parse results returned by server.
-		status = parse_results_fn(err, fd, deadline_ms, parse_results_data);
+		status = parse_results_fn(err, conn, deadline_ms, parse_results_data);
+		
+		if (status == AEROSPIKE_ERR_CLIENT && conn->idle) {
+			// Server closed the pooled connection.  This is not a node failure.  Each stale
+			// connection is closed, so a new connection is eventually used.
+			as_node_close_connection(node, conn);
+			if (release_node) {
+				as_command_release_node(node, begin_us, false);
+			}
+			failed_conns++;
+			sleep_between_retries_ms = 0;
+			
+			// The server may have executed a write before closing the connection, so
+			// writes are only sent again when the retry policy allows it.  Commands on a
+			// preassigned node (batch, scan, query) may also write and are treated alike.
+			if (! release_node || cn->write) {
+				goto Retry;
+			}
+			
+			// Single record reads are sent again without counting as a retry, but not past
+			// the deadline.
+			if (deadline_ms > 0 && ! as_command_reset_timeout(command, deadline_ms, 0)) {
+				break;
+			}
+			continue;
+		}
+		
+		if (hedge) {
+			as_node_add_latency(node, cf_getus() - send_us);
+		}
+		as_command_breaker_update(node, status);
 		
 		if (status == AEROSPIKE_OK) {
 			// Reset error code if retry had occurred.
@@ -442,9 +924,9 @@ as_command_execute(as_cluster* cluster, as_error * err, as_command_node* cn, uin
 			switch (status) {
 				// Retry on timeout.
 				case AEROSPIKE_ERR_TIMEOUT:
-					as_close(fd);
+					as_node_close_connection(node, conn);
 					if (release_node) {
-						as_node_release(node);
+						as_command_release_node(node, begin_us, true);
 					}
 					sleep_between_retries_ms = 0;
 					goto Retry;
@@ -454,9 +936,9 @@ as_command_execute(as_cluster* cluster, as_error * err, as_command_node* cn, uin
 				case AEROSPIKE_ERR_SCAN_ABORTED:
 				case AEROSPIKE_ERR_CLIENT_ABORT:
 				case AEROSPIKE_ERR_CLIENT:
-					as_close(fd);
+					as_node_close_connection(node, conn);
 					if (release_node) {
-						as_node_release(node);
+						as_command_release_node(node, begin_us, false);
 					}
 					err->code = status;
 					return status;
@@ -468,11 +950,11 @@ as_command_execute(as_cluster* cluster, as_error * err, as_command_node* cn, uin
 		}
 		
 		// Put connection back in pool.
-		as_node_put_connection(node, fd, cluster->conn_queue_size);
+		as_node_put_connection(node, conn, cluster->conn_queue_size);
 		
 		// Release resources.
 		if (release_node) {
-			as_node_release(node);
+			as_command_release_node(node, begin_us, true);
 		}
 		return status;
 
@@ -483,15 +965,8 @@ Retry:
 		}
 		
 		// Check for client timeout.
-		if (deadline_ms > 0) {
-			int remaining_ms = (int)(deadline_ms - cf_getms() - sleep_between_retries_ms);
-			
-			if (remaining_ms <= 0) {
-				break;
-			}
-			
-			// Reset timeout in send buffer (destined for server).
-			*(uint32_t*)(command + 22) = cf_swap_to_be32(remaining_ms);
+		if (deadline_ms > 0 && ! as_command_reset_timeout(command, deadline_ms, sleep_between_retries_ms)) {
+			break;
 		}
 		
 		if (sleep_between_retries_ms > 0) {
@@ -505,12 +980,403 @@ Retry:
 		timeout_ms, iterations, failed_nodes, failed_conns);
 }
 
+/**
+ *	Response state of one fan-out command.
+ */
+typedef struct as_fanout_state_s {
+	as_connection* conn;
+	uint8_t* buf;       // Groups larger than the connection buffer.
+	size_t capacity;
+	size_t pos;
+	size_t size;        // Size of current group.
+	bool header;        // Reading group header.
+	bool deferred;      // Waiting for a connection to a node at its connection limit.
+} as_fanout_state;
+
+/**
+ *	Read available bytes without blocking.  Return AEROSPIKE_OK and zero bytes when the
+ *	socket has no more data.
+ */
+static as_status
+as_fanout_recv(as_error* err, int fd, uint8_t* buf, size_t len, size_t* bytes_read)
+{
+	while (true) {
+		ssize_t bytes = recv(fd, buf, len, 0);
+		
+		if (bytes > 0) {
+			*bytes_read = bytes;
+			return AEROSPIKE_OK;
+		}
+		
+		if (bytes == 0) {
+			// We believe this means that the server has closed this socket.
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+		
+		if (errno == EINTR) {
+			continue;
+		}
+		
+		if (errno != EWOULDBLOCK && errno != EAGAIN) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read error: %d", errno);
+		}
+		*bytes_read = 0;
+		return AEROSPIKE_OK;
+	}
+}
+
+/**
+ *	Parse all complete groups that can be read from the connection without blocking.
+ *	Return AEROSPIKE_OK when more data is needed, AEROSPIKE_NO_MORE_RECORDS when the
+ *	response is complete, or an error.
+ */
+static as_status
+as_fanout_read(as_error* err, as_fanout_state* st, as_parse_group_fn parse_group_fn, void* parse_data)
+{
+	as_connection* conn = st->conn;
+	
+	while (true) {
+		size_t need = st->header ? sizeof(as_proto) : st->size;
+		uint8_t* buf;
+		size_t bytes_read;
+		as_status status;
+		
+		if (need <= AS_CONNECTION_BUFFER_SIZE) {
+			// Parse directly from connection buffer.
+			size_t avail = conn->length - conn->offset;
+			
+			if (avail < need) {
+				if (conn->offset + need > AS_CONNECTION_BUFFER_SIZE) {
+					// Move partial data to front of buffer so the full range fits.
+					memmove(conn->buf, conn->buf + conn->offset, avail);
+					conn->offset = 0;
+					conn->length = (uint32_t)avail;
+				}
+				
+				status = as_fanout_recv(err, conn->fd, conn->buf + conn->length,
+					AS_CONNECTION_BUFFER_SIZE - conn->length, &bytes_read);
+				
+				if (status || bytes_read == 0) {
+					return status;
+				}
+				conn->length += (uint32_t)bytes_read;
+				continue;
+			}
+			buf = conn->buf + conn->offset;
+			conn->offset += (uint32_t)need;
+		}
+		else {
+			if (st->pos < need) {
+				status = as_fanout_recv(err, conn->fd, st->buf + st->pos, need - st->pos, &bytes_read);
+				
+				if (status || bytes_read == 0) {
+					return status;
+				}
+				st->pos += bytes_read;
+				continue;
+			}
+			buf = st->buf;
+		}
+		
+		if (st->header) {
+			as_proto proto;
+			memcpy(&proto, buf, sizeof(as_proto));
+			as_proto_swap_from_be(&proto);
+			st->size = proto.sz;
+			
+			if (st->size == 0) {
+				continue;
+			}
+			st->header = false;
+			
+			if (st->size > AS_CONNECTION_BUFFER_SIZE) {
+				// Prepare buffer.  Extra byte lets borrowed parsing terminate the last
+				// string in place.
+				if (st->size > st->capacity) {
+					cf_free(st->buf);
+					st->capacity = st->size;
+					st->buf = cf_malloc(st->capacity + 1);
+				}
+				
+				// Start with bytes already read into the connection buffer.
+				st->pos = conn->length - conn->offset;
+				memcpy(st->buf, conn->buf + conn->offset, st->pos);
+				conn->offset = 0;
+				conn->length = 0;
+			}
+			continue;
+		}
+		
+		st->header = true;
+		status = parse_group_fn(err, buf, st->size, parse_data);
+		
+		if (status) {
+			return status;
+		}
+	}
+}
+
+/**
+ *	Record command failure.  The first failure is returned to the caller.
+ */
+static inline void
+as_fanout_set_error(as_error* err, as_status* status, as_command_fanout* command, as_error* cmd_err)
+{
+	command->status = cmd_err->code;
+	
+	if (*status == AEROSPIKE_OK) {
+		*status = cmd_err->code;
+		as_error_copy(err, cmd_err);
+	}
+}
+
+/**
+ *	Get connection for fan-out command and send it.  If wait is false and the node is at
+ *	its connection limit, the command is marked deferred and not sent.
+ */
+static as_status
+as_fanout_send(as_error* err, as_command_fanout* command, as_fanout_state* st, uint64_t deadline_ms, bool wait)
+{
+	as_node* node = command->node;
+	as_status status = (wait)? as_node_get_connection(err, node, deadline_ms, &st->conn) :
+		as_node_get_connection_nowait(err, node, deadline_ms, &st->conn);
+	
+	if (status) {
+		st->conn = 0;
+		st->deferred = false;
+		return status;
+	}
+	
+	st->deferred = (st->conn == 0);
+	
+	if (st->deferred) {
+		return AEROSPIKE_OK;
+	}
+	
+	status = as_connection_write(err, st->conn, command->command, command->command_len, deadline_ms);
+	
+	if (status) {
+		as_node_breaker_failure(node);
+		as_node_close_connection(node, st->conn);
+		st->conn = 0;
+		return status;
+	}
+	st->header = true;
+	return AEROSPIKE_OK;
+}
+
+as_status
+as_command_execute_fanout(as_cluster* cluster, as_error* err, as_command_fanout* commands, uint32_t n_commands,
+	uint32_t timeout_ms, as_parse_group_fn parse_group_fn, bool abort_on_error)
+{
+	uint64_t deadline_ms = as_socket_deadline(timeout_ms);
+	as_fanout_state* states = cf_malloc(sizeof(as_fanout_state) * n_commands);
+	struct pollfd* fds = cf_malloc(sizeof(struct pollfd) * n_commands);
+	uint32_t* indexes = cf_malloc(sizeof(uint32_t) * n_commands);
+	uint32_t n_pending = 0;
+	uint32_t n_deferred = 0;
+	bool abort = false;
+	as_status status = AEROSPIKE_OK;
+	as_error cmd_err;
+	
+	memset(states, 0, sizeof(as_fanout_state) * n_commands);
+	
+	for (uint32_t i = 0; i < n_commands; i++) {
+		commands[i].status = AEROSPIKE_ERR_CLIENT_ABORT;
+	}
+	
+	// Send all commands before waiting for any response.  Commands for nodes at their
+	// connection limit are deferred.  Waiting for the pool while holding connections
+	// could wait on connections that only this caller can return.
+	for (uint32_t i = 0; i < n_commands && ! abort; i++) {
+		as_command_fanout* command = &commands[i];
+		as_node* node = command->node;
+		
+		as_error_init(&cmd_err);
+		
+		if (! as_node_breaker_allow(node)) {
+			ck_pr_inc_64(&cluster->breaker_rejects);
+			as_error_update(&cmd_err, AEROSPIKE_ERR_NODE_UNAVAILABLE, "Node %s circuit breaker open", node->name);
+			as_fanout_set_error(err, &status, command, &cmd_err);
+			abort = abort_on_error;
+			continue;
+		}
+		
+		if (as_fanout_send(&cmd_err, command, &states[i], deadline_ms, false)) {
+			as_fanout_set_error(err, &status, command, &cmd_err);
+			abort = abort_on_error;
+			continue;
+		}
+		
+		if (states[i].deferred) {
+			n_deferred++;
+		}
+		else {
+			n_pending++;
+		}
+	}
+	
+	// Parse responses in the order they arrive.
+	while (! abort && (n_pending > 0 || n_deferred > 0)) {
+		if (n_pending == 0) {
+			// No connections are held, so waiting for one can not block other callers.
+			for (uint32_t i = 0; i < n_commands; i++) {
+				if (states[i].deferred) {
+					n_deferred--;
+					as_error_init(&cmd_err);
+					
+					if (as_fanout_send(&cmd_err, &commands[i], &states[i], deadline_ms, true)) {
+						as_fanout_set_error(err, &status, &commands[i], &cmd_err);
+						abort = abort_on_error;
+					}
+					else {
+						n_pending++;
+					}
+					break;
+				}
+			}
+			continue;
+		}
+		
+		int wait_ms = -1;
+		
+		if (deadline_ms > 0) {
+			int64_t remaining = (int64_t)(deadline_ms - cf_getms());
+			
+			if (remaining <= 0) {
+				// Fail each command that has not completed.
+				as_error_init(&cmd_err);
+				as_error_update(&cmd_err, AEROSPIKE_ERR_TIMEOUT, "Client timeout: timeout=%u nodes=%u pending=%u",
+					timeout_ms, n_commands, n_pending + n_deferred);
+				
+				for (uint32_t i = 0; i < n_commands; i++) {
+					if (states[i].conn) {
+						as_node_breaker_failure(commands[i].node);
+						as_fanout_set_error(err, &status, &commands[i], &cmd_err);
+					}
+					else if (states[i].deferred) {
+						as_fanout_set_error(err, &status, &commands[i], &cmd_err);
+					}
+				}
+				break;
+			}
+			wait_ms = (int)remaining;
+		}
+		
+		uint32_t n_fds = 0;
+		
+		for (uint32_t i = 0; i < n_commands; i++) {
+			if (states[i].conn) {
+				fds[n_fds].fd = states[i].conn->fd;
+				fds[n_fds].events = POLLIN;
+				fds[n_fds].revents = 0;
+				indexes[n_fds++] = i;
+			}
+		}
+		
+		int rv = poll(fds, n_fds, wait_ms);
+		
+		if (rv < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			as_error_init(&cmd_err);
+			as_error_update(&cmd_err, AEROSPIKE_ERR_CLIENT, "Poll failed: %d", errno);
+			
+			if (status == AEROSPIKE_OK) {
+				status = cmd_err.code;
+				as_error_copy(err, &cmd_err);
+			}
+			break;
+		}
+		
+		bool completed = false;
+		
+		for (uint32_t j = 0; j < n_fds && rv > 0 && ! abort; j++) {
+			if (! fds[j].revents) {
+				continue;
+			}
+			rv--;
+			
+			uint32_t i = indexes[j];
+			as_command_fanout* command = &commands[i];
+			as_node* node = command->node;
+			as_fanout_state* st = &states[i];
+			
+			as_error_init(&cmd_err);
+			as_status rc = as_fanout_read(&cmd_err, st, parse_group_fn, command->parse_data);
+			
+			if (rc == AEROSPIKE_OK) {
+				// Wait for more data.
+				continue;
+			}
+			
+			n_pending--;
+			completed = true;
+			
+			if (rc == AEROSPIKE_NO_MORE_RECORDS) {
+				as_node_breaker_success(node);
+				as_node_put_connection(node, st->conn, cluster->conn_queue_size);
+				st->conn = 0;
+				command->status = AEROSPIKE_OK;
+				continue;
+			}
+			
+			// Errors can leave unread data in the socket, so close the connection.
+			as_command_breaker_update(node, rc);
+			as_node_close_connection(node, st->conn);
+			st->conn = 0;
+			cmd_err.code = rc;
+			as_fanout_set_error(err, &status, command, &cmd_err);
+			abort = abort_on_error || rc == AEROSPIKE_ERR_CLIENT_ABORT;
+		}
+		
+		if (! completed || n_deferred == 0) {
+			continue;
+		}
+		
+		// Completed commands returned connections.  Send deferred commands that can now
+		// get one.
+		for (uint32_t i = 0; i < n_commands && ! abort; i++) {
+			if (! states[i].deferred) {
+				continue;
+			}
+			
+			as_error_init(&cmd_err);
+			
+			if (as_fanout_send(&cmd_err, &commands[i], &states[i], deadline_ms, false)) {
+				n_deferred--;
+				as_fanout_set_error(err, &status, &commands[i], &cmd_err);
+				abort = abort_on_error;
+			}
+			else if (! states[i].deferred) {
+				n_deferred--;
+				n_pending++;
+			}
+		}
+	}
+	
+	// Close connections of commands that have not completed.
+	for (uint32_t i = 0; i < n_commands; i++) {
+		as_fanout_state* st = &states[i];
+		
+		if (st->conn) {
+			as_node_close_connection(commands[i].node, st->conn);
+		}
+		cf_free(st->buf);
+	}
+	cf_free(states);
+	cf_free(fds);
+	cf_free(indexes);
+	return status;
+}
+
 as_status
-as_command_parse_header(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+as_command_parse_header(as_error* err, as_connection* conn, uint64_t deadline_ms, void* user_data)
 {
 	// Read header
 	as_proto_msg* msg = user_data;
-	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)msg, sizeof(as_proto_msg), deadline_ms);
+	as_status status = as_connection_read(err, conn, (uint8_t*)msg, sizeof(as_proto_msg), deadline_ms);
 	
 	if (status) {
 		return status;
@@ -522,18 +1388,18 @@ as_command_parse_header(as_error* err, int fd, uint64_t deadline_ms, void* user_
 	size_t size = msg->proto.sz  - msg->m.header_sz;
 	
 	if (size > 0) {
-		as_log_warn("Unexpected data received from socket after a write: fd=%d size=%zu", fd, size);
+		as_log_warn("Unexpected data received from socket after a write: fd=%d size=%zu", conn->fd, size);
 		
 		// Verify size is not corrupted.
 		if (size > 100000) {
 			// The socket will be closed on this error, so we don't have to worry about emptying it.
 			return as_error_update(err, AEROSPIKE_ERR_CLIENT,
-				"Unexpected data received from socket after a write: fd=%d size=%zu", fd, size);
+				"Unexpected data received from socket after a write: fd=%d size=%zu", conn->fd, size);
 		}
 		
 		// Empty socket.
 		uint8_t* buf = cf_malloc(size);
-		status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
+		status = as_connection_read(err, conn, buf, size, deadline_ms);
 		cf_free(buf);
 		
 		if (status) {
@@ -606,6 +1472,15 @@ as_command_ignore_fields(uint8_t* p, uint32_t n_fields)
 	return p;
 }
 
+uint8_t*
+as_command_ignore_bins(uint8_t* p, uint32_t n_bins)
+{
+	for (uint32_t i = 0; i < n_bins; i++) {
+		p += cf_swap_from_be32(*(uint32_t*)p) + 4;
+	}
+	return p;
+}
+
 uint8_t*
 as_command_parse_key(uint8_t* p, uint32_t n_fields, as_key* key)
 {
@@ -857,14 +1732,46 @@ as_command_parse_udf_failure(uint8_t* p, as_error* err, as_msg* msg, as_status s
 	return as_error_set_message(err, status, as_error_string(status));
 }
 
+/**
+ *	Allocate value memory from record arena space if available.
+ */
+static inline void*
+as_command_value_alloc(uint8_t** heap, size_t size, bool* free)
+{
+	if (*heap) {
+		void* p = *heap;
+		*heap += size;
+		*free = false;
+		return p;
+	}
+	*free = true;
+	return malloc(size);
+}
+
 uint8_t*
-as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize)
+as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize, bool borrow)
 {
 	as_bin* bin = rec->bins.entries;
+	uint8_t* term = 0;
+	uint8_t* heap = 0;
+	bool free;
+	
+	if (rec->arena && ! borrow) {
+		// Reserve arena space for all values at once.  Values never take more
+		// room than their bins on the wire, including terminators.
+		heap = as_arena_alloc(rec->arena, as_command_ignore_bins(p, n_bins) - p);
+	}
 	
 	// Parse bins
 	for (uint32_t i = 0; i < n_bins; i++, bin++) {
 		uint32_t op_size = cf_swap_from_be32(*(uint32_t*)p);
+		
+		if (term) {
+			// Size of this bin has been read, so the previous borrowed string can be
+			// terminated in place.
+			*term = 0;
+			term = 0;
+		}
 		p += 5;
 		uint8_t type = *p;
 		p += 2;
@@ -897,10 +1804,16 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 				break;
 			}
 			case AS_BYTES_STRING: {
-				char* value = malloc(value_size + 1);
-				memcpy(value, p, value_size);
-				value[value_size] = 0;
-				as_string_init_wlen((as_string*)&bin->value, (char*)value, value_size, true);
+				if (borrow) {
+					as_string_init_wlen((as_string*)&bin->value, (char*)p, value_size, false);
+					term = p + value_size;
+				}
+				else {
+					char* value = as_command_value_alloc(&heap, value_size + 1, &free);
+					memcpy(value, p, value_size);
+					value[value_size] = 0;
+					as_string_init_wlen((as_string*)&bin->value, (char*)value, value_size, free);
+				}
 				bin->valuep = &bin->value;
 				break;
 			}
@@ -919,11 +1832,18 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 
 				// Use the json bytes.
 				size_t jsonsz = value_size - 1 - 2 - (ncells * sizeof(uint64_t));
-				char* v = malloc(jsonsz + 1);
-				memcpy(v, ptr, jsonsz);
-				v[jsonsz] = 0;
-				as_geojson_init_wlen((as_geojson*)&bin->value,
-									 (char*)v, jsonsz, true);
+				
+				if (borrow) {
+					as_geojson_init_wlen((as_geojson*)&bin->value, (char*)ptr, jsonsz, false);
+					term = ptr + jsonsz;
+				}
+				else {
+					char* v = as_command_value_alloc(&heap, jsonsz + 1, &free);
+					memcpy(v, ptr, jsonsz);
+					v[jsonsz] = 0;
+					as_geojson_init_wlen((as_geojson*)&bin->value,
+										 (char*)v, jsonsz, free);
+				}
 				bin->valuep = &bin->value;
 				break;
 			}
@@ -944,19 +1864,29 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 					
 					bin->valuep = (as_bin_value*)value;
 				}
+				else if (borrow) {
+					as_bytes_init_wrap((as_bytes*)&bin->value, p, value_size, false);
+					bin->value.bytes.type = (as_bytes_type)type;
+					bin->valuep = &bin->value;
+				}
 				else {
-					void* value = malloc(value_size);
+					void* value = as_command_value_alloc(&heap, value_size, &free);
 					memcpy(value, p, value_size);
-					as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, true);
+					as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, free);
 					bin->value.bytes.type = (as_bytes_type)type;
 					bin->valuep = &bin->value;
 				}
 				break;
 			}
 			default: {
-				void* value = malloc(value_size);
-				memcpy(value, p, value_size);
-				as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, true);
+				if (borrow) {
+					as_bytes_init_wrap((as_bytes*)&bin->value, p, value_size, false);
+				}
+				else {
+					void* value = as_command_value_alloc(&heap, value_size, &free);
+					memcpy(value, p, value_size);
+					as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, free);
+				}
 				bin->value.bytes.type = (as_bytes_type)type;
 				bin->valuep = &bin->value;
 				break;
@@ -965,71 +1895,55 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 		rec->bins.size++;
 		p += value_size;
 	}
+	
+	if (term) {
+		*term = 0;
+	}
 	return p;
 }
 
 as_status
-as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+as_command_parse_result_buf(as_error* err, as_msg* msg, uint8_t* buf, void* user_data)
 {
-	// Read header
-	as_proto_msg msg;
-	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
-	
-	if (status) {
-		return status;
-	}
-	
-	as_proto_swap_from_be(&msg.proto);
-	as_msg_swap_header_from_be(&msg.m);
-	size_t size = msg.proto.sz	- msg.m.header_sz;
-	uint8_t* buf = 0;
-	
-	if (size > 0) {
-		// Read remaining message bytes.
-		buf = as_command_init(size);
-		status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
-		
-		if (status) {
-			as_command_free(buf, size);
-			return status;
-		}
-	}
-	
 	// Parse result code and record.
-	status = msg.m.result_code;
+	as_status status = msg->result_code;
 	as_command_parse_result_data* data = user_data;
 	
 	switch (status) {
 		case AEROSPIKE_OK: {
 			if (data->record) {
 				as_record* rec = *data->record;
+				uint8_t* p = as_command_ignore_fields(buf, msg->n_fields);
 				
 				if (rec) {
-					if (msg.m.n_ops > rec->bins.capacity) {
+					if (msg->n_ops > rec->bins.capacity) {
 						if (rec->bins._free) {
 							free(rec->bins.entries);
 						}
-						rec->bins.capacity = msg.m.n_ops;
+						rec->bins.capacity = msg->n_ops;
 						rec->bins.size = 0;
-						rec->bins.entries = malloc(sizeof(as_bin) * msg.m.n_ops);
+						rec->bins.entries = malloc(sizeof(as_bin) * msg->n_ops);
 						rec->bins._free = true;
 					}
 				}
 				else {
-					rec = as_record_new(msg.m.n_ops);
+					// Bins array and values share the record's allocation.
+					size_t size = as_command_ignore_bins(p, msg->n_ops) - p;
+					rec = as_record_new_arena(msg->n_ops, size);
 					*data->record = rec;
 				}
-				rec->gen = msg.m.generation;
-				rec->ttl = cf_server_void_time_to_ttl(msg.m.record_ttl);
+				rec->gen = msg->generation;
+				rec->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
 				
-				uint8_t* p = as_command_ignore_fields(buf, msg.m.n_fields);
-				as_command_parse_bins(rec, p, msg.m.n_ops, data->deserialize);
+				// Lazy records keep lists and maps packed until first access.
+				rec->lazy = data->deserialize && data->lazy;
+				as_command_parse_bins(rec, p, msg->n_ops, data->deserialize && ! rec->lazy, false);
 			}
 			break;
 		}
 			
 		case AEROSPIKE_ERR_UDF: {
-			status = as_command_parse_udf_failure(buf, err, &msg.m, status);
+			status = as_command_parse_udf_failure(buf, err, msg, status);
 			break;
 		}
 			
@@ -1037,16 +1951,15 @@ as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_
 			as_error_set_message(err, status, as_error_string(status));
 			break;
 	}
-	as_command_free(buf, size);
 	return status;
 }
 
 as_status
-as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+as_command_parse_result(as_error* err, as_connection* conn, uint64_t deadline_ms, void* user_data)
 {
 	// Read header
 	as_proto_msg msg;
-	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
+	as_status status = as_connection_read(err, conn, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
 	
 	if (status) {
 		return status;
@@ -1057,26 +1970,44 @@ as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, vo
 	size_t size = msg.proto.sz	- msg.m.header_sz;
 	uint8_t* buf = 0;
 	
-	if (size > 0) {
-		// Read remaining message bytes.
-		buf = as_command_init(size);
-		status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
-		
-		if (status) {
-			as_command_free(buf, size);
-			return status;
+	if (size <= AS_CONNECTION_BUFFER_SIZE) {
+		// Parse directly from connection buffer.
+		if (size > 0) {
+			status = as_connection_read_ptr(err, conn, size, deadline_ms, &buf);
+			
+			if (status) {
+				return status;
+			}
 		}
+		return as_command_parse_result_buf(err, &msg.m, buf, user_data);
+	}
+	
+	// Read remaining message bytes.
+	buf = as_command_init(size);
+	status = as_connection_read(err, conn, buf, size, deadline_ms);
+	
+	if (status) {
+		as_command_free(buf, size);
+		return status;
 	}
 	
+	status = as_command_parse_result_buf(err, &msg.m, buf, user_data);
+	as_command_free(buf, size);
+	return status;
+}
+
+as_status
+as_command_parse_success_failure_buf(as_error* err, as_msg* msg, uint8_t* buf, void* user_data)
+{
 	as_val** val = user_data;
 	
 	// Parse result code and record.
-	status = msg.m.result_code;
+	as_status status = msg->result_code;
 	
 	switch (status) {
 		case AEROSPIKE_OK: {
 			uint8_t* p = buf;
-			status = as_command_parse_success_failure_bins(&p, err, &msg.m, val);
+			status = as_command_parse_success_failure_bins(&p, err, msg, val);
 			
 			if (status != AEROSPIKE_OK) {
 				if (val) {
@@ -1087,7 +2018,7 @@ as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, vo
 		}
 			
 		case AEROSPIKE_ERR_UDF: {
-			status = as_command_parse_udf_failure(buf, err, &msg.m, status);
+			status = as_command_parse_udf_failure(buf, err, msg, status);
 			if (val) {
 				*val = 0;
 			}
@@ -1101,6 +2032,47 @@ as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, vo
 			}
 			break;
 	}
+	return status;
+}
+
+as_status
+as_command_parse_success_failure(as_error* err, as_connection* conn, uint64_t deadline_ms, void* user_data)
+{
+	// Read header
+	as_proto_msg msg;
+	as_status status = as_connection_read(err, conn, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
+	
+	if (status) {
+		return status;
+	}
+	
+	as_proto_swap_from_be(&msg.proto);
+	as_msg_swap_header_from_be(&msg.m);
+	size_t size = msg.proto.sz	- msg.m.header_sz;
+	uint8_t* buf = 0;
+	
+	if (size <= AS_CONNECTION_BUFFER_SIZE) {
+		// Parse directly from connection buffer.
+		if (size > 0) {
+			status = as_connection_read_ptr(err, conn, size, deadline_ms, &buf);
+			
+			if (status) {
+				return status;
+			}
+		}
+		return as_command_parse_success_failure_buf(err, &msg.m, buf, user_data);
+	}
+	
+	// Read remaining message bytes.
+	buf = as_command_init(size);
+	status = as_connection_read(err, conn, buf, size, deadline_ms);
+	
+	if (status) {
+		as_command_free(buf, size);
+		return status;
+	}
+	
+	status = as_command_parse_success_failure_buf(err, &msg.m, buf, user_data);
 	as_command_free(buf, size);
 	return status;
 }
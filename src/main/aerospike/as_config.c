@@ -39,9 +39,18 @@ as_config * as_config_init(as_config * c)
 	c->ip_map_size = 0;
 	c->max_threads = 100;
 	c->max_socket_idle_sec = 14;
+	c->conn_validate_ms = 1000;
+	c->max_conns_per_node = 0;
+	c->min_conns_per_node = 0;
+	c->breaker_errors = 0;
+	c->breaker_open_ms = 1000;
 	c->conn_timeout_ms = 3000;
 	c->tender_interval = 3000;
 	c->thread_pool_size = 16;
+	c->event_loop_size = 0;
+	c->event_loop_external = false;
+	c->async_max_conns_per_node = 0;
+	c->pipeline_depth = 0;
 	c->hosts_size = 0;
 	memset(c->user, 0, sizeof(c->user));
 	memset(c->password, 0, sizeof(c->password));
@@ -57,6 +66,7 @@ as_config * as_config_init(as_config * c)
 	c->shm_max_nodes = 16;
 	c->shm_max_namespaces = 8;
 	c->shm_takeover_threshold_sec = 30;
+	c->warm_start_path[0] = 0;
 	return c;
 }
 
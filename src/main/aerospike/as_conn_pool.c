@@ -0,0 +1,382 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_conn_pool.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <string.h>
+#include <sys/time.h>
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+// Slot index plus one of the current thread.  Zero means not assigned yet.
+static __thread uint32_t as_conn_pool_thread_slot = 0;
+
+// Number of slot indexes handed out so far.
+static uint32_t as_conn_pool_thread_count = 0;
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Push connection to shared queue.  Return false if queue is full.
+ */
+static bool
+as_conn_pool_queue_push(as_conn_pool* pool, as_connection* conn)
+{
+	uint64_t pos = ck_pr_load_64(&pool->tail);
+	as_conn_pool_cell* cell;
+
+	while (true) {
+		cell = &pool->cells[pos & pool->mask];
+		uint64_t seq = ck_pr_load_64(&cell->seq);
+		ck_pr_fence_load();
+		int64_t dif = (int64_t)(seq - pos);
+
+		if (dif == 0) {
+			// Cell is free for this position.  Claim it.
+			if (ck_pr_cas_64(&pool->tail, pos, pos + 1)) {
+				break;
+			}
+			pos = ck_pr_load_64(&pool->tail);
+		}
+		else if (dif < 0) {
+			// Cell still holds the connection from one lap ago.
+			return false;
+		}
+		else {
+			// Another producer claimed this position.
+			pos = ck_pr_load_64(&pool->tail);
+		}
+	}
+
+	cell->conn = conn;
+	ck_pr_fence_store();
+	ck_pr_store_64(&cell->seq, pos + 1);
+	return true;
+}
+
+/**
+ *	Pop connection from shared queue.  Return false if queue is empty.
+ */
+static bool
+as_conn_pool_queue_pop(as_conn_pool* pool, as_connection** conn)
+{
+	uint64_t pos = ck_pr_load_64(&pool->head);
+	as_conn_pool_cell* cell;
+
+	while (true) {
+		cell = &pool->cells[pos & pool->mask];
+		uint64_t seq = ck_pr_load_64(&cell->seq);
+		ck_pr_fence_load();
+		int64_t dif = (int64_t)(seq - (pos + 1));
+
+		if (dif == 0) {
+			// Cell holds a connection for this position.  Claim it.
+			if (ck_pr_cas_64(&pool->head, pos, pos + 1)) {
+				break;
+			}
+			pos = ck_pr_load_64(&pool->head);
+		}
+		else if (dif < 0) {
+			// Producer has not filled this position yet.
+			return false;
+		}
+		else {
+			// Another consumer claimed this position.
+			pos = ck_pr_load_64(&pool->head);
+		}
+	}
+
+	*conn = cell->conn;
+
+	// Connection must be read before the cell is handed back to producers.
+	ck_pr_fence_memory();
+	ck_pr_store_64(&cell->seq, pos + pool->mask + 1);
+	return true;
+}
+
+/**
+ *	Wake one waiting thread, if any.
+ */
+static inline void
+as_conn_pool_signal(as_conn_pool* pool)
+{
+	// Waiters register before re-checking the pool under the lock, so a waiter
+	// either sees the change or is already blocked when signaled.  The change
+	// may be a plain store (queue push), which can otherwise be reordered after
+	// the waiters load.
+	ck_pr_fence_memory();
+
+	if (ck_pr_load_32(&pool->waiters)) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_signal(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+void
+as_conn_pool_init(as_conn_pool* pool, uint32_t capacity, uint32_t max)
+{
+	uint32_t size = 2;
+
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	memset(pool->slots, 0, sizeof(pool->slots));
+	pool->cells = cf_malloc(sizeof(as_conn_pool_cell) * size);
+
+	for (uint32_t i = 0; i < size; i++) {
+		pool->cells[i].seq = i;
+		pool->cells[i].conn = 0;
+	}
+	pool->head = 0;
+	pool->tail = 0;
+	pool->size = 0;
+	pool->mask = size - 1;
+	pool->total = 0;
+	pool->max = max;
+	pool->waiters = 0;
+	pthread_mutex_init(&pool->lock, 0);
+	pthread_cond_init(&pool->cond, 0);
+}
+
+void
+as_conn_pool_destroy(as_conn_pool* pool)
+{
+	as_connection* conn;
+
+	while (as_conn_pool_get(pool, &conn)) {
+		as_connection_close(conn);
+	}
+	cf_free(pool->cells);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+as_conn_pool_slot*
+as_conn_pool_slot_current(as_conn_pool* pool)
+{
+	uint32_t index = as_conn_pool_thread_slot;
+
+	if (index == 0) {
+		index = ck_pr_faa_32(&as_conn_pool_thread_count, 1) % AS_CONN_POOL_SLOTS + 1;
+		as_conn_pool_thread_slot = index;
+	}
+	return &pool->slots[index - 1];
+}
+
+bool
+as_conn_pool_get(as_conn_pool* pool, as_connection** conn)
+{
+	as_conn_pool_slot* slot = as_conn_pool_slot_current(pool);
+
+	if (ck_pr_load_ptr(&slot->conn)) {
+		as_connection* c = ck_pr_fas_ptr(&slot->conn, 0);
+
+		if (c) {
+			*conn = c;
+			ck_pr_dec_32(&pool->size);
+			ck_pr_inc_64(&slot->stats.hits);
+			return true;
+		}
+	}
+
+	if (as_conn_pool_queue_pop(pool, conn)) {
+		ck_pr_dec_32(&pool->size);
+		ck_pr_inc_64(&slot->stats.hits);
+		return true;
+	}
+
+	// Take a connection cached by another thread before reporting the pool empty.
+	// This is only reached on a miss, which is followed by a connect anyway.
+	for (uint32_t i = 0; i < AS_CONN_POOL_SLOTS; i++) {
+		as_conn_pool_slot* other = &pool->slots[i];
+
+		if (ck_pr_load_ptr(&other->conn)) {
+			as_connection* c = ck_pr_fas_ptr(&other->conn, 0);
+
+			if (c) {
+				*conn = c;
+				ck_pr_dec_32(&pool->size);
+				ck_pr_inc_64(&slot->stats.hits);
+				return true;
+			}
+		}
+	}
+
+	ck_pr_inc_64(&slot->stats.misses);
+	return false;
+}
+
+bool
+as_conn_pool_put(as_conn_pool* pool, as_connection* conn, uint32_t limit)
+{
+	as_conn_pool_slot* slot = as_conn_pool_slot_current(pool);
+
+	// Reserve room first so concurrent puts can not overshoot the limit.
+	if (ck_pr_faa_32(&pool->size, 1) < limit) {
+		if ((! ck_pr_load_ptr(&slot->conn) && ck_pr_cas_ptr(&slot->conn, 0, conn)) ||
+			as_conn_pool_queue_push(pool, conn)) {
+			as_conn_pool_signal(pool);
+			return true;
+		}
+	}
+
+	ck_pr_dec_32(&pool->size);
+	ck_pr_inc_64(&slot->stats.discards);
+	return false;
+}
+
+void
+as_conn_pool_release(as_conn_pool* pool)
+{
+	if (pool->max == 0) {
+		// Reservations are not counted.
+		return;
+	}
+	ck_pr_dec_32(&pool->total);
+	as_conn_pool_signal(pool);
+}
+
+bool
+as_conn_pool_wait(as_conn_pool* pool, uint64_t deadline_ms, as_connection** conn)
+{
+	as_conn_pool_slot* slot = as_conn_pool_slot_current(pool);
+	uint64_t begin = cf_getms();
+	bool found = false;
+
+	pthread_mutex_lock(&pool->lock);
+	ck_pr_inc_32(&pool->waiters);
+
+	while (true) {
+		if (as_conn_pool_get(pool, conn)) {
+			found = true;
+			break;
+		}
+
+		if (as_conn_pool_reserve(pool)) {
+			*conn = 0;
+			found = true;
+			break;
+		}
+
+		if (deadline_ms == 0) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+
+		uint64_t now = cf_getms();
+
+		if (now >= deadline_ms) {
+			break;
+		}
+
+		// cf_getms() is not wall clock time, so convert remaining time to an absolute wall clock time.
+		uint64_t remaining_ms = deadline_ms - now;
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+
+		uint64_t ns = (uint64_t)tv.tv_usec * 1000 + (remaining_ms % 1000) * 1000000;
+		struct timespec ts;
+		ts.tv_sec = tv.tv_sec + (remaining_ms / 1000) + (ns / 1000000000);
+		ts.tv_nsec = ns % 1000000000;
+
+		pthread_cond_timedwait(&pool->cond, &pool->lock, &ts);
+	}
+
+	ck_pr_dec_32(&pool->waiters);
+	pthread_mutex_unlock(&pool->lock);
+
+	ck_pr_inc_64(&slot->stats.waits);
+	ck_pr_add_64(&slot->stats.wait_time_ms, cf_getms() - begin);
+	return found;
+}
+
+uint32_t
+as_conn_pool_close_idle(as_conn_pool* pool, uint64_t used_before_ms)
+{
+	as_connection* conn;
+	uint32_t closed = 0;
+
+	// Cache slots.  Fresh connections are put back, or queued if the slot has been refilled.
+	for (uint32_t i = 0; i < AS_CONN_POOL_SLOTS; i++) {
+		as_conn_pool_slot* slot = &pool->slots[i];
+
+		if (! ck_pr_load_ptr(&slot->conn)) {
+			continue;
+		}
+
+		conn = ck_pr_fas_ptr(&slot->conn, 0);
+
+		if (! conn) {
+			continue;
+		}
+
+		if (conn->last_used >= used_before_ms &&
+			(ck_pr_cas_ptr(&slot->conn, 0, conn) || as_conn_pool_queue_push(pool, conn))) {
+			continue;
+		}
+
+		ck_pr_dec_32(&pool->size);
+		as_conn_pool_close(pool, conn);
+		closed++;
+	}
+
+	// Shared queue.  Fresh connections are pushed back to the tail, so bound the
+	// scan by the number of entries queued at the start.
+	uint64_t count = ck_pr_load_64(&pool->tail) - ck_pr_load_64(&pool->head);
+
+	for (uint64_t i = 0; i < count; i++) {
+		if (! as_conn_pool_queue_pop(pool, &conn)) {
+			break;
+		}
+
+		if (conn->last_used >= used_before_ms && as_conn_pool_queue_push(pool, conn)) {
+			continue;
+		}
+
+		ck_pr_dec_32(&pool->size);
+		as_conn_pool_close(pool, conn);
+		closed++;
+	}
+	return closed;
+}
+
+void
+as_conn_pool_get_stats(as_conn_pool* pool, as_conn_pool_stats* stats)
+{
+	memset(stats, 0, sizeof(as_conn_pool_stats));
+
+	for (uint32_t i = 0; i < AS_CONN_POOL_SLOTS; i++) {
+		as_conn_pool_stats* s = &pool->slots[i].stats;
+		stats->hits += ck_pr_load_64(&s->hits);
+		stats->misses += ck_pr_load_64(&s->misses);
+		stats->creates += ck_pr_load_64(&s->creates);
+		stats->closes += ck_pr_load_64(&s->closes);
+		stats->waits += ck_pr_load_64(&s->waits);
+		stats->wait_time_ms += ck_pr_load_64(&s->wait_time_ms);
+		stats->discards += ck_pr_load_64(&s->discards);
+	}
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_connection.h>
+#include <citrusleaf/alloc.h>
+#include <string.h>
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_connection*
+as_connection_create(int fd)
+{
+	as_connection* conn = cf_malloc(sizeof(as_connection));
+
+	if (! conn) {
+		return 0;
+	}
+	conn->fd = fd;
+	conn->offset = 0;
+	conn->length = 0;
+	conn->last_used = 0;
+	conn->idle = false;
+	return conn;
+}
+
+void
+as_connection_close(as_connection* conn)
+{
+	as_close(conn->fd);
+	cf_free(conn);
+}
+
+as_status
+as_connection_read(as_error* err, as_connection* conn, uint8_t* buf, size_t len, uint64_t deadline_ms)
+{
+	size_t avail = conn->length - conn->offset;
+
+	if (avail >= len) {
+		memcpy(buf, conn->buf + conn->offset, len);
+		conn->offset += len;
+		return AEROSPIKE_OK;
+	}
+
+	// Drain buffer.
+	memcpy(buf, conn->buf + conn->offset, avail);
+	buf += avail;
+	len -= avail;
+	conn->offset = 0;
+	conn->length = 0;
+
+	if (len >= AS_CONNECTION_BUFFER_SIZE) {
+		// Large remainder.  Read directly into destination.
+		return as_socket_read_deadline(err, conn->fd, buf, len, deadline_ms);
+	}
+
+	// Read remainder plus whatever else is available.
+	size_t bytes_read;
+	as_status status = as_socket_read_available(err, conn->fd, conn->buf, len, AS_CONNECTION_BUFFER_SIZE,
+		deadline_ms, &bytes_read);
+
+	if (status) {
+		return status;
+	}
+
+	memcpy(buf, conn->buf, len);
+	conn->offset = (uint32_t)len;
+	conn->length = (uint32_t)bytes_read;
+	conn->idle = false;
+	return AEROSPIKE_OK;
+}
+
+as_status
+as_connection_read_ptr(as_error* err, as_connection* conn, size_t len, uint64_t deadline_ms, uint8_t** ptr)
+{
+	size_t avail = conn->length - conn->offset;
+
+	if (avail < len) {
+		if (conn->offset + len > AS_CONNECTION_BUFFER_SIZE) {
+			// Move partial data to front of buffer so the full range fits.
+			memmove(conn->buf, conn->buf + conn->offset, avail);
+			conn->offset = 0;
+			conn->length = (uint32_t)avail;
+		}
+
+		size_t bytes_read;
+		as_status status = as_socket_read_available(err, conn->fd, conn->buf + conn->length, len - avail,
+			AS_CONNECTION_BUFFER_SIZE - conn->length, deadline_ms, &bytes_read);
+
+		if (status) {
+			return status;
+		}
+		conn->length += (uint32_t)bytes_read;
+		conn->idle = false;
+	}
+
+	*ptr = conn->buf + conn->offset;
+	conn->offset += (uint32_t)len;
+	return AEROSPIKE_OK;
+}
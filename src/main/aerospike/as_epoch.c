@@ -0,0 +1,212 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_epoch.h>
+#include <citrusleaf/alloc.h>
+#include <pthread.h>
+#include <string.h>
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+__thread uint32_t as_epoch_thread_slot = 0;
+
+// Number of slot indexes handed out so far.
+static uint32_t as_epoch_thread_count = 0;
+
+__thread as_epoch_hazard* as_epoch_thread_hazard = 0;
+
+// Hazard pointer records of all threads that have protected data.
+static as_epoch_hazard* as_epoch_hazards = 0;
+
+static pthread_key_t as_epoch_hazard_key;
+static pthread_once_t as_epoch_hazard_once = PTHREAD_ONCE_INIT;
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void
+as_epoch_hazard_release(void* data)
+{
+	// Thread has exited.  Clear hazards and allow another thread to take the record.
+	as_epoch_hazard* hazard = data;
+
+	for (uint32_t i = 0; i < AS_EPOCH_HAZARDS; i++) {
+		ck_pr_store_ptr(&hazard->ptr[i], 0);
+	}
+	ck_pr_fence_store();
+	ck_pr_store_32(&hazard->used, 0);
+}
+
+static void
+as_epoch_hazard_key_create()
+{
+	pthread_key_create(&as_epoch_hazard_key, as_epoch_hazard_release);
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_epoch*
+as_epoch_create()
+{
+	as_epoch* epoch = cf_malloc(sizeof(as_epoch));
+	memset(epoch->slots, 0, sizeof(epoch->slots));
+
+	// Start at one so a zeroed slot epoch is always older than the global epoch.
+	epoch->global = 1;
+	as_vector_init(&epoch->retired, sizeof(as_epoch_item), 8);
+	return epoch;
+}
+
+void
+as_epoch_destroy(as_epoch* epoch)
+{
+	for (uint32_t i = 0; i < epoch->retired.size; i++) {
+		as_epoch_item* item = as_vector_get(&epoch->retired, i);
+		item->release_fn(item->data);
+	}
+	as_vector_destroy(&epoch->retired);
+	cf_free(epoch);
+}
+
+uint32_t
+as_epoch_register()
+{
+	uint32_t index = ck_pr_faa_32(&as_epoch_thread_count, 1) % AS_EPOCH_SLOTS + 1;
+	as_epoch_thread_slot = index;
+	return index;
+}
+
+as_epoch_hazard*
+as_epoch_hazard_register()
+{
+	pthread_once(&as_epoch_hazard_once, as_epoch_hazard_key_create);
+
+	as_epoch_hazard* hazard = ck_pr_load_ptr(&as_epoch_hazards);
+
+	// Reuse record of an exited thread.
+	while (hazard) {
+		if (! ck_pr_load_32(&hazard->used) && ck_pr_cas_32(&hazard->used, 0, 1)) {
+			break;
+		}
+		hazard = hazard->next;
+	}
+
+	if (! hazard) {
+		hazard = cf_malloc(sizeof(as_epoch_hazard));
+		memset(hazard, 0, sizeof(as_epoch_hazard));
+		hazard->used = 1;
+
+		as_epoch_hazard* head;
+
+		do {
+			head = ck_pr_load_ptr(&as_epoch_hazards);
+			hazard->next = head;
+			ck_pr_fence_store();
+		} while (! ck_pr_cas_ptr(&as_epoch_hazards, head, hazard));
+	}
+
+	pthread_setspecific(as_epoch_hazard_key, hazard);
+	as_epoch_thread_hazard = hazard;
+	return hazard;
+}
+
+bool
+as_epoch_protected(void* data)
+{
+	// Hazards published before readers left their epoch must be visible.
+	ck_pr_fence_memory();
+
+	as_epoch_hazard* hazard = ck_pr_load_ptr(&as_epoch_hazards);
+
+	while (hazard) {
+		for (uint32_t i = 0; i < AS_EPOCH_HAZARDS; i++) {
+			if (ck_pr_load_ptr(&hazard->ptr[i]) == data) {
+				return true;
+			}
+		}
+		hazard = hazard->next;
+	}
+	return false;
+}
+
+void
+as_epoch_retire(as_epoch* epoch, void* data, as_release_fn release_fn)
+{
+	as_epoch_item item;
+	item.data = data;
+	item.release_fn = release_fn;
+
+	// Data is already unlinked, so readers that announce a later epoch can not see it.
+	item.epoch = epoch->global;
+	as_vector_append(&epoch->retired, &item);
+}
+
+uint32_t
+as_epoch_reclaim(as_epoch* epoch)
+{
+	if (epoch->retired.size == 0) {
+		return 0;
+	}
+
+	uint64_t global = epoch->global + 1;
+	ck_pr_store_64(&epoch->global, global);
+
+	// New epoch must be visible before slots are checked.  A reader that enters after
+	// its slot is checked sees the new epoch and therefore all unlinks before it.
+	ck_pr_fence_memory();
+
+	uint64_t safe = global;
+
+	for (uint32_t i = 0; i < AS_EPOCH_SLOTS; i++) {
+		as_epoch_slot* slot = &epoch->slots[i];
+
+		if (ck_pr_load_32(&slot->active)) {
+			ck_pr_fence_load();
+			uint64_t e = ck_pr_load_64(&slot->epoch);
+
+			if (e < safe) {
+				safe = e;
+			}
+		}
+	}
+
+	// Release data retired before the oldest active reader entered.  Keep the rest in order.
+	as_vector* retired = &epoch->retired;
+	uint32_t released = 0;
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < retired->size; i++) {
+		as_epoch_item* item = as_vector_get(retired, i);
+
+		if (item->epoch < safe) {
+			item->release_fn(item->data);
+			released++;
+		}
+		else {
+			if (kept != i) {
+				memcpy(as_vector_get(retired, kept), item, sizeof(as_epoch_item));
+			}
+			kept++;
+		}
+	}
+	retired->size = kept;
+	return released;
+}
@@ -33,6 +33,7 @@ as_error_string(as_status status)
 		CASE_ASSIGN(AEROSPIKE_OK);
 		CASE_ASSIGN(AEROSPIKE_QUERY_END);
 
+		CASE_ASSIGN(AEROSPIKE_ERR_NODE_UNAVAILABLE);
 		CASE_ASSIGN(AEROSPIKE_ERR_INVALID_HOST);
 		CASE_ASSIGN(AEROSPIKE_NO_MORE_RECORDS);
 		CASE_ASSIGN(AEROSPIKE_ERR_PARAM);
@@ -0,0 +1,1281 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_event.h>
+#include <aerospike/as_admin.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <citrusleaf/cf_clock.h>
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+// Minimum inline buffer, so small responses are read without another allocation.
+#define AS_EVENT_BUFFER_MIN 1024
+
+// Maximum events returned by one epoll_wait() call.
+#define AS_EVENT_MAX_EVENTS 128
+
+// Authentication response result code offset after the 8 byte proto header.
+#define AS_EVENT_AUTH_RESULT_CODE 1
+
+/******************************************************************************
+ *	GLOBALS
+ *****************************************************************************/
+
+// Event loop serviced by the current thread, if any.
+static __thread as_event_loop* as_event_loop_current = 0;
+
+#if defined(__linux__)
+
+/******************************************************************************
+ *	TIMER HEAP
+ *****************************************************************************/
+
+static inline void
+as_event_timer_set(as_event_loop* loop, uint32_t index, as_event_command* cmd)
+{
+	loop->timers[index] = cmd;
+	cmd->timer_index = index;
+}
+
+static void
+as_event_timer_up(as_event_loop* loop, uint32_t index)
+{
+	as_event_command* cmd = loop->timers[index];
+
+	while (index > 0) {
+		uint32_t parent = (index - 1) / 2;
+		as_event_command* p = loop->timers[parent];
+
+		if (p->deadline_ms <= cmd->deadline_ms) {
+			break;
+		}
+		as_event_timer_set(loop, index, p);
+		index = parent;
+	}
+	as_event_timer_set(loop, index, cmd);
+}
+
+static void
+as_event_timer_down(as_event_loop* loop, uint32_t index)
+{
+	as_event_command* cmd = loop->timers[index];
+	uint32_t size = loop->timers_size;
+
+	while (true) {
+		uint32_t child = index * 2 + 1;
+
+		if (child >= size) {
+			break;
+		}
+
+		if (child + 1 < size && loop->timers[child + 1]->deadline_ms < loop->timers[child]->deadline_ms) {
+			child++;
+		}
+
+		if (cmd->deadline_ms <= loop->timers[child]->deadline_ms) {
+			break;
+		}
+		as_event_timer_set(loop, index, loop->timers[child]);
+		index = child;
+	}
+	as_event_timer_set(loop, index, cmd);
+}
+
+static void
+as_event_timer_add(as_event_loop* loop, as_event_command* cmd)
+{
+	if (loop->timers_size == loop->timers_capacity) {
+		loop->timers_capacity = (loop->timers_capacity == 0)? 256 : loop->timers_capacity * 2;
+		loop->timers = cf_realloc(loop->timers, sizeof(as_event_command*) * loop->timers_capacity);
+	}
+	uint32_t index = loop->timers_size++;
+	loop->timers[index] = cmd;
+	as_event_timer_up(loop, index);
+}
+
+static void
+as_event_timer_remove(as_event_loop* loop, as_event_command* cmd)
+{
+	if (cmd->timer_index < 0) {
+		return;
+	}
+
+	uint32_t index = cmd->timer_index;
+	uint32_t last = --loop->timers_size;
+	cmd->timer_index = -1;
+
+	if (index == last) {
+		return;
+	}
+
+	as_event_timer_set(loop, index, loop->timers[last]);
+
+	if (index > 0 && loop->timers[index]->deadline_ms < loop->timers[(index - 1) / 2]->deadline_ms) {
+		as_event_timer_up(loop, index);
+	}
+	else {
+		as_event_timer_down(loop, index);
+	}
+}
+
+/******************************************************************************
+ *	CONNECTIONS
+ *****************************************************************************/
+
+static void
+as_event_connection_close(as_event_loop* loop, as_event_connection* conn)
+{
+	if (conn->fd >= 0) {
+		// Closing the socket also removes it from the epoll set.
+		as_close(conn->fd);
+		conn->fd = -1;
+	}
+	conn->cmd = 0;
+
+	// Events for this connection may still be pending in the current epoll batch.
+	// Free the connection after the batch has been processed.
+	as_vector_append(&loop->garbage, &conn);
+}
+
+static void
+as_event_pool_close(as_event_loop* loop, cf_queue* q)
+{
+	as_event_connection* conn;
+
+	while (cf_queue_pop(q, &conn, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		if (loop) {
+			as_event_connection_close(loop, conn);
+		}
+		else {
+			if (conn->fd >= 0) {
+				as_close(conn->fd);
+			}
+			cf_free(conn);
+		}
+	}
+	cf_queue_destroy(q);
+}
+
+/**
+ *	Close connection that counts against the node's asynchronous connection limit.
+ */
+static inline void
+as_event_connection_discard(as_event_loop* loop, as_node* node, as_event_connection* conn)
+{
+	node->async_conn_counts[loop->index]--;
+	as_event_connection_close(loop, conn);
+}
+
+static inline bool
+as_event_connection_available(as_event_loop* loop, as_node* node)
+{
+	uint32_t max = node->cluster->async_max_conns_per_loop;
+	return max == 0 || node->async_conn_counts[loop->index] < max ||
+		cf_queue_sz(node->async_conn_qs[loop->index]) > 0;
+}
+
+static void
+as_event_collect(as_event_loop* loop)
+{
+	as_vector* garbage = &loop->garbage;
+
+	for (uint32_t i = 0; i < garbage->size; i++) {
+		cf_free(as_vector_get_ptr(garbage, i));
+	}
+	as_vector_clear(garbage);
+}
+
+static inline bool
+as_event_watch_write(as_event_loop* loop, as_event_connection* conn, bool watch)
+{
+	if (conn->watch_write == watch) {
+		return true;
+	}
+
+	struct epoll_event event;
+	event.events = watch ? (EPOLLIN | EPOLLOUT | EPOLLRDHUP) : (EPOLLIN | EPOLLRDHUP);
+	event.data.ptr = conn;
+
+	if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event) < 0) {
+		return false;
+	}
+	conn->watch_write = watch;
+	return true;
+}
+
+static as_status
+as_event_connection_get(as_error* err, as_event_command* cmd)
+{
+	as_event_loop* loop = cmd->event_loop;
+	as_node* node = cmd->node;
+	cf_queue* q = node->async_conn_qs[loop->index];
+	as_event_connection* conn;
+
+	// Pooled connections that were closed by the server while idle are marked by the event loop.
+	while (cf_queue_pop(q, &conn, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		if (! conn->closed) {
+			conn->cmd = cmd;
+			cmd->conn = conn;
+			return AEROSPIKE_OK;
+		}
+		as_event_connection_discard(loop, node, conn);
+	}
+
+	uint32_t* count = &node->async_conn_counts[loop->index];
+
+	uint32_t max = cmd->cluster->async_max_conns_per_loop;
+
+	if (max > 0 && *count >= max) {
+		// Node is at its connection limit on this event loop.  No connection is assigned.
+		return AEROSPIKE_OK;
+	}
+
+	int fd;
+	as_status status = as_node_create_socket(err, node, &fd);
+
+	if (status) {
+		return status;
+	}
+
+	conn = cf_malloc(sizeof(as_event_connection));
+	conn->fd = fd;
+	conn->watch_write = true;
+	conn->authenticated = (cmd->cluster->user == 0);
+	conn->closed = false;
+	conn->cmd = cmd;
+
+	// Watch for write readiness until the first write completes, which also
+	// signals that the non-blocking connect has finished.
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+	event.data.ptr = conn;
+
+	if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+		as_close(fd);
+		cf_free(conn);
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to add socket to event loop: %d", errno);
+	}
+	(*count)++;
+	cmd->conn = conn;
+	return AEROSPIKE_OK;
+}
+
+static inline void
+as_event_connection_put(as_event_command* cmd)
+{
+	as_event_connection* conn = cmd->conn;
+	conn->cmd = 0;
+	cf_queue_push(cmd->node->async_conn_qs[cmd->event_loop->index], &conn);
+	cmd->conn = 0;
+}
+
+/******************************************************************************
+ *	COMMANDS
+ *****************************************************************************/
+
+static inline void
+as_event_command_free(as_event_command* cmd)
+{
+	if (cmd->free_buf) {
+		cf_free(cmd->buf);
+	}
+	cf_free(cmd);
+}
+
+static void
+as_event_wait_add(as_event_loop* loop, as_event_command* cmd)
+{
+	cmd->state = AS_EVENT_WAIT_CONNECTION;
+	cmd->wait_next = 0;
+	cmd->wait_prev = loop->wait_tail;
+
+	if (loop->wait_tail) {
+		loop->wait_tail->wait_next = cmd;
+	}
+	else {
+		loop->wait_head = cmd;
+	}
+	loop->wait_tail = cmd;
+}
+
+static void
+as_event_wait_remove(as_event_loop* loop, as_event_command* cmd)
+{
+	if (cmd->wait_prev) {
+		cmd->wait_prev->wait_next = cmd->wait_next;
+	}
+	else {
+		loop->wait_head = cmd->wait_next;
+	}
+
+	if (cmd->wait_next) {
+		cmd->wait_next->wait_prev = cmd->wait_prev;
+	}
+	else {
+		loop->wait_tail = cmd->wait_prev;
+	}
+	cmd->wait_next = 0;
+	cmd->wait_prev = 0;
+	cmd->state = AS_EVENT_WRITE_COMMAND;
+}
+
+static inline void
+as_event_command_release(as_event_command* cmd)
+{
+	if (cmd->state == AS_EVENT_WAIT_CONNECTION) {
+		as_event_wait_remove(cmd->event_loop, cmd);
+	}
+
+	if (cmd->conn) {
+		as_event_connection_discard(cmd->event_loop, cmd->node, cmd->conn);
+		cmd->conn = 0;
+	}
+
+	if (cmd->node) {
+		as_node_release(cmd->node);
+		cmd->node = 0;
+	}
+
+	if (cmd->free_buf) {
+		cf_free(cmd->buf);
+		cmd->free_buf = false;
+	}
+}
+
+static void
+as_event_notify_error(as_event_command* cmd, as_error* err)
+{
+	switch (cmd->type) {
+		case AS_EVENT_TYPE_WRITE:
+			cmd->listener.write(err, cmd->udata, cmd->event_loop);
+			break;
+
+		case AS_EVENT_TYPE_RECORD:
+			cmd->listener.record(err, 0, cmd->udata, cmd->event_loop);
+			break;
+
+		case AS_EVENT_TYPE_VALUE:
+			cmd->listener.value(err, 0, cmd->udata, cmd->event_loop);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void
+as_event_command_fail(as_event_command* cmd, as_error* err)
+{
+	as_event_loop* loop = cmd->event_loop;
+
+	as_event_timer_remove(loop, cmd);
+	as_event_command_release(cmd);
+	loop->pending--;
+	as_event_notify_error(cmd, err);
+	as_event_command_free(cmd);
+}
+
+static void as_event_command_begin(as_event_command* cmd);
+static void as_event_command_connect(as_event_command* cmd);
+
+static void
+as_event_command_retry(as_event_command* cmd, as_error* err)
+{
+	// Retry only covers failures that occur before any response bytes have been
+	// received, so the serialized command is still intact.
+	if (cmd->node) {
+		as_node_breaker_failure(cmd->node);
+	}
+	
+	if (++cmd->iterations > cmd->retry) {
+		as_event_command_fail(cmd, err);
+		return;
+	}
+
+	if (cmd->deadline_ms > 0) {
+		int remaining_ms = (int)(cmd->deadline_ms - cf_getms());
+
+		if (remaining_ms <= 0) {
+			as_event_command_fail(cmd, err);
+			return;
+		}
+
+		// Reset timeout in send buffer (destined for server).
+		*(uint32_t*)(cmd->cmd_buf + 22) = cf_swap_to_be32(remaining_ms);
+	}
+
+	as_event_command_release(cmd);
+	as_event_command_begin(cmd);
+}
+
+static void
+as_event_command_parse(as_event_command* cmd)
+{
+	as_event_loop* loop = cmd->event_loop;
+	as_msg* msg = (as_msg*)cmd->buf;
+	as_msg_swap_header_from_be(msg);
+	uint8_t* p = cmd->buf + sizeof(as_msg);
+
+	// Return connection to pool and release node before calling the listener,
+	// so the listener can immediately issue new commands on the same connection.
+	as_event_timer_remove(loop, cmd);
+	as_event_connection_put(cmd);
+	as_node_breaker_success(cmd->node);
+	as_node_release(cmd->node);
+	cmd->node = 0;
+	loop->pending--;
+
+	as_error err;
+	as_error_init(&err);
+	as_status status;
+
+	switch (cmd->type) {
+		case AS_EVENT_TYPE_WRITE: {
+			status = msg->result_code;
+
+			if (status == AEROSPIKE_OK) {
+				cmd->listener.write(0, cmd->udata, loop);
+			}
+			else {
+				as_error_set_message(&err, status, as_error_string(status));
+				cmd->listener.write(&err, cmd->udata, loop);
+			}
+			break;
+		}
+
+		case AS_EVENT_TYPE_RECORD: {
+			as_record* rec = 0;
+			as_command_parse_result_data data;
+			data.record = &rec;
+			data.deserialize = cmd->deserialize;
+			data.lazy = cmd->lazy;
+			status = as_command_parse_result_buf(&err, msg, p, &data);
+
+			if (status == AEROSPIKE_OK) {
+				cmd->listener.record(0, rec, cmd->udata, loop);
+			}
+			else {
+				cmd->listener.record(&err, 0, cmd->udata, loop);
+			}
+
+			if (rec) {
+				as_record_destroy(rec);
+			}
+			break;
+		}
+
+		case AS_EVENT_TYPE_VALUE: {
+			as_val* val = 0;
+			status = as_command_parse_success_failure_buf(&err, msg, p, &val);
+
+			if (status == AEROSPIKE_OK) {
+				cmd->listener.value(0, val, cmd->udata, loop);
+			}
+			else {
+				cmd->listener.value(&err, 0, cmd->udata, loop);
+			}
+
+			if (val) {
+				as_val_destroy(val);
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+	as_event_command_free(cmd);
+}
+
+static void
+as_event_command_write(as_event_command* cmd)
+{
+	as_event_loop* loop = cmd->event_loop;
+	as_event_connection* conn = cmd->conn;
+
+	while (cmd->pos < cmd->len) {
+		ssize_t bytes = send(conn->fd, cmd->buf + cmd->pos, cmd->len - cmd->pos, MSG_NOSIGNAL);
+
+		if (bytes > 0) {
+			cmd->pos += bytes;
+			continue;
+		}
+
+		if (bytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				// Socket buffer is full or connect is still in progress.
+				if (as_event_watch_write(loop, conn, true)) {
+					return;
+				}
+			}
+		}
+
+		as_error err;
+		as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Socket write failed: %d", errno);
+		as_event_command_retry(cmd, &err);
+		return;
+	}
+
+	if (! as_event_watch_write(loop, conn, false)) {
+		as_error err;
+		as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Failed to modify socket events: %d", errno);
+		as_event_command_retry(cmd, &err);
+		return;
+	}
+
+	// Wait for response header.
+	cmd->state = (cmd->state == AS_EVENT_WRITE_AUTH)? AS_EVENT_READ_AUTH_HEADER : AS_EVENT_READ_HEADER;
+	cmd->len = sizeof(as_proto);
+	cmd->pos = 0;
+}
+
+static void
+as_event_command_read(as_event_command* cmd)
+{
+	as_event_connection* conn = cmd->conn;
+	uint8_t* buf = (cmd->state == AS_EVENT_READ_HEADER || cmd->state == AS_EVENT_READ_AUTH_HEADER)?
+		(uint8_t*)&cmd->proto : cmd->buf;
+
+	while (true) {
+		while (cmd->pos < cmd->len) {
+			ssize_t bytes = recv(conn->fd, buf + cmd->pos, cmd->len - cmd->pos, 0);
+
+			if (bytes > 0) {
+				cmd->pos += bytes;
+				continue;
+			}
+
+			if (bytes < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					// Wait for more data.
+					return;
+				}
+			}
+
+			as_error err;
+
+			if (bytes == 0) {
+				as_error_set_message(&err, AEROSPIKE_ERR_CLIENT, "Connection closed by server");
+			}
+			else {
+				as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Socket read failed: %d", errno);
+			}
+
+			// Stale pooled connections fail before any response bytes arrive. Retry those.
+			if (cmd->pos == 0 && (cmd->state == AS_EVENT_READ_HEADER || cmd->state == AS_EVENT_READ_AUTH_HEADER)) {
+				as_event_command_retry(cmd, &err);
+			}
+			else {
+				as_event_command_fail(cmd, &err);
+			}
+			return;
+		}
+
+		switch (cmd->state) {
+			case AS_EVENT_READ_AUTH_HEADER: {
+				as_proto_swap_from_be(&cmd->proto);
+
+				// The authentication buffer is larger than any valid response.
+				as_cluster* cluster = cmd->cluster;
+				size_t capacity = 34 + strlen(cluster->user) + strlen(cluster->password);
+
+				if (cmd->proto.sz < AS_EVENT_AUTH_RESULT_CODE + 1 || cmd->proto.sz > capacity) {
+					as_error err;
+					as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Invalid authentication response size: %zu", (size_t)cmd->proto.sz);
+					as_event_command_fail(cmd, &err);
+					return;
+				}
+				cmd->state = AS_EVENT_READ_AUTH_BODY;
+				cmd->len = (uint32_t)cmd->proto.sz;
+				cmd->pos = 0;
+				buf = cmd->buf;
+				break;
+			}
+
+			case AS_EVENT_READ_AUTH_BODY: {
+				as_status status = cmd->buf[AS_EVENT_AUTH_RESULT_CODE];
+
+				if (status) {
+					as_error err;
+					as_error_set_message(&err, status, as_error_string(status));
+					as_event_command_fail(cmd, &err);
+					return;
+				}
+				conn->authenticated = true;
+				cf_free(cmd->buf);
+				cmd->free_buf = false;
+
+				// Send the real command.
+				cmd->state = AS_EVENT_WRITE_COMMAND;
+				cmd->buf = cmd->cmd_buf;
+				cmd->len = cmd->cmd_len;
+				cmd->pos = 0;
+				as_event_command_write(cmd);
+				return;
+			}
+
+			case AS_EVENT_READ_HEADER: {
+				as_proto_swap_from_be(&cmd->proto);
+				size_t size = cmd->proto.sz;
+
+				if (size < sizeof(as_msg)) {
+					as_error err;
+					as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Invalid response size: %zu", size);
+					as_event_command_fail(cmd, &err);
+					return;
+				}
+
+				// The command has been sent, so its buffer can be reused for the response.
+				if (size > cmd->capacity) {
+					cmd->buf = cf_malloc(size);
+					cmd->free_buf = true;
+				}
+				else {
+					cmd->buf = cmd->cmd_buf;
+				}
+				cmd->state = AS_EVENT_READ_BODY;
+				cmd->len = (uint32_t)size;
+				cmd->pos = 0;
+				buf = cmd->buf;
+				break;
+			}
+
+			case AS_EVENT_READ_BODY:
+				as_event_command_parse(cmd);
+				return;
+
+			default:
+				return;
+		}
+	}
+}
+
+static void
+as_event_command_begin(as_event_command* cmd)
+{
+	as_error err;
+	as_error_init(&err);
+
+	cmd->node = as_node_get(cmd->cluster, cmd->ns, cmd->handle, cmd->digest, cmd->write, cmd->replica);
+
+	if (! cmd->node) {
+		as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Failed to find node for namespace %s", cmd->ns);
+		as_event_command_fail(cmd, &err);
+		return;
+	}
+
+	if (! as_node_breaker_allow(cmd->node)) {
+		ck_pr_inc_64(&cmd->cluster->breaker_rejects);
+		as_error_update(&err, AEROSPIKE_ERR_NODE_UNAVAILABLE, "Node %s circuit breaker open", cmd->node->name);
+		as_event_command_fail(cmd, &err);
+		return;
+	}
+	as_event_command_connect(cmd);
+}
+
+static void
+as_event_command_connect(as_event_command* cmd)
+{
+	as_error err;
+	as_error_init(&err);
+
+	as_status status = as_event_connection_get(&err, cmd);
+
+	if (status) {
+		as_event_command_retry(cmd, &err);
+		return;
+	}
+
+	if (! cmd->conn) {
+		// Wait for a connection to be returned or closed.  The timer still applies.
+		as_event_wait_add(cmd->event_loop, cmd);
+		return;
+	}
+
+	if (cmd->conn->authenticated) {
+		cmd->state = AS_EVENT_WRITE_COMMAND;
+		cmd->buf = cmd->cmd_buf;
+		cmd->len = cmd->cmd_len;
+	}
+	else {
+		// New connection on a cluster with security enabled.  Authenticate first.
+		as_cluster* cluster = cmd->cluster;
+		size_t size = 34 + strlen(cluster->user) + strlen(cluster->password);
+		cmd->buf = cf_malloc(size);
+		cmd->free_buf = true;
+		cmd->len = as_authenticate_set(cluster->user, cluster->password, cmd->buf);
+		cmd->state = AS_EVENT_WRITE_AUTH;
+	}
+	cmd->pos = 0;
+	as_event_command_write(cmd);
+}
+
+static void
+as_event_command_start(as_event_command* cmd)
+{
+	as_event_loop* loop = cmd->event_loop;
+	loop->pending++;
+
+	if (cmd->deadline_ms > 0) {
+		if (cf_getms() >= cmd->deadline_ms) {
+			as_error err;
+			as_error_update(&err, AEROSPIKE_ERR_TIMEOUT, "Client timeout: timeout=%u iterations=0", cmd->timeout_ms);
+			as_event_command_fail(cmd, &err);
+			return;
+		}
+		as_event_timer_add(loop, cmd);
+	}
+	as_event_command_begin(cmd);
+}
+
+/******************************************************************************
+ *	EVENT LOOP
+ *****************************************************************************/
+
+static void
+as_event_loop_wakeup(as_event_loop* loop)
+{
+	uint64_t value;
+
+	if (read(loop->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+		as_log_warn("Event loop %u wakeup read failed: %d", loop->index, errno);
+	}
+
+	// Clear flag before draining queue, so a command pushed after the drain
+	// always signals another wakeup.
+	ck_pr_store_32(&loop->wakeup, 0);
+	ck_pr_fence_memory();
+
+	as_event_command* cmd;
+
+	while (cf_queue_pop(loop->queue, &cmd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		if (cmd->type == AS_EVENT_TYPE_CLOSE_POOL) {
+			as_event_pool_close(loop, cmd->udata);
+			cf_free(cmd);
+		}
+		else {
+			as_event_command_start(cmd);
+		}
+	}
+}
+
+static void
+as_event_process(as_event_loop* loop, as_event_connection* conn, uint32_t events)
+{
+	if (conn->fd < 0) {
+		// Connection was closed earlier in this epoll batch.
+		return;
+	}
+
+	as_event_command* cmd = conn->cmd;
+
+	if (! cmd) {
+		// Idle pooled connection was closed or sent unexpected data. Stop watching
+		// it and discard it the next time it is popped from the pool.
+		conn->closed = true;
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, 0);
+		return;
+	}
+
+	switch (cmd->state) {
+		case AS_EVENT_WRITE_AUTH:
+		case AS_EVENT_WRITE_COMMAND:
+			if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+				as_event_command_write(cmd);
+			}
+			break;
+
+		default:
+			if (events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+				as_event_command_read(cmd);
+			}
+			break;
+	}
+}
+
+/**
+ *	Start waiting commands whose node has an idle connection or is below its limit.
+ */
+static void
+as_event_loop_start_waiting(as_event_loop* loop)
+{
+	as_event_command* cmd = loop->wait_head;
+
+	while (cmd) {
+		as_event_command* next = cmd->wait_next;
+
+		if (as_event_connection_available(loop, cmd->node)) {
+			as_event_wait_remove(loop, cmd);
+			as_event_command_connect(cmd);
+		}
+		cmd = next;
+	}
+}
+
+static void
+as_event_loop_expire(as_event_loop* loop)
+{
+	if (loop->timers_size == 0) {
+		return;
+	}
+
+	uint64_t now = cf_getms();
+
+	while (loop->timers_size > 0 && loop->timers[0]->deadline_ms <= now) {
+		as_event_command* cmd = loop->timers[0];
+		as_error err;
+		as_error_update(&err, AEROSPIKE_ERR_TIMEOUT, "Client timeout: timeout=%u iterations=%u",
+			cmd->timeout_ms, cmd->iterations);
+
+		// Waiting for a connection is not a node failure.
+		if (cmd->node && cmd->state != AS_EVENT_WAIT_CONNECTION) {
+			as_node_breaker_failure(cmd->node);
+		}
+		
+		// The response may still arrive, so the connection can not be reused.
+		as_event_command_fail(cmd, &err);
+	}
+}
+
+static void
+as_event_loop_process(as_event_loop* loop, int timeout_ms)
+{
+	if (loop->timers_size > 0) {
+		int64_t wait_ms = (int64_t)(loop->timers[0]->deadline_ms - cf_getms());
+
+		if (wait_ms < 0) {
+			wait_ms = 0;
+		}
+
+		if (wait_ms < timeout_ms) {
+			timeout_ms = (int)wait_ms;
+		}
+	}
+
+	struct epoll_event events[AS_EVENT_MAX_EVENTS];
+	int n = epoll_wait(loop->epoll_fd, events, AS_EVENT_MAX_EVENTS, timeout_ms);
+
+	if (n < 0 && errno != EINTR) {
+		as_log_warn("Event loop %u epoll_wait failed: %d", loop->index, errno);
+	}
+
+	for (int i = 0; i < n; i++) {
+		void* ptr = events[i].data.ptr;
+
+		if (ptr == loop) {
+			as_event_loop_wakeup(loop);
+		}
+		else {
+			as_event_process(loop, ptr, events[i].events);
+		}
+	}
+	as_event_loop_expire(loop);
+
+	if (loop->wait_head) {
+		as_event_loop_start_waiting(loop);
+	}
+	as_event_collect(loop);
+}
+
+static void*
+as_event_loop_run(void* udata)
+{
+	as_event_loop* loop = udata;
+	as_event_loop_current = loop;
+
+	// Keep running after close until commands already accepted have completed.
+	while (loop->valid || loop->pending > 0 || cf_queue_sz(loop->queue) > 0) {
+		as_event_loop_process(loop, 1000);
+	}
+	as_event_loop_current = 0;
+	return 0;
+}
+
+static as_status
+as_event_loop_init(as_event_loop* loop, as_error* err, uint32_t index, bool external)
+{
+	memset(loop, 0, sizeof(as_event_loop));
+	loop->index = index;
+	loop->external = external;
+	loop->wakeup_fd = -1;
+	loop->epoll_fd = epoll_create(AS_EVENT_MAX_EVENTS);
+
+	if (loop->epoll_fd < 0) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to create epoll instance: %d", errno);
+	}
+
+	loop->wakeup_fd = eventfd(0, EFD_NONBLOCK);
+
+	if (loop->wakeup_fd < 0) {
+		as_close(loop->epoll_fd);
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to create eventfd: %d", errno);
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = loop;
+
+	if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeup_fd, &event) < 0) {
+		as_close(loop->wakeup_fd);
+		as_close(loop->epoll_fd);
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to register eventfd: %d", errno);
+	}
+
+	loop->queue = cf_queue_create(sizeof(as_event_command*), true);
+	as_vector_init(&loop->garbage, sizeof(as_event_connection*), 64);
+	loop->valid = true;
+
+	if (! external) {
+		if (pthread_create(&loop->thread, 0, as_event_loop_run, loop)) {
+			as_vector_destroy(&loop->garbage);
+			cf_queue_destroy(loop->queue);
+			as_close(loop->wakeup_fd);
+			as_close(loop->epoll_fd);
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to create event loop thread");
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+static void
+as_event_loop_signal(as_event_loop* loop)
+{
+	if (ck_pr_fas_32(&loop->wakeup, 1) == 0) {
+		uint64_t value = 1;
+
+		if (write(loop->wakeup_fd, &value, sizeof(value)) < 0) {
+			as_log_warn("Event loop %u wakeup write failed: %d", loop->index, errno);
+		}
+	}
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_event_loop*
+as_event_loop_get(aerospike* as, int index)
+{
+	as_cluster* cluster = as->cluster;
+
+	if (! cluster || cluster->event_loop_size == 0) {
+		return 0;
+	}
+
+	if (index < 0) {
+		index = ck_pr_faa_32(&cluster->event_loop_index, 1) % cluster->event_loop_size;
+	}
+	else if ((uint32_t)index >= cluster->event_loop_size) {
+		return 0;
+	}
+	return &cluster->event_loops[index];
+}
+
+uint32_t
+as_event_loop_poll(as_event_loop* event_loop, uint32_t timeout_ms)
+{
+	as_event_loop* prev = as_event_loop_current;
+	as_event_loop_current = event_loop;
+	as_event_loop_process(event_loop, (int)timeout_ms);
+	as_event_loop_current = prev;
+	return event_loop->pending + cf_queue_sz(event_loop->queue);
+}
+
+as_status
+as_event_loops_create(as_cluster* cluster, as_error* err, uint32_t size, bool external)
+{
+	if (size == 0) {
+		return AEROSPIKE_OK;
+	}
+
+	cluster->event_loops = cf_malloc(sizeof(as_event_loop) * size);
+	cluster->event_loop_size = 0;
+
+	for (uint32_t i = 0; i < size; i++) {
+		as_status status = as_event_loop_init(&cluster->event_loops[i], err, i, external);
+
+		if (status) {
+			if (i == 0) {
+				cf_free(cluster->event_loops);
+				cluster->event_loops = 0;
+			}
+			return status;
+		}
+		cluster->event_loop_size++;
+	}
+	return AEROSPIKE_OK;
+}
+
+void
+as_event_loops_destroy(as_cluster* cluster)
+{
+	as_event_loop* loops = cluster->event_loops;
+
+	if (! loops) {
+		return;
+	}
+
+	uint32_t size = cluster->event_loop_size;
+
+	for (uint32_t i = 0; i < size; i++) {
+		as_event_loop* loop = &loops[i];
+		loop->valid = false;
+
+		if (! loop->external) {
+			as_event_loop_signal(loop);
+		}
+	}
+
+	for (uint32_t i = 0; i < size; i++) {
+		as_event_loop* loop = &loops[i];
+
+		if (loop->external) {
+			// The application no longer polls this loop.  Complete pending commands here.
+			as_event_loop_current = loop;
+
+			while (loop->pending > 0 || cf_queue_sz(loop->queue) > 0) {
+				as_event_loop_process(loop, 100);
+			}
+			as_event_loop_current = 0;
+		}
+		else {
+			pthread_join(loop->thread, 0);
+		}
+	}
+
+	// Nodes destroyed from here on close their async pools directly.
+	ck_pr_store_ptr(&cluster->event_loops, 0);
+	ck_pr_fence_memory();
+
+	for (uint32_t i = 0; i < size; i++) {
+		as_event_loop* loop = &loops[i];
+		as_event_command* cmd;
+
+		// Pool close requests can be queued by other loops while they shut down.  Commands
+		// can be queued by threads that checked the loop just before it was closed.
+		while (cf_queue_pop(loop->queue, &cmd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+			if (cmd->type == AS_EVENT_TYPE_CLOSE_POOL) {
+				as_event_pool_close(0, cmd->udata);
+				cf_free(cmd);
+			}
+			else {
+				as_error err;
+				as_error_set_message(&err, AEROSPIKE_ERR_CLIENT, "Event loop closed");
+				as_event_notify_error(cmd, &err);
+				as_event_command_free(cmd);
+			}
+		}
+		as_event_collect(loop);
+		as_vector_destroy(&loop->garbage);
+		cf_queue_destroy(loop->queue);
+		cf_free(loop->timers);
+		as_close(loop->wakeup_fd);
+		as_close(loop->epoll_fd);
+	}
+	cf_free(loops);
+}
+
+as_event_command*
+as_event_command_create(as_cluster* cluster, const as_key* key, size_t size,
+	uint32_t timeout_ms, uint32_t retry, as_policy_replica replica, bool write)
+{
+	size_t capacity = (size < AS_EVENT_BUFFER_MIN)? AS_EVENT_BUFFER_MIN : size;
+	as_event_command* cmd = cf_malloc(sizeof(as_event_command) + capacity);
+
+	if (! cmd) {
+		return 0;
+	}
+
+	cmd->event_loop = 0;
+	cmd->cluster = cluster;
+	cmd->node = 0;
+	cmd->conn = 0;
+	cmd->listener.write = 0;
+	cmd->udata = 0;
+	cmd->cmd_buf = (uint8_t*)cmd + sizeof(as_event_command);
+	cmd->buf = cmd->cmd_buf;
+	cmd->deadline_ms = 0;
+	cmd->cmd_len = 0;
+	cmd->capacity = (uint32_t)capacity;
+	cmd->len = 0;
+	cmd->pos = 0;
+	cmd->timer_index = -1;
+	cmd->timeout_ms = timeout_ms;
+	cmd->retry = retry;
+	cmd->iterations = 0;
+	strcpy(cmd->ns, key->ns);
+	cmd->handle = key->handle;
+	memcpy(cmd->digest, key->digest.value, AS_DIGEST_VALUE_SIZE);
+	cmd->state = AS_EVENT_WRITE_COMMAND;
+	cmd->type = AS_EVENT_TYPE_WRITE;
+	cmd->replica = (uint8_t)replica;
+	cmd->write = write;
+	cmd->deserialize = false;
+	cmd->lazy = false;
+	cmd->free_buf = false;
+	cmd->wait_next = 0;
+	cmd->wait_prev = 0;
+	return cmd;
+}
+
+as_status
+as_event_command_execute(as_error* err, as_event_command* cmd, as_event_loop* event_loop)
+{
+	as_cluster* cluster = cmd->cluster;
+
+	if (! event_loop) {
+		if (cluster->event_loop_size == 0 || ! cluster->event_loops) {
+			as_event_command_free(cmd);
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT,
+				"Event loops not created.  Set as_config.event_loop_size.");
+		}
+		uint32_t index = ck_pr_faa_32(&cluster->event_loop_index, 1) % cluster->event_loop_size;
+		event_loop = &cluster->event_loops[index];
+	}
+
+	if (! event_loop->valid) {
+		as_event_command_free(cmd);
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Event loop closed");
+	}
+
+	cmd->event_loop = event_loop;
+	cmd->deadline_ms = (cmd->timeout_ms > 0)? cf_getms() + cmd->timeout_ms : 0;
+
+	if (as_event_loop_current == event_loop) {
+		// Already on event loop thread (typically inside a listener). Start immediately.
+		as_event_command_start(cmd);
+		return AEROSPIKE_OK;
+	}
+
+	cf_queue_push(event_loop->queue, &cmd);
+	as_event_loop_signal(event_loop);
+	return AEROSPIKE_OK;
+}
+
+void
+as_event_node_destroy(as_node* node)
+{
+	as_cluster* cluster = node->cluster;
+	as_event_loop* loops = ck_pr_load_ptr(&cluster->event_loops);
+
+	for (uint32_t i = 0; i < cluster->event_loop_size; i++) {
+		cf_queue* q = node->async_conn_qs[i];
+
+		if (! loops) {
+			// Event loops have been stopped. No other thread references these connections.
+			as_event_pool_close(0, q);
+		}
+		else if (as_event_loop_current == &loops[i]) {
+			as_event_pool_close(&loops[i], q);
+		}
+		else {
+			// Idle connections are registered with the event loop's epoll instance,
+			// so only that event loop may close them.
+			as_event_command* cmd = cf_malloc(sizeof(as_event_command));
+			memset(cmd, 0, sizeof(as_event_command));
+			cmd->type = AS_EVENT_TYPE_CLOSE_POOL;
+			cmd->udata = q;
+			cf_queue_push(loops[i].queue, &cmd);
+			as_event_loop_signal(&loops[i]);
+		}
+	}
+	cf_free(node->async_conn_qs);
+	cf_free(node->async_conn_counts);
+	node->async_conn_qs = 0;
+	node->async_conn_counts = 0;
+}
+
+#else // !__linux__
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_event_loop*
+as_event_loop_get(aerospike* as, int index)
+{
+	return 0;
+}
+
+uint32_t
+as_event_loop_poll(as_event_loop* event_loop, uint32_t timeout_ms)
+{
+	return 0;
+}
+
+as_status
+as_event_loops_create(struct as_cluster_s* cluster, as_error* err, uint32_t size, bool external)
+{
+	if (size == 0) {
+		return AEROSPIKE_OK;
+	}
+	return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Event loops are only supported on Linux");
+}
+
+void
+as_event_loops_destroy(struct as_cluster_s* cluster)
+{
+}
+
+as_event_command*
+as_event_command_create(struct as_cluster_s* cluster, const as_key* key, size_t size,
+	uint32_t timeout_ms, uint32_t retry, as_policy_replica replica, bool write)
+{
+	as_event_command* cmd = cf_malloc(sizeof(as_event_command) + size);
+	memset(cmd, 0, sizeof(as_event_command));
+	cmd->cmd_buf = (uint8_t*)cmd + sizeof(as_event_command);
+	return cmd;
+}
+
+as_status
+as_event_command_execute(as_error* err, as_event_command* cmd, as_event_loop* event_loop)
+{
+	cf_free(cmd);
+	return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Event loops are only supported on Linux");
+}
+
+void
+as_event_node_destroy(as_node* node)
+{
+	cf_free(node->async_conn_qs);
+	cf_free(node->async_conn_counts);
+	node->async_conn_qs = 0;
+	node->async_conn_counts = 0;
+}
+
+#endif // __linux__
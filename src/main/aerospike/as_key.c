@@ -54,6 +54,7 @@ static as_key * as_key_cons(as_key * key, bool free, const as_namespace ns, cons
 	strcpy(key->ns, ns);
 	strcpy(key->set, set);
 	key->valuep = (as_key_value *) valuep;
+	key->handle = NULL;
 	
 	if ( digest == NULL ) {
 		key->digest.init = false;
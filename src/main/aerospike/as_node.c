@@ -18,15 +18,15 @@
 #include <aerospike/as_admin.h>
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_command.h>
+#include <aerospike/as_event.h>
 #include <aerospike/as_info.h>
 #include <aerospike/as_log_macros.h>
+#include <aerospike/as_pipeline.h>
 #include <aerospike/as_socket.h>
 #include <aerospike/as_string.h>
 #include <citrusleaf/cf_byte_order.h>
 #include <errno.h> //errno
-
-// Replicas take ~2K per namespace, so this will cover most deployments:
-#define INFO_STACK_BUF_SIZE (16 * 1024)
+#include <poll.h>
 
 /******************************************************************************
  *	Function declarations.
@@ -35,6 +35,12 @@
 bool
 as_partition_tables_update(struct as_cluster_s* cluster, as_node* node, char* buf, bool master);
 
+/******************************************************************************
+ *	Globals.
+ *****************************************************************************/
+
+__thread uint32_t as_node_select_count = 0;
+
 /******************************************************************************
  *	Functions.
  *****************************************************************************/
@@ -61,60 +67,63 @@ as_node_create(as_cluster* cluster, struct sockaddr_in* addr, as_node_info* node
 	
 	as_vector_init(&node->addresses, sizeof(as_address), 2);
 	as_node_add_address(node, addr);
+	as_vector_init(&node->bitmaps, sizeof(as_node_bitmap), 4);
 		
-	node->conn_q = cf_queue_create(sizeof(int), true);
-	// node->conn_q_asyncfd = cf_queue_create(sizeof(int), true);
-	// node->asyncwork_q = cf_queue_create(sizeof(cl_async_work*), true);
+	as_conn_pool_init(&node->conn_pool, cluster->conn_queue_size, cluster->max_conns_per_node);
+	
+	uint32_t event_loop_size = cluster->event_loop_size;
+	
+	if (event_loop_size > 0) {
+		node->async_conn_qs = cf_malloc(sizeof(cf_queue*) * event_loop_size);
+		node->async_conn_counts = cf_malloc(sizeof(uint32_t) * event_loop_size);
+		
+		for (uint32_t i = 0; i < event_loop_size; i++) {
+			node->async_conn_qs[i] = cf_queue_create(sizeof(as_event_connection*), false);
+			node->async_conn_counts[i] = 0;
+		}
+	}
+	else {
+		node->async_conn_qs = 0;
+		node->async_conn_counts = 0;
+	}
 	
+	node->pipeline = (cluster->pipeline_depth > 0)? as_pipeline_create(&node->conn_pool, cluster->pipeline_depth) : 0;
 	node->info_fd = -1;
 	node->friends = 0;
 	node->failures = 0;
 	node->index = 0;
 	node->active = true;
+	node->latency = 0;
+	node->inflight = 0;
+	memset(node->latency_buckets, 0, sizeof(node->latency_buckets));
+	node->breaker_state = AS_NODE_BREAKER_CLOSED;
+	node->breaker_errors = 0;
+	node->breaker_open_ms = 0;
 	return node;
 }
 
-void
-as_node_destroy(as_node* node)
+static void
+as_node_free(as_node* node)
 {
-	// Drain out the queue and close the FDs
-	int rv;
-	do {
-		int	fd;
-		rv = cf_queue_pop(node->conn_q, &fd, CF_QUEUE_NOWAIT);
-		if (rv == CF_QUEUE_OK)
-			as_close(fd);
-	} while (rv == CF_QUEUE_OK);
-	
-	/*
-	 do {
-	 int	fd;
-	 rv = cf_queue_pop(node->conn_q_asyncfd, &fd, CF_QUEUE_NOWAIT);
-	 if (rv == CF_QUEUE_OK)
-	 as_close(fd);
-	 } while (rv == CF_QUEUE_OK);
-	 */
-	
-	/*
-	 do {
-	 //When we reach this point, ideally there should not be any workitems.
-	 cl_async_work *aw;
-	 rv = cf_queue_pop(node->asyncwork_q, &aw, CF_QUEUE_NOWAIT);
-	 if (rv == CF_QUEUE_OK) {
-	 free(aw);
-	 }
-	 } while (rv == CF_QUEUE_OK);
-	 
-	 //We want to delete all the workitems of this node
-	 if (g_cl_async_hashtab) {
-	 shash_reduce_delete(g_cl_async_hashtab, cl_del_node_asyncworkitems, node);
-	 }
-	 */
+	// Pipeline connection counts against the pool, so close it first.
+	if (node->pipeline) {
+		as_pipeline_destroy(node->pipeline);
+	}
+	
+	// Close pooled connections.
+	as_conn_pool_destroy(&node->conn_pool);
+	
+	if (node->async_conn_qs) {
+		as_event_node_destroy(node);
+	}
 	
 	as_vector_destroy(&node->addresses);
-	cf_queue_destroy(node->conn_q);
-	//cf_queue_destroy(node->conn_q_asyncfd);
-	//cf_queue_destroy(node->asyncwork_q);
+	
+	for (uint32_t i = 0; i < node->bitmaps.size; i++) {
+		as_node_bitmap* bitmap = as_vector_get(&node->bitmaps, i);
+		cf_free(bitmap->bits);
+	}
+	as_vector_destroy(&node->bitmaps);
 	
 	if (node->info_fd >= 0) {
 		as_close(node->info_fd);
@@ -123,6 +132,48 @@ as_node_destroy(as_node* node)
 	cf_free(node);
 }
 
+static void
+as_node_defer(as_node* node)
+{
+	as_cluster* cluster = node->cluster;
+	as_node* head;
+	
+	do {
+		head = ck_pr_load_ptr(&cluster->deferred_nodes);
+		node->deferred_next = head;
+		ck_pr_fence_store();
+	} while (! ck_pr_cas_ptr(&cluster->deferred_nodes, head, node));
+}
+
+void
+as_node_destroy(as_node* node)
+{
+	// A command thread may have selected the node before its last reference was dropped.
+	if (as_epoch_protected(node)) {
+		as_node_defer(node);
+		return;
+	}
+	as_node_free(node);
+}
+
+void
+as_node_destroy_deferred(as_cluster* cluster, bool force)
+{
+	as_node* node = ck_pr_fas_ptr(&cluster->deferred_nodes, 0);
+	
+	while (node) {
+		as_node* next = node->deferred_next;
+		
+		if (! force && as_epoch_protected(node)) {
+			as_node_defer(node);
+		}
+		else {
+			as_node_free(node);
+		}
+		node = next;
+	}
+}
+
 void
 as_node_add_address(as_node* node, struct sockaddr_in* addr)
 {
@@ -132,6 +183,129 @@ as_node_add_address(as_node* node, struct sockaddr_in* addr)
 	as_vector_append(&node->addresses, &address);
 }
 
+as_node_bitmap*
+as_node_get_bitmap(as_node* node, const char* ns, bool master, uint32_t size)
+{
+	for (uint32_t i = 0; i < node->bitmaps.size; i++) {
+		as_node_bitmap* bitmap = as_vector_get(&node->bitmaps, i);
+		
+		if (bitmap->master == master && strcmp(bitmap->ns, ns) == 0) {
+			return bitmap;
+		}
+	}
+	
+	as_node_bitmap bitmap;
+	as_strncpy(bitmap.ns, ns, AS_NAMESPACE_MAX_SIZE);
+	bitmap.master = master;
+	bitmap.valid = false;
+	bitmap.bits = cf_malloc(size);
+	as_vector_append(&node->bitmaps, &bitmap);
+	return as_vector_get(&node->bitmaps, node->bitmaps.size - 1);
+}
+
+uint64_t
+as_node_latency_percentile(as_node* node, uint32_t percentile)
+{
+	uint32_t counts[AS_NODE_LATENCY_BUCKETS];
+	uint64_t total = 0;
+	
+	for (uint32_t i = 0; i < AS_NODE_LATENCY_BUCKETS; i++) {
+		counts[i] = ck_pr_load_32(&node->latency_buckets[i]);
+		total += counts[i];
+	}
+	
+	if (total < AS_NODE_LATENCY_MIN_SAMPLES) {
+		return 0;
+	}
+	
+	uint64_t target = (total * percentile + 99) / 100;
+	uint64_t sum = 0;
+	
+	for (uint32_t i = 0; i < AS_NODE_LATENCY_BUCKETS; i++) {
+		sum += counts[i];
+		
+		if (sum >= target) {
+			return 1ULL << i;
+		}
+	}
+	return 1ULL << (AS_NODE_LATENCY_BUCKETS - 1);
+}
+
+void
+as_node_decay_latency(as_node* node)
+{
+	uint64_t total = 0;
+	
+	for (uint32_t i = 0; i < AS_NODE_LATENCY_BUCKETS; i++) {
+		total += ck_pr_load_32(&node->latency_buckets[i]);
+	}
+	
+	if (total < AS_NODE_LATENCY_WINDOW) {
+		return;
+	}
+	
+	// Samples added concurrently by command threads may be lost.  The histogram is
+	// only an estimate, so this is cheaper than a compare-and-swap loop.
+	for (uint32_t i = 0; i < AS_NODE_LATENCY_BUCKETS; i++) {
+		ck_pr_store_32(&node->latency_buckets[i], ck_pr_load_32(&node->latency_buckets[i]) >> 1);
+	}
+}
+
+bool
+as_node_breaker_probe(as_node* node)
+{
+	uint64_t open_ms = ck_pr_load_64(&node->breaker_open_ms);
+	uint64_t now = cf_getms();
+	
+	if (now - open_ms < node->cluster->breaker_open_ms) {
+		return false;
+	}
+	
+	// Only the thread that moves the timestamp forward sends the probe.  If the probe
+	// never reports back, another is allowed after the next interval.
+	if (! ck_pr_cas_64(&node->breaker_open_ms, open_ms, now)) {
+		return false;
+	}
+	ck_pr_store_32(&node->breaker_state, AS_NODE_BREAKER_HALF_OPEN);
+	as_log_info("Node %s circuit breaker half-open", node->name);
+	return true;
+}
+
+void
+as_node_breaker_failure(as_node* node)
+{
+	as_cluster* cluster = node->cluster;
+	
+	if (cluster->breaker_errors == 0) {
+		return;
+	}
+	
+	uint32_t errors = ck_pr_faa_32(&node->breaker_errors, 1) + 1;
+	uint32_t state = ck_pr_load_32(&node->breaker_state);
+	
+	if (state == AS_NODE_BREAKER_OPEN || (state == AS_NODE_BREAKER_CLOSED && errors < cluster->breaker_errors)) {
+		return;
+	}
+	
+	// Timestamp must be visible before the state, so an opened breaker is not probed at once.
+	ck_pr_store_64(&node->breaker_open_ms, cf_getms());
+	ck_pr_fence_store();
+	
+	if (ck_pr_cas_32(&node->breaker_state, state, AS_NODE_BREAKER_OPEN)) {
+		ck_pr_inc_64(&cluster->breaker_trips);
+		as_log_warn("Node %s circuit breaker open after %u errors", node->name, errors);
+	}
+}
+
+void
+as_node_breaker_close(as_node* node)
+{
+	if (ck_pr_cas_32(&node->breaker_state, AS_NODE_BREAKER_HALF_OPEN, AS_NODE_BREAKER_CLOSED) ||
+		ck_pr_cas_32(&node->breaker_state, AS_NODE_BREAKER_OPEN, AS_NODE_BREAKER_CLOSED)) {
+		as_log_info("Node %s circuit breaker closed", node->name);
+	}
+}
+
 static as_status
 as_node_authenticate_connection(as_error* err, as_node* node, uint64_t deadline_ms, int* fd)
 {
@@ -149,8 +323,8 @@ as_node_authenticate_connection(as_error* err, as_node* node, uint64_t deadline_
 	return AEROSPIKE_OK;
 }
 
-static as_status
-as_node_create_connection(as_error* err, as_node* node, uint64_t deadline_ms, int* fd)
+as_status
+as_node_create_socket(as_error* err, as_node* node, int* fd)
 {
 	// Create a non-blocking socket.
 	as_status status = as_socket_create_nb(err, fd);
@@ -166,7 +340,7 @@ as_node_create_connection(as_error* err, as_node* node, uint64_t deadline_ms, in
 	
 	if (as_socket_start_connect_nb(&err_local, *fd, &primary->addr) == AEROSPIKE_OK) {
 		// Connection started ok - we have our socket.
-		return as_node_authenticate_connection(err, node, deadline_ms, fd);
+		return AEROSPIKE_OK;
 	}
 	
 	// Try other addresses.
@@ -182,7 +356,7 @@ as_node_create_connection(as_error* err, as_node* node, uint64_t deadline_ms, in
 				// It's just a hint, not a requirement to try this new address first.
 				as_log_debug("Change node address %s %s:%d", node->name, address->name, (int)cf_swap_from_be16(address->addr.sin_port));
 				ck_pr_store_32(&node->address_index, i);
-				return as_node_authenticate_connection(err, node, deadline_ms, fd);
+				return AEROSPIKE_OK;
 			}
 		}
 	}
@@ -194,106 +368,166 @@ as_node_create_connection(as_error* err, as_node* node, uint64_t deadline_ms, in
 			node->name, primary->name, (int)cf_swap_from_be16(primary->addr.sin_port))
 }
 
-as_status
-as_node_get_connection(as_error* err, as_node* node, uint64_t deadline_ms, int* fd)
+static as_status
+as_node_create_connection(as_error* err, as_node* node, uint64_t deadline_ms, int* fd)
 {
-	//cf_queue* q = asyncfd ? node->conn_q_asyncfd : node->conn_q;
-	cf_queue* q = node->conn_q;
+	as_status status = as_node_create_socket(err, node, fd);
 	
-	while (1) {
-		int rv = cf_queue_pop(q, fd, CF_QUEUE_NOWAIT);
-		
-		if (rv == CF_QUEUE_OK) {
-			if (as_socket_validate(*fd, true)) {
+	if (status) {
+		return status;
+	}
+	return as_node_authenticate_connection(err, node, deadline_ms, fd);
+}
+
+/**
+ *	Check pooled connection before reuse.  Invalid connections are closed.
+ */
+static inline bool
+as_node_check_connection(as_conn_pool* pool, as_connection* conn, uint32_t validate_ms)
+{
+	// A connection returned moments ago is still connected unless the server
+	// failed in between, which the command itself will detect.  Skip the peek.
+	if (cf_getms() - conn->last_used < validate_ms || as_socket_validate(conn->fd, true)) {
+		return true;
+	}
+	// as_socket_validate() closes the socket.  Free the rest of the connection.
+	as_conn_pool_closed(pool);
+	cf_free(conn);
+	return false;
+}
+
+/**
+ *	Open new connection.  Room must already be reserved in pool.
+ */
+static as_status
+as_node_open_connection(as_error* err, as_node* node, uint64_t deadline_ms, as_connection** conn)
+{
+	as_conn_pool* pool = &node->conn_pool;
+	int fd;
+	as_status status = as_node_create_connection(err, node, deadline_ms, &fd);
+	
+	if (status) {
+		if (status == AEROSPIKE_ERR_CLIENT || status == AEROSPIKE_ERR_TIMEOUT) {
+			as_node_breaker_failure(node);
+		}
+		as_conn_pool_release(pool);
+		*conn = 0;
+		return status;
+	}
+	
+	*conn = as_connection_create(fd);
+	
+	if (! *conn) {
+		as_close(fd);
+		as_conn_pool_release(pool);
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate connection");
+	}
+	as_conn_pool_incr_creates(pool);
+	return AEROSPIKE_OK;
+}
+
+/**
+ *	Get pooled connection or open a new one.  If the node is at its connection limit,
+ *	wait for a connection when wait is true.  Otherwise, return with no connection.
+ */
+static as_status
+as_node_acquire_connection(as_error* err, as_node* node, uint64_t deadline_ms, bool wait, as_connection** conn)
+{
+	as_conn_pool* pool = &node->conn_pool;
+	uint32_t validate_ms = node->cluster->conn_validate_ms;
+	
+	while (true) {
+		if (as_conn_pool_get(pool, conn)) {
+			if (as_node_check_connection(pool, *conn, validate_ms)) {
 				return AEROSPIKE_OK;
 			}
+			continue;
 		}
-		else if (rv == CF_QUEUE_EMPTY) {
-			// We exhausted the queue. Try creating a fresh socket.
-			return as_node_create_connection(err, node, deadline_ms, fd);
+		
+		// We exhausted the pool. Try creating a fresh socket.
+		if (as_conn_pool_reserve(pool)) {
+			break;
 		}
-		else {
-			*fd = -1;
-			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad return value from cf_queue_pop");
+		
+		if (! wait) {
+			*conn = 0;
+			return AEROSPIKE_OK;
+		}
+		
+		// Node is at its connection limit.  Wait for another thread to return one.
+		if (! as_conn_pool_wait(pool, deadline_ms, conn)) {
+			*conn = 0;
+			return as_error_update(err, AEROSPIKE_ERR_TIMEOUT,
+				"Timeout waiting for connection: node=%s max=%u", node->name, pool->max);
+		}
+		
+		if (! *conn) {
+			// Room for a new connection was reserved.
+			break;
+		}
+		
+		if (as_node_check_connection(pool, *conn, validate_ms)) {
+			return AEROSPIKE_OK;
 		}
 	}
+	return as_node_open_connection(err, node, deadline_ms, conn);
 }
 
-static inline int
-as_node_get_info_connection(as_error* err, as_node* node, uint64_t deadline_ms)
+as_status
+as_node_get_connection(as_error* err, as_node* node, uint64_t deadline_ms, as_connection** conn)
 {
-	if (node->info_fd < 0) {
-		// Try to open a new socket.
-		return as_node_create_connection(err, node, deadline_ms, &node->info_fd);
-	}
-	return AEROSPIKE_OK;
+	return as_node_acquire_connection(err, node, deadline_ms, true, conn);
 }
 
-static void
-as_node_close_info_connection(as_node* node)
+as_status
+as_node_get_connection_nowait(as_error* err, as_node* node, uint64_t deadline_ms, as_connection** conn)
 {
-	shutdown(node->info_fd, SHUT_RDWR);
-	as_close(node->info_fd);
-	node->info_fd = -1;
+	return as_node_acquire_connection(err, node, deadline_ms, false, conn);
 }
 
-static uint8_t*
-as_node_get_info(as_error* err, as_node* node, const char* names, size_t names_len, uint64_t deadline_ms, uint8_t* stack_buf)
+bool
+as_node_try_connection(as_node* node, as_connection** conn)
 {
-	int fd = node->info_fd;
-	
-	// Prepare the write request buffer.
-	size_t write_size = sizeof(as_proto) + names_len;
-	as_proto* proto = (as_proto*)stack_buf;
-	
-	proto->sz = names_len;
-	proto->version = AS_MESSAGE_VERSION;
-	proto->type = AS_INFO_MESSAGE_TYPE;
-	as_proto_swap_to_be(proto);
-	
-	memcpy((void*)(stack_buf + sizeof(as_proto)), (const void*)names, names_len);
-
-	// Write the request. Note that timeout_ms is never 0.
-	if (as_socket_write_deadline(err, fd, stack_buf, write_size, deadline_ms) != AEROSPIKE_OK) {
-		return 0;
-	}
-	
-	// Reuse the buffer, read the response - first 8 bytes contains body size.
-	if (as_socket_read_deadline(err, fd, stack_buf, sizeof(as_proto), deadline_ms) != AEROSPIKE_OK) {
-		return 0;
-	}
-	
-	proto = (as_proto*)stack_buf;
-	as_proto_swap_from_be(proto);
-	
-	// Sanity check body size.
-	if (proto->sz == 0 || proto->sz > 512 * 1024) {
-		as_error_update(err, AEROSPIKE_ERR_CLIENT, "Invalid info response size %lu", proto->sz);
-		return 0;
-	}
-	
-	// Allocate a buffer if the response is bigger than the stack buffer -
-	// caller must free it if this call succeeds. Note that proto is overwritten
-	// if stack_buf is used, so we save the sz field here.
-	size_t proto_sz = proto->sz;
-	uint8_t* rbuf = proto_sz >= INFO_STACK_BUF_SIZE ? (uint8_t*)cf_malloc(proto_sz + 1) : stack_buf;
+	as_conn_pool* pool = &node->conn_pool;
+	uint32_t validate_ms = node->cluster->conn_validate_ms;
 	
-	if (! rbuf) {
-		as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Allocation failed for info response");
-		return 0;
+	while (as_conn_pool_get(pool, conn)) {
+		if (as_node_check_connection(pool, *conn, validate_ms)) {
+			return true;
+		}
 	}
+	*conn = 0;
+	return false;
+}
+
+uint32_t
+as_node_create_min_connections(as_node* node, uint32_t count, uint64_t deadline_ms)
+{
+	as_cluster* cluster = node->cluster;
+	as_conn_pool* pool = &node->conn_pool;
+	uint32_t opened = 0;
 	
-	// Read the response body.
-	if (as_socket_read_deadline(err, fd, rbuf, proto_sz, deadline_ms) != AEROSPIKE_OK) {
-		if (rbuf != stack_buf) {
-			cf_free(rbuf);
+	while (ck_pr_load_32(&pool->size) < count && as_conn_pool_reserve(pool)) {
+		as_error err;
+		as_connection* conn;
+		
+		if (as_node_open_connection(&err, node, deadline_ms, &conn) != AEROSPIKE_OK) {
+			as_log_warn("Node %s failed to create minimum connections: %s", node->name, err.message);
+			break;
 		}
-		return 0;
+		
+		as_node_put_connection(node, conn, cluster->conn_queue_size);
+		opened++;
 	}
-	
-	// Null-terminate the response body and return it.
-	rbuf[proto_sz] = 0;
-	return rbuf;
+	return opened;
+}
+
+static void
+as_node_close_info_connection(as_node* node)
+{
+	shutdown(node->info_fd, SHUT_RDWR);
+	as_close(node->info_fd);
+	node->info_fd = -1;
 }
 
 static bool
@@ -478,60 +712,384 @@ const char INFO_STR_CHECK[] = "node\npartition-generation\nservices\n";
 const char INFO_STR_GET_REPLICAS[] = "partition-generation\nreplicas-master\nreplicas-prole\n";
 
 /**
- *	Request current status from server node.
+ *	@private
+ *	Info request states.
  */
-as_status
-as_node_refresh(as_cluster* cluster, as_error* err, as_node* node, as_vector* /* <as_friend> */ friends)
+#define AS_INFO_WRITE 0
+#define AS_INFO_READ_HEADER 1
+#define AS_INFO_READ_BODY 2
+#define AS_INFO_DONE 3
+#define AS_INFO_FAILED 4
+
+/**
+ *	@private
+ *	Non-blocking request on a node's info socket.  Requests to all nodes are
+ *	driven by a single poll() loop in the tend thread.
+ */
+typedef struct as_info_request_s {
+	as_node* node;
+	as_error err;
+	
+	// Request while writing, response body while reading.
+	uint8_t* buf;
+	size_t len;
+	size_t pos;
+	as_proto proto;
+	uint8_t state;
+	
+	// Connection is being authenticated.
+	bool auth;
+	
+	// Socket has been polled since the request started.
+	bool waited;
+	
+	bool update_partitions;
+} as_info_request;
+
+static void
+as_info_request_fail(as_info_request* req)
 {
-	uint64_t deadline_ms = as_socket_deadline(cluster->conn_timeout_ms);
-	as_status status = as_node_get_info_connection(err, node, deadline_ms);
+	if (req->state == AS_INFO_WRITE || req->state == AS_INFO_READ_BODY) {
+		cf_free(req->buf);
+	}
+	req->buf = 0;
+	req->state = AS_INFO_FAILED;
+	as_node_close_info_connection(req->node);
+}
+
+static void
+as_info_request_start(as_info_request* req, const char* names, size_t names_len)
+{
+	size_t len = sizeof(as_proto) + names_len;
+	uint8_t* buf = cf_malloc(len);
 	
-	if (status != AEROSPIKE_OK) {
-		return status;
+	as_proto* proto = (as_proto*)buf;
+	proto->sz = names_len;
+	proto->version = AS_MESSAGE_VERSION;
+	proto->type = AS_INFO_MESSAGE_TYPE;
+	as_proto_swap_to_be(proto);
+	memcpy(buf + sizeof(as_proto), names, names_len);
+	
+	req->buf = buf;
+	req->len = len;
+	req->pos = 0;
+	req->state = AS_INFO_WRITE;
+	req->waited = false;
+}
+
+static void
+as_info_request_start_auth(as_info_request* req)
+{
+	as_cluster* cluster = req->node->cluster;
+	
+	// Header, command header and two string fields.
+	uint8_t* buf = cf_malloc(sizeof(as_proto) + 16 + 10 + strlen(cluster->user) + strlen(cluster->password));
+	
+	req->buf = buf;
+	req->len = as_authenticate_set(cluster->user, cluster->password, buf);
+	req->pos = 0;
+	req->state = AS_INFO_WRITE;
+	req->auth = true;
+	req->waited = false;
+}
+
+/**
+ *	Response has been read.  Check authentication result and send the info request
+ *	that authentication was holding back.
+ */
+static void
+as_info_request_auth_complete(as_info_request* req, const char* names, size_t names_len)
+{
+	// Result code follows the proto header at offset 9 of the admin response.
+	as_status status = req->len > 1 ? req->buf[1] : AEROSPIKE_ERR_CLIENT;
+	cf_free(req->buf);
+	req->buf = 0;
+	req->auth = false;
+	
+	if (status) {
+		as_error_set_message(&req->err, status, as_error_string(status));
+		req->state = AS_INFO_FAILED;
+		as_node_close_info_connection(req->node);
+		return;
 	}
+	as_info_request_start(req, names, names_len);
+}
+
+/**
+ *	Transfer as much data as the socket allows without blocking.
+ */
+static void
+as_info_request_io(as_info_request* req, const char* names, size_t names_len)
+{
+	int fd = req->node->info_fd;
 	
-	uint8_t stack_buf[INFO_STACK_BUF_SIZE];
-	uint8_t* buf = as_node_get_info(err, node, INFO_STR_CHECK, sizeof(INFO_STR_CHECK) - 1, deadline_ms, stack_buf);
+	while (req->state < AS_INFO_DONE) {
+		ssize_t bytes;
+		
+		if (req->state == AS_INFO_WRITE) {
+			bytes = send(fd, req->buf + req->pos, req->len - req->pos, MSG_NOSIGNAL);
+		}
+		else {
+			uint8_t* buf = (req->state == AS_INFO_READ_HEADER)? (uint8_t*)&req->proto : req->buf;
+			bytes = recv(fd, buf + req->pos, req->len - req->pos, 0);
+		}
+		
+		if (bytes <= 0) {
+			if (bytes < 0 && errno == EINTR) {
+				continue;
+			}
+			
+			if (bytes < 0 && (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINPROGRESS ||
+				(errno == ENOTCONN && ! req->waited))) {
+				// Wait for poll.  MacOS returns "socket not connected" while a non-blocking
+				// connect is in progress.
+				return;
+			}
+			
+			if (bytes == 0) {
+				as_error_set_message(&req->err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+			}
+			else {
+				as_error_update(&req->err, AEROSPIKE_ERR_CLIENT, "Socket %s error: %d",
+					(req->state == AS_INFO_WRITE)? "write" : "read", errno);
+			}
+			as_info_request_fail(req);
+			return;
+		}
+		
+		req->pos += bytes;
+		
+		if (req->pos < req->len) {
+			continue;
+		}
+		
+		switch (req->state) {
+			case AS_INFO_WRITE:
+				cf_free(req->buf);
+				req->buf = 0;
+				req->len = sizeof(as_proto);
+				req->pos = 0;
+				req->state = AS_INFO_READ_HEADER;
+				break;
+				
+			case AS_INFO_READ_HEADER: {
+				as_proto_swap_from_be(&req->proto);
+				size_t sz = req->proto.sz;
+				
+				// Sanity check body size.
+				if (sz == 0 || sz > 512 * 1024) {
+					as_error_update(&req->err, AEROSPIKE_ERR_CLIENT, "Invalid info response size %lu", sz);
+					as_info_request_fail(req);
+					return;
+				}
+				
+				// Caller null-terminates the body.
+				req->buf = cf_malloc(sz + 1);
+				req->len = sz;
+				req->pos = 0;
+				req->state = AS_INFO_READ_BODY;
+				break;
+			}
+				
+			default:
+				if (req->auth) {
+					as_info_request_auth_complete(req, names, names_len);
+				}
+				else {
+					req->buf[req->len] = 0;
+					req->state = AS_INFO_DONE;
+				}
+				break;
+		}
+	}
+}
+
+/**
+ *	Drive all started requests until they complete, fail or the deadline passes.
+ *	Return time spent in milliseconds.
+ */
+static uint64_t
+as_info_requests_run(as_info_request* reqs, uint32_t n, const char* names, size_t names_len, uint64_t deadline_ms)
+{
+	uint64_t begin = cf_getms();
+	struct pollfd* pfds = cf_malloc(sizeof(struct pollfd) * n);
+	uint32_t* map = cf_malloc(sizeof(uint32_t) * n);
 	
-	if (! buf) {
-		as_node_close_info_connection(node);
-		return err->code;
+	// Write requests and read any data that is already available.
+	for (uint32_t i = 0; i < n; i++) {
+		as_info_request_io(&reqs[i], names, names_len);
 	}
 	
-	as_vector values;
-	as_vector_inita(&values, sizeof(as_name_value), 4);
+	while (true) {
+		uint32_t count = 0;
+		
+		for (uint32_t i = 0; i < n; i++) {
+			as_info_request* req = &reqs[i];
+			
+			if (req->state < AS_INFO_DONE) {
+				pfds[count].fd = req->node->info_fd;
+				pfds[count].events = (req->state == AS_INFO_WRITE)? POLLOUT : POLLIN;
+				pfds[count].revents = 0;
+				map[count] = i;
+				count++;
+			}
+		}
+		
+		if (count == 0) {
+			break;
+		}
+		
+		int timeout = -1;
+		
+		if (deadline_ms) {
+			uint64_t now = cf_getms();
+			
+			if (now >= deadline_ms) {
+				for (uint32_t i = 0; i < count; i++) {
+					as_info_request* req = &reqs[map[i]];
+					as_error_update(&req->err, AEROSPIKE_ERR_TIMEOUT, "Node %s info request timed out", req->node->name);
+					as_info_request_fail(req);
+				}
+				break;
+			}
+			uint64_t ms_left = deadline_ms - now;
+			timeout = (ms_left > INT32_MAX)? INT32_MAX : (int)ms_left;
+		}
+		
+		int rv = poll(pfds, count, timeout);
+		
+		if (rv < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			
+			for (uint32_t i = 0; i < count; i++) {
+				as_info_request* req = &reqs[map[i]];
+				as_error_update(&req->err, AEROSPIKE_ERR_CLIENT, "Socket poll error: %d", errno);
+				as_info_request_fail(req);
+			}
+			break;
+		}
+		
+		for (uint32_t i = 0; i < count && rv > 0; i++) {
+			if (pfds[i].revents) {
+				// Ready, or an error/hangup that the read or write will report.
+				as_info_request* req = &reqs[map[i]];
+				req->waited = true;
+				as_info_request_io(req, names, names_len);
+				rv--;
+			}
+		}
+	}
 	
-	as_info_parse_multi_response((char*)buf, &values);
+	cf_free(map);
+	cf_free(pfds);
+	return cf_getms() - begin;
+}
+
+/**
+ *	Request current status from all active nodes.  The tend thread writes info
+ *	requests to every node's non-blocking info socket and polls the responses together,
+ *	so one slow or unreachable node delays each phase (status, then partition maps of
+ *	nodes that changed) by at most conn_timeout_ms instead of delaying every node
+ *	after it.  Each phase has its own deadline.  Responses are applied afterwards in
+ *	node order by the tend thread, the only writer of node and partition state.
+ */
+uint32_t
+as_node_refresh_all(as_cluster* cluster, as_nodes* nodes, as_vector* /* <as_friend> */ friends, uint64_t* refresh_ms)
+{
+	uint64_t deadline_ms = as_socket_deadline(cluster->conn_timeout_ms);
+	as_info_request* reqs = cf_malloc(sizeof(as_info_request) * (nodes->size + 1));
+	uint32_t n = 0;
 	
-	bool update_partitions;
-	bool response_status = as_node_process_response(cluster, node, &values, friends, &update_partitions);
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+		
+		if (! node->active) {
+			continue;
+		}
 		
-	if (buf != stack_buf) {
-		cf_free(buf);
+		as_info_request* req = &reqs[n++];
+		req->node = node;
+		req->buf = 0;
+		req->auth = false;
+		req->update_partitions = false;
+		as_error_reset(&req->err);
+		
+		if (node->info_fd < 0) {
+			// Connect is non-blocking.  Authentication runs in the poll loop.
+			if (as_node_create_socket(&req->err, node, &node->info_fd) != AEROSPIKE_OK) {
+				req->state = AS_INFO_FAILED;
+				continue;
+			}
+			
+			if (cluster->user) {
+				as_info_request_start_auth(req);
+				continue;
+			}
+		}
+		as_info_request_start(req, INFO_STR_CHECK, sizeof(INFO_STR_CHECK) - 1);
 	}
 	
-	if (response_status && update_partitions) {
-		buf = as_node_get_info(err, node, INFO_STR_GET_REPLICAS, sizeof(INFO_STR_GET_REPLICAS) - 1, deadline_ms, stack_buf);
+	*refresh_ms = as_info_requests_run(reqs, n, INFO_STR_CHECK, sizeof(INFO_STR_CHECK) - 1, deadline_ms);
+	
+	// Apply status responses and request partition maps from nodes whose generation changed.
+	as_vector values;
+	as_vector_inita(&values, sizeof(as_name_value), 4);
+	uint32_t replicas = 0;
+	
+	for (uint32_t i = 0; i < n; i++) {
+		as_info_request* req = &reqs[i];
 		
-		if (! buf) {
-			as_node_close_info_connection(node);
-			as_vector_destroy(&values);
-			return err->code;
+		if (req->state != AS_INFO_DONE) {
+			continue;
 		}
 		
 		as_vector_clear(&values);
+		as_info_parse_multi_response((char*)req->buf, &values);
 		
-		as_info_parse_multi_response((char*)buf, &values);
-
-		if (buf) {
+		bool update_partitions;
+		bool response_status = as_node_process_response(cluster, req->node, &values, friends, &update_partitions);
+		cf_free(req->buf);
+		req->buf = 0;
+		
+		if (response_status && update_partitions) {
+			req->update_partitions = true;
+			as_info_request_start(req, INFO_STR_GET_REPLICAS, sizeof(INFO_STR_GET_REPLICAS) - 1);
+			replicas++;
+		}
+	}
+	
+	if (replicas > 0) {
+		// A node that hung in the status phase may have used up the first deadline.
+		// Nodes that answered still get the full timeout for their partition maps.
+		deadline_ms = as_socket_deadline(cluster->conn_timeout_ms);
+		*refresh_ms += as_info_requests_run(reqs, n, INFO_STR_GET_REPLICAS, sizeof(INFO_STR_GET_REPLICAS) - 1, deadline_ms);
+	}
+	
+	uint32_t refresh_count = 0;
+	
+	for (uint32_t i = 0; i < n; i++) {
+		as_info_request* req = &reqs[i];
+		as_node* node = req->node;
+		
+		if (req->state != AS_INFO_DONE) {
+			as_log_info("Node %s refresh failed: %s %s", node->name, as_error_string(req->err.code), req->err.message);
+			node->failures++;
+			continue;
+		}
+		
+		if (req->update_partitions) {
+			as_vector_clear(&values);
+			as_info_parse_multi_response((char*)req->buf, &values);
 			as_node_process_partitions(cluster, node, &values);
-			
-			if (buf != stack_buf) {
-				cf_free(buf);
-			}
+			cf_free(req->buf);
 		}
+		node->failures = 0;
+		refresh_count++;
 	}
 	
 	as_vector_destroy(&values);
-	return status;
+	cf_free(reqs);
+	return refresh_count;
 }
@@ -0,0 +1,633 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_pack.h>
+#include <aerospike/as_boolean.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_double.h>
+#include <aerospike/as_geojson.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_pair.h>
+#include <aerospike/as_string.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <string.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct as_pack_size_data_s {
+	uint64_t size;
+	bool ok;
+} as_pack_size_data;
+
+/******************************************************************************
+ *	SIZE
+ *
+ *	Encodings match the as_msgpack serializer: integers use the smallest form,
+ *	strings, blobs and geojson are raw values prefixed with their particle type
+ *	byte, and raw/array/map headers use the fix, 16 and 32 bit forms.
+ *****************************************************************************/
+
+static bool as_pack_size_val(const as_val* val, as_pack_size_data* data);
+
+static inline uint32_t
+as_pack_int64_size(int64_t v)
+{
+	if (v < -(1LL << 5)) {
+		if (v < -(1LL << 15)) {
+			return (v < -(1LL << 31))? 9 : 5;
+		}
+		return (v < -(1LL << 7))? 3 : 2;
+	}
+
+	if (v < (1LL << 7)) {
+		return 1;
+	}
+
+	if (v < (1LL << 16)) {
+		return (v < (1LL << 8))? 2 : 3;
+	}
+	return (v < (1LL << 32))? 5 : 9;
+}
+
+static inline uint32_t
+as_pack_raw_size(uint32_t len)
+{
+	if (len < 32) {
+		return 1 + len;
+	}
+	return ((len < 65536)? 3 : 5) + len;
+}
+
+static inline uint32_t
+as_pack_container_header_size(uint32_t n)
+{
+	if (n < 16) {
+		return 1;
+	}
+	return (n < 65536)? 3 : 5;
+}
+
+static bool
+as_pack_size_list_cb(as_val* val, void* udata)
+{
+	return as_pack_size_val(val, udata);
+}
+
+static bool
+as_pack_size_map_cb(const as_val* key, const as_val* val, void* udata)
+{
+	return as_pack_size_val(key, udata) && as_pack_size_val(val, udata);
+}
+
+static bool
+as_pack_size_val(const as_val* val, as_pack_size_data* data)
+{
+	if (! val) {
+		data->size += 1;
+		return true;
+	}
+
+	switch (as_val_type(val)) {
+		case AS_NIL:
+		case AS_BOOLEAN:
+			data->size += 1;
+			return true;
+
+		case AS_INTEGER:
+			data->size += as_pack_int64_size(as_integer_fromval(val)->value);
+			return true;
+
+		case AS_DOUBLE:
+			data->size += 9;
+			return true;
+
+		case AS_STRING: {
+			as_string* v = as_string_fromval(val);
+			data->size += as_pack_raw_size((uint32_t)as_string_len(v) + 1);
+			return true;
+		}
+
+		case AS_GEOJSON: {
+			as_geojson* v = as_geojson_fromval(val);
+			data->size += as_pack_raw_size((uint32_t)as_geojson_len(v) + 1);
+			return true;
+		}
+
+		case AS_BYTES: {
+			as_bytes* v = as_bytes_fromval(val);
+			data->size += as_pack_raw_size(v->size + 1);
+			return true;
+		}
+
+		case AS_LIST: {
+			as_list* v = as_list_fromval((as_val*)val);
+			data->size += as_pack_container_header_size(as_list_size(v));
+			return as_list_foreach(v, as_pack_size_list_cb, data) && data->ok;
+		}
+
+		case AS_MAP: {
+			as_map* v = as_map_fromval(val);
+			data->size += as_pack_container_header_size(as_map_size(v));
+			return as_map_foreach(v, as_pack_size_map_cb, data) && data->ok;
+		}
+
+		case AS_PAIR: {
+			as_pair* v = as_pair_fromval(val);
+			data->size += 1;
+			return as_pack_size_val(as_pair_1(v), data) && as_pack_size_val(as_pair_2(v), data);
+		}
+
+		default:
+			// Records and unknown types are left to the serializer.
+			data->ok = false;
+			return false;
+	}
+}
+
+/******************************************************************************
+ *	WRITE
+ *****************************************************************************/
+
+static uint8_t* as_pack_write_val(uint8_t* p, const as_val* val);
+
+static inline uint8_t*
+as_pack_write_int64(uint8_t* p, int64_t v)
+{
+	if (v < -(1LL << 5)) {
+		if (v < -(1LL << 15)) {
+			if (v < -(1LL << 31)) {
+				*p++ = 0xd3;
+				*(uint64_t*)p = cf_swap_to_be64((uint64_t)v);
+				return p + 8;
+			}
+			*p++ = 0xd2;
+			*(uint32_t*)p = cf_swap_to_be32((uint32_t)v);
+			return p + 4;
+		}
+
+		if (v < -(1LL << 7)) {
+			*p++ = 0xd1;
+			*(uint16_t*)p = cf_swap_to_be16((uint16_t)v);
+			return p + 2;
+		}
+		*p++ = 0xd0;
+		*p++ = (uint8_t)v;
+		return p;
+	}
+
+	if (v < (1LL << 7)) {
+		// Positive and negative fixint.
+		*p++ = (uint8_t)v;
+		return p;
+	}
+
+	if (v < (1LL << 16)) {
+		if (v < (1LL << 8)) {
+			*p++ = 0xcc;
+			*p++ = (uint8_t)v;
+			return p;
+		}
+		*p++ = 0xcd;
+		*(uint16_t*)p = cf_swap_to_be16((uint16_t)v);
+		return p + 2;
+	}
+
+	if (v < (1LL << 32)) {
+		*p++ = 0xce;
+		*(uint32_t*)p = cf_swap_to_be32((uint32_t)v);
+		return p + 4;
+	}
+	*p++ = 0xcf;
+	*(uint64_t*)p = cf_swap_to_be64((uint64_t)v);
+	return p + 8;
+}
+
+static inline uint8_t*
+as_pack_write_header(uint8_t* p, uint32_t n, uint8_t fix, uint8_t type16, uint8_t type32, uint32_t fix_max)
+{
+	if (n < fix_max) {
+		*p++ = fix | (uint8_t)n;
+		return p;
+	}
+
+	if (n < 65536) {
+		*p++ = type16;
+		*(uint16_t*)p = cf_swap_to_be16((uint16_t)n);
+		return p + 2;
+	}
+	*p++ = type32;
+	*(uint32_t*)p = cf_swap_to_be32(n);
+	return p + 4;
+}
+
+static inline uint8_t*
+as_pack_write_raw(uint8_t* p, uint8_t type, const void* buf, uint32_t len)
+{
+	p = as_pack_write_header(p, len + 1, 0xa0, 0xda, 0xdb, 32);
+	*p++ = type;
+	memcpy(p, buf, len);
+	return p + len;
+}
+
+static bool
+as_pack_write_list_cb(as_val* val, void* udata)
+{
+	uint8_t** pp = udata;
+	*pp = as_pack_write_val(*pp, val);
+	return true;
+}
+
+static bool
+as_pack_write_map_cb(const as_val* key, const as_val* val, void* udata)
+{
+	uint8_t** pp = udata;
+	*pp = as_pack_write_val(*pp, key);
+	*pp = as_pack_write_val(*pp, val);
+	return true;
+}
+
+static uint8_t*
+as_pack_write_val(uint8_t* p, const as_val* val)
+{
+	if (! val) {
+		*p++ = 0xc0;
+		return p;
+	}
+
+	switch (as_val_type(val)) {
+		case AS_NIL:
+		default:
+			*p++ = 0xc0;
+			return p;
+
+		case AS_BOOLEAN:
+			*p++ = as_boolean_get(as_boolean_fromval(val))? 0xc3 : 0xc2;
+			return p;
+
+		case AS_INTEGER:
+			return as_pack_write_int64(p, as_integer_fromval(val)->value);
+
+		case AS_DOUBLE: {
+			*p++ = 0xcb;
+			*(double*)p = cf_swap_to_big_float64(as_double_fromval(val)->value);
+			return p + 8;
+		}
+
+		case AS_STRING: {
+			as_string* v = as_string_fromval(val);
+			return as_pack_write_raw(p, AS_BYTES_STRING, v->value, (uint32_t)as_string_len(v));
+		}
+
+		case AS_GEOJSON: {
+			as_geojson* v = as_geojson_fromval(val);
+			return as_pack_write_raw(p, AS_BYTES_GEOJSON, v->value, (uint32_t)as_geojson_len(v));
+		}
+
+		case AS_BYTES: {
+			as_bytes* v = as_bytes_fromval(val);
+			return as_pack_write_raw(p, v->type, v->value, v->size);
+		}
+
+		case AS_LIST: {
+			as_list* v = as_list_fromval((as_val*)val);
+			p = as_pack_write_header(p, as_list_size(v), 0x90, 0xdc, 0xdd, 16);
+			as_list_foreach(v, as_pack_write_list_cb, &p);
+			return p;
+		}
+
+		case AS_MAP: {
+			as_map* v = as_map_fromval(val);
+			p = as_pack_write_header(p, as_map_size(v), 0x80, 0xde, 0xdf, 16);
+			as_map_foreach(v, as_pack_write_map_cb, &p);
+			return p;
+		}
+
+		case AS_PAIR: {
+			as_pair* v = as_pair_fromval(val);
+			*p++ = 0x92;
+			p = as_pack_write_val(p, as_pair_1(v));
+			return as_pack_write_val(p, as_pair_2(v));
+		}
+	}
+}
+
+/******************************************************************************
+ *	UNPACK
+ *
+ *	Reads packed values in place.  All msgpack formats are accepted so data
+ *	written by other clients can be walked as well.
+ *****************************************************************************/
+
+static inline uint64_t
+as_unpack_uint(const uint8_t* p, uint32_t n)
+{
+	switch (n) {
+		case 1:
+			return *p;
+		case 2:
+			return cf_swap_from_be16(*(uint16_t*)p);
+		case 4:
+			return cf_swap_from_be32(*(uint32_t*)p);
+		default:
+			return cf_swap_from_be64(*(uint64_t*)p);
+	}
+}
+
+/**
+ *	Parse header of value at p.  Set hdr to header size, len to payload size and
+ *	count to number of contained values (map entries count as two).
+ */
+static bool
+as_unpack_header(const uint8_t* p, const uint8_t* end, uint32_t* hdr, uint64_t* len, uint64_t* count)
+{
+	if (p >= end) {
+		return false;
+	}
+
+	uint8_t b = *p;
+	uint32_t n = 0;        // Size of length or count field.
+	uint32_t fixed = 0;    // Payload size when not given by a length field.
+	bool is_count = false;
+	uint32_t mult = 1;
+
+	*count = 0;
+
+	if (b <= 0x7f || b >= 0xe0 || b == 0xc0 || b == 0xc2 || b == 0xc3) {
+		*hdr = 1;
+		*len = 0;
+		return true;
+	}
+
+	if (b <= 0x8f) {
+		*hdr = 1;
+		*len = 0;
+		*count = (uint64_t)(b & 0x0f) * 2;
+		return true;
+	}
+
+	if (b <= 0x9f) {
+		*hdr = 1;
+		*len = 0;
+		*count = b & 0x0f;
+		return true;
+	}
+
+	if (b <= 0xbf) {
+		*hdr = 1;
+		*len = b & 0x1f;
+		return p + 1 + *len <= end;
+	}
+
+	switch (b) {
+		case 0xc4: case 0xd9: n = 1; break;
+		case 0xc5: case 0xda: n = 2; break;
+		case 0xc6: case 0xdb: n = 4; break;
+		case 0xc7: n = 1; fixed = 1; break;
+		case 0xc8: n = 2; fixed = 1; break;
+		case 0xc9: n = 4; fixed = 1; break;
+		case 0xca: fixed = 4; break;
+		case 0xcb: fixed = 8; break;
+		case 0xcc: case 0xd0: fixed = 1; break;
+		case 0xcd: case 0xd1: fixed = 2; break;
+		case 0xce: case 0xd2: fixed = 4; break;
+		case 0xcf: case 0xd3: fixed = 8; break;
+		case 0xd4: fixed = 2; break;
+		case 0xd5: fixed = 3; break;
+		case 0xd6: fixed = 5; break;
+		case 0xd7: fixed = 9; break;
+		case 0xd8: fixed = 17; break;
+		case 0xdc: n = 2; is_count = true; break;
+		case 0xdd: n = 4; is_count = true; break;
+		case 0xde: n = 2; is_count = true; mult = 2; break;
+		case 0xdf: n = 4; is_count = true; mult = 2; break;
+		default: return false;
+	}
+
+	if (p + 1 + n > end) {
+		return false;
+	}
+
+	uint64_t v = n ? as_unpack_uint(p + 1, n) : 0;
+	*hdr = 1 + n;
+
+	if (is_count) {
+		*len = 0;
+		*count = v * mult;
+		return true;
+	}
+
+	// Extension length excludes its type byte.
+	*len = (n ? v : 0) + fixed;
+	return p + *hdr + *len <= end;
+}
+
+/**
+ *	Skip one value, including all values it contains.
+ */
+static const uint8_t*
+as_unpack_skip(const uint8_t* p, const uint8_t* end)
+{
+	uint64_t remaining = 1;
+
+	while (remaining > 0) {
+		uint32_t hdr;
+		uint64_t len;
+		uint64_t count;
+
+		if (! as_unpack_header(p, end, &hdr, &len, &count)) {
+			return 0;
+		}
+		p += hdr + len;
+		remaining += count - 1;
+	}
+	return p;
+}
+
+/**
+ *	Read container header of expected kind.  Return number of elements (map entries count once).
+ */
+static bool
+as_unpack_container(const uint8_t** pp, const uint8_t* end, bool map, uint64_t* n)
+{
+	const uint8_t* p = *pp;
+	uint32_t hdr;
+	uint64_t len;
+	uint64_t count;
+
+	if (! as_unpack_header(p, end, &hdr, &len, &count)) {
+		return false;
+	}
+
+	uint8_t b = *p;
+	bool is_map = (b >= 0x80 && b <= 0x8f) || b == 0xde || b == 0xdf;
+	bool is_list = (b >= 0x90 && b <= 0x9f) || b == 0xdc || b == 0xdd;
+
+	if (map ? ! is_map : ! is_list) {
+		return false;
+	}
+	*pp = p + hdr;
+	*n = map ? count / 2 : count;
+	return true;
+}
+
+/**
+ *	Does packed value at p equal key?  Only integer and string keys are compared.
+ */
+static bool
+as_unpack_key_equals(const uint8_t* p, const uint8_t* end, const as_val* key)
+{
+	uint32_t hdr;
+	uint64_t len;
+	uint64_t count;
+
+	if (! as_unpack_header(p, end, &hdr, &len, &count)) {
+		return false;
+	}
+
+	uint8_t b = *p;
+
+	if (as_val_type(key) == AS_STRING) {
+		as_string* str = (as_string*)key;
+		size_t str_len = as_string_len(str);
+		bool is_raw = (b >= 0xa0 && b <= 0xbf) || (b >= 0xc4 && b <= 0xc6) || (b >= 0xd9 && b <= 0xdb);
+
+		// Strings are packed with their particle type as the first payload byte.
+		return is_raw && len == str_len + 1 && p[hdr] == AS_BYTES_STRING &&
+			memcmp(p + hdr + 1, str->value, str_len) == 0;
+	}
+
+	if (as_val_type(key) == AS_INTEGER) {
+		int64_t k = ((as_integer*)key)->value;
+		int64_t v;
+
+		if (b <= 0x7f) {
+			v = b;
+		}
+		else if (b >= 0xe0) {
+			v = (int8_t)b;
+		}
+		else if (b >= 0xcc && b <= 0xcf) {
+			uint64_t u = as_unpack_uint(p + 1, (uint32_t)len);
+
+			if (u > INT64_MAX) {
+				return false;
+			}
+			v = (int64_t)u;
+		}
+		else if (b >= 0xd0 && b <= 0xd3) {
+			uint64_t u = as_unpack_uint(p + 1, (uint32_t)len);
+
+			switch (len) {
+				case 1: v = (int8_t)u; break;
+				case 2: v = (int16_t)u; break;
+				case 4: v = (int32_t)u; break;
+				default: v = (int64_t)u; break;
+			}
+		}
+		else {
+			return false;
+		}
+		return v == k;
+	}
+	return false;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+bool
+as_pack_size(const as_val* val, uint32_t* size)
+{
+	as_pack_size_data data = {0, true};
+
+	if (! as_pack_size_val(val, &data) || data.size > UINT32_MAX) {
+		return false;
+	}
+	*size = (uint32_t)data.size;
+	return true;
+}
+
+uint8_t*
+as_pack_write(uint8_t* p, const as_val* val)
+{
+	return as_pack_write_val(p, val);
+}
+
+bool
+as_unpack_list_element(const uint8_t* buf, uint32_t size, uint32_t index, const uint8_t** elem, uint32_t* elem_size)
+{
+	const uint8_t* p = buf;
+	const uint8_t* end = buf + size;
+	uint64_t n;
+
+	if (! as_unpack_container(&p, end, false, &n) || index >= n) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < index; i++) {
+		if (! (p = as_unpack_skip(p, end))) {
+			return false;
+		}
+	}
+
+	const uint8_t* next = as_unpack_skip(p, end);
+
+	if (! next) {
+		return false;
+	}
+	*elem = p;
+	*elem_size = (uint32_t)(next - p);
+	return true;
+}
+
+bool
+as_unpack_map_value(const uint8_t* buf, uint32_t size, const as_val* key, const uint8_t** val, uint32_t* val_size)
+{
+	const uint8_t* p = buf;
+	const uint8_t* end = buf + size;
+	uint64_t n;
+
+	if (! as_unpack_container(&p, end, true, &n)) {
+		return false;
+	}
+
+	for (uint64_t i = 0; i < n; i++) {
+		bool found = as_unpack_key_equals(p, end, key);
+
+		if (! (p = as_unpack_skip(p, end))) {
+			return false;
+		}
+
+		const uint8_t* next = as_unpack_skip(p, end);
+
+		if (! next) {
+			return false;
+		}
+
+		if (found) {
+			*val = p;
+			*val_size = (uint32_t)(next - p);
+			return true;
+		}
+		p = next;
+	}
+	return false;
+}
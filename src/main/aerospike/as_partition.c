@@ -110,34 +110,32 @@ as_partition_tables_create(uint32_t capacity)
 }
 
 static inline as_node*
-reserve_node(as_cluster* cluster, as_node* node)
+select_node(as_cluster* cluster, as_node* node)
 {
 	// Make volatile reference so changes to tend thread will be reflected in this thread.
 	if (node && ck_pr_load_8(&node->active)) {
-		as_node_reserve(node);
 		return node;
 	}
 #ifdef DEBUG_VERBOSE
 	as_log_debug("Choose random node for unmapped namespace/partition");
 #endif
-	return as_node_get_random(cluster);
+	return as_node_select_random(cluster);
 }
 
 static as_node*
-reserve_node_alternate(as_cluster* cluster, as_node* chosen, as_node* alternate)
+select_node_alternate(as_cluster* cluster, as_node* chosen, as_node* alternate)
 {
 	// Make volatile reference so changes to tend thread will be reflected in this thread.
 	if (ck_pr_load_8(&chosen->active)) {
-		as_node_reserve(chosen);
 		return chosen;
 	}
-	return reserve_node(cluster, alternate);
+	return select_node(cluster, alternate);
 }
 
 static uint32_t g_randomizer = 0;
 
 as_node*
-as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, bool write, as_policy_replica replica)
+as_partition_table_select_node(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, bool write, as_policy_replica replica)
 {
 	if (table) {
 		uint32_t partition_id = as_partition_getid(digest, cluster->n_partitions);
@@ -148,7 +146,7 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 
 		if (write) {
 			// Writes always go to master.
-			return reserve_node(cluster, master);
+			return select_node(cluster, master);
 		}
 
 		bool use_master_replica = true;
@@ -157,6 +155,7 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 				use_master_replica = true;
 				break;
 			case AS_POLICY_REPLICA_ANY:
+			case AS_POLICY_REPLICA_FASTEST:
 				use_master_replica = false;
 				break;
 			default:
@@ -165,32 +164,50 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 		}
 
 		if (use_master_replica) {
-			return reserve_node(cluster, master);
+			return select_node(cluster, master);
 		} else {
 			as_node* prole = ck_pr_load_ptr(&p->prole);
 
 			if (! prole) {
-				return reserve_node(cluster, master);
+				return select_node(cluster, master);
 			}
 
 			if (! master) {
-				return reserve_node(cluster, prole);
+				return select_node(cluster, prole);
+			}
+			
+			if (replica == AS_POLICY_REPLICA_FASTEST && ck_pr_load_8(&master->active) && ck_pr_load_8(&prole->active)) {
+				return as_node_select_fastest(master, prole);
 			}
 
 			// Alternate between master and prole for reads.
 			uint32_t r = ck_pr_faa_32(&g_randomizer, 1);
 				
 			if (r & 1) {
-				return reserve_node_alternate(cluster, master, prole);
+				return select_node_alternate(cluster, master, prole);
 			}
-			return reserve_node_alternate(cluster, prole, master);
+			return select_node_alternate(cluster, prole, master);
 		}
 	}
 	
 #ifdef DEBUG_VERBOSE
 	as_log_debug("Choose random node for null partition table");
 #endif
-	return as_node_get_random(cluster);
+	return as_node_select_random(cluster);
+}
+
+as_node*
+as_partition_table_select_alternate(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, as_node* node)
+{
+	if (! table) {
+		return 0;
+	}
+	
+	uint32_t partition_id = as_partition_getid(digest, cluster->n_partitions);
+	as_partition* p = &table->partitions[partition_id];
+	as_node* master = ck_pr_load_ptr(&p->master);
+	as_node* prole = ck_pr_load_ptr(&p->prole);
+	return as_node_other_replica(node, master, prole);
 }
 
 as_partition_table*
@@ -208,6 +225,45 @@ as_partition_tables_get(as_partition_tables* tables, const char* ns)
 	return 0;
 }
 
+void
+as_namespace_handle_resolve(as_cluster* cluster, as_namespace_handle* handle)
+{
+	// Partition tables are only appended, so the table count serves as a generation.
+	// Skip the name lookup when no namespace has been added since the last attempt.
+	if (cluster->shm_info) {
+		as_cluster_shm* cluster_shm = cluster->shm_info->cluster_shm;
+		uint32_t size = ck_pr_load_32(&cluster_shm->partition_tables_size);
+		
+		if (size != ck_pr_load_32(&handle->generation)) {
+			uint32_t index = as_shm_find_partition_index(cluster_shm, handle->ns, size);
+			ck_pr_store_32(&handle->generation, size);
+			
+			if (index) {
+				ck_pr_store_32(&handle->index, index);
+			}
+		}
+		return;
+	}
+	
+	as_partition_tables* tables = as_partition_tables_reserve(cluster);
+	
+	if (tables->size != ck_pr_load_32(&handle->generation)) {
+		for (uint32_t i = 0; i < tables->size; i++) {
+			as_partition_table* table = tables->array[i];
+			
+			if (strcmp(table->ns, handle->ns) == 0) {
+				// Table must be visible before index marks the handle resolved.
+				ck_pr_store_ptr(&handle->table, table);
+				ck_pr_fence_store();
+				ck_pr_store_32(&handle->index, i + 1);
+				break;
+			}
+		}
+		ck_pr_store_32(&handle->generation, tables->size);
+	}
+	as_partition_tables_release(tables);
+}
+
 bool
 as_partition_tables_find_node(as_partition_tables* tables, as_node* node)
 {
@@ -230,21 +286,36 @@ as_partition_tables_find_node(as_partition_tables* tables, as_node* node)
 }
 
 static inline void
-force_replicas_refresh(as_node* node)
+force_replicas_refresh(as_node* node, const char* ns, bool master, uint32_t partition_id)
 {
 	node->partition_generation = (uint32_t)-1;
+	as_node_bitmap_clear(node, ns, master, partition_id);
 }
 
+/**
+ *	Use non-inline function for epoch release function pointer reference.
+ *	Forward to inlined release.
+ */
 static void
-as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
+release_node(as_node* node)
 {
+	as_node_release(node);
+}
+
+static void
+as_partition_update(as_epoch* epoch, as_partition_table* table, uint32_t partition_id, as_node* node, bool master, bool owns)
+{
+	as_partition* p = &table->partitions[partition_id];
+	
 	// Volatile reads are not necessary because the tend thread exclusively modifies partition.
-	// Volatile writes are used so other threads can view change.
+	// Volatile writes are used so other threads can view change.  Commands may still be using
+	// a replaced node without a reference, so the partition's reference is released through
+	// the epoch.
 	if (master) {
 		if (node == p->master) {
 			if (! owns) {
 				set_node(&p->master, 0);
-				as_node_release(node);
+				as_epoch_retire(epoch, node, (as_release_fn)release_node);
 			}
 		}
 		else {
@@ -254,8 +325,8 @@ as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
 				set_node(&p->master, node);
 				
 				if (tmp) {
-					force_replicas_refresh(tmp);
-					as_node_release(tmp);
+					force_replicas_refresh(tmp, table->ns, master, partition_id);
+					as_epoch_retire(epoch, tmp, (as_release_fn)release_node);
 				}
 			}
 		}
@@ -264,7 +335,7 @@ as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
 		if (node == p->prole) {
 			if (! owns) {
 				set_node(&p->prole, 0);
-				as_node_release(node);
+				as_epoch_retire(epoch, node, (as_release_fn)release_node);
 			}
 		}
 		else {
@@ -274,8 +345,8 @@ as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
 				set_node(&p->prole, node);
 				
 				if (tmp) {
-					force_replicas_refresh(tmp);
-					as_node_release(tmp);
+					force_replicas_refresh(tmp, table->ns, master, partition_id);
+					as_epoch_retire(epoch, tmp, (as_release_fn)release_node);
 				}
 			}
 		}
@@ -298,24 +369,46 @@ as_partition_vector_get(as_vector* tables, const char* ns)
 }
 
 static void
-decode_and_update(char* bitmap_b64, long len, as_partition_table* table, as_node* node, bool master)
+update_from_bitmap(as_epoch* epoch, uint8_t* bitmap, as_partition_table* table, as_node* node, bool master)
+{
+	// Only partitions whose ownership changed since the node's last update need to be
+	// touched.  Without a valid previous bitmap, update all partitions.
+	uint32_t size = (table->size + 7) / 8;
+	as_node_bitmap* prev = as_node_get_bitmap(node, table->ns, master, size);
+	bool full = ! prev->valid;
+
+	// Expand the bitmap.
+	for (uint32_t b = 0; b < size; b++) {
+		uint8_t changed = full ? 0xFF : bitmap[b] ^ prev->bits[b];
+		
+		if (! changed) {
+			continue;
+		}
+		
+		uint32_t max = (b + 1) * 8 < table->size ? (b + 1) * 8 : table->size;
+		
+		for (uint32_t i = b * 8; i < max; i++) {
+			uint8_t mask = 0x80 >> (i & 7);
+			
+			if (changed & mask) {
+				bool owns = (bitmap[b] & mask) != 0;
+				as_partition_update(epoch, table, i, node, master, owns);
+			}
+		}
+	}
+	memcpy(prev->bits, bitmap, size);
+	prev->valid = true;
+}
+
+static void
+decode_and_update(as_epoch* epoch, char* bitmap_b64, long len, as_partition_table* table, as_node* node, bool master)
 {
 	// Size allows for padding - is actual size rounded up to multiple of 3.
 	uint8_t* bitmap = (uint8_t*)alloca(cf_b64_decoded_buf_size((uint32_t)len));
 
 	// For now - for speed - trust validity of encoded characters.
 	cf_b64_decode(bitmap_b64, (uint32_t)len, bitmap, NULL);
-
-	// Expand the bitmap.
-	for (uint32_t i = 0; i < table->size; i++) {
-		bool owns = ((bitmap[i >> 3] & (0x80 >> (i & 7))) != 0);
-		/*
-		if (owns) {
-			as_log_debug("Set partition %s:%s:%u:%s", master? "master" : "prole", table->ns, i, node->name);
-		}
-		*/
-		as_partition_update(&table->partitions[i], node, master, owns);
-	}
+	update_from_bitmap(epoch, bitmap, table, node, master);
 }
 
 static void
@@ -339,11 +432,29 @@ as_partition_tables_copy_add(as_cluster* cluster, as_partition_tables* tables_ol
 	// Replace tables with copy.
 	set_partition_tables(cluster, tables_new);
 	
-	// Put old tables on garbage collector stack.
-	as_gc_item item;
-	item.data = tables_old;
-	item.release_fn = (as_release_fn)release_partition_tables;
-	as_vector_append(cluster->gc, &item);
+	// Release old tables when no command can still be using them.
+	as_epoch_retire(cluster->epoch, tables_old, (as_release_fn)release_partition_tables);
+}
+
+void
+as_partition_tables_apply(as_cluster* cluster, as_node* node, const char* ns, uint8_t* bitmap, bool master)
+{
+	as_partition_tables* tables = cluster->partition_tables;
+	as_partition_table* table = as_partition_tables_get(tables, ns);
+	
+	if (table) {
+		update_from_bitmap(cluster->epoch, bitmap, table, node, master);
+		return;
+	}
+	
+	table = as_partition_table_create(ns, cluster->n_partitions);
+	update_from_bitmap(cluster->epoch, bitmap, table, node, master);
+	
+	as_vector tables_to_add;
+	as_vector_inita(&tables_to_add, sizeof(as_partition_table*), 1);
+	as_vector_append(&tables_to_add, &table);
+	as_partition_tables_copy_add(cluster, tables, &tables_to_add);
+	as_vector_destroy(&tables_to_add);
 }
 
 bool
@@ -410,7 +521,7 @@ as_partition_tables_update(as_cluster* cluster, as_node* node, char* buf, bool m
 				}
 
 				// Decode partition bitmap and update client's view.
-				decode_and_update(bitmap_b64, len, table, node, master);
+				decode_and_update(cluster->epoch, bitmap_b64, len, table, node, master);
 			}
 			ns = ++p;
 		}
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_pipeline.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_proto.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Read and discard one response frame.  Single record responses are always
+ *	exactly one proto message.
+ */
+static as_status
+as_pipeline_skip(as_error* err, as_connection* conn, uint64_t deadline_ms)
+{
+	as_proto proto;
+	as_status status = as_connection_read(err, conn, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
+
+	if (status) {
+		return status;
+	}
+
+	as_proto_swap_from_be(&proto);
+	size_t size = proto.sz;
+	uint8_t* buf;
+
+	while (size > 0) {
+		size_t len = (size < AS_CONNECTION_BUFFER_SIZE)? size : AS_CONNECTION_BUFFER_SIZE;
+		status = as_connection_read_ptr(err, conn, len, deadline_ms, &buf);
+
+		if (status) {
+			return status;
+		}
+		size -= len;
+	}
+	return AEROSPIKE_OK;
+}
+
+/**
+ *	Close current connection.  Outstanding tickets are invalidated.
+ *	Must hold pipe->lock.
+ */
+static void
+as_pipeline_break(as_pipeline* pipe, uint32_t generation)
+{
+	if (generation != pipe->generation || ! pipe->conn) {
+		// Already closed.
+		return;
+	}
+
+	// Wake any thread blocked on the socket.  The descriptor itself is closed
+	// once no reader or writer is using it, so it can not be reused underneath them.
+	shutdown(pipe->conn->fd, SHUT_RDWR);
+	pipe->stale_conn = pipe->conn;
+	pipe->conn = 0;
+	pipe->generation++;
+	pipe->write_seq = 0;
+	pipe->read_seq = 0;
+	memset(pipe->abandoned, 0, sizeof(bool) * pipe->depth);
+	pthread_cond_broadcast(&pipe->cond);
+}
+
+/**
+ *	Close stale connection if no longer in use.  Must hold pipe->lock.
+ */
+static inline void
+as_pipeline_collect(as_pipeline* pipe)
+{
+	if (pipe->stale_conn && ! pipe->reading && ! pipe->writing) {
+		as_conn_pool_close(pipe->pool, pipe->stale_conn);
+		pipe->stale_conn = 0;
+	}
+}
+
+/**
+ *	Wait for pipeline condition.  Return false if deadline was reached.
+ *	Must hold pipe->lock.
+ */
+static bool
+as_pipeline_wait(as_pipeline* pipe, uint64_t deadline_ms)
+{
+	if (deadline_ms == 0) {
+		pthread_cond_wait(&pipe->cond, &pipe->lock);
+		return true;
+	}
+
+	uint64_t now = cf_getms();
+
+	if (now >= deadline_ms) {
+		return false;
+	}
+
+	// cf_getms() is not wall clock time, so convert remaining time to an absolute wall clock time.
+	uint64_t remaining_ms = deadline_ms - now;
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+
+	uint64_t ns = (uint64_t)tv.tv_usec * 1000 + (remaining_ms % 1000) * 1000000;
+	struct timespec ts;
+	ts.tv_sec = tv.tv_sec + (remaining_ms / 1000) + (ns / 1000000000);
+	ts.tv_nsec = ns % 1000000000;
+
+	pthread_cond_timedwait(&pipe->cond, &pipe->lock, &ts);
+	return true;
+}
+
+/**
+ *	Abandon ticket after timeout.  The response is discarded by the next reader.
+ *	Must hold pipe->lock.
+ */
+static as_status
+as_pipeline_abandon(as_error* err, as_pipeline* pipe, uint64_t ticket, uint32_t generation)
+{
+	if (generation == pipe->generation) {
+		pipe->abandoned[ticket % pipe->depth] = true;
+
+		// The next waiter may now be able to discard this response.
+		pthread_cond_broadcast(&pipe->cond);
+	}
+	pthread_mutex_unlock(&pipe->lock);
+	return as_error_set_message(err, AEROSPIKE_ERR_TIMEOUT, "Timeout waiting for pipeline response");
+}
+
+/**
+ *	Get pipeline connection.  Must hold pipe->write_lock and pipe->lock.
+ *	pipe->lock is temporarily released when a new connection is required.
+ */
+static as_status
+as_pipeline_connect(as_error* err, as_pipeline* pipe, as_node* node, uint64_t deadline_ms)
+{
+	if (pipe->conn) {
+		if (pipe->write_seq != pipe->read_seq || pipe->reading) {
+			// Connection is in use, so it was recently valid.
+			return AEROSPIKE_OK;
+		}
+
+		// Connection is idle.  Make sure the server has not closed it.
+		if (as_socket_validate(pipe->conn->fd, true)) {
+			return AEROSPIKE_OK;
+		}
+
+		// as_socket_validate() closes invalid sockets.
+		as_conn_pool_closed(pipe->pool);
+		cf_free(pipe->conn);
+		pipe->conn = 0;
+		pipe->generation++;
+		pipe->write_seq = 0;
+		pipe->read_seq = 0;
+		memset(pipe->abandoned, 0, sizeof(bool) * pipe->depth);
+	}
+
+	// Other writers are held off by write_lock while connecting.
+	pthread_mutex_unlock(&pipe->lock);
+
+	as_connection* conn;
+	as_status status = as_node_get_connection(err, node, deadline_ms, &conn);
+
+	pthread_mutex_lock(&pipe->lock);
+
+	if (status == AEROSPIKE_OK) {
+		pipe->conn = conn;
+	}
+	return status;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+as_pipeline*
+as_pipeline_create(as_conn_pool* pool, uint32_t depth)
+{
+	as_pipeline* pipe = cf_malloc(sizeof(as_pipeline));
+
+	if (! pipe) {
+		return 0;
+	}
+
+	pthread_mutex_init(&pipe->lock, 0);
+	pthread_mutex_init(&pipe->write_lock, 0);
+	pthread_cond_init(&pipe->cond, 0);
+	pipe->abandoned = cf_malloc(sizeof(bool) * depth);
+	memset(pipe->abandoned, 0, sizeof(bool) * depth);
+	pipe->write_seq = 0;
+	pipe->read_seq = 0;
+	pipe->depth = depth;
+	pipe->generation = 0;
+	pipe->pool = pool;
+	pipe->conn = 0;
+	pipe->stale_conn = 0;
+	pipe->reading = false;
+	pipe->writing = false;
+	return pipe;
+}
+
+void
+as_pipeline_destroy(as_pipeline* pipe)
+{
+	if (pipe->conn) {
+		as_conn_pool_close(pipe->pool, pipe->conn);
+	}
+
+	if (pipe->stale_conn) {
+		as_conn_pool_close(pipe->pool, pipe->stale_conn);
+	}
+
+	pthread_cond_destroy(&pipe->cond);
+	pthread_mutex_destroy(&pipe->write_lock);
+	pthread_mutex_destroy(&pipe->lock);
+	cf_free(pipe->abandoned);
+	cf_free(pipe);
+}
+
+as_status
+as_pipeline_execute(as_error* err, as_node* node, struct iovec* iov, int iovcnt,
+	uint64_t deadline_ms, as_parse_results_fn parse_results_fn, void* parse_results_data, bool* sent)
+{
+	as_pipeline* pipe = node->pipeline;
+	*sent = false;
+
+	// The current writer may be connecting or blocked on a full socket.  Do not wait
+	// for it without a deadline.  Use a pooled connection instead.
+	if (pthread_mutex_trylock(&pipe->write_lock)) {
+		return AEROSPIKE_OK;
+	}
+	pthread_mutex_lock(&pipe->lock);
+
+	if (pipe->stale_conn || pipe->write_seq - pipe->read_seq >= pipe->depth) {
+		// Pipeline is full or still closing its previous connection.
+		pthread_mutex_unlock(&pipe->lock);
+		pthread_mutex_unlock(&pipe->write_lock);
+		return AEROSPIKE_OK;
+	}
+
+	as_status status = as_pipeline_connect(err, pipe, node, deadline_ms);
+
+	if (status) {
+		pthread_mutex_unlock(&pipe->lock);
+		pthread_mutex_unlock(&pipe->write_lock);
+		return status;
+	}
+
+	uint64_t ticket = pipe->write_seq++;
+	uint32_t generation = pipe->generation;
+	as_connection* conn = pipe->conn;
+	pipe->writing = true;
+	pthread_mutex_unlock(&pipe->lock);
+
+	// Send command.  Readers continue to drain the socket while this write is in progress.
+	status = as_connection_writev(err, conn, iov, iovcnt, deadline_ms);
+
+	pthread_mutex_lock(&pipe->lock);
+	pipe->writing = false;
+	pthread_mutex_unlock(&pipe->write_lock);
+
+	if (status) {
+		// A partial write corrupts the stream for all outstanding commands.
+		as_pipeline_break(pipe, generation);
+		as_pipeline_collect(pipe);
+		pthread_mutex_unlock(&pipe->lock);
+		return status;
+	}
+	as_pipeline_collect(pipe);
+	*sent = true;
+
+	// Wait until all earlier responses have been read.
+	while (generation == pipe->generation && pipe->read_seq != ticket) {
+		uint32_t index = pipe->read_seq % pipe->depth;
+
+		if (! pipe->reading && pipe->abandoned[index]) {
+			// Discard response of a command that has already timed out.
+			pipe->abandoned[index] = false;
+			pipe->reading = true;
+			pthread_mutex_unlock(&pipe->lock);
+
+			status = as_pipeline_skip(err, conn, deadline_ms);
+
+			pthread_mutex_lock(&pipe->lock);
+			pipe->reading = false;
+
+			if (status) {
+				as_pipeline_break(pipe, generation);
+				as_pipeline_collect(pipe);
+				pthread_mutex_unlock(&pipe->lock);
+				return status;
+			}
+
+			if (generation == pipe->generation) {
+				pipe->read_seq++;
+			}
+			as_pipeline_collect(pipe);
+			pthread_cond_broadcast(&pipe->cond);
+			continue;
+		}
+
+		if (! as_pipeline_wait(pipe, deadline_ms)) {
+			return as_pipeline_abandon(err, pipe, ticket, generation);
+		}
+	}
+
+	if (generation != pipe->generation) {
+		pthread_mutex_unlock(&pipe->lock);
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Pipeline connection closed by another command");
+	}
+
+	if (deadline_ms > 0 && cf_getms() >= deadline_ms) {
+		// Reading now would time out in the middle of the response and break the
+		// connection for everyone else.  Let the next reader discard it instead.
+		return as_pipeline_abandon(err, pipe, ticket, generation);
+	}
+
+	pipe->reading = true;
+	pthread_mutex_unlock(&pipe->lock);
+
+	// Parse results returned by server.
+	status = parse_results_fn(err, conn, deadline_ms, parse_results_data);
+
+	pthread_mutex_lock(&pipe->lock);
+	pipe->reading = false;
+
+	switch (status) {
+		// Errors that can leave unread data in socket.
+		case AEROSPIKE_ERR_TIMEOUT:
+		case AEROSPIKE_ERR_CLIENT_ABORT:
+		case AEROSPIKE_ERR_CLIENT:
+			as_pipeline_break(pipe, generation);
+			break;
+
+		default:
+			if (generation == pipe->generation) {
+				pipe->read_seq++;
+			}
+			break;
+	}
+	as_pipeline_collect(pipe);
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->lock);
+	return status;
+}
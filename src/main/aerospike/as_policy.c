@@ -52,6 +52,9 @@ as_policies_init(as_policies* p)
 	p->read.replica = -1;
 	p->read.consistency_level = -1;
 	p->read.deserialize = true;
+	p->read.lazy_deserialize = false;
+	p->read.hedge_delay_ms = 0;
+	p->read.hedge_percentile = 0;
 
 	p->write.timeout = -1;
 	p->write.retry = -1;
@@ -86,6 +89,7 @@ as_policies_init(as_policies* p)
 
 	as_policy_batch_init(&p->batch);
 	p->batch.timeout = -1;
+	p->batch.retry = -1;
 
 	p->admin.timeout = -1;
 
@@ -134,6 +138,7 @@ as_policies_resolve(as_policies* p)
 	as_policy_resolve(p->info.timeout, p->timeout);
 
 	as_policy_resolve(p->batch.timeout, p->timeout);
+	as_policy_resolve(p->batch.retry, p->retry);
 
 	as_policy_resolve(p->admin.timeout, p->timeout);
 }
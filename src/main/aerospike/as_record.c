@@ -14,6 +14,7 @@
  * License for the specific language governing permissions and limitations under
  * the License.
  */
+#include <aerospike/as_arena.h>
 #include <aerospike/as_bin.h>
 #include <aerospike/as_bytes.h>
 #include <aerospike/as_double.h>
@@ -21,8 +22,11 @@
 #include <aerospike/as_key.h>
 #include <aerospike/as_list.h>
 #include <aerospike/as_map.h>
+#include <aerospike/as_msgpack.h>
 #include <aerospike/as_nil.h>
+#include <aerospike/as_pack.h>
 #include <aerospike/as_record.h>
+#include <aerospike/as_serializer.h>
 #include <aerospike/as_string.h>
 
 #include <stdbool.h>
@@ -54,6 +58,9 @@ extern inline bool as_record_set_raw(as_record * rec, const as_bin_name name, co
 
 static as_record * 	as_record_defaults(as_record * rec, bool free, uint16_t nbins);
 static as_bin * 	as_record_bin_forupdate(as_record * rec, const as_bin_name name);
+static as_val * 	as_record_copy_val(void * dst, as_val * src);
+static as_val * 	as_record_share_val(void * dst, as_val * src);
+static as_val * 	as_record_unpack(const uint8_t * buf, uint32_t size);
 
 /******************************************************************************
  *	STATIC FUNCTIONS
@@ -70,12 +77,15 @@ static as_record * as_record_defaults(as_record * rec, bool free, uint16_t nbins
 	rec->key.ns[0] = '\0';
 	rec->key.set[0] = '\0';
 	rec->key.valuep = NULL;
+	rec->key.handle = NULL;
 
 	rec->key.digest.init = false;
 	memset(rec->key.digest.value, 0, AS_DIGEST_VALUE_SIZE);
 
 	rec->gen = 0;
 	rec->ttl = 0;
+	rec->arena = NULL;
+	rec->lazy = false;
 
 	if ( nbins > 0 ) {
 		rec->bins._free = true;
@@ -122,6 +132,129 @@ static as_bin * as_record_bin_forupdate(as_record * rec, const as_bin_name name)
 	return NULL;
 }
 
+/**
+ *	Copy value into dst, which must be large enough for any scalar value.
+ *	Strings, geojson and bytes are duplicated so the copy does not depend on the
+ *	source buffer.  Other values are shared by reference count.
+ */
+static as_val * as_record_copy_val(void * dst, as_val * src)
+{
+	switch ( as_val_type(src) ) {
+		case AS_NIL: {
+			return (as_val *) &as_nil;
+		}
+		case AS_INTEGER: {
+			as_integer_init((as_integer *) dst, as_integer_get((as_integer *) src));
+			return (as_val *) dst;
+		}
+		case AS_DOUBLE: {
+			as_double_init((as_double *) dst, as_double_get((as_double *) src));
+			return (as_val *) dst;
+		}
+		case AS_STRING: {
+			as_string * str = (as_string *) src;
+			size_t len = as_string_len(str);
+			char * value = (char *) malloc(len + 1);
+			memcpy(value, str->value, len);
+			value[len] = '\0';
+			as_string_init_wlen((as_string *) dst, value, len, true);
+			return (as_val *) dst;
+		}
+		case AS_GEOJSON: {
+			as_geojson * geo = (as_geojson *) src;
+			size_t len = as_geojson_len(geo);
+			char * value = (char *) malloc(len + 1);
+			memcpy(value, geo->value, len);
+			value[len] = '\0';
+			as_geojson_init_wlen((as_geojson *) dst, value, len, true);
+			return (as_val *) dst;
+		}
+		case AS_BYTES: {
+			as_bytes * bytes = (as_bytes *) src;
+			uint8_t * value = (uint8_t *) malloc(bytes->size);
+			memcpy(value, bytes->value, bytes->size);
+			as_bytes_init_wrap((as_bytes *) dst, value, bytes->size, true);
+			((as_bytes *) dst)->type = bytes->type;
+			return (as_val *) dst;
+		}
+		default: {
+			as_val_reserve(src);
+			return src;
+		}
+	}
+}
+
+/**
+ *	Copy value into dst like as_record_copy_val(), except strings, geojson and bytes
+ *	that do not own their buffer point to the same buffer.  Only used when the buffer
+ *	is arena memory kept alive by the destination record's arena reference.
+ */
+static as_val * as_record_share_val(void * dst, as_val * src)
+{
+	switch ( as_val_type(src) ) {
+		case AS_STRING: {
+			as_string * str = (as_string *) src;
+			if ( str->free ) break;
+			as_string_init_wlen((as_string *) dst, str->value, as_string_len(str), false);
+			return (as_val *) dst;
+		}
+		case AS_GEOJSON: {
+			as_geojson * geo = (as_geojson *) src;
+			if ( geo->free ) break;
+			as_geojson_init_wlen((as_geojson *) dst, geo->value, as_geojson_len(geo), false);
+			return (as_val *) dst;
+		}
+		case AS_BYTES: {
+			as_bytes * bytes = (as_bytes *) src;
+			if ( bytes->free ) break;
+			as_bytes_init_wrap((as_bytes *) dst, bytes->value, bytes->size, false);
+			((as_bytes *) dst)->type = bytes->type;
+			return (as_val *) dst;
+		}
+		default: {
+			break;
+		}
+	}
+	return as_record_copy_val(dst, src);
+}
+
+/**
+ *	Deserialize packed value.
+ */
+static as_val * as_record_unpack(const uint8_t * buf, uint32_t size)
+{
+	as_val * val = NULL;
+
+	as_buffer buffer;
+	buffer.data = (uint8_t *) buf;
+	buffer.size = size;
+
+	as_serializer ser;
+	as_msgpack_init(&ser);
+	as_serializer_deserialize(&ser, &buffer, &val);
+	as_serializer_destroy(&ser);
+	return val;
+}
+
+/**
+ *	Return bin value if it is a packed list or map of the given type.
+ */
+static inline as_bytes * as_record_packed(const as_bin * bin, as_bytes_type type)
+{
+	as_bytes * bytes = as_bytes_fromval((as_val *) bin->valuep);
+	return (bytes && bytes->type == type) ? bytes : NULL;
+}
+
+static as_bin * as_record_find(const as_record * rec, const as_bin_name name)
+{
+	for(int i=0; i<rec->bins.size; i++) {
+		if ( strcmp(rec->bins.entries[i].name, name) == 0 ) {
+			return &rec->bins.entries[i];
+		}
+	}
+	return NULL;
+}
+
 /******************************************************************************
  *	INSTANCE FUNCTIONS
  *****************************************************************************/
@@ -150,6 +283,11 @@ void as_record_release(as_record * rec)
 		rec->key.valuep = NULL;
 
 		rec->key.digest.init = false;
+
+		if ( rec->arena ) {
+			as_arena_release(rec->arena);
+			rec->arena = NULL;
+		}
 	}
 }
 
@@ -185,6 +323,126 @@ as_record * as_record_init(as_record * rec, uint16_t nbins)
 	return as_record_defaults(rec, false, nbins);
 }
 
+/**
+ *	Create a new as_record on the heap with bins and an arena for bin values
+ *	in a single allocation, which is freed when the record is destroyed.
+ *	@param nbins - the number of bins to allocate.
+ *	@param size - the number of bytes to reserve for bin values.
+ *	@return a pointer to the new as_record if successful, otherwise NULL.
+ */
+as_record * as_record_new_arena(uint16_t nbins, size_t size)
+{
+	size_t bins_size = sizeof(as_bin) * nbins;
+	as_record * rec = (as_record *) malloc(sizeof(as_record) + as_arena_footprint(bins_size + size));
+	if ( !rec ) return rec;
+
+	as_record_defaults(rec, true, 0);
+	rec->arena = as_arena_init(rec + 1, bins_size + size, AS_ARENA_BLOCK_SIZE);
+	rec->bins.capacity = nbins;
+	rec->bins.entries = (as_bin *) as_arena_alloc(rec->arena, bins_size);
+	return rec;
+}
+
+/**
+ *	Initialize an as_record with bins allocated from a shared arena.
+ *	@param rec - the record to initialize
+ *	@param nbins - the number of bins to allocate.
+ *	@param arena - the arena to allocate from. The record holds a reference until destroyed.
+ *	@return a pointer to the initialized as_record if successful, otherwise NULL.
+ */
+as_record * as_record_init_arena(as_record * rec, uint16_t nbins, as_arena * arena)
+{
+	if ( !rec ) return rec;
+
+	as_bin * entries = (as_bin *) as_arena_alloc(arena, sizeof(as_bin) * nbins);
+	if ( !entries ) return as_record_defaults(rec, false, nbins);
+
+	as_record_defaults(rec, false, 0);
+	as_arena_reserve(arena);
+	rec->arena = arena;
+	rec->bins.capacity = nbins;
+	rec->bins.entries = entries;
+	return rec;
+}
+
+/**
+ *	Create a heap copy of a record that does not reference the source record's
+ *	memory.  Records parsed with borrowed bins must be copied this way to be kept.
+ *	@param rec - the record to copy
+ *	@return a pointer to the new as_record if successful, otherwise NULL.
+ */
+as_record * as_record_copy(const as_record * rec)
+{
+	as_record * copy = as_record_new(rec->bins.size);
+	if ( !copy ) return copy;
+
+	copy->gen = rec->gen;
+	copy->ttl = rec->ttl;
+	copy->lazy = rec->lazy;
+
+	copy->key._free = false;
+	strcpy(copy->key.ns, rec->key.ns);
+	strcpy(copy->key.set, rec->key.set);
+	copy->key.digest = rec->key.digest;
+	copy->key.handle = rec->key.handle;
+
+	if ( rec->key.valuep ) {
+		copy->key.valuep = (as_key_value *) as_record_copy_val(&copy->key.value, (as_val *) rec->key.valuep);
+	}
+
+	for ( int i = 0; i < rec->bins.size; i++ ) {
+		as_bin * src = &rec->bins.entries[i];
+		as_bin * dst = &copy->bins.entries[i];
+		strcpy(dst->name, src->name);
+		dst->valuep = src->valuep ? (as_bin_value *) as_record_copy_val(&dst->value, (as_val *) src->valuep) : NULL;
+	}
+	copy->bins.size = rec->bins.size;
+	return copy;
+}
+
+/**
+ *	Initialize rec with the bins of src.  When src was allocated from an arena, rec
+ *	holds a reference to the same arena and points to the string, geojson and bytes
+ *	values stored there instead of copying them.  Other values are copied as in
+ *	as_record_copy().  The key is not copied.
+ *	@param rec - the record to initialize
+ *	@param src - the record to share bins with
+ *	@return a pointer to the initialized as_record if successful, otherwise NULL.
+ */
+as_record * as_record_init_shared(as_record * rec, const as_record * src)
+{
+	if ( !rec ) return rec;
+
+	if ( src->arena ) {
+		as_record_init_arena(rec, src->bins.size, src->arena);
+	}
+	else {
+		as_record_init(rec, src->bins.size);
+	}
+
+	rec->gen = src->gen;
+	rec->ttl = src->ttl;
+	rec->lazy = src->lazy;
+
+	for ( int i = 0; i < src->bins.size; i++ ) {
+		as_bin * from = &src->bins.entries[i];
+		as_bin * to = &rec->bins.entries[i];
+		strcpy(to->name, from->name);
+
+		if ( !from->valuep ) {
+			to->valuep = NULL;
+		}
+		else if ( rec->arena ) {
+			to->valuep = (as_bin_value *) as_record_share_val(&to->value, (as_val *) from->valuep);
+		}
+		else {
+			to->valuep = (as_bin_value *) as_record_copy_val(&to->value, (as_val *) from->valuep);
+		}
+	}
+	rec->bins.size = src->bins.size;
+	return rec;
+}
+
 /**
  *	Destroy the as_record and associated resources.
  */
@@ -461,12 +719,30 @@ bool as_record_set_nil(as_record * rec, const as_bin_name name)
  */
 as_bin_value * as_record_get(const as_record * rec, const as_bin_name name) 
 {
-	for(int i=0; i<rec->bins.size; i++) {
-		if ( strcmp(rec->bins.entries[i].name, name) == 0 ) {
-			return (as_bin_value *) rec->bins.entries[i].valuep;
+	as_bin * bin = as_record_find(rec, name);
+	return bin ? as_record_bin_value(rec, bin) : NULL;
+}
+
+/**
+ *	Return bin value.  Packed lists and maps of lazy records are deserialized
+ *	on first access and replace the packed value.  The record is modified even
+ *	though it is const, so lazy records are not safe to read concurrently.
+ */
+as_bin_value * as_record_bin_value(const as_record * rec, as_bin * bin)
+{
+	if ( rec->lazy && bin->valuep && as_val_type(bin->valuep) == AS_BYTES ) {
+		as_bytes * bytes = (as_bytes *) bin->valuep;
+
+		if ( bytes->type == AS_BYTES_LIST || bytes->type == AS_BYTES_MAP ) {
+			as_val * val = as_record_unpack(bytes->value, bytes->size);
+
+			if ( val ) {
+				as_val_destroy((as_val *) bytes);
+				bin->valuep = (as_bin_value *) val;
+			}
 		}
 	}
-	return NULL;
+	return bin->valuep;
 }
 
 /**
@@ -594,6 +870,86 @@ as_map * as_record_get_map(const as_record * rec, const as_bin_name name)
 	return as_map_fromval((as_val *) as_record_get(rec, name));
 }
 
+/**
+ *	Get a value from a map bin, reading it in place if the map is still packed.
+ *	@param rec - the record containing the bin.
+ *	@param name - the name of the map bin.
+ *	@param key - the map key.
+ *	@return the value if found, otherwise NULL. The caller must destroy the value.
+ */
+as_val * as_record_get_map_value(const as_record * rec, const as_bin_name name, const as_val * key)
+{
+	as_bin * bin = as_record_find(rec, name);
+	if ( !bin ) return NULL;
+
+	as_bytes * bytes = as_record_packed(bin, AS_BYTES_MAP);
+
+	if ( bytes && (as_val_type(key) == AS_INTEGER || as_val_type(key) == AS_STRING) ) {
+		const uint8_t * val;
+		uint32_t size;
+
+		if ( ! as_unpack_map_value(bytes->value, bytes->size, key, &val, &size) ) {
+			return NULL;
+		}
+		return as_record_unpack(val, size);
+	}
+
+	as_map * map = as_map_fromval((as_val *) as_record_bin_value(rec, bin));
+	as_map * tmp = NULL;
+
+	if ( !map && bytes ) {
+		// Packed map of a record that is not lazy.  Leave the bin packed.
+		tmp = as_map_fromval(as_record_unpack(bytes->value, bytes->size));
+		map = tmp;
+	}
+	if ( !map ) return NULL;
+
+	as_val * val = as_map_get(map, key);
+
+	if ( val ) {
+		as_val_reserve(val);
+	}
+	if ( tmp ) {
+		as_map_destroy(tmp);
+	}
+	return val;
+}
+
+/**
+ *	Get an element from a list bin, reading it in place if the list is still packed.
+ *	@param rec - the record containing the bin.
+ *	@param name - the name of the list bin.
+ *	@param index - the list index.
+ *	@return the element if found, otherwise NULL. The caller must destroy the value.
+ */
+as_val * as_record_get_list_value(const as_record * rec, const as_bin_name name, uint32_t index)
+{
+	as_bin * bin = as_record_find(rec, name);
+	if ( !bin ) return NULL;
+
+	as_bytes * bytes = as_record_packed(bin, AS_BYTES_LIST);
+
+	if ( bytes ) {
+		const uint8_t * val;
+		uint32_t size;
+
+		if ( ! as_unpack_list_element(bytes->value, bytes->size, index, &val, &size) ) {
+			return NULL;
+		}
+		return as_record_unpack(val, size);
+	}
+
+	as_list * list = as_list_fromval((as_val *) bin->valuep);
+	if ( !list ) return NULL;
+
+	as_val * val = as_list_get(list, index);
+
+	if ( val ) {
+		as_val_reserve(val);
+	}
+	return val;
+}
+
 /******************************************************************************
  *	ITERATION FUNCTIONS
  *****************************************************************************/
@@ -602,7 +958,8 @@ bool as_record_foreach(const as_record * rec, as_rec_foreach_callback callback,
 {
 	if ( rec->bins.entries ) {
 		for ( int i = 0; i < rec->bins.size; i++ ) {
-			if ( callback(rec->bins.entries[i].name, (as_val *) rec->bins.entries[i].valuep, udata) == false ) {
+			as_bin * bin = &rec->bins.entries[i];
+			if ( callback(bin->name, (as_val *) as_record_bin_value(rec, bin), udata) == false ) {
 				return false;
 			}
 		}
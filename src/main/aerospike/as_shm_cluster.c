@@ -276,21 +276,31 @@ as_shm_reset_nodes(as_cluster* cluster)
 	as_vector_destroy(&nodes_to_remove);
 }
 
-static as_partition_table_shm*
-as_shm_find_partition_table(as_cluster_shm* cluster_shm, const char* ns)
+uint32_t
+as_shm_find_partition_index(as_cluster_shm* cluster_shm, const char* ns, uint32_t max)
 {
 	as_partition_table_shm* table = as_shm_get_partition_tables(cluster_shm);
-	uint32_t max = cluster_shm->partition_tables_size;
 	
 	for (uint32_t i = 0; i < max; i++) {
 		if (strcmp(table->ns, ns) == 0) {
-			return table;
+			return i + 1;
 		}
 		table = as_shm_next_partition_table(cluster_shm, table);
 	}
 	return 0;
 }
 
+static as_partition_table_shm*
+as_shm_find_partition_table(as_cluster_shm* cluster_shm, const char* ns)
+{
+	uint32_t index = as_shm_find_partition_index(cluster_shm, ns, cluster_shm->partition_tables_size);
+	
+	if (index) {
+		return as_shm_get_partition_table(cluster_shm, as_shm_get_partition_tables(cluster_shm), index - 1);
+	}
+	return 0;
+}
+
 static as_partition_table_shm*
 as_shm_add_partition_table(as_cluster_shm* cluster_shm, const char* ns)
 {
@@ -311,19 +321,22 @@ as_shm_add_partition_table(as_cluster_shm* cluster_shm, const char* ns)
 }
 
 static void
-as_shm_force_replicas_refresh(as_shm_info* shm_info, uint32_t node_index)
+as_shm_force_replicas_refresh(as_shm_info* shm_info, uint32_t node_index, const char* ns, bool master, uint32_t partition_id)
 {
 	// node_index starts at one (zero indicates unset).
 	as_node* node = shm_info->local_nodes[node_index-1];
 	
 	if (node) {
 		node->partition_generation = (uint32_t)-1;
+		as_node_bitmap_clear(node, ns, master, partition_id);
 	}
 }
 
 static void
-as_shm_partition_update(as_shm_info* shm_info, as_partition_shm* p, uint32_t node_index, bool master, bool owns)
+as_shm_partition_update(as_shm_info* shm_info, as_partition_table_shm* table, uint32_t partition_id, uint32_t node_index, bool master, bool owns)
 {
+	as_partition_shm* p = &table->partitions[partition_id];
+	
 	// node_index starts at one (zero indicates unset).
 	if (master) {
 		if (node_index == p->master) {
@@ -334,7 +347,7 @@ as_shm_partition_update(as_shm_info* shm_info, as_partition_shm* p, uint32_t nod
 		else {
 			if (owns) {
 				if (p->master) {
-					as_shm_force_replicas_refresh(shm_info, p->master);
+					as_shm_force_replicas_refresh(shm_info, p->master, table->ns, master, partition_id);
 				}
 				ck_pr_store_32(&p->master, node_index);
 			}
@@ -349,7 +362,7 @@ as_shm_partition_update(as_shm_info* shm_info, as_partition_shm* p, uint32_t nod
 		else {
 			if (owns) {
 				if (p->prole) {
-					as_shm_force_replicas_refresh(shm_info, p->prole);
+					as_shm_force_replicas_refresh(shm_info, p->prole, table->ns, master, partition_id);
 				}
 				ck_pr_store_32(&p->prole, node_index);
 			}
@@ -358,7 +371,7 @@ as_shm_partition_update(as_shm_info* shm_info, as_partition_shm* p, uint32_t nod
 }
 
 static void
-as_shm_decode_and_update(as_shm_info* shm_info, char* bitmap_b64, int64_t len, as_partition_table_shm* table, uint32_t node_index, bool master)
+as_shm_decode_and_update(as_shm_info* shm_info, char* bitmap_b64, int64_t len, as_partition_table_shm* table, as_node* node, bool master)
 {
 	// Size allows for padding - is actual size rounded up to multiple of 3.
 	uint8_t* bitmap = (uint8_t*)alloca(cf_b64_decoded_buf_size((uint32_t)len));
@@ -366,13 +379,35 @@ as_shm_decode_and_update(as_shm_info* shm_info, char* bitmap_b64, int64_t len, a
 	// For now - for speed - trust validity of encoded characters.
 	cf_b64_decode(bitmap_b64, (uint32_t)len, bitmap, NULL);
 	
-	// Expand the bitmap.
+	// Only write shared memory partitions whose ownership changed since the node's last
+	// update, so unchanged cache lines stay valid in attached processes.
 	uint32_t max = shm_info->cluster_shm->n_partitions;
+	uint32_t size = (max + 7) / 8;
+	uint32_t node_index = node->index + 1;
+	as_node_bitmap* prev = as_node_get_bitmap(node, table->ns, master, size);
+	bool full = ! prev->valid;
 	
-	for (uint32_t i = 0; i < max; i++) {
-		bool owns = ((bitmap[i >> 3] & (0x80 >> (i & 7))) != 0);
-		as_shm_partition_update(shm_info, &table->partitions[i], node_index, master, owns);
+	// Expand the bitmap.
+	for (uint32_t b = 0; b < size; b++) {
+		uint8_t changed = full ? 0xFF : bitmap[b] ^ prev->bits[b];
+		
+		if (! changed) {
+			continue;
+		}
+		
+		uint32_t end = (b + 1) * 8 < max ? (b + 1) * 8 : max;
+		
+		for (uint32_t i = b * 8; i < end; i++) {
+			uint8_t mask = 0x80 >> (i & 7);
+			
+			if (changed & mask) {
+				bool owns = (bitmap[b] & mask) != 0;
+				as_shm_partition_update(shm_info, table, i, node_index, master, owns);
+			}
+		}
 	}
+	memcpy(prev->bits, bitmap, size);
+	prev->valid = true;
 }
 
 void
@@ -386,49 +421,46 @@ as_shm_update_partitions(as_shm_info* shm_info, const char* ns, char* bitmap_b64
 	}
 	
 	if (table) {
-		as_shm_decode_and_update(shm_info, bitmap_b64, len, table, node->index + 1, master);
+		as_shm_decode_and_update(shm_info, bitmap_b64, len, table, node, master);
 	}
 }
 
 static inline as_node*
-as_shm_reserve_node(as_cluster* cluster, as_node** local_nodes, uint32_t node_index)
+as_shm_select_node(as_cluster* cluster, as_node** local_nodes, uint32_t node_index)
 {
 	// node_index starts at one (zero indicates unset).
 	if (node_index) {
 		as_node* node = ck_pr_load_ptr(&local_nodes[node_index-1]);
 		
 		if (node && ck_pr_load_8(&node->active)) {
-			as_node_reserve(node);
 			return node;
 		}
 	}
 	
 	// as_log_debug("Choose random node for unmapped namespace/partition");
-	return as_node_get_random(cluster);
+	return as_node_select_random(cluster);
 }
 
 static as_node*
-as_shm_reserve_node_alternate(as_cluster* cluster, as_node** local_nodes, uint32_t chosen_index, uint32_t alternate_index)
+as_shm_select_node_alternate(as_cluster* cluster, as_node** local_nodes, uint32_t chosen_index, uint32_t alternate_index)
 {
 	// index values start at one (zero indicates unset).
 	as_node* chosen = ck_pr_load_ptr(&local_nodes[chosen_index-1]);
 	
 	// Make volatile reference so changes to tend thread will be reflected in this thread.
 	if (chosen && ck_pr_load_8(&chosen->active)) {
-		as_node_reserve(chosen);
 		return chosen;
 	}
-	return as_shm_reserve_node(cluster, local_nodes, alternate_index);
+	return as_shm_select_node(cluster, local_nodes, alternate_index);
 }
 
 static uint32_t g_shm_randomizer = 0;
 
-as_node*
-as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica)
+static as_node*
+as_shm_table_select_node(as_cluster* cluster, as_partition_table_shm* table, const uint8_t* digest, bool write, as_policy_replica replica)
 {
 	as_shm_info* shm_info = cluster->shm_info;
 	as_cluster_shm* cluster_shm = shm_info->cluster_shm;
-	as_partition_table_shm* table = as_shm_find_partition_table(cluster_shm, ns);
 
 	if (table) {
 		uint32_t partition_id = as_partition_getid(digest, cluster_shm->n_partitions);
@@ -439,7 +471,7 @@ as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool
 
 		if (write) {
 			// Writes always go to master.
-			return as_shm_reserve_node(cluster, shm_info->local_nodes, master);
+			return as_shm_select_node(cluster, shm_info->local_nodes, master);
 		}
 
 		bool use_master_replica = true;
@@ -448,6 +480,7 @@ as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool
 				use_master_replica = true;
 				break;
 			case AS_POLICY_REPLICA_ANY:
+			case AS_POLICY_REPLICA_FASTEST:
 				use_master_replica = false;
 				break;
 			default:
@@ -456,30 +489,92 @@ as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool
 		}
 
 		if (use_master_replica) {
-			return as_shm_reserve_node(cluster, shm_info->local_nodes, master);
+			return as_shm_select_node(cluster, shm_info->local_nodes, master);
 		} else {
 			uint32_t prole = ck_pr_load_32(&p->prole);
 
 			if (! prole) {
-				return as_shm_reserve_node(cluster, shm_info->local_nodes, master);
+				return as_shm_select_node(cluster, shm_info->local_nodes, master);
 			}
 
 			if (! master) {
-				return as_shm_reserve_node(cluster, shm_info->local_nodes, prole);
+				return as_shm_select_node(cluster, shm_info->local_nodes, prole);
+			}
+			
+			if (replica == AS_POLICY_REPLICA_FASTEST) {
+				as_node* master_node = ck_pr_load_ptr(&shm_info->local_nodes[master-1]);
+				as_node* prole_node = ck_pr_load_ptr(&shm_info->local_nodes[prole-1]);
+				
+				if (master_node && prole_node && ck_pr_load_8(&master_node->active) && ck_pr_load_8(&prole_node->active)) {
+					return as_node_select_fastest(master_node, prole_node);
+				}
 			}
 
 			// Alternate between master and prole for reads.
 			uint32_t r = ck_pr_faa_32(&g_shm_randomizer, 1);
 
 			if (r & 1) {
-				return as_shm_reserve_node_alternate(cluster, shm_info->local_nodes, master, prole);
+				return as_shm_select_node_alternate(cluster, shm_info->local_nodes, master, prole);
 			}
-			return as_shm_reserve_node_alternate(cluster, shm_info->local_nodes, prole, master);
+			return as_shm_select_node_alternate(cluster, shm_info->local_nodes, prole, master);
 		}
 	}
 
 	// as_log_debug("Choose random node for null partition table");
-	return as_node_get_random(cluster);
+	return as_node_select_random(cluster);
+}
+
+as_node*
+as_shm_node_select_alternate(as_cluster* cluster, const char* ns, uint32_t index, const uint8_t* digest, as_node* node)
+{
+	as_shm_info* shm_info = cluster->shm_info;
+	as_cluster_shm* cluster_shm = shm_info->cluster_shm;
+	as_partition_table_shm* table;
+	
+	if (index) {
+		table = as_shm_get_partition_table(cluster_shm, as_shm_get_partition_tables(cluster_shm), index - 1);
+	}
+	else {
+		table = as_shm_find_partition_table(cluster_shm, ns);
+	}
+	
+	if (! table) {
+		return 0;
+	}
+	
+	uint32_t partition_id = as_partition_getid(digest, cluster_shm->n_partitions);
+	as_partition_shm* p = &table->partitions[partition_id];
+	uint32_t master = ck_pr_load_32(&p->master);
+	uint32_t prole = ck_pr_load_32(&p->prole);
+	
+	if (! master || ! prole) {
+		return 0;
+	}
+	
+	// index values start at one (zero indicates unset).
+	as_node* master_node = ck_pr_load_ptr(&shm_info->local_nodes[master-1]);
+	as_node* prole_node = ck_pr_load_ptr(&shm_info->local_nodes[prole-1]);
+	return as_node_other_replica(node, master_node, prole_node);
+}
+
+as_node*
+as_shm_node_select(as_cluster* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica)
+{
+	as_partition_table_shm* table = as_shm_find_partition_table(cluster->shm_info->cluster_shm, ns);
+	return as_shm_table_select_node(cluster, table, digest, write, replica);
+}
+
+as_node*
+as_shm_node_select_by_index(as_cluster* cluster, uint32_t index, const uint8_t* digest, bool write, as_policy_replica replica)
+{
+	// Shared memory partition tables are only appended, so an index stays valid.
+	as_partition_table_shm* table = 0;
+	
+	if (index) {
+		as_cluster_shm* cluster_shm = cluster->shm_info->cluster_shm;
+		table = as_shm_get_partition_table(cluster_shm, as_shm_get_partition_tables(cluster_shm), index - 1);
+	}
+	return as_shm_table_select_node(cluster, table, digest, write, replica);
 }
 
 static void
@@ -563,6 +658,10 @@ as_shm_tender(void* userdata)
 				limit = ts + threshold;
 			}
 			
+			// Release local nodes removed in previous intervals.
+			as_epoch_reclaim(cluster->epoch);
+			as_node_destroy_deferred(cluster, false);
+			
 			// Synchronize local cluster with shared memory cluster.
 			uint32_t gen = ck_pr_load_32(&cluster_shm->nodes_gen);
 			
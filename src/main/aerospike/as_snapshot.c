@@ -0,0 +1,389 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_snapshot.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_string.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Snapshot file layout.  All integers are in host byte order, because a snapshot is
+// only read on the machine that wrote it.  Addresses and ports are in network order.
+//
+// header:  magic u32, version u32, n_partitions u32, n_nodes u32
+// node:    name[AS_NODE_NAME_SIZE], address u32, port u16, features u8[4],
+//          partition_generation u32, n_bitmaps u32
+// bitmap:  ns[AS_NAMESPACE_MAX_SIZE], master u8, bits[(n_partitions + 7) / 8]
+
+/******************************************************************************
+ * DECLARATIONS
+ ******************************************************************************/
+
+void
+as_partition_tables_apply(as_cluster* cluster, as_node* node, const char* ns, uint8_t* bitmap, bool master);
+
+/******************************************************************************
+ * MACROS
+ ******************************************************************************/
+
+#define AS_SNAPSHOT_MAGIC 0x53575341  // "ASWS"
+#define AS_SNAPSHOT_HEADER_SIZE 16
+#define AS_SNAPSHOT_NODE_SIZE (AS_NODE_NAME_SIZE + 18)
+#define AS_SNAPSHOT_BITMAP_HEADER_SIZE (AS_NAMESPACE_MAX_SIZE + 1)
+
+/******************************************************************************
+ * TYPES
+ ******************************************************************************/
+
+typedef struct as_snapshot_reader_s {
+	uint8_t* p;
+	uint8_t* end;
+} as_snapshot_reader;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ******************************************************************************/
+
+static inline uint8_t*
+as_snapshot_write(uint8_t* p, const void* data, size_t len)
+{
+	memcpy(p, data, len);
+	return p + len;
+}
+
+static inline bool
+as_snapshot_read(as_snapshot_reader* r, void* data, size_t len)
+{
+	if ((size_t)(r->end - r->p) < len) {
+		return false;
+	}
+	memcpy(data, r->p, len);
+	r->p += len;
+	return true;
+}
+
+static inline bool
+as_snapshot_skip(as_snapshot_reader* r, size_t len)
+{
+	if ((size_t)(r->end - r->p) < len) {
+		return false;
+	}
+	r->p += len;
+	return true;
+}
+
+static inline uint64_t
+as_snapshot_hash(uint64_t hash, const void* data, size_t len)
+{
+	// FNV-1a
+	const uint8_t* p = data;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/**
+ * Signature of the cluster state saved in a snapshot.  Partition ownership only changes
+ * when a node's partition generation changes.
+ */
+static uint64_t
+as_snapshot_signature(as_cluster* cluster)
+{
+	as_nodes* nodes = cluster->nodes;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+
+		if (node->active) {
+			hash = as_snapshot_hash(hash, node->name, strlen(node->name));
+			hash = as_snapshot_hash(hash, &node->partition_generation, sizeof(uint32_t));
+			hash = as_snapshot_hash(hash, &node->address_index, sizeof(uint32_t));
+		}
+	}
+	return hash;
+}
+
+static bool
+as_snapshot_read_file(const char* path, uint8_t** buf, size_t* size)
+{
+	FILE* file = fopen(path, "rb");
+
+	if (! file) {
+		return false;
+	}
+
+	bool rv = false;
+
+	if (fseek(file, 0, SEEK_END) == 0) {
+		long len = ftell(file);
+
+		if (len > 0 && fseek(file, 0, SEEK_SET) == 0) {
+			*buf = cf_malloc(len);
+
+			if (fread(*buf, 1, len, file) == (size_t)len) {
+				*size = (size_t)len;
+				rv = true;
+			}
+			else {
+				cf_free(*buf);
+			}
+		}
+	}
+	fclose(file);
+	return rv;
+}
+
+/**
+ * Verify snapshot structure, so loading can not fail after nodes have been created.
+ */
+static bool
+as_snapshot_validate(as_snapshot_reader r, uint32_t n_nodes, uint32_t bitmap_size)
+{
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		char name[AS_NODE_NAME_SIZE];
+		uint32_t n_bitmaps;
+
+		if (! as_snapshot_read(&r, name, sizeof(name)) ||
+			! as_snapshot_skip(&r, AS_SNAPSHOT_NODE_SIZE - AS_NODE_NAME_SIZE - sizeof(uint32_t)) ||
+			! as_snapshot_read(&r, &n_bitmaps, sizeof(uint32_t))) {
+			return false;
+		}
+
+		if (name[0] == 0 || memchr(name, 0, sizeof(name)) == 0) {
+			return false;
+		}
+
+		for (uint32_t j = 0; j < n_bitmaps; j++) {
+			as_namespace ns;
+
+			if (! as_snapshot_read(&r, ns, sizeof(ns)) ||
+				! as_snapshot_skip(&r, 1 + bitmap_size)) {
+				return false;
+			}
+
+			if (ns[0] == 0 || memchr(ns, 0, sizeof(ns)) == 0) {
+				return false;
+			}
+		}
+	}
+	return r.p == r.end;
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ ******************************************************************************/
+
+as_status
+as_snapshot_load(as_cluster* cluster, as_error* err, const char* path, as_vector* /* <as_node*> */ nodes)
+{
+	uint8_t* buf;
+	size_t size;
+
+	if (! as_snapshot_read_file(path, &buf, &size)) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to read snapshot %s: %d", path, errno);
+	}
+
+	as_snapshot_reader r;
+	r.p = buf;
+	r.end = buf + size;
+
+	uint32_t header[4];
+
+	if (! as_snapshot_read(&r, header, sizeof(header)) ||
+		header[0] != AS_SNAPSHOT_MAGIC || header[1] != AS_SNAPSHOT_VERSION ||
+		header[2] == 0 || header[3] == 0) {
+		cf_free(buf);
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Invalid snapshot header: %s", path);
+	}
+
+	uint32_t n_partitions = header[2];
+	uint32_t n_nodes = header[3];
+	uint32_t bitmap_size = (n_partitions + 7) / 8;
+
+	if ((cluster->n_partitions && cluster->n_partitions != n_partitions) ||
+		! as_snapshot_validate(r, n_nodes, bitmap_size)) {
+		cf_free(buf);
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Invalid snapshot: %s", path);
+	}
+	cluster->n_partitions = n_partitions;
+
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		as_node_info node_info;
+		uint8_t features[4];
+		uint32_t partition_generation;
+		uint32_t n_bitmaps;
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+
+		as_snapshot_read(&r, node_info.name, AS_NODE_NAME_SIZE);
+		as_snapshot_read(&r, &addr.sin_addr.s_addr, sizeof(uint32_t));
+		as_snapshot_read(&r, &addr.sin_port, sizeof(uint16_t));
+		as_snapshot_read(&r, features, sizeof(features));
+		as_snapshot_read(&r, &partition_generation, sizeof(uint32_t));
+		as_snapshot_read(&r, &n_bitmaps, sizeof(uint32_t));
+
+		node_info.has_batch_index = features[0];
+		node_info.has_replicas_all = features[1];
+		node_info.has_double = features[2];
+		node_info.has_geo = features[3];
+
+		as_node* node = as_node_create(cluster, &addr, &node_info);
+
+		// The first tend refreshes partitions only if the server's generation differs.
+		node->partition_generation = partition_generation;
+
+		for (uint32_t j = 0; j < n_bitmaps; j++) {
+			as_namespace ns;
+			uint8_t master;
+			as_snapshot_read(&r, ns, sizeof(ns));
+			as_snapshot_read(&r, &master, 1);
+			as_partition_tables_apply(cluster, node, ns, r.p, master != 0);
+			r.p += bitmap_size;
+		}
+
+		as_address* a = as_node_get_address_full(node);
+		as_log_info("Warm start node %s %s:%d", node->name, a->name, (int)cf_swap_from_be16(a->addr.sin_port));
+		as_vector_append(nodes, &node);
+	}
+	cf_free(buf);
+	return AEROSPIKE_OK;
+}
+
+void
+as_snapshot_save(as_cluster* cluster, const char* path)
+{
+	if (cluster->n_partitions == 0) {
+		return;
+	}
+
+	uint64_t signature = as_snapshot_signature(cluster);
+
+	if (signature == cluster->snapshot_signature) {
+		return;
+	}
+
+	as_nodes* nodes = cluster->nodes;
+	uint32_t bitmap_size = (cluster->n_partitions + 7) / 8;
+	uint32_t n_nodes = 0;
+	size_t size = AS_SNAPSHOT_HEADER_SIZE;
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+
+		if (! node->active) {
+			continue;
+		}
+		n_nodes++;
+		size += AS_SNAPSHOT_NODE_SIZE;
+
+		for (uint32_t j = 0; j < node->bitmaps.size; j++) {
+			as_node_bitmap* bitmap = as_vector_get(&node->bitmaps, j);
+
+			if (bitmap->valid) {
+				size += AS_SNAPSHOT_BITMAP_HEADER_SIZE + bitmap_size;
+			}
+		}
+	}
+
+	if (n_nodes == 0) {
+		return;
+	}
+
+	uint8_t* buf = cf_malloc(size);
+	uint32_t header[4] = {AS_SNAPSHOT_MAGIC, AS_SNAPSHOT_VERSION, cluster->n_partitions, n_nodes};
+	uint8_t* p = as_snapshot_write(buf, header, sizeof(header));
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+
+		if (! node->active) {
+			continue;
+		}
+
+		as_address* a = as_node_get_address_full(node);
+		uint8_t features[4] = {node->has_batch_index, node->has_replicas_all, node->has_double, node->has_geo};
+		uint32_t n_bitmaps = 0;
+
+		for (uint32_t j = 0; j < node->bitmaps.size; j++) {
+			as_node_bitmap* bitmap = as_vector_get(&node->bitmaps, j);
+
+			if (bitmap->valid) {
+				n_bitmaps++;
+			}
+		}
+
+		char name[AS_NODE_NAME_SIZE];
+		memset(name, 0, sizeof(name));
+		as_strncpy(name, node->name, sizeof(name));
+
+		p = as_snapshot_write(p, name, sizeof(name));
+		p = as_snapshot_write(p, &a->addr.sin_addr.s_addr, sizeof(uint32_t));
+		p = as_snapshot_write(p, &a->addr.sin_port, sizeof(uint16_t));
+		p = as_snapshot_write(p, features, sizeof(features));
+		p = as_snapshot_write(p, &node->partition_generation, sizeof(uint32_t));
+		p = as_snapshot_write(p, &n_bitmaps, sizeof(uint32_t));
+
+		for (uint32_t j = 0; j < node->bitmaps.size; j++) {
+			as_node_bitmap* bitmap = as_vector_get(&node->bitmaps, j);
+
+			if (bitmap->valid) {
+				as_namespace ns;
+				memset(ns, 0, sizeof(ns));
+				as_strncpy(ns, bitmap->ns, sizeof(ns));
+				uint8_t master = bitmap->master;
+
+				p = as_snapshot_write(p, ns, sizeof(ns));
+				p = as_snapshot_write(p, &master, 1);
+				p = as_snapshot_write(p, bitmap->bits, bitmap_size);
+			}
+		}
+	}
+
+	// Processes sharing a snapshot path each write their own temporary file.
+	char tmp_path[AS_CONFIG_PATH_MAX_SIZE + 16];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+
+	FILE* file = fopen(tmp_path, "wb");
+
+	if (! file) {
+		as_log_warn("Failed to create snapshot %s: %d", tmp_path, errno);
+		cf_free(buf);
+		return;
+	}
+
+	bool written = fwrite(buf, 1, size, file) == size;
+	written = (fclose(file) == 0) && written;
+	cf_free(buf);
+
+	if (! written || rename(tmp_path, path) != 0) {
+		as_log_warn("Failed to write snapshot %s: %d", path, errno);
+		unlink(tmp_path);
+		return;
+	}
+	cluster->snapshot_signature = signature;
+	as_log_debug("Saved snapshot %s: %u nodes", path, n_nodes);
+}
@@ -27,7 +27,9 @@
 #if defined(__linux__) || defined(__APPLE__)
 #include <fcntl.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <errno.h>
@@ -64,8 +66,6 @@
 
 #if defined(__linux__) || defined(__APPLE__)
 
-#define STACK_LIMIT (16 * 1024)
-
 /******************************************************************************
  * DEBUG FUNCTIONS
  *****************************************************************************/
@@ -93,40 +93,229 @@ debug_time_printf(const char* desc, int try, int busy, uint64_t start, uint64_t
  * STATIC FUNCTIONS
  *****************************************************************************/
 
+#if defined(__linux__)
+#define AS_SOCKET_SEND_FLAGS MSG_NOSIGNAL
+#else
+// SO_NOSIGPIPE is set on socket creation.
+#define AS_SOCKET_SEND_FLAGS 0
+#endif
+
 //
-// There is a conflict even among various versions of
-// linux, because it's common to compile kernels - or set ulimits -
-// where the FD_SETSIZE is much greater than a compiled version.
-// Thus, we can compute the required size of the fdset and use a reasonable size
-// the other option is using epoll, which is a little scary for this kind of
-// "I just want a timeout" usage.
+// All client sockets are created non-blocking by as_socket_create_nb() and stay
+// non-blocking for their entire life, so socket flags do not need to be checked
+// before each read or write.  The socket is read/written first and poll() is only
+// called when the operation would block.  Unlike select(), poll() has no
+// FD_SETSIZE limit on descriptor values.
 //
-// The reality is 8 bits per byte, but this calculation is a little more general
+// Wait until socket is ready for the given events.  A zero deadline waits forever.
 //
-static inline size_t
-as_fdset_size(int fd)
+static as_status
+as_socket_wait(as_error* err, int fd, short events, uint64_t deadline)
 {
-	// Roundup fd in increments of FD_SETSIZE and convert to bytes.
-	return ((fd / FD_SETSIZE) + 1) * FD_SETSIZE / 8;
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = events;
+
+	while (true) {
+		int timeout = -1;
+
+		if (deadline) {
+			uint64_t now = cf_getms();
+
+			if (now >= deadline) {
+				// Do not set error string to avoid affecting performance.
+				// Calling functions usually retry, so the error string is not used anyway.
+				return err->code = AEROSPIKE_ERR_TIMEOUT;
+			}
+			uint64_t ms_left = deadline - now;
+			timeout = (ms_left > INT32_MAX)? INT32_MAX : (int)ms_left;
+		}
+
+		pfd.revents = 0;
+		int rv = poll(&pfd, 1, timeout);
+
+		if (rv > 0) {
+			// Ready, or an error/hangup that the following read or write will report.
+			return AEROSPIKE_OK;
+		}
+
+		if (rv < 0 && errno != EINTR) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket poll error: %d", errno);
+		}
+		// Timed out or interrupted.  Deadline is checked at top of loop.
+	}
 }
 
-// From glibc-2.15 (ubuntu 12.0.4+), the FD_* functions has a check on the
-// number of fds passed. According to the man page of FD_SET, the behavior
-// is undefined for fd > 1024. But this is enforced from glibc-2.15
-// https://sourceware.org/bugzilla/show_bug.cgi?id=10352
-//
-// So, manipulate the base and the offset of the fd in it
-//
-static inline void
-as_fd_set(int fd, fd_set *fdset)
+static as_status
+as_socket_writev_internal(as_error* err, int fd, struct iovec* iov, int iovcnt, uint64_t deadline)
 {
-	FD_SET(fd%FD_SETSIZE, &fdset[fd/FD_SETSIZE]);
+#ifdef DEBUG_TIME
+	uint64_t start = cf_getms();
+	int try = 0;
+#endif
+	// Partial writes advance the vector in place, so work on a copy.  The caller's
+	// vector must stay intact for retries.
+	struct iovec* vec = alloca(sizeof(struct iovec) * iovcnt);
+	memcpy(vec, iov, sizeof(struct iovec) * iovcnt);
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = vec;
+	msg.msg_iovlen = iovcnt;
+
+	// Skip empty entries so a zero byte write is never requested.
+	while (msg.msg_iovlen > 0 && msg.msg_iov->iov_len == 0) {
+		msg.msg_iov++;
+		msg.msg_iovlen--;
+	}
+
+	bool waited = false;
+
+	while (msg.msg_iovlen > 0) {
+		ssize_t bytes = sendmsg(fd, &msg, AS_SOCKET_SEND_FLAGS);
+
+		if (bytes > 0) {
+			size_t len = (size_t)bytes;
+
+			// Drop entries that were fully written and trim the partially written one.
+			while (msg.msg_iovlen > 0 && len >= msg.msg_iov->iov_len) {
+				len -= msg.msg_iov->iov_len;
+				msg.msg_iov++;
+				msg.msg_iovlen--;
+			}
+
+			if (len > 0) {
+				msg.msg_iov->iov_base = (uint8_t*)msg.msg_iov->iov_base + len;
+				msg.msg_iov->iov_len -= len;
+			}
+			continue;
+		}
+
+		if (bytes == 0) {
+			// We shouldn't see 0 returned unless we try to write 0 bytes, which we don't.
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+
+		if (errno == EINTR) {
+			continue;
+		}
+
+		// MacOS returns "socket not connected" while a non-blocking connect is still
+		// in progress.  Wait for writability once before treating that as an error.
+		if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINPROGRESS && ! (errno == ENOTCONN && ! waited)) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
+		}
+
+		as_status status = as_socket_wait(err, fd, POLLOUT, deadline);
+
+		if (status) {
+#ifdef DEBUG_TIME
+			debug_time_printf("socket write wait", try, 0, start, cf_getms(), deadline);
+#endif
+			return status;
+		}
+		waited = true;
+#ifdef DEBUG_TIME
+		try++;
+#endif
+	}
+	return AEROSPIKE_OK;
+}
+
+static as_status
+as_socket_write_internal(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline)
+{
+#ifdef DEBUG_TIME
+	uint64_t start = cf_getms();
+	int try = 0;
+#endif
+	size_t pos = 0;
+	bool waited = false;
+
+	while (pos < buf_len) {
+		ssize_t bytes = send(fd, buf + pos, buf_len - pos, AS_SOCKET_SEND_FLAGS);
+
+		if (bytes > 0) {
+			pos += bytes;
+			continue;
+		}
+
+		if (bytes == 0) {
+			// We shouldn't see 0 returned unless we try to write 0 bytes, which we don't.
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+
+		if (errno == EINTR) {
+			continue;
+		}
+
+		// MacOS returns "socket not connected" while a non-blocking connect is still
+		// in progress.  Wait for writability once before treating that as an error.
+		if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINPROGRESS && ! (errno == ENOTCONN && ! waited)) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
+		}
+
+		as_status status = as_socket_wait(err, fd, POLLOUT, deadline);
+
+		if (status) {
+#ifdef DEBUG_TIME
+			debug_time_printf("socket write wait", try, 0, start, cf_getms(), deadline);
+#endif
+			return status;
+		}
+		waited = true;
+#ifdef DEBUG_TIME
+		try++;
+#endif
+	}
+	return AEROSPIKE_OK;
 }
 
-static inline int
-as_fd_isset(int fd, fd_set *fdset)
+static as_status
+as_socket_read_internal(as_error* err, int fd, uint8_t *buf, size_t min_len, size_t max_len,
+	uint64_t deadline, size_t* bytes_read)
 {
-	return FD_ISSET(fd%FD_SETSIZE, &fdset[fd/FD_SETSIZE]);
+#ifdef DEBUG_TIME
+	uint64_t start = cf_getms();
+	int try = 0;
+#endif
+	size_t pos = 0;
+
+	while (pos < min_len) {
+		ssize_t bytes = recv(fd, buf + pos, max_len - pos, 0);
+
+		if (bytes > 0) {
+			pos += bytes;
+			continue;
+		}
+
+		if (bytes == 0) {
+			// We believe this means that the server has closed this socket.
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+
+		if (errno == EINTR) {
+			continue;
+		}
+
+		if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINPROGRESS) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read error: %d", errno);
+		}
+
+		as_status status = as_socket_wait(err, fd, POLLIN, deadline);
+
+		if (status) {
+#ifdef DEBUG_TIME
+			debug_time_printf("socket read wait", try, 0, start, cf_getms(), deadline);
+#endif
+			return status;
+		}
+#ifdef DEBUG_TIME
+		try++;
+#endif
+	}
+	*bytes_read = pos;
+	return AEROSPIKE_OK;
 }
 
 /******************************************************************************
@@ -236,114 +425,21 @@ as_socket_validate(int fd, bool expect_empty)
 as_status
 as_socket_write_forever(as_error* err, int fd, uint8_t *buf, size_t buf_len)
 {
-	// MacOS will return "socket not connected" errors even when connection is
-	// blocking.  Therefore, select() is required before writing.  Since write
-	// timeout function also calls select(), use write timeout function with
-	// 1 minute timeout.
+	// Keep the historical 1 minute limit so a write to a peer that stopped
+	// reading can not block forever.
 	return as_socket_write_timeout(err, fd, buf, buf_len, 60000);
 }
 
 as_status
 as_socket_write_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline)
 {
-#ifdef DEBUG_TIME
-	uint64_t start = cf_getms();
-#endif
-	struct timeval tv;
-	size_t pos = 0;
-    
-	int flags;
-	if (-1 == (flags = fcntl(fd, F_GETFL, 0)))
-		flags = 0;
-	if (! (flags & O_NONBLOCK)) {
-		if (-1 == fcntl(fd, F_SETFL, flags | O_NONBLOCK)) {
-			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Socket nonblocking set failed.");
-		}
-	}
-	
-	// Setup fdset. This looks weird, but there's no guarantee that compiled
-	// FD_SETSIZE has much to do with the machine we're running on.
-	size_t wset_size = as_fdset_size(fd);
-	fd_set* wset = (fd_set*)(wset_size > STACK_LIMIT ? cf_malloc(wset_size) : alloca(wset_size));
-	
-	if (!wset) {
-		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket fdset allocation error: %d", wset_size);
-	}
-	
-	as_status status = AEROSPIKE_OK;
-	int try = 0;
-#ifdef DEBUG_TIME
-	int select_busy = 0;
-#endif
-    
-	do {
-		uint64_t now = cf_getms();
-		if (now > deadline) {
-#ifdef DEBUG_TIME
-			debug_time_printf("socket writeselect timeout", try, select_busy, start, now, deadline);
-#endif
-			// Do not set error string to avoid affecting performance.
-			// Calling functions usually retry, so the error string is not used anyway.
-			status = err->code = AEROSPIKE_ERR_TIMEOUT;
-			goto Out;
-        }
-        
-		uint64_t ms_left = deadline - now;
-		tv.tv_sec = ms_left / 1000;
-		tv.tv_usec = (ms_left % 1000) * 1000;
-        
-		memset((void*)wset, 0, wset_size);
-		as_fd_set(fd, wset);
-        
-		int rv = select(fd +1, 0 /*readfd*/, wset /*writefd*/, 0/*oobfd*/, &tv);
-        
-		// we only have one fd, so we know it's ours, but select seems confused sometimes - do the safest thing
-		if ((rv > 0) && as_fd_isset(fd, wset)) {
-            
-			int r_bytes = (int)write(fd, buf + pos, buf_len - pos );
-            
-			if (r_bytes > 0) {
-				pos += r_bytes;
-				if (pos >= buf_len)	{
-					// done happily
-					goto Out;
-				}
-            }
-			else if (r_bytes == 0) {
-				// We shouldn't see 0 returned unless we try to write 0 bytes, which we don't.
-				status = as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
-				goto Out;
-			}
-            else if (errno != ETIMEDOUT
-                     && errno != EWOULDBLOCK && errno != EINPROGRESS && errno != EAGAIN) {
-#ifdef DEBUG_TIME
-    			debug_time_printf("socket write timeout", try, select_busy, start, now, deadline);
-#endif
-				status = as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
-                goto Out;
-			}
-		}
-        else if (rv == 0) {
-#ifdef DEBUG_TIME
-        	select_busy++;
-#endif
-    	}
-        else {
-			if (rv == -1) {
-				status = as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
-				goto Out;
-			}
-        }
-        
-		try++;
-        
-	} while( pos < buf_len );
-    
-Out:
-	if (wset_size > STACK_LIMIT) {
-		cf_free(wset);
-	}
-	return status;
+	return as_socket_write_internal(err, fd, buf, buf_len, deadline);
+}
+
+as_status
+as_socket_writev_limit(as_error* err, int fd, struct iovec* iov, int iovcnt, uint64_t deadline)
+{
+	return as_socket_writev_internal(err, fd, iov, iovcnt, deadline);
 }
 
 //
@@ -353,135 +449,23 @@ Out:
 as_status
 as_socket_read_forever(as_error* err, int fd, uint8_t *buf, size_t buf_len)
 {
-	// one way is to make sure the fd is blocking, and block
-	int flags;
-	if (-1 == (flags = fcntl(fd, F_GETFL, 0)))
-		flags = 0;
-	if (flags & O_NONBLOCK) {
-		if (-1 == fcntl(fd, F_SETFL, flags & ~O_NONBLOCK)) {
-			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Socket blocking set failed.");
-		}
-	}
-    
-	size_t pos = 0;
-	do {
-		int r_bytes = (int)read(fd, buf + pos, buf_len - pos );
-		if (r_bytes < 0) { // don't combine these into one line! think about it!
-			if (errno != ETIMEDOUT) {
-				return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read forever failed, errno %d", errno);
-			}
-		}
-		else if (r_bytes == 0) {
-			// blocking read returns 0 bytes socket timedout at server side
-			// is closed
-			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
-		}
-		else {
-			pos += r_bytes;
-		}
-	} while (pos < buf_len);
-    
-	return AEROSPIKE_OK;
+	// Keep socket non-blocking and wait without a deadline.
+	size_t bytes_read;
+	return as_socket_read_internal(err, fd, buf, buf_len, buf_len, 0, &bytes_read);
 }
 
 as_status
 as_socket_read_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline)
 {
-#ifdef DEBUG_TIME
-	uint64_t start = cf_getms();
-#endif
-	struct timeval tv;
-	size_t pos = 0;
-    
-	int flags;
-	if (-1 == (flags = fcntl(fd, F_GETFL, 0)))
-		flags = 0;
-	if (! (flags & O_NONBLOCK)) {
-		if (-1 == fcntl(fd, F_SETFL, flags | O_NONBLOCK)) {
-			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Socket nonblocking set failed.");
-		}
-	}
-    
-	// Setup fdset. This looks weird, but there's no guarantee that compiled
-	// FD_SETSIZE has much to do with the machine we're running on.
-	size_t rset_size = as_fdset_size(fd);
-	fd_set* rset = (fd_set*)(rset_size > STACK_LIMIT ? cf_malloc(rset_size) : alloca(rset_size));
-	
-	if (!rset) {
-		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket fdset allocation error: %d", rset_size);
-	}
+	size_t bytes_read;
+	return as_socket_read_internal(err, fd, buf, buf_len, buf_len, deadline, &bytes_read);
+}
 
-	int status = AEROSPIKE_OK;
-	int try = 0;
-#ifdef DEBUG_TIME
-	int select_busy = 0;
-#endif
-    
-	do {
-		uint64_t now = cf_getms();
-		if (now > deadline) {
-#ifdef DEBUG_TIME
-			debug_time_printf("socket readselect timeout", try, select_busy, start, now, deadline);
-#endif
-			// Do not set error string to avoid affecting performance.
-			// Calling functions usually retry, so the error string is not used anyway.
-			status = err->code = AEROSPIKE_ERR_TIMEOUT;
-			goto Out;
-        }
-        
-		uint64_t ms_left = deadline - now;
-		tv.tv_sec = ms_left / 1000;
-		tv.tv_usec = (ms_left % 1000) * 1000;
-        
-		memset((void*)rset, 0, rset_size);
-		as_fd_set(fd, rset);
-		int rv = select(fd +1, rset /*readfd*/, 0 /*writefd*/, 0 /*oobfd*/, &tv);
-        
-		// we only have one fd, so we know it's ours?
-		if ((rv > 0) && as_fd_isset(fd, rset)) {
-            
-			int r_bytes = (int)read(fd, buf + pos, buf_len - pos );
-            
-			if (r_bytes > 0) {
-				pos += r_bytes;
-            }
-			else if (r_bytes == 0) {
-				// We believe this means that the server has closed this socket.
-				status = as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
-				goto Out;
-			}
-            else if (errno != ETIMEDOUT
-                     // It's apparently possible that select() returns successfully yet
-                     // the socket is not ready for reading.
-                     && errno != EWOULDBLOCK && errno != EINPROGRESS && errno != EAGAIN) {
-#ifdef DEBUG_TIME
-    			debug_time_printf("socket read timeout", try, select_busy, start, now, deadline);
-#endif
-				status = as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read error: %d", errno);
-				goto Out;
-            }
-		}
-		else if (rv == 0) {
-#ifdef DEBUG_TIME
-			select_busy++;
-#endif
-        }
-        else {
-			if (rv == -1)  {
-				status = as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
-				goto Out;
-			}
-        }
-        
-        try++;
-        
-	} while (pos < buf_len);
-    
-Out:
-	if (rset_size > STACK_LIMIT) {
-		cf_free(rset);
-	}
-	return status;
+as_status
+as_socket_read_available(as_error* err, int fd, uint8_t *buf, size_t min_len, size_t max_len,
+	uint64_t deadline, size_t* bytes_read)
+{
+	return as_socket_read_internal(err, fd, buf, min_len, max_len, deadline, bytes_read);
 }
 
 #else // CF_WINDOWS
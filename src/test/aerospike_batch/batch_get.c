@@ -116,6 +116,54 @@ static bool batch_sequence_callback(as_key* key, as_record* record, void* udata)
 	return true;
 }
 
+typedef struct batch_foreach_data_s {
+    uint32_t counts[N_KEYS + 1];
+    uint32_t total;
+    uint32_t found;
+    uint32_t errors;
+    uint32_t limit;
+} batch_foreach_data;
+
+static bool batch_foreach_callback(const as_batch_read* result, void* udata)
+{
+	batch_foreach_data* data = (batch_foreach_data*)udata;
+	int64_t k = as_integer_getorelse((as_integer *)result->key->valuep, -1);
+
+	if (k < 0 || k > N_KEYS) {
+		data->errors++;
+		return true;
+	}
+
+	data->counts[k]++;
+	data->total++;
+
+	if (result->result == AEROSPIKE_OK) {
+		data->found++;
+
+		// Exists results have no bins.
+		int64_t v = as_record_get_int64(&result->record, "val", k);
+		if (k != v) {
+			warn("key(%d) != val(%d)", k, v);
+			data->errors++;
+		}
+	}
+	else if (result->result != AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+		data->errors++;
+	}
+	return data->limit == 0 || data->total < data->limit;
+}
+
+static bool batch_foreach_once(batch_foreach_data* data)
+{
+	for (uint32_t i = 1; i <= N_KEYS; i++) {
+		if (data->counts[i] != 1) {
+			warn("key(%d) passed %d times", i, data->counts[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
 /******************************************************************************
  * TEST CASES
  *****************************************************************************/
@@ -181,6 +229,35 @@ TEST( batch_get_1 , "Simple" )
     assert_int_eq( data.errors , 0 );
 }
 
+TEST( batch_get_duplicates , "Batch get with duplicate keys" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, N_KEYS);
+
+    // Each of 10 keys appears N_KEYS/10 times.
+    for (uint32_t i = 0; i < N_KEYS; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i % 10 + 1);
+    }
+
+    as_policy_batch policy;
+    as_policy_batch_init(&policy);
+    policy.deduplicate = true;
+
+    batch_read_data data = {0};
+
+    aerospike_batch_get(as, &err, &policy, &batch, batch_get_1_callback, &data);
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    assert_int_eq( data.total , N_KEYS );
+    assert_int_eq( data.found , N_KEYS );
+    assert_int_eq( data.errors , 0 );
+}
+
 TEST( batch_get_sequence , "Batch get in sequence" )
 {
     as_error err;
@@ -204,6 +281,113 @@ TEST( batch_get_sequence , "Batch get in sequence" )
     assert_int_eq( data.errors , 0 );
 }
 
+TEST( batch_get_foreach , "Batch get foreach" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, N_KEYS);
+
+    for (uint32_t i = 0; i < N_KEYS; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i+1);
+    }
+
+    as_policy_batch policy;
+    as_policy_batch_init(&policy);
+
+    // Sequential and concurrent node commands.
+    for (uint32_t i = 0; i < 2; i++) {
+        policy.concurrent = i == 1;
+
+        batch_foreach_data data = {{0}};
+
+        aerospike_batch_get_foreach(as, &err, &policy, &batch, batch_foreach_callback, &data);
+        if ( err.code != AEROSPIKE_OK ) {
+            info("error(%d): %s", err.code, err.message);
+        }
+        assert_int_eq( err.code , AEROSPIKE_OK );
+
+        assert_int_eq( data.total , N_KEYS );
+        assert_int_eq( data.found , N_KEYS - N_KEYS/20);
+        assert_int_eq( data.errors , 0 );
+        assert_true( batch_foreach_once(&data) );
+    }
+}
+
+TEST( batch_get_bins_foreach , "Batch get bins foreach" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, N_KEYS);
+
+    for (uint32_t i = 0; i < N_KEYS; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i+1);
+    }
+
+    batch_foreach_data data = {{0}};
+    const char* bins[] = {"val2"};
+
+    aerospike_batch_get_bins_foreach(as, &err, NULL, &batch, bins, 1, batch_foreach_callback, &data);
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    // "val" is filtered out, so the callback does not find a mismatch.
+    assert_int_eq( data.total , N_KEYS );
+    assert_int_eq( data.found , N_KEYS - N_KEYS/20);
+    assert_int_eq( data.errors , 0 );
+    assert_true( batch_foreach_once(&data) );
+}
+
+TEST( batch_exists_foreach , "Batch exists foreach" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, N_KEYS);
+
+    for (uint32_t i = 0; i < N_KEYS; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i+1);
+    }
+
+    batch_foreach_data data = {{0}};
+
+    aerospike_batch_exists_foreach(as, &err, NULL, &batch, batch_foreach_callback, &data);
+    if ( err.code != AEROSPIKE_OK ) {
+        info("error(%d): %s", err.code, err.message);
+    }
+    assert_int_eq( err.code , AEROSPIKE_OK );
+
+    assert_int_eq( data.total , N_KEYS );
+    assert_int_eq( data.found , N_KEYS - N_KEYS/20);
+    assert_int_eq( data.errors , 0 );
+    assert_true( batch_foreach_once(&data) );
+}
+
+TEST( batch_get_foreach_abort , "Batch get foreach aborted by callback" )
+{
+    as_error err;
+
+    as_batch batch;
+    as_batch_inita(&batch, N_KEYS);
+
+    for (uint32_t i = 0; i < N_KEYS; i++) {
+        as_key_init_int64(as_batch_keyat(&batch,i), NAMESPACE, SET, i+1);
+    }
+
+    batch_foreach_data data = {{0}};
+    data.limit = 10;
+
+    aerospike_batch_get_foreach(as, &err, NULL, &batch, batch_foreach_callback, &data);
+    assert_int_eq( err.code , AEROSPIKE_ERR_CLIENT_ABORT );
+
+    // No callbacks after the abort.
+    assert_int_eq( data.total , 10 );
+    assert_int_eq( data.errors , 0 );
+}
+
 void *batch_get_function(void  *thread_id)
 {
     int thread_num = *(int*)thread_id;
@@ -471,7 +655,12 @@ TEST( batch_get_post , "Post: Remove Records" )
 SUITE( batch_get, "aerospike_batch_get tests" ) {
     suite_add( batch_get_pre );
     suite_add( batch_get_1 );
+    suite_add( batch_get_duplicates );
     suite_add( batch_get_sequence );
+    suite_add( batch_get_foreach );
+    suite_add( batch_get_bins_foreach );
+    suite_add( batch_exists_foreach );
+    suite_add( batch_get_foreach_abort );
     suite_add( multithreaded_batch_get );
     suite_add( batch_get_bins );
     suite_add( batch_read_complex );
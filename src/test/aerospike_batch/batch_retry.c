@@ -0,0 +1,427 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_info.h>
+#include <aerospike/aerospike_key.h>
+
+#include <aerospike/as_batch.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_clock.h>
+#include <string.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define SET "test_batch_retry"
+#define N_KEYS 100
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct batch_retry_data_s {
+	uint32_t counts[N_KEYS];
+	uint32_t total;
+	uint32_t found;
+	uint32_t failed;
+	uint32_t errors;
+	as_status last_error;
+} batch_retry_data;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * Connect client whose breakers open on the first error and stay open, so tests
+ * can make nodes fail without stopping them.
+ */
+static bool
+batch_retry_connect(aerospike * client)
+{
+	as_config config;
+	test_config_init(&config);
+	config.breaker_errors = 1;
+	config.breaker_open_ms = 60000;
+
+	aerospike_init(client, &config);
+
+	as_error err;
+
+	if ( aerospike_connect(client, &err) != AEROSPIKE_OK ) {
+		error("%s @ %s[%s:%d]", err.message, err.func, err.file, err.line);
+		aerospike_destroy(client);
+		return false;
+	}
+	return true;
+}
+
+static void
+batch_retry_close(aerospike * client)
+{
+	as_error err;
+	aerospike_close(client, &err);
+	aerospike_destroy(client);
+}
+
+/**
+ * Open breakers of the first n nodes.  Return number of nodes in cluster.
+ */
+static uint32_t
+batch_retry_fail_nodes(aerospike * client, uint32_t n)
+{
+	as_nodes * nodes = as_nodes_reserve(client->cluster);
+	uint32_t size = nodes->size;
+
+	for (uint32_t i = 0; i < n && i < size; i++) {
+		as_node_breaker_failure(nodes->array[i]);
+	}
+	as_nodes_release(nodes);
+	return size;
+}
+
+static uint32_t
+batch_retry_replication_factor()
+{
+	as_error err;
+	char * res = NULL;
+
+	if ( aerospike_info_host(as, &err, NULL, g_host, g_port, "namespace/" NAMESPACE, &res) != AEROSPIKE_OK ) {
+		return 0;
+	}
+
+	uint32_t factor = 0;
+	char * p = strstr(res, "replication-factor=");
+
+	if ( p ) {
+		factor = atoi(p + strlen("replication-factor="));
+	}
+	else if ( (p = strstr(res, "repl-factor=")) ) {
+		factor = atoi(p + strlen("repl-factor="));
+	}
+	free(res);
+	return factor;
+}
+
+static void
+batch_retry_init(as_batch * batch)
+{
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		as_key_init_int64(as_batch_keyat(batch, i), NAMESPACE, SET, i);
+	}
+}
+
+static bool
+batch_retry_callback(const as_batch_read * result, void * udata)
+{
+	batch_retry_data * data = (batch_retry_data *) udata;
+	int64_t k = as_integer_getorelse((as_integer *) result->key->valuep, -1);
+
+	if ( k < 0 || k >= N_KEYS ) {
+		data->errors++;
+		return true;
+	}
+
+	data->counts[k]++;
+	data->total++;
+
+	if ( result->result == AEROSPIKE_OK ) {
+		data->found++;
+
+		if ( as_record_get_int64(&result->record, "val", -1) != k ) {
+			data->errors++;
+		}
+	}
+	else {
+		data->failed++;
+		data->last_error = result->result;
+	}
+	return true;
+}
+
+static bool
+batch_retry_once(batch_retry_data * data)
+{
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		if ( data->counts[i] != 1 ) {
+			warn("key(%d) passed %d times", i, data->counts[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( batch_retry_pre , "Pre: Create Records" )
+{
+	as_error err;
+
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		as_key key;
+		as_key_init_int64(&key, NAMESPACE, SET, (int64_t) i);
+
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "val", (int64_t) i);
+
+		aerospike_key_put(as, &err, NULL, &key, &rec);
+		as_record_destroy(&rec);
+
+		assert_int_eq( err.code , AEROSPIKE_OK );
+	}
+}
+
+TEST( batch_retry_unavailable , "Keys of failed nodes get the error when no replica is available" )
+{
+	aerospike client;
+	assert_true( batch_retry_connect(&client) );
+
+	as_batch batch;
+	as_batch_inita(&batch, N_KEYS);
+	batch_retry_init(&batch);
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.retry = 2;
+
+	batch_retry_fail_nodes(&client, UINT32_MAX);
+
+	// Sequential and concurrent node commands.
+	for (uint32_t i = 0; i < 2; i++) {
+		policy.concurrent = i == 1;
+
+		as_error err;
+		batch_retry_data data = {{0}};
+
+		aerospike_batch_get_foreach(&client, &err, &policy, &batch, batch_retry_callback, &data);
+		assert_int_eq( err.code , AEROSPIKE_ERR_NODE_UNAVAILABLE );
+
+		// Every key is passed once with the error.
+		assert_int_eq( data.total , N_KEYS );
+		assert_int_eq( data.failed , N_KEYS );
+		assert_int_eq( data.last_error , AEROSPIKE_ERR_NODE_UNAVAILABLE );
+		assert_true( batch_retry_once(&data) );
+	}
+
+	batch_retry_close(&client);
+}
+
+TEST( batch_retry_alternate , "Keys of a failed node are sent to the other replica" )
+{
+	if ( batch_retry_replication_factor() < 2 ) {
+		fprintf(stderr, "replication factor is less than 2. skipping test");
+		return;
+	}
+
+	aerospike client;
+	assert_true( batch_retry_connect(&client) );
+
+	if ( batch_retry_fail_nodes(&client, 1) < 2 ) {
+		fprintf(stderr, "cluster has one node. skipping test");
+		batch_retry_close(&client);
+		return;
+	}
+
+	as_batch batch;
+	as_batch_inita(&batch, N_KEYS);
+	batch_retry_init(&batch);
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.retry = 1;
+
+	for (uint32_t i = 0; i < 2; i++) {
+		policy.concurrent = i == 1;
+
+		as_error err;
+		batch_retry_data data = {{0}};
+
+		aerospike_batch_get_foreach(&client, &err, &policy, &batch, batch_retry_callback, &data);
+		if ( err.code != AEROSPIKE_OK ) {
+			info("error(%d): %s", err.code, err.message);
+		}
+		assert_int_eq( err.code , AEROSPIKE_OK );
+
+		// Keys that returned from healthy nodes are not sent again.
+		assert_int_eq( data.found , N_KEYS );
+		assert_int_eq( data.errors , 0 );
+		assert_true( batch_retry_once(&data) );
+	}
+
+	// Result arrays get the same results.
+	as_batch_read_records records;
+	as_batch_read_inita(&records, N_KEYS);
+
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		as_batch_read_record * record = as_batch_read_reserve(&records);
+		as_key_init_int64(&record->key, NAMESPACE, SET, i);
+		record->read_all_bins = true;
+	}
+
+	as_error err;
+	aerospike_batch_read(&client, &err, &policy, &records);
+	assert_int_eq( err.code , AEROSPIKE_OK );
+
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		as_batch_read_record * record = as_vector_get(&records.list, i);
+		assert_int_eq( record->result , AEROSPIKE_OK );
+		assert_int_eq( as_record_get_int64(&record->record, "val", -1) , i );
+	}
+	as_batch_read_destroy(&records);
+
+	batch_retry_close(&client);
+}
+
+TEST( batch_retry_disabled , "Failed node keys are not retried when retry is zero" )
+{
+	aerospike client;
+	assert_true( batch_retry_connect(&client) );
+
+	uint32_t n_nodes = batch_retry_fail_nodes(&client, 1);
+
+	as_batch batch;
+	as_batch_inita(&batch, N_KEYS);
+	batch_retry_init(&batch);
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.retry = 0;
+
+	as_error err;
+	batch_retry_data data = {{0}};
+
+	aerospike_batch_get_foreach(&client, &err, &policy, &batch, batch_retry_callback, &data);
+	assert_int_eq( err.code , AEROSPIKE_ERR_NODE_UNAVAILABLE );
+
+	// Other nodes still run, so only the failed node's keys get the error.
+	assert_int_eq( data.total , N_KEYS );
+	assert_int_eq( data.errors , 0 );
+	assert_true( data.failed > 0 );
+	assert_true( n_nodes == 1 || data.found > 0 );
+	assert_int_eq( data.found + data.failed , N_KEYS );
+	assert_true( batch_retry_once(&data) );
+
+	batch_retry_close(&client);
+}
+
+TEST( batch_retry_timeout , "Retries stop at the total timeout" )
+{
+	aerospike client;
+	assert_true( batch_retry_connect(&client) );
+
+	batch_retry_fail_nodes(&client, UINT32_MAX);
+
+	as_batch batch;
+	as_batch_inita(&batch, N_KEYS);
+	batch_retry_init(&batch);
+
+	// Attempts fail at once, so only the total timeout ends the retries.
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.timeout = 200;
+	policy.socket_timeout = 50;
+	policy.retry = UINT32_MAX;
+
+	as_error err;
+	batch_retry_data data = {{0}};
+
+	uint64_t begin = cf_getms();
+	aerospike_batch_get_foreach(&client, &err, &policy, &batch, batch_retry_callback, &data);
+	uint64_t elapsed = cf_getms() - begin;
+
+	assert_int_ne( err.code , AEROSPIKE_OK );
+	assert_true( elapsed >= policy.timeout );
+	assert_true( elapsed < policy.timeout + 1000 );
+	assert_int_eq( data.failed , N_KEYS );
+	assert_true( batch_retry_once(&data) );
+
+	batch_retry_close(&client);
+}
+
+TEST( batch_retry_socket_timeout , "Attempts complete within socket_timeout" )
+{
+	as_batch batch;
+	as_batch_inita(&batch, N_KEYS);
+	batch_retry_init(&batch);
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.timeout = 1000;
+
+	// Larger than the total timeout, and smaller.  Healthy nodes answer in time.
+	uint32_t socket_timeouts[] = {5000, 500};
+
+	for (uint32_t i = 0; i < 2; i++) {
+		policy.socket_timeout = socket_timeouts[i];
+
+		as_error err;
+		batch_retry_data data = {{0}};
+
+		aerospike_batch_get_foreach(as, &err, &policy, &batch, batch_retry_callback, &data);
+		assert_int_eq( err.code , AEROSPIKE_OK );
+		assert_int_eq( data.found , N_KEYS );
+		assert_true( batch_retry_once(&data) );
+	}
+}
+
+TEST( batch_retry_post , "Post: Remove Records" )
+{
+	as_error err;
+
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		as_key key;
+		as_key_init_int64(&key, NAMESPACE, SET, (int64_t) i);
+
+		aerospike_key_remove(as, &err, NULL, &key);
+		assert_int_eq( err.code , AEROSPIKE_OK );
+	}
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( batch_retry, "aerospike_batch retry tests" )
+{
+	suite_add( batch_retry_pre );
+	suite_add( batch_retry_unavailable );
+	suite_add( batch_retry_alternate );
+	suite_add( batch_retry_disabled );
+	suite_add( batch_retry_timeout );
+	suite_add( batch_retry_socket_timeout );
+	suite_add( batch_retry_post );
+}
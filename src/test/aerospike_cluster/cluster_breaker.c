@@ -0,0 +1,247 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <unistd.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define SET "test_breaker"
+#define N_KEYS 100
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static bool
+breaker_connect(aerospike * client, uint32_t errors, uint32_t open_ms)
+{
+	as_config config;
+	test_config_init(&config);
+	config.breaker_errors = errors;
+	config.breaker_open_ms = open_ms;
+
+	aerospike_init(client, &config);
+
+	as_error err;
+
+	if ( aerospike_connect(client, &err) != AEROSPIKE_OK ) {
+		error("%s @ %s[%s:%d]", err.message, err.func, err.file, err.line);
+		aerospike_destroy(client);
+		return false;
+	}
+	return true;
+}
+
+static void
+breaker_close(aerospike * client)
+{
+	as_error err;
+	aerospike_close(client, &err);
+	aerospike_destroy(client);
+}
+
+/**
+ * Record errors on every node.
+ */
+static void
+breaker_fail_nodes(aerospike * client, uint32_t errors)
+{
+	as_nodes * nodes = as_nodes_reserve(client->cluster);
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		for (uint32_t j = 0; j < errors; j++) {
+			as_node_breaker_failure(nodes->array[i]);
+		}
+	}
+	as_nodes_release(nodes);
+}
+
+static void
+breaker_succeed_nodes(aerospike * client)
+{
+	as_nodes * nodes = as_nodes_reserve(client->cluster);
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node_breaker_success(nodes->array[i]);
+	}
+	as_nodes_release(nodes);
+}
+
+static uint32_t
+breaker_node_count(aerospike * client)
+{
+	as_nodes * nodes = as_nodes_reserve(client->cluster);
+	uint32_t size = nodes->size;
+	as_nodes_release(nodes);
+	return size;
+}
+
+static as_status
+breaker_get(aerospike * client, int64_t k)
+{
+	as_error err;
+
+	as_key key;
+	as_key_init_int64(&key, NAMESPACE, SET, k);
+
+	as_record * rec = NULL;
+	as_status status = aerospike_key_get(client, &err, NULL, &key, &rec);
+	if ( rec ) {
+		as_record_destroy(rec);
+	}
+	return status;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( breaker_disabled , "errors do not open breakers when breaker_errors is zero" )
+{
+	aerospike client;
+	assert_true( breaker_connect(&client, 0, 1000) );
+
+	breaker_fail_nodes(&client, 10);
+
+	as_breaker_stats stats;
+	as_cluster_get_breaker_stats(client.cluster, &stats);
+
+	assert_int_eq( stats.trips, 0 );
+	assert_int_eq( stats.open_nodes, 0 );
+	assert_int_ne( breaker_get(&client, 1), AEROSPIKE_ERR_NODE_UNAVAILABLE );
+
+	breaker_close(&client);
+}
+
+TEST( breaker_open , "breaker opens after consecutive errors and rejects commands" )
+{
+	aerospike client;
+	assert_true( breaker_connect(&client, 3, 60000) );
+
+	uint32_t n_nodes = breaker_node_count(&client);
+
+	// Errors must be consecutive.  A response resets the count.
+	breaker_fail_nodes(&client, 2);
+	breaker_succeed_nodes(&client);
+	breaker_fail_nodes(&client, 2);
+
+	as_breaker_stats stats;
+	as_cluster_get_breaker_stats(client.cluster, &stats);
+
+	assert_int_eq( stats.trips, 0 );
+	assert_int_eq( stats.open_nodes, 0 );
+
+	breaker_fail_nodes(&client, 1);
+	as_cluster_get_breaker_stats(client.cluster, &stats);
+
+	assert_int_eq( stats.trips, n_nodes );
+	assert_int_eq( stats.open_nodes, n_nodes );
+
+	// Every replica is open, so the command fails without waiting for its timeout.
+	assert_int_eq( breaker_get(&client, 1), AEROSPIKE_ERR_NODE_UNAVAILABLE );
+
+	as_cluster_get_breaker_stats(client.cluster, &stats);
+	assert_int_eq( stats.rejects, 1 );
+
+	breaker_close(&client);
+}
+
+TEST( breaker_probe , "open breaker allows one probe per interval" )
+{
+	aerospike client;
+	assert_true( breaker_connect(&client, 1, 200) );
+
+	as_nodes * nodes = as_nodes_reserve(client.cluster);
+	as_node * node = nodes->array[0];
+
+	as_node_breaker_failure(node);
+	assert_int_eq( node->breaker_state, AS_NODE_BREAKER_OPEN );
+	assert_false( as_node_breaker_allow(node) );
+
+	usleep(300 * 1000);
+
+	// Only one command is let through until it reports.
+	assert_true( as_node_breaker_allow(node) );
+	assert_int_eq( node->breaker_state, AS_NODE_BREAKER_HALF_OPEN );
+	assert_false( as_node_breaker_allow(node) );
+
+	// Failed probe reopens the breaker.
+	as_node_breaker_failure(node);
+	assert_int_eq( node->breaker_state, AS_NODE_BREAKER_OPEN );
+	assert_false( as_node_breaker_allow(node) );
+
+	usleep(300 * 1000);
+
+	// Successful probe closes it.
+	assert_true( as_node_breaker_allow(node) );
+	as_node_breaker_success(node);
+	assert_int_eq( node->breaker_state, AS_NODE_BREAKER_CLOSED );
+	assert_true( as_node_breaker_allow(node) );
+
+	as_breaker_stats stats;
+	as_cluster_get_breaker_stats(client.cluster, &stats);
+	assert_int_eq( stats.trips, 2 );
+
+	as_nodes_release(nodes);
+	breaker_close(&client);
+}
+
+TEST( breaker_recover , "commands close breakers once nodes respond again" )
+{
+	aerospike client;
+	assert_true( breaker_connect(&client, 1, 200) );
+
+	breaker_fail_nodes(&client, 1);
+	assert_int_eq( breaker_get(&client, 1), AEROSPIKE_ERR_NODE_UNAVAILABLE );
+
+	usleep(300 * 1000);
+
+	// Keys are spread over all nodes, so each node receives a probe.
+	for (int64_t i = 0; i < N_KEYS; i++) {
+		assert_int_ne( breaker_get(&client, i), AEROSPIKE_ERR_NODE_UNAVAILABLE );
+	}
+
+	as_breaker_stats stats;
+	as_cluster_get_breaker_stats(client.cluster, &stats);
+	assert_int_eq( stats.open_nodes, 0 );
+
+	breaker_close(&client);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( cluster_breaker, "node circuit breaker tests" )
+{
+	suite_add( breaker_disabled );
+	suite_add( breaker_open );
+	suite_add( breaker_probe );
+	suite_add( breaker_recover );
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_epoch.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_partition.h>
+#include <citrusleaf/cf_b64.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define N_NODES 3
+#define N_PARTITIONS 4096
+#define BITMAP_SIZE (N_PARTITIONS / 8)
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+/**
+ * In-memory cluster with fake nodes.  Partition updates are applied the way
+ * the tend thread applies "replicas-master" and "replicas-prole" responses.
+ */
+typedef struct {
+	as_cluster * cluster;
+	as_node * nodes[N_NODES];
+	uint8_t bitmaps[2][N_NODES][BITMAP_SIZE];
+} partition_env;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+bool
+as_partition_tables_update(as_cluster * cluster, as_node * node, char * buf, bool master);
+
+static void
+partition_env_init(partition_env * env)
+{
+	memset(env, 0, sizeof(partition_env));
+
+	as_cluster * cluster = calloc(1, sizeof(as_cluster));
+	cluster->n_partitions = N_PARTITIONS;
+	cluster->epoch = as_epoch_create();
+	cluster->partition_tables = as_partition_tables_create(0);
+	env->cluster = cluster;
+
+	for ( uint32_t i = 0; i < N_NODES; i++ ) {
+		as_node * node = calloc(1, sizeof(as_node));
+		snprintf(node->name, sizeof(node->name), "BB9%013X", i);
+		node->ref_count = 1;
+		node->active = 1;
+		node->cluster = cluster;
+		as_vector_init(&node->bitmaps, sizeof(as_node_bitmap), 4);
+		env->nodes[i] = node;
+	}
+}
+
+/**
+ * Tear down and verify every partition reference taken on a node was released.
+ */
+static bool
+partition_env_destroy(partition_env * env)
+{
+	as_cluster * cluster = env->cluster;
+
+	// Releases nodes replaced during the test.
+	as_epoch_destroy(cluster->epoch);
+
+	as_partition_tables * tables = cluster->partition_tables;
+
+	for ( uint32_t i = 0; i < tables->size; i++ ) {
+		as_partition_table_destroy(tables->array[i]);
+	}
+	as_partition_tables_release(tables);
+
+	bool rv = true;
+
+	for ( uint32_t i = 0; i < N_NODES; i++ ) {
+		as_node * node = env->nodes[i];
+
+		if ( node->ref_count != 1 ) {
+			error("node %u ref_count %u", i, node->ref_count);
+			rv = false;
+		}
+
+		for ( uint32_t j = 0; j < node->bitmaps.size; j++ ) {
+			as_node_bitmap * bitmap = as_vector_get(&node->bitmaps, j);
+			free(bitmap->bits);
+		}
+		as_vector_destroy(&node->bitmaps);
+		free(node);
+	}
+	free(cluster);
+	return rv;
+}
+
+static void
+partition_set(partition_env * env, uint32_t node, bool master, uint32_t partition_id, bool owns)
+{
+	uint8_t * bitmap = env->bitmaps[master][node];
+	uint8_t mask = 0x80 >> (partition_id & 7);
+
+	if ( owns ) {
+		bitmap[partition_id >> 3] |= mask;
+	}
+	else {
+		bitmap[partition_id >> 3] &= ~mask;
+	}
+}
+
+/**
+ * Apply node's current bitmap as a tend info response "ns:<base64>\n".
+ */
+static bool
+partition_apply(partition_env * env, uint32_t node, bool master)
+{
+	char buf[sizeof(NAMESPACE) + 4 + BITMAP_SIZE * 2];
+	char * p = buf + sprintf(buf, "%s:", NAMESPACE);
+
+	cf_b64_encode(env->bitmaps[master][node], BITMAP_SIZE, p);
+	p += cf_b64_encoded_len(BITMAP_SIZE);
+	*p++ = '\n';
+	*p = 0;
+
+	return as_partition_tables_update(env->cluster, env->nodes[node], buf, master);
+}
+
+static as_node *
+partition_owner(partition_env * env, bool master, uint32_t partition_id)
+{
+	as_partition_table * table = as_partition_tables_get(env->cluster->partition_tables, NAMESPACE);
+
+	if ( ! table ) {
+		return NULL;
+	}
+
+	as_partition * p = &table->partitions[partition_id];
+	return master ? p->master : p->prole;
+}
+
+/**
+ * Bit last applied for node, as kept for the next diff.
+ */
+static bool
+partition_applied(partition_env * env, uint32_t node, bool master, uint32_t partition_id)
+{
+	as_node_bitmap * bitmap = as_node_get_bitmap(env->nodes[node], NAMESPACE, master, BITMAP_SIZE);
+	return (bitmap->bits[partition_id >> 3] & (0x80 >> (partition_id & 7))) != 0;
+}
+
+/**
+ * Spread partitions round robin, with prole on the node after the master.
+ */
+static bool
+partition_distribute(partition_env * env)
+{
+	for ( uint32_t i = 0; i < N_PARTITIONS; i++ ) {
+		partition_set(env, i % N_NODES, true, i, true);
+		partition_set(env, (i + 1) % N_NODES, false, i, true);
+	}
+
+	for ( uint32_t n = 0; n < N_NODES; n++ ) {
+		if ( ! partition_apply(env, n, true) || ! partition_apply(env, n, false) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t
+partition_mismatches(partition_env * env)
+{
+	uint32_t count = 0;
+
+	for ( uint32_t i = 0; i < N_PARTITIONS; i++ ) {
+		if ( partition_owner(env, true, i) != env->nodes[i % N_NODES] ) {
+			count++;
+		}
+		if ( partition_owner(env, false, i) != env->nodes[(i + 1) % N_NODES] ) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( cluster_partition_full , "first update applies every partition" )
+{
+	partition_env env;
+	partition_env_init(&env);
+
+	assert_true( partition_distribute(&env) );
+	assert_int_eq( partition_mismatches(&env), 0 );
+
+	for ( uint32_t n = 0; n < N_NODES; n++ ) {
+		for ( int master = 0; master < 2; master++ ) {
+			as_node_bitmap * bitmap = as_node_get_bitmap(env.nodes[n], NAMESPACE, master, BITMAP_SIZE);
+			assert_true( bitmap->valid );
+			assert_int_eq( memcmp(bitmap->bits, env.bitmaps[master][n], BITMAP_SIZE), 0 );
+		}
+	}
+
+	assert_true( partition_env_destroy(&env) );
+}
+
+TEST( cluster_partition_diff , "update touches only partitions whose bits changed" )
+{
+	partition_env env;
+	partition_env_init(&env);
+
+	assert_true( partition_distribute(&env) );
+
+	// Node 0 drops partition 0 and keeps the rest.
+	partition_set(&env, 0, true, 0, false);
+	assert_true( partition_apply(&env, 0, true) );
+	assert_null( partition_owner(&env, true, 0) );
+	assert_false( partition_applied(&env, 0, true, 0) );
+
+	// Unchanged bits are skipped, so a partition node 0 still claims but no
+	// longer holds is not rewritten.  A full update would take it back.
+	as_partition_table * table = as_partition_tables_get(env.cluster->partition_tables, NAMESPACE);
+	as_node_reserve(env.nodes[2]);
+	as_node_release(table->partitions[3].master);
+	table->partitions[3].master = env.nodes[2];
+
+	assert_true( partition_apply(&env, 0, true) );
+	assert_true( partition_owner(&env, true, 3) == env.nodes[2] );
+
+	// A changed bit is applied.
+	partition_set(&env, 0, true, 0, true);
+	assert_true( partition_apply(&env, 0, true) );
+	assert_true( partition_owner(&env, true, 0) == env.nodes[0] );
+
+	assert_true( partition_env_destroy(&env) );
+}
+
+TEST( cluster_partition_handoff , "ownership follows a handoff and a handback" )
+{
+	for ( int master = 0; master < 2; master++ ) {
+		partition_env env;
+		partition_env_init(&env);
+
+		assert_true( partition_distribute(&env) );
+
+		// Partition 0 starts on node a.  Node b takes it over before a reports the loss.
+		uint32_t pid = 0;
+		uint32_t a = master ? 0 : 1;
+		uint32_t b = 2;
+
+		assert_true( partition_owner(&env, master, pid) == env.nodes[a] );
+
+		partition_set(&env, b, master, pid, true);
+		assert_true( partition_apply(&env, b, master) );
+
+		assert_true( partition_owner(&env, master, pid) == env.nodes[b] );
+		assert_false( partition_applied(&env, a, master, pid) );
+		assert_int_eq( env.nodes[a]->partition_generation, (uint32_t)-1 );
+
+		// The old owner's stale claim is applied again on its next update, as a full
+		// update would.  Without the takeover clear, its unchanged bit is skipped.
+		assert_true( partition_apply(&env, a, master) );
+		assert_true( partition_owner(&env, master, pid) == env.nodes[a] );
+		assert_false( partition_applied(&env, b, master, pid) );
+
+		// Node a reports the handoff.  Node b's next update takes the partition back.
+		partition_set(&env, a, master, pid, false);
+		assert_true( partition_apply(&env, a, master) );
+		assert_null( partition_owner(&env, master, pid) );
+
+		assert_true( partition_apply(&env, b, master) );
+		assert_true( partition_owner(&env, master, pid) == env.nodes[b] );
+
+		// Handback: a reclaims the partition, then b drops it.
+		partition_set(&env, a, master, pid, true);
+		assert_true( partition_apply(&env, a, master) );
+		assert_true( partition_owner(&env, master, pid) == env.nodes[a] );
+		assert_false( partition_applied(&env, b, master, pid) );
+
+		partition_set(&env, b, master, pid, false);
+		assert_true( partition_apply(&env, b, master) );
+		assert_true( partition_owner(&env, master, pid) == env.nodes[a] );
+
+		// Every other partition is where it started.
+		assert_int_eq( partition_mismatches(&env), 0 );
+		assert_true( partition_env_destroy(&env) );
+	}
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( cluster_partition, "partition map bitmap diff tests" )
+{
+	suite_add( cluster_partition_full );
+	suite_add( cluster_partition_diff );
+	suite_add( cluster_partition_handoff );
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define SET "test_snapshot"
+#define SNAPSHOT_PATH "/tmp/aerospike_test_snapshot"
+#define SNAPSHOT_MAX_SIZE (1024 * 1024)
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static bool
+snapshot_connect(aerospike * client, uint16_t seed_port)
+{
+	as_config config;
+	test_config_init(&config);
+	config.hosts[0].port = seed_port;
+	strcpy(config.warm_start_path, SNAPSHOT_PATH);
+
+	aerospike_init(client, &config);
+
+	as_error err;
+
+	if ( aerospike_connect(client, &err) != AEROSPIKE_OK ) {
+		error("%s @ %s[%s:%d]", err.message, err.func, err.file, err.line);
+		aerospike_destroy(client);
+		return false;
+	}
+	return true;
+}
+
+static void
+snapshot_close(aerospike * client)
+{
+	as_error err;
+	aerospike_close(client, &err);
+	aerospike_destroy(client);
+}
+
+static uint32_t
+snapshot_node_count(aerospike * client)
+{
+	as_nodes * nodes = as_nodes_reserve(client->cluster);
+	uint32_t size = nodes->size;
+	as_nodes_release(nodes);
+	return size;
+}
+
+static as_status
+snapshot_put(aerospike * client)
+{
+	as_error err;
+
+	as_key key;
+	as_key_init_int64(&key, NAMESPACE, SET, 1);
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "val", 1);
+
+	as_status status = aerospike_key_put(client, &err, NULL, &key, &rec);
+	as_record_destroy(&rec);
+	return status;
+}
+
+/**
+ * Connect with snapshot enabled, so the tend thread saves the current cluster.
+ */
+static bool
+snapshot_create()
+{
+	unlink(SNAPSHOT_PATH);
+
+	aerospike client;
+
+	if ( ! snapshot_connect(&client, g_port) ) {
+		return false;
+	}
+	snapshot_close(&client);
+	return access(SNAPSHOT_PATH, R_OK) == 0;
+}
+
+static size_t
+snapshot_read(uint8_t * buf)
+{
+	FILE * file = fopen(SNAPSHOT_PATH, "rb");
+
+	if ( ! file ) {
+		return 0;
+	}
+	size_t size = fread(buf, 1, SNAPSHOT_MAX_SIZE, file);
+	fclose(file);
+	return size;
+}
+
+static bool
+snapshot_write(uint8_t * buf, size_t size)
+{
+	FILE * file = fopen(SNAPSHOT_PATH, "wb");
+
+	if ( ! file ) {
+		return false;
+	}
+	bool rv = fwrite(buf, 1, size, file) == size;
+	return (fclose(file) == 0) && rv;
+}
+
+/**
+ * Point every node saved in the snapshot at a port nothing listens on.
+ * Layout is described in as_snapshot.c.
+ */
+static bool
+snapshot_break_nodes()
+{
+	uint8_t * buf = malloc(SNAPSHOT_MAX_SIZE);
+	size_t size = snapshot_read(buf);
+
+	if ( size < 16 ) {
+		free(buf);
+		return false;
+	}
+
+	uint32_t * header = (uint32_t *) buf;
+	uint32_t bitmap_size = (header[2] + 7) / 8;
+	uint32_t n_nodes = header[3];
+	uint8_t * p = buf + 16;
+	uint16_t port = htons(1);
+
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		memcpy(p + AS_NODE_NAME_SIZE + 4, &port, sizeof(uint16_t));
+
+		uint32_t n_bitmaps;
+		memcpy(&n_bitmaps, p + AS_NODE_NAME_SIZE + 14, sizeof(uint32_t));
+		p += AS_NODE_NAME_SIZE + 18 + n_bitmaps * (AS_NAMESPACE_MAX_SIZE + 1 + bitmap_size);
+	}
+
+	bool rv = p == buf + size && snapshot_write(buf, size);
+	free(buf);
+	return rv;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( snapshot_save , "tend thread saves snapshot" )
+{
+	assert_true( snapshot_create() );
+
+	uint8_t * buf = malloc(SNAPSHOT_MAX_SIZE);
+	size_t size = snapshot_read(buf);
+	uint32_t n_nodes = size >= 16 ? ((uint32_t *) buf)[3] : 0;
+	free(buf);
+
+	assert_int_eq( n_nodes, snapshot_node_count(as) );
+}
+
+TEST( snapshot_load , "connect routes commands from snapshot without seeds" )
+{
+	assert_true( snapshot_create() );
+
+	// Seed is unreachable, so connect only succeeds if nodes come from the snapshot.
+	aerospike client;
+	assert_true( snapshot_connect(&client, 1) );
+
+	assert_int_eq( snapshot_node_count(&client), snapshot_node_count(as) );
+	assert_int_eq( snapshot_put(&client), AEROSPIKE_OK );
+
+	snapshot_close(&client);
+}
+
+TEST( snapshot_invalid , "invalid snapshot is ignored" )
+{
+	uint8_t buf[64];
+	memset(buf, 0xff, sizeof(buf));
+	assert_true( snapshot_write(buf, sizeof(buf)) );
+
+	aerospike client;
+	assert_true( snapshot_connect(&client, g_port) );
+
+	assert_int_eq( snapshot_node_count(&client), snapshot_node_count(as) );
+	assert_int_eq( snapshot_put(&client), AEROSPIKE_OK );
+
+	snapshot_close(&client);
+}
+
+TEST( snapshot_seed_fallback , "cluster is seeded again when no snapshot node responds" )
+{
+	assert_true( snapshot_create() );
+	assert_true( snapshot_break_nodes() );
+
+	aerospike client;
+	assert_true( snapshot_connect(&client, g_port) );
+
+	// Snapshot nodes are dropped on the first tend and seeds are used on the next.
+	as_status status = AEROSPIKE_ERR_CLIENT;
+
+	for (uint32_t i = 0; i < 50 && status != AEROSPIKE_OK; i++) {
+		usleep(200 * 1000);
+		status = snapshot_put(&client);
+	}
+	assert_int_eq( status, AEROSPIKE_OK );
+	assert_int_eq( snapshot_node_count(&client), snapshot_node_count(as) );
+
+	snapshot_close(&client);
+	unlink(SNAPSHOT_PATH);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( cluster_snapshot, "warm start snapshot tests" )
+{
+	suite_add( snapshot_save );
+	suite_add( snapshot_load );
+	suite_add( snapshot_invalid );
+	suite_add( snapshot_seed_fallback );
+}
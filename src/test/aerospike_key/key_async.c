@@ -0,0 +1,524 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_event.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_operations.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+#include "../util/udf.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define SET "test_async"
+
+#define LUA_FILE "src/test/lua/key_apply.lua"
+#define UDF_FILE "key_apply"
+
+// Maximum time to wait for a listener.
+#define WAIT_MAX_MS 10000
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+/**
+ * Result of one asynchronous command.
+ */
+typedef struct async_result_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool done;
+	as_status status;
+	int64_t value;
+	uint32_t calls;
+
+	// Listener sleeps this long on the event loop thread before completing.
+	uint32_t sleep_ms;
+	volatile bool entered;
+} async_result;
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+// Client with event loop threads.
+static aerospike async_as;
+
+// Client with an event loop polled by the test thread.
+static aerospike async_ext;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static bool
+async_connect(aerospike * client, bool external, uint32_t max_conns)
+{
+	as_config config;
+	test_config_init(&config);
+	config.event_loop_size = external ? 1 : 2;
+	config.event_loop_external = external;
+	config.async_max_conns_per_node = max_conns;
+
+	aerospike_init(client, &config);
+
+	as_error err;
+
+	if ( aerospike_connect(client, &err) != AEROSPIKE_OK ) {
+		error("%s @ %s[%s:%d]", err.message, err.func, err.file, err.line);
+		aerospike_destroy(client);
+		return false;
+	}
+	return true;
+}
+
+static void
+async_close(aerospike * client)
+{
+	as_error err;
+	aerospike_close(client, &err);
+	aerospike_destroy(client);
+}
+
+static void
+async_result_init(async_result * r)
+{
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	r->done = false;
+	r->status = AEROSPIKE_OK;
+	r->value = 0;
+	r->calls = 0;
+	r->sleep_ms = 0;
+	r->entered = false;
+}
+
+static void
+async_result_destroy(async_result * r)
+{
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->lock);
+}
+
+static void
+async_complete(async_result * r, as_error * err, int64_t value)
+{
+	r->entered = true;
+
+	if ( r->sleep_ms ) {
+		usleep(r->sleep_ms * 1000);
+	}
+
+	pthread_mutex_lock(&r->lock);
+	r->status = err ? err->code : AEROSPIKE_OK;
+	r->value = value;
+	r->calls++;
+	r->done = true;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * Wait for listener.  External event loops are polled by this thread.
+ */
+static bool
+async_wait(aerospike * client, async_result * r)
+{
+	if ( client == &async_ext ) {
+		as_event_loop * loop = as_event_loop_get(client, 0);
+
+		for (uint32_t i = 0; i < WAIT_MAX_MS / 10 && ! r->done; i++) {
+			as_event_loop_poll(loop, 10);
+		}
+		return r->done;
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += WAIT_MAX_MS / 1000;
+
+	pthread_mutex_lock(&r->lock);
+
+	while ( ! r->done ) {
+		if ( pthread_cond_timedwait(&r->cond, &r->lock, &ts) ) {
+			break;
+		}
+	}
+
+	bool done = r->done;
+	pthread_mutex_unlock(&r->lock);
+	return done;
+}
+
+static void
+async_write_listener(as_error * err, void * udata, as_event_loop * event_loop)
+{
+	async_complete(udata, err, 0);
+}
+
+static void
+async_record_listener(as_error * err, as_record * rec, void * udata, as_event_loop * event_loop)
+{
+	int64_t value = rec ? as_record_get_int64(rec, "a", -1) : 0;
+	async_complete(udata, err, value);
+}
+
+static void
+async_value_listener(as_error * err, as_val * val, void * udata, as_event_loop * event_loop)
+{
+	as_integer * i = as_integer_fromval(val);
+	async_complete(udata, err, i ? as_integer_get(i) : 0);
+}
+
+static as_status
+async_put(aerospike * client, const char * k, int64_t a)
+{
+	async_result r;
+	async_result_init(&r);
+
+	as_key key;
+	as_key_init(&key, NAMESPACE, SET, k);
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", a);
+
+	as_error err;
+	as_status status = aerospike_key_put_async(client, &err, NULL, &key, &rec, async_write_listener, &r, NULL);
+	as_record_destroy(&rec);
+
+	if ( status == AEROSPIKE_OK ) {
+		status = async_wait(client, &r) ? r.status : AEROSPIKE_ERR_TIMEOUT;
+	}
+	async_result_destroy(&r);
+	return status;
+}
+
+static as_status
+async_get(aerospike * client, const char * ns, const char * k, int64_t * a)
+{
+	async_result r;
+	async_result_init(&r);
+
+	as_key key;
+	as_key_init(&key, ns, SET, k);
+
+	as_error err;
+	as_status status = aerospike_key_get_async(client, &err, NULL, &key, async_record_listener, &r, NULL);
+
+	if ( status == AEROSPIKE_OK ) {
+		status = async_wait(client, &r) ? r.status : AEROSPIKE_ERR_TIMEOUT;
+		*a = r.value;
+	}
+	async_result_destroy(&r);
+	return status;
+}
+
+static as_status
+async_remove(aerospike * client, const char * k)
+{
+	async_result r;
+	async_result_init(&r);
+
+	as_key key;
+	as_key_init(&key, NAMESPACE, SET, k);
+
+	as_error err;
+	as_status status = aerospike_key_remove_async(client, &err, NULL, &key, async_write_listener, &r, NULL);
+
+	if ( status == AEROSPIKE_OK ) {
+		status = async_wait(client, &r) ? r.status : AEROSPIKE_ERR_TIMEOUT;
+	}
+	async_result_destroy(&r);
+	return status;
+}
+
+static as_status
+async_operate(aerospike * client, const char * k, int64_t incr, int64_t * a)
+{
+	async_result r;
+	async_result_init(&r);
+
+	as_key key;
+	as_key_init(&key, NAMESPACE, SET, k);
+
+	as_operations ops;
+	as_operations_inita(&ops, 2);
+	as_operations_add_incr(&ops, "a", incr);
+	as_operations_add_read(&ops, "a");
+
+	as_error err;
+	as_status status = aerospike_key_operate_async(client, &err, NULL, &key, &ops, async_record_listener, &r, NULL);
+	as_operations_destroy(&ops);
+
+	if ( status == AEROSPIKE_OK ) {
+		status = async_wait(client, &r) ? r.status : AEROSPIKE_ERR_TIMEOUT;
+		*a = r.value;
+	}
+	async_result_destroy(&r);
+	return status;
+}
+
+static as_status
+async_apply(aerospike * client, const char * k, const char * function, int64_t * value)
+{
+	async_result r;
+	async_result_init(&r);
+
+	as_key key;
+	as_key_init(&key, NAMESPACE, SET, k);
+
+	as_error err;
+	as_status status = aerospike_key_apply_async(client, &err, NULL, &key, UDF_FILE, function, NULL,
+		async_value_listener, &r, NULL);
+
+	if ( status == AEROSPIKE_OK ) {
+		status = async_wait(client, &r) ? r.status : AEROSPIKE_ERR_TIMEOUT;
+		*value = r.value;
+	}
+	async_result_destroy(&r);
+	return status;
+}
+
+/**
+ * Put, get, operate, apply and remove one record.
+ */
+static void
+async_crud(atf_test_result * __result__, aerospike * client, const char * k)
+{
+	int64_t a = 0;
+
+	assert_int_eq( async_put(client, k, 10), AEROSPIKE_OK );
+	assert_int_eq( async_get(client, NAMESPACE, k, &a), AEROSPIKE_OK );
+	assert_int_eq( a, 10 );
+
+	assert_int_eq( async_operate(client, k, 5, &a), AEROSPIKE_OK );
+	assert_int_eq( a, 15 );
+
+	assert_int_eq( async_apply(client, k, "ten", &a), AEROSPIKE_OK );
+	assert_int_eq( a, 10 );
+
+	assert_int_eq( async_remove(client, k), AEROSPIKE_OK );
+	assert_int_eq( async_get(client, NAMESPACE, k, &a), AEROSPIKE_ERR_RECORD_NOT_FOUND );
+}
+
+static bool
+before(atf_suite * suite)
+{
+	if ( ! udf_put(LUA_FILE) ) {
+		error("failure while uploading: %s", LUA_FILE);
+		return false;
+	}
+
+	if ( ! async_connect(&async_as, false, 0) ) {
+		return false;
+	}
+
+	if ( ! async_connect(&async_ext, true, 0) ) {
+		async_close(&async_as);
+		return false;
+	}
+	return true;
+}
+
+static bool
+after(atf_suite * suite)
+{
+	async_close(&async_ext);
+	async_close(&async_as);
+
+	if ( ! udf_remove(LUA_FILE) ) {
+		error("failure while removing: %s", LUA_FILE);
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_async_crud , "put, get, operate, apply and remove on event loop threads" )
+{
+	async_crud(__result__, &async_as, "internal");
+}
+
+TEST( key_async_crud_external , "put, get, operate, apply and remove on a polled event loop" )
+{
+	async_crud(__result__, &async_ext, "external");
+}
+
+TEST( key_async_not_found , "server errors are passed to the listener" )
+{
+	int64_t a = 0;
+
+	async_remove(&async_as, "missing");
+	assert_int_eq( async_get(&async_as, NAMESPACE, "missing", &a), AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	assert_int_eq( async_get(&async_ext, NAMESPACE, "missing", &a), AEROSPIKE_ERR_RECORD_NOT_FOUND );
+
+	assert_int_eq( async_put(&async_as, "udf", 1), AEROSPIKE_OK );
+	assert_int_eq( async_apply(&async_as, "udf", "no_such_function", &a), AEROSPIKE_ERR_UDF );
+	assert_int_eq( async_remove(&async_as, "udf"), AEROSPIKE_OK );
+}
+
+TEST( key_async_bad_namespace , "client errors are passed to the listener" )
+{
+	int64_t a = 0;
+
+	assert_int_eq( async_get(&async_as, "no_such_namespace", "k", &a), AEROSPIKE_ERR_CLIENT );
+	assert_int_eq( async_get(&async_ext, "no_such_namespace", "k", &a), AEROSPIKE_ERR_CLIENT );
+}
+
+TEST( key_async_timeout , "command queued past its deadline fails with timeout" )
+{
+	assert_int_eq( async_put(&async_as, "timeout", 1), AEROSPIKE_OK );
+
+	// Hold the event loop thread in a listener, so the next command is queued past its deadline.
+	as_event_loop * loop = as_event_loop_get(&async_as, 0);
+
+	async_result blocker;
+	async_result_init(&blocker);
+	blocker.sleep_ms = 200;
+
+	as_key key;
+	as_key_init(&key, NAMESPACE, SET, "timeout");
+
+	as_error err;
+	assert_int_eq( aerospike_key_get_async(&async_as, &err, NULL, &key, async_record_listener, &blocker, loop), AEROSPIKE_OK );
+
+	for (uint32_t i = 0; i < WAIT_MAX_MS && ! blocker.entered; i++) {
+		usleep(1000);
+	}
+	assert_true( blocker.entered );
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.timeout = 20;
+
+	async_result r;
+	async_result_init(&r);
+	assert_int_eq( aerospike_key_get_async(&async_as, &err, &policy, &key, async_record_listener, &r, loop), AEROSPIKE_OK );
+
+	assert_true( async_wait(&async_as, &r) );
+	assert_int_eq( r.status, AEROSPIKE_ERR_TIMEOUT );
+	assert_int_eq( r.calls, 1 );
+
+	assert_true( async_wait(&async_as, &blocker) );
+	assert_int_eq( blocker.status, AEROSPIKE_OK );
+
+	async_result_destroy(&r);
+	async_result_destroy(&blocker);
+}
+
+TEST( key_async_timeout_external , "polled event loop fails commands past their deadline" )
+{
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.timeout = 10;
+
+	as_key key;
+	as_key_init(&key, NAMESPACE, SET, "timeout");
+
+	async_result r;
+	async_result_init(&r);
+
+	as_error err;
+	assert_int_eq( aerospike_key_get_async(&async_ext, &err, &policy, &key, async_record_listener, &r, NULL), AEROSPIKE_OK );
+
+	// Nothing runs until the loop is polled.
+	usleep(50 * 1000);
+	assert_false( r.done );
+
+	assert_true( async_wait(&async_ext, &r) );
+	assert_int_eq( r.status, AEROSPIKE_ERR_TIMEOUT );
+	assert_int_eq( r.calls, 1 );
+
+	async_result_destroy(&r);
+}
+
+TEST( key_async_max_conns , "commands wait for a connection when a node is at its limit" )
+{
+	// One connection per node on each of the two event loops.
+	aerospike client;
+	assert_true( async_connect(&client, false, 2) );
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", 1);
+
+	async_result results[50];
+	as_error err;
+
+	for (uint32_t i = 0; i < 50; i++) {
+		async_result_init(&results[i]);
+
+		as_key key;
+		as_key_init_int64(&key, NAMESPACE, SET, i);
+		assert_int_eq( aerospike_key_put_async(&client, &err, NULL, &key, &rec, async_write_listener, &results[i], NULL), AEROSPIKE_OK );
+	}
+	as_record_destroy(&rec);
+
+	for (uint32_t i = 0; i < 50; i++) {
+		assert_true( async_wait(&client, &results[i]) );
+		assert_int_eq( results[i].status, AEROSPIKE_OK );
+		async_result_destroy(&results[i]);
+	}
+
+	// Connections are only accessed by their event loop, but are idle now.
+	as_nodes * nodes = as_nodes_reserve(client.cluster);
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node * node = nodes->array[i];
+
+		for (uint32_t j = 0; j < client.cluster->event_loop_size; j++) {
+			assert_true( ck_pr_load_32(&node->async_conn_counts[j]) <= 1 );
+		}
+	}
+	as_nodes_release(nodes);
+	async_close(&client);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_async, "aerospike_key async tests" )
+{
+	suite_before( before );
+	suite_after( after );
+
+	suite_add( key_async_crud );
+	suite_add( key_async_crud_external );
+	suite_add( key_async_not_found );
+	suite_add( key_async_bad_namespace );
+	suite_add( key_async_timeout );
+	suite_add( key_async_timeout_external );
+	suite_add( key_async_max_conns );
+}
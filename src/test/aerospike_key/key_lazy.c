@@ -0,0 +1,443 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_arraylist.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_double.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_hashmap.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_record_iterator.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+#include <aerospike/as_val.h>
+#include <string.h>
+
+#include "../test.h"
+#include "../util/val_equal.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define SET "test_lazy"
+#define N_KEYS 10
+#define N_LIST 20
+#define N_MAP 20
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct {
+	const as_record * eager;
+	uint32_t count;
+	uint32_t errors;
+} lazy_compare_data;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void
+lazy_key(as_key * key, int64_t k)
+{
+	as_key_init_int64(key, NAMESPACE, SET, k);
+}
+
+/**
+ * List of mixed elements, including nested containers.
+ */
+static as_list *
+lazy_list_new(int64_t k)
+{
+	as_arraylist * list = as_arraylist_new(N_LIST, 0);
+
+	for ( int64_t i = 0; i < N_LIST; i++ ) {
+		switch ( i % 4 ) {
+			case 0:
+				as_arraylist_append_int64(list, k * 1000 + i);
+				break;
+			case 1:
+				as_arraylist_append_str(list, "element");
+				break;
+			case 2:
+				as_arraylist_append(list, (as_val *) as_double_new(i + 0.5));
+				break;
+			default: {
+				as_arraylist * inner = as_arraylist_new(2, 0);
+				as_arraylist_append_int64(inner, i);
+				as_arraylist_append_str(inner, "inner");
+				as_arraylist_append(list, (as_val *) inner);
+				break;
+			}
+		}
+	}
+	return (as_list *) list;
+}
+
+/**
+ * Map with integer and string keys, including nested containers.
+ */
+static as_map *
+lazy_map_new(int64_t k)
+{
+	as_hashmap * map = as_hashmap_new(N_MAP * 2);
+
+	for ( int64_t i = 0; i < N_MAP; i++ ) {
+		char name[16];
+		sprintf(name, "k%d", (int) i);
+
+		as_hashmap_set(map, (as_val *) as_integer_new(i), (as_val *) as_integer_new(k + i));
+		as_hashmap_set(map, (as_val *) as_string_new(strdup(name), true),
+			(as_val *) (i % 2 ? (as_val *) lazy_list_new(i) : (as_val *) as_string_new(strdup(name), true)));
+	}
+	return (as_map *) map;
+}
+
+static as_status
+lazy_put(int64_t k)
+{
+	as_error err;
+
+	as_key key;
+	lazy_key(&key, k);
+
+	as_record rec;
+	as_record_inita(&rec, 4);
+	as_record_set_int64(&rec, "int", k);
+	as_record_set_str(&rec, "str", "lazy");
+	as_record_set_list(&rec, "list", lazy_list_new(k));
+	as_record_set_map(&rec, "map", lazy_map_new(k));
+
+	as_status status = aerospike_key_put(as, &err, NULL, &key, &rec);
+	as_record_destroy(&rec);
+	return status;
+}
+
+static as_status
+lazy_get(int64_t k, bool lazy, as_record ** rec)
+{
+	as_error err;
+
+	as_key key;
+	lazy_key(&key, k);
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.lazy_deserialize = lazy;
+
+	*rec = NULL;
+	return aerospike_key_get(as, &err, &policy, &key, rec);
+}
+
+/**
+ * Is the bin still held as packed bytes?
+ */
+static bool
+lazy_packed(const as_record * rec, const char * name)
+{
+	for ( uint16_t i = 0; i < rec->bins.size; i++ ) {
+		as_bin * bin = &rec->bins.entries[i];
+
+		if ( strcmp(bin->name, name) == 0 ) {
+			return bin->valuep && as_val_type(bin->valuep) == AS_BYTES;
+		}
+	}
+	return false;
+}
+
+/**
+ * Compare values returned by caller-owned getters, destroying both.
+ */
+static bool
+lazy_equal_destroy(as_val * a, as_val * b)
+{
+	bool rv = val_equal(a, b);
+
+	if ( a ) {
+		as_val_destroy(a);
+	}
+	if ( b ) {
+		as_val_destroy(b);
+	}
+	return rv;
+}
+
+static bool
+lazy_compare_bin(const char * name, const as_val * val, void * udata)
+{
+	lazy_compare_data * data = (lazy_compare_data *) udata;
+	data->count++;
+
+	if ( ! val_equal(val, (as_val *) as_record_get(data->eager, name)) ) {
+		error("bin %s differs", name);
+		data->errors++;
+	}
+	return true;
+}
+
+static bool
+lazy_batch_callback(const as_batch_read * results, uint32_t n, void * udata)
+{
+	lazy_compare_data * data = (lazy_compare_data *) udata;
+
+	for ( uint32_t i = 0; i < n; i++ ) {
+		if ( results[i].result != AEROSPIKE_OK ) {
+			data->errors++;
+			continue;
+		}
+
+		int64_t k = as_integer_getorelse((as_integer *) results[i].key->valuep, -1);
+		as_record * eager = NULL;
+
+		if ( lazy_get(k, false, &eager) != AEROSPIKE_OK ) {
+			data->errors++;
+			continue;
+		}
+
+		// Element reads first, so they run against the packed bins.
+		as_integer index;
+		as_integer_init(&index, 1);
+
+		if ( ! lazy_equal_destroy(as_record_get_list_value(&results[i].record, "list", 3),
+				as_record_get_list_value(eager, "list", 3)) ||
+			! lazy_equal_destroy(as_record_get_map_value(&results[i].record, "map", (as_val *) &index),
+				as_record_get_map_value(eager, "map", (as_val *) &index)) ) {
+			data->errors++;
+		}
+
+		data->eager = eager;
+		as_record_foreach(&results[i].record, lazy_compare_bin, data);
+		as_record_destroy(eager);
+	}
+	return true;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_lazy_put , "write records with list and map bins" )
+{
+	for ( int64_t k = 0; k < N_KEYS; k++ ) {
+		assert_int_eq( lazy_put(k), AEROSPIKE_OK );
+	}
+}
+
+TEST( key_lazy_bins_packed , "lazy read keeps list and map bins packed" )
+{
+	as_record * lazy = NULL;
+	assert_int_eq( lazy_get(1, true, &lazy), AEROSPIKE_OK );
+
+	assert_true( lazy_packed(lazy, "list") );
+	assert_true( lazy_packed(lazy, "map") );
+	assert_false( lazy_packed(lazy, "int") );
+
+	// Element reads do not decode the whole bin.
+	as_val_destroy(as_record_get_list_value(lazy, "list", 0));
+	assert_true( lazy_packed(lazy, "list") );
+
+	// Whole bin access decodes in place, once.
+	as_list * list = as_record_get_list(lazy, "list");
+	assert_not_null( list );
+	assert_false( lazy_packed(lazy, "list") );
+	assert_true( as_record_get_list(lazy, "list") == list );
+
+	as_record_destroy(lazy);
+
+	as_record * eager = NULL;
+	assert_int_eq( lazy_get(1, false, &eager), AEROSPIKE_OK );
+	assert_false( lazy_packed(eager, "list") );
+	assert_false( lazy_packed(eager, "map") );
+	as_record_destroy(eager);
+}
+
+TEST( key_lazy_list_value , "packed list elements equal decoded list elements" )
+{
+	as_record * lazy = NULL;
+	as_record * eager = NULL;
+	assert_int_eq( lazy_get(2, true, &lazy), AEROSPIKE_OK );
+	assert_int_eq( lazy_get(2, false, &eager), AEROSPIKE_OK );
+
+	// Past the end must be NULL on both.
+	for ( uint32_t i = 0; i <= N_LIST; i++ ) {
+		assert_true( lazy_equal_destroy(as_record_get_list_value(lazy, "list", i),
+			as_record_get_list_value(eager, "list", i)) );
+	}
+	assert_null( as_record_get_list_value(lazy, "list", N_LIST) );
+	assert_null( as_record_get_list_value(lazy, "nobin", 0) );
+
+	as_record_destroy(lazy);
+	as_record_destroy(eager);
+}
+
+TEST( key_lazy_map_value , "packed map values equal decoded map values" )
+{
+	as_record * lazy = NULL;
+	as_record * eager = NULL;
+	assert_int_eq( lazy_get(3, true, &lazy), AEROSPIKE_OK );
+	assert_int_eq( lazy_get(3, false, &eager), AEROSPIKE_OK );
+
+	// One past the last key is missing on both.
+	for ( int64_t i = 0; i <= N_MAP; i++ ) {
+		char name[16];
+		sprintf(name, "k%d", (int) i);
+
+		as_integer ikey;
+		as_integer_init(&ikey, i);
+
+		as_string skey;
+		as_string_init(&skey, name, false);
+
+		assert_true( lazy_equal_destroy(as_record_get_map_value(lazy, "map", (as_val *) &ikey),
+			as_record_get_map_value(eager, "map", (as_val *) &ikey)) );
+		assert_true( lazy_equal_destroy(as_record_get_map_value(lazy, "map", (as_val *) &skey),
+			as_record_get_map_value(eager, "map", (as_val *) &skey)) );
+	}
+	assert_true( lazy_packed(lazy, "map") );
+
+	as_record_destroy(lazy);
+	as_record_destroy(eager);
+}
+
+TEST( key_lazy_whole , "lazily decoded bins equal eagerly decoded bins" )
+{
+	for ( int64_t k = 0; k < N_KEYS; k++ ) {
+		as_record * lazy = NULL;
+		as_record * eager = NULL;
+		assert_int_eq( lazy_get(k, true, &lazy), AEROSPIKE_OK );
+		assert_int_eq( lazy_get(k, false, &eager), AEROSPIKE_OK );
+
+		assert_true( val_equal((as_val *) as_record_get_list(lazy, "list"),
+			(as_val *) as_record_get_list(eager, "list")) );
+		assert_true( val_equal((as_val *) as_record_get_map(lazy, "map"),
+			(as_val *) as_record_get_map(eager, "map")) );
+		assert_int_eq( as_record_get_int64(lazy, "int", -1), k );
+
+		as_record_destroy(lazy);
+		as_record_destroy(eager);
+	}
+}
+
+TEST( key_lazy_foreach , "foreach yields eagerly decoded values" )
+{
+	as_record * lazy = NULL;
+	as_record * eager = NULL;
+	assert_int_eq( lazy_get(4, true, &lazy), AEROSPIKE_OK );
+	assert_int_eq( lazy_get(4, false, &eager), AEROSPIKE_OK );
+
+	lazy_compare_data data = { .eager = eager };
+	as_record_foreach(lazy, lazy_compare_bin, &data);
+
+	assert_int_eq( data.count, as_record_numbins(eager) );
+	assert_int_eq( data.errors, 0 );
+
+	as_record_destroy(lazy);
+	as_record_destroy(eager);
+}
+
+TEST( key_lazy_iterator , "iterator yields eagerly decoded values" )
+{
+	as_record * lazy = NULL;
+	as_record * eager = NULL;
+	assert_int_eq( lazy_get(5, true, &lazy), AEROSPIKE_OK );
+	assert_int_eq( lazy_get(5, false, &eager), AEROSPIKE_OK );
+
+	lazy_compare_data data = { .eager = eager };
+
+	as_record_iterator it;
+	as_record_iterator_init(&it, lazy);
+
+	while ( as_record_iterator_has_next(&it) ) {
+		as_bin * bin = as_record_iterator_next(&it);
+		lazy_compare_bin(as_bin_get_name(bin), (as_val *) as_bin_get_value(bin), &data);
+	}
+	as_record_iterator_destroy(&it);
+
+	assert_int_eq( data.count, as_record_numbins(eager) );
+	assert_int_eq( data.errors, 0 );
+
+	as_record_destroy(lazy);
+	as_record_destroy(eager);
+}
+
+TEST( key_lazy_batch , "lazy batch records equal eagerly read records" )
+{
+	as_batch batch;
+	as_batch_inita(&batch, N_KEYS);
+
+	for ( int64_t k = 0; k < N_KEYS; k++ ) {
+		lazy_key(as_batch_keyat(&batch, (uint32_t) k), k);
+	}
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.lazy_deserialize = true;
+
+	lazy_compare_data data = { .eager = NULL };
+
+	as_error err;
+	as_status status = aerospike_batch_get(as, &err, &policy, &batch, lazy_batch_callback, &data);
+
+	assert_int_eq( status, AEROSPIKE_OK );
+	assert_int_eq( data.count, N_KEYS * 4 );
+	assert_int_eq( data.errors, 0 );
+
+	as_batch_destroy(&batch);
+}
+
+TEST( key_lazy_remove , "remove records" )
+{
+	as_error err;
+
+	for ( int64_t k = 0; k < N_KEYS; k++ ) {
+		as_key key;
+		lazy_key(&key, k);
+		aerospike_key_remove(as, &err, NULL, &key);
+	}
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_lazy, "lazy list/map deserialization tests" )
+{
+	suite_add( key_lazy_put );
+	suite_add( key_lazy_bins_packed );
+	suite_add( key_lazy_list_value );
+	suite_add( key_lazy_map_value );
+	suite_add( key_lazy_whole );
+	suite_add( key_lazy_foreach );
+	suite_add( key_lazy_iterator );
+	suite_add( key_lazy_batch );
+	suite_add( key_lazy_remove );
+}
@@ -0,0 +1,321 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_arraylist.h>
+#include <aerospike/as_boolean.h>
+#include <aerospike/as_buffer.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_double.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_geojson.h>
+#include <aerospike/as_hashmap.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_msgpack_serializer.h>
+#include <aerospike/as_nil.h>
+#include <aerospike/as_pack.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_serializer.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+#include <aerospike/as_val.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../test.h"
+#include "../util/val_equal.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define SET "test_pack"
+#define GUARD 0xa5
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * Pack val directly and through the msgpack serializer.  Sizes and bytes must
+ * match exactly, the writer must stop on the computed size, and the packed
+ * bytes must deserialize back to an equal value.
+ */
+static bool
+pack_check(const as_val * val)
+{
+	uint32_t size = 0;
+
+	if ( ! as_pack_size(val, &size) ) {
+		error("as_pack_size failed for type %d", as_val_type(val));
+		return false;
+	}
+
+	as_buffer buffer;
+	as_buffer_init(&buffer);
+
+	as_serializer ser;
+	as_msgpack_init(&ser);
+	as_serializer_serialize(&ser, (as_val *) val, &buffer);
+
+	bool rv = false;
+	uint8_t * packed = malloc(size + 1);
+	packed[size] = GUARD;
+
+	if ( size != buffer.size ) {
+		error("type %d: packed size %u != serialized size %u", as_val_type(val), size, buffer.size);
+		goto Done;
+	}
+
+	uint8_t * end = as_pack_write(packed, val);
+
+	if ( end != packed + size || packed[size] != GUARD ) {
+		error("type %d: wrote %ld bytes, expected %u", as_val_type(val), (long)(end - packed), size);
+		goto Done;
+	}
+
+	if ( memcmp(packed, buffer.data, size) != 0 ) {
+		error("type %d: packed bytes differ from serializer output", as_val_type(val));
+		goto Done;
+	}
+
+	as_buffer in = { .capacity = size, .size = size, .data = packed };
+	as_val * out = NULL;
+	as_serializer_deserialize(&ser, &in, &out);
+
+	rv = val_equal(val, out);
+
+	if ( ! rv ) {
+		error("type %d: unpacked value differs", as_val_type(val));
+	}
+
+	if ( out ) {
+		as_val_destroy(out);
+	}
+
+Done:
+	free(packed);
+	as_serializer_destroy(&ser);
+	as_buffer_destroy(&buffer);
+	return rv;
+}
+
+/**
+ * Check val on its own and as an element of a list, then destroy it.
+ */
+static bool
+pack_check_destroy(as_val * val)
+{
+	bool rv = pack_check(val);
+
+	as_arraylist list;
+	as_arraylist_init(&list, 1, 0);
+	as_arraylist_append(&list, val);
+
+	rv = pack_check((as_val *) &list) && rv;
+
+	as_arraylist_destroy(&list);
+	return rv;
+}
+
+static as_string *
+pack_string_new(uint32_t len)
+{
+	char * s = malloc(len + 1);
+	memset(s, 'p', len);
+	s[len] = 0;
+	return as_string_new(s, true);
+}
+
+static as_bytes *
+pack_bytes_new(uint32_t len)
+{
+	uint8_t * buf = malloc(len ? len : 1);
+
+	for ( uint32_t i = 0; i < len; i++ ) {
+		buf[i] = (uint8_t) i;
+	}
+	return as_bytes_new_wrap(buf, len, true);
+}
+
+static as_list *
+pack_list_new(uint32_t n)
+{
+	as_arraylist * list = as_arraylist_new(n ? n : 1, 0);
+
+	for ( uint32_t i = 0; i < n; i++ ) {
+		as_arraylist_append_int64(list, i);
+	}
+	return (as_list *) list;
+}
+
+static as_map *
+pack_map_new(uint32_t n)
+{
+	as_hashmap * map = as_hashmap_new(n ? n : 1);
+
+	for ( uint32_t i = 0; i < n; i++ ) {
+		as_hashmap_set(map, (as_val *) as_integer_new(i), (as_val *) as_integer_new(-(int64_t)i));
+	}
+	return (as_map *) map;
+}
+
+/**
+ * Map with every packable type, nested two levels deep.
+ */
+static as_map *
+pack_nested_new()
+{
+	as_hashmap * inner = as_hashmap_new(4);
+	as_hashmap_set(inner, (as_val *) as_string_new("d", false), (as_val *) as_double_new(-3.25));
+	as_hashmap_set(inner, (as_val *) as_string_new("b", false), (as_val *) pack_bytes_new(40));
+	as_hashmap_set(inner, (as_val *) as_integer_new(7), (as_val *) pack_list_new(3));
+
+	as_arraylist * list = as_arraylist_new(8, 0);
+	as_arraylist_append_int64(list, -1);
+	as_arraylist_append_str(list, "str");
+	as_arraylist_append(list, (as_val *) as_boolean_new(true));
+	as_arraylist_append(list, (as_val *) &as_nil);
+	as_arraylist_append(list, (as_val *) inner);
+	as_arraylist_append(list, (as_val *) pack_list_new(0));
+	as_arraylist_append(list, (as_val *) pack_map_new(0));
+
+	as_hashmap * map = as_hashmap_new(4);
+	as_hashmap_set(map, (as_val *) as_string_new("list", false), (as_val *) list);
+	as_hashmap_set(map, (as_val *) as_string_new("geo", false),
+		(as_val *) as_geojson_new("{ \"type\": \"Point\", \"coordinates\": [0.0, 0.0] }", false));
+	as_hashmap_set(map, (as_val *) as_integer_new(1 << 20), (as_val *) pack_string_new(100));
+	return (as_map *) map;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_pack_integers , "integers pack like the serializer at every width boundary" )
+{
+	static const int64_t values[] = {
+		0, 1, 127, 128, 255, 256, 65535, 65536,
+		4294967295LL, 4294967296LL, INT64_MAX,
+		-1, -31, -32, -33, -127, -128, -129, -32768, -32769,
+		-2147483647LL - 1, -2147483647LL - 2, INT64_MIN
+	};
+
+	for ( uint32_t i = 0; i < sizeof(values) / sizeof(values[0]); i++ ) {
+		assert_true( pack_check_destroy((as_val *) as_integer_new(values[i])) );
+	}
+}
+
+TEST( key_pack_strings , "strings pack like the serializer at every length boundary" )
+{
+	// Strings carry a type byte, so raw length is one more than the string.
+	static const uint32_t lengths[] = { 0, 1, 30, 31, 32, 254, 255, 256, 65534, 65535, 65536 };
+
+	for ( uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++ ) {
+		assert_true( pack_check_destroy((as_val *) pack_string_new(lengths[i])) );
+	}
+}
+
+TEST( key_pack_bytes , "bytes pack like the serializer" )
+{
+	static const uint32_t lengths[] = { 0, 1, 31, 255, 256, 65535, 65536 };
+
+	for ( uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++ ) {
+		assert_true( pack_check_destroy((as_val *) pack_bytes_new(lengths[i])) );
+	}
+}
+
+TEST( key_pack_scalars , "doubles, booleans, nil and geojson pack like the serializer" )
+{
+	assert_true( pack_check_destroy((as_val *) as_double_new(0.0)) );
+	assert_true( pack_check_destroy((as_val *) as_double_new(-1.5)) );
+	assert_true( pack_check_destroy((as_val *) as_double_new(1e300)) );
+	assert_true( pack_check_destroy((as_val *) as_boolean_new(true)) );
+	assert_true( pack_check_destroy((as_val *) as_boolean_new(false)) );
+	assert_true( pack_check_destroy((as_val *) &as_nil) );
+	assert_true( pack_check_destroy((as_val *) as_geojson_new("{ \"type\": \"Point\", \"coordinates\": [1.0, 2.0] }", false)) );
+}
+
+TEST( key_pack_containers , "lists and maps pack like the serializer at every header boundary" )
+{
+	static const uint32_t sizes[] = { 0, 1, 15, 16, 65535, 65536 };
+
+	for ( uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++ ) {
+		assert_true( pack_check_destroy((as_val *) pack_list_new(sizes[i])) );
+		assert_true( pack_check_destroy((as_val *) pack_map_new(sizes[i])) );
+	}
+}
+
+TEST( key_pack_nested , "nested containers pack like the serializer" )
+{
+	assert_true( pack_check_destroy((as_val *) pack_nested_new()) );
+}
+
+TEST( key_pack_put_get , "packed list and map bins read back equal" )
+{
+	as_error err;
+
+	as_key key;
+	as_key_init_str(&key, NAMESPACE, SET, "pack");
+
+	as_list * list = pack_list_new(1000);
+	as_map * map = pack_nested_new();
+
+	as_record rec;
+	as_record_inita(&rec, 2);
+	as_record_set_list(&rec, "list", list);
+	as_record_set_map(&rec, "map", map);
+
+	as_status status = aerospike_key_put(as, &err, NULL, &key, &rec);
+	assert_int_eq( status, AEROSPIKE_OK );
+
+	as_record * out = NULL;
+	status = aerospike_key_get(as, &err, NULL, &key, &out);
+	assert_int_eq( status, AEROSPIKE_OK );
+
+	assert_true( val_equal((as_val *) list, (as_val *) as_record_get_list(out, "list")) );
+	assert_true( val_equal((as_val *) map, (as_val *) as_record_get_map(out, "map")) );
+
+	as_record_destroy(out);
+	as_record_destroy(&rec);
+
+	aerospike_key_remove(as, &err, NULL, &key);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_pack, "direct list/map packing tests" )
+{
+	suite_add( key_pack_integers );
+	suite_add( key_pack_strings );
+	suite_add( key_pack_bytes );
+	suite_add( key_pack_scalars );
+	suite_add( key_pack_containers );
+	suite_add( key_pack_nested );
+	suite_add( key_pack_put_get );
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_arraylist.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+#include "../util/udf.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define NAMESPACE "test"
+#define SET "test_pipeline"
+
+#define LUA_FILE "src/test/lua/key_pipeline.lua"
+#define UDF_FILE "key_pipeline"
+
+#define N_THREADS 8
+#define N_KEYS 200
+
+// Iterations of the spin UDF.  Takes a few hundred milliseconds on the server.
+#define SPIN_COUNT 20000000
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct pipeline_thread_s {
+	uint32_t id;
+	uint32_t errors;
+	uint32_t mismatches;
+} pipeline_thread;
+
+typedef struct pipeline_spin_s {
+	as_status status;
+	int64_t value;
+} pipeline_spin;
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+// Client with pipelining enabled.
+static aerospike pipe_as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_status
+pipeline_put(int64_t k, int64_t v)
+{
+	as_error err;
+
+	as_key key;
+	as_key_init_int64(&key, NAMESPACE, SET, k);
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "v", v);
+
+	as_status status = aerospike_key_put(&pipe_as, &err, NULL, &key, &rec);
+	as_record_destroy(&rec);
+	return status;
+}
+
+static as_status
+pipeline_get(int64_t k, uint32_t timeout, int64_t * v)
+{
+	as_error err;
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.timeout = timeout;
+	policy.retry = 0;
+
+	as_key key;
+	as_key_init_int64(&key, NAMESPACE, SET, k);
+
+	as_record * rec = NULL;
+	as_status status = aerospike_key_get(&pipe_as, &err, &policy, &key, &rec);
+
+	if ( rec ) {
+		*v = as_record_get_int64(rec, "v", -1);
+		as_record_destroy(rec);
+	}
+	return status;
+}
+
+/**
+ * Each thread owns its own keys, so any response read by the wrong caller shows up
+ * as a value mismatch.
+ */
+static void *
+pipeline_worker(void * udata)
+{
+	pipeline_thread * t = udata;
+
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		int64_t k = t->id * N_KEYS + i;
+		int64_t expected = k * 1000 + t->id;
+
+		if ( pipeline_put(k, expected) != AEROSPIKE_OK ) {
+			t->errors++;
+			continue;
+		}
+
+		int64_t v = 0;
+
+		if ( pipeline_get(k, 0, &v) != AEROSPIKE_OK ) {
+			t->errors++;
+			continue;
+		}
+
+		if ( v != expected ) {
+			t->mismatches++;
+		}
+	}
+	return NULL;
+}
+
+static void *
+pipeline_spin_worker(void * udata)
+{
+	pipeline_spin * s = udata;
+	as_error err;
+
+	as_key key;
+	as_key_init_int64(&key, NAMESPACE, SET, 0);
+
+	as_arraylist args;
+	as_arraylist_inita(&args, 1);
+	as_arraylist_append_int64(&args, SPIN_COUNT);
+
+	as_val * val = NULL;
+	s->status = aerospike_key_apply(&pipe_as, &err, NULL, &key, UDF_FILE, "spin", (as_list *) &args, &val);
+
+	as_integer * i = as_integer_fromval(val);
+	s->value = i ? as_integer_get(i) : 0;
+
+	as_val_destroy(val);
+	as_arraylist_destroy(&args);
+	return NULL;
+}
+
+static bool
+before(atf_suite * suite)
+{
+	if ( ! udf_put(LUA_FILE) ) {
+		error("failure while uploading: %s", LUA_FILE);
+		return false;
+	}
+
+	as_config config;
+	test_config_init(&config);
+	config.pipeline_depth = 4;
+
+	aerospike_init(&pipe_as, &config);
+
+	as_error err;
+
+	if ( aerospike_connect(&pipe_as, &err) != AEROSPIKE_OK ) {
+		error("%s @ %s[%s:%d]", err.message, err.func, err.file, err.line);
+		aerospike_destroy(&pipe_as);
+		return false;
+	}
+	return true;
+}
+
+static bool
+after(atf_suite * suite)
+{
+	as_error err;
+	aerospike_close(&pipe_as, &err);
+	aerospike_destroy(&pipe_as);
+
+	if ( ! udf_remove(LUA_FILE) ) {
+		error("failure while removing: %s", LUA_FILE);
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_pipeline_sequential , "pipelined commands from one caller" )
+{
+	for (int64_t k = 0; k < N_KEYS; k++) {
+		assert_int_eq( pipeline_put(k, k + 1), AEROSPIKE_OK );
+	}
+
+	for (int64_t k = 0; k < N_KEYS; k++) {
+		int64_t v = 0;
+		assert_int_eq( pipeline_get(k, 0, &v), AEROSPIKE_OK );
+		assert_int_eq( v, k + 1 );
+	}
+}
+
+TEST( key_pipeline_concurrent , "each concurrent caller receives its own response" )
+{
+	pthread_t threads[N_THREADS];
+	pipeline_thread state[N_THREADS];
+
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		state[i].id = i;
+		state[i].errors = 0;
+		state[i].mismatches = 0;
+		pthread_create(&threads[i], NULL, pipeline_worker, &state[i]);
+	}
+
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		assert_int_eq( state[i].errors, 0 );
+		assert_int_eq( state[i].mismatches, 0 );
+	}
+}
+
+TEST( key_pipeline_abandoned , "response of a timed out command is skipped by the next caller" )
+{
+	assert_int_eq( pipeline_put(0, 0), AEROSPIKE_OK );
+	assert_int_eq( pipeline_put(1, 111), AEROSPIKE_OK );
+	assert_int_eq( pipeline_put(2, 222), AEROSPIKE_OK );
+
+	// Slow command occupies the head of the pipeline.
+	pipeline_spin spin;
+	pthread_t thread;
+	pthread_create(&thread, NULL, pipeline_spin_worker, &spin);
+	usleep(50 * 1000);
+
+	// Queued behind it, so it times out waiting for its turn and abandons its ticket.
+	int64_t v = 0;
+	assert_int_eq( pipeline_get(1, 50, &v), AEROSPIKE_ERR_TIMEOUT );
+
+	pthread_join(thread, NULL);
+	assert_int_eq( spin.status, AEROSPIKE_OK );
+	assert_int_eq( spin.value, SPIN_COUNT );
+
+	// The abandoned response for key 1 is still on the socket ahead of this one.
+	v = 0;
+	assert_int_eq( pipeline_get(2, 0, &v), AEROSPIKE_OK );
+	assert_int_eq( v, 222 );
+
+	for (int64_t k = 0; k < 3; k++) {
+		assert_int_eq( pipeline_get(k, 0, &v), AEROSPIKE_OK );
+		assert_int_eq( v, k * 111 );
+	}
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_pipeline, "pipelined key command tests" )
+{
+	suite_before( before );
+	suite_after( after );
+
+	suite_add( key_pipeline_sequential );
+	suite_add( key_pipeline_concurrent );
+	suite_add( key_pipeline_abandoned );
+}
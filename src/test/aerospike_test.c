@@ -41,6 +41,18 @@ int g_port = 3000;
 static char g_user[AS_USER_SIZE];
 static char g_password[AS_PASSWORD_HASH_SIZE];
 
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+void test_config_init(as_config * config)
+{
+	as_config_init(config);
+	as_config_add_host(config, g_host, g_port);
+	as_config_set_user(config, g_user, g_password);
+	as_policies_init(&config->policies);
+}
+
 /******************************************************************************
  * STATIC FUNCTIONS
  *****************************************************************************/
@@ -123,13 +135,10 @@ static bool before(atf_plan * plan) {
     }
 	
 	as_config config;
-	as_config_init(&config);
-	as_config_add_host(&config, g_host, g_port);
-	as_config_set_user(&config, g_user, g_password);
+	test_config_init(&config);
 	config.lua.cache_enabled = false;
 	strcpy(config.lua.system_path, "modules/lua-core/src");
 	strcpy(config.lua.user_path, "src/test/lua");
-    as_policies_init(&config.policies);
 
 	as_error err;
 	as_error_reset(&err);
@@ -189,6 +198,10 @@ PLAN( aerospike_test ) {
     plan_add( key_apply );
     plan_add( key_apply2 );
     plan_add( key_operate );
+    plan_add( key_async );
+    plan_add( key_pipeline );
+    plan_add( key_pack );
+    plan_add( key_lazy );
     
     // aerospike_info module
     plan_add( info_basics );
@@ -210,10 +223,17 @@ PLAN( aerospike_test ) {
 
     // aerospike_scan module
     plan_add( batch_get );
+    plan_add( batch_retry );
+
+    // as_cluster module
+    plan_add( cluster_partition );
+    plan_add( cluster_breaker );
+    plan_add( cluster_snapshot );
 
     // as_policy module
     plan_add( policy_read );
     plan_add( policy_scan );
+    plan_add( policy_batch );
 
     // as_ldt module
     plan_add( ldt_lmap );
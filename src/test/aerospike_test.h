@@ -18,3 +18,11 @@
 
 #define MAX_HOST_SIZE 1024
 extern char g_host[MAX_HOST_SIZE];
+extern int g_port;
+
+struct as_config_s;
+
+/**
+ * Initialize config for a test client connecting to the test cluster.
+ */
+void test_config_init(struct as_config_s * config);
@@ -0,0 +1,7 @@
+function spin(rec, n)
+    local x = 0
+    for i=1, n do
+        x = x + 1
+    end
+    return x
+end
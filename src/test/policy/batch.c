@@ -0,0 +1,79 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_policy.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( policy_batch_init , "init" )
+{
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+
+	assert_int_eq(policy.timeout, AS_POLICY_TIMEOUT_DEFAULT);
+	assert_int_eq(policy.socket_timeout, 0);
+	assert_int_eq(policy.retry, AS_POLICY_RETRY_DEFAULT);
+}
+
+TEST( policy_batch_resolve_1 , "resolve: global.batch (init)" )
+{
+	as_policies global;
+	as_policies_init(&global);
+	as_policies_resolve(&global);
+
+	// check timeout and retry
+	assert_int_eq(global.batch.timeout, global.timeout);
+	assert_int_eq(global.batch.retry, global.retry);
+}
+
+TEST( policy_batch_resolve_2 , "resolve: global.retry=3, global.batch.socket_timeout=100" )
+{
+	as_policies global;
+	as_policies_init(&global);
+
+	global.retry = 3;
+	global.batch.socket_timeout = 100;
+
+	as_policies_resolve(&global);
+
+	// check retry
+	assert_int_eq(global.batch.retry, 3);
+
+	// socket timeout is not resolved from global policy
+	assert_int_eq(global.batch.socket_timeout, 100);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( policy_batch, "as_policy_batch tests" )
+{
+	suite_add( policy_batch_init );
+	suite_add( policy_batch_resolve_1 );
+	suite_add( policy_batch_resolve_2 );
+}
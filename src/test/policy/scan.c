@@ -36,6 +36,7 @@ TEST( policy_scan_init , "init" )
 
 	assert_int_eq(policy.timeout, 0);
 	assert_int_eq(policy.fail_on_cluster_change, false);
+	assert_int_eq(policy.borrow_bins, false);
 }
 
 TEST( policy_scan_resolve_1 , "resolve: global.scan (init)" )
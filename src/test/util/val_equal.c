@@ -0,0 +1,122 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_boolean.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_double.h>
+#include <aerospike/as_geojson.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_string.h>
+#include <string.h>
+#include "val_equal.h"
+
+/*****************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct {
+	const as_map * other;
+	bool equal;
+} map_equal_data;
+
+/*****************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static bool
+map_equal_callback(const as_val * key, const as_val * val, void * udata)
+{
+	map_equal_data * data = (map_equal_data *) udata;
+	data->equal = val_equal(val, as_map_get(data->other, key));
+	return data->equal;
+}
+
+static bool
+list_equal(const as_list * a, const as_list * b)
+{
+	uint32_t size = as_list_size(a);
+
+	if ( size != as_list_size(b) ) {
+		return false;
+	}
+
+	for ( uint32_t i = 0; i < size; i++ ) {
+		if ( ! val_equal(as_list_get(a, i), as_list_get(b, i)) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool
+map_equal(const as_map * a, const as_map * b)
+{
+	if ( as_map_size(a) != as_map_size(b) ) {
+		return false;
+	}
+
+	map_equal_data data = { .other = b, .equal = true };
+	as_map_foreach(a, map_equal_callback, &data);
+	return data.equal;
+}
+
+/*****************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * Compare two values by type and content. Maps are compared by lookup, so
+ * their iteration order does not matter.
+ */
+bool
+val_equal(const as_val * a, const as_val * b)
+{
+	if ( ! a || ! b ) {
+		return a == b;
+	}
+
+	if ( as_val_type(a) != as_val_type(b) ) {
+		return false;
+	}
+
+	switch ( as_val_type(a) ) {
+		case AS_NIL:
+			return true;
+		case AS_BOOLEAN:
+			return as_boolean_get((as_boolean *) a) == as_boolean_get((as_boolean *) b);
+		case AS_INTEGER:
+			return as_integer_get((as_integer *) a) == as_integer_get((as_integer *) b);
+		case AS_DOUBLE:
+			return as_double_get((as_double *) a) == as_double_get((as_double *) b);
+		case AS_STRING:
+			return strcmp(as_string_get((as_string *) a), as_string_get((as_string *) b)) == 0;
+		case AS_GEOJSON:
+			return strcmp(as_geojson_get((as_geojson *) a), as_geojson_get((as_geojson *) b)) == 0;
+		case AS_BYTES: {
+			uint32_t size = as_bytes_size((as_bytes *) a);
+			return size == as_bytes_size((as_bytes *) b) &&
+				memcmp(as_bytes_get((as_bytes *) a), as_bytes_get((as_bytes *) b), size) == 0;
+		}
+		case AS_LIST:
+			return list_equal((as_list *) a, (as_list *) b);
+		case AS_MAP:
+			return map_equal((as_map *) a, (as_map *) b);
+		default:
+			return false;
+	}
+}